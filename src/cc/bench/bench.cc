@@ -0,0 +1,151 @@
+#include "cc/bench/bench.h"
+
+#include <ftw.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+
+#include "cc/io/file.h"
+#include "cc/utils/clock.h"
+
+using std::string;
+using std::vector;
+using io::File;
+using utils::Error;
+using utils::ErrorOr;
+using utils::JsonWriter;
+using utils::MonotonicNowNs;
+
+namespace bench {
+namespace {
+int RemoveEntry(const char* path, const struct stat*, int, struct FTW*) {
+  return remove(path);
+}
+} // namespace
+
+void BenchmarkState::PauseTiming() {
+  elapsed_ns_ += MonotonicNowNs() - resumed_at_ns_;
+}
+
+void BenchmarkState::ResumeTiming() {
+  resumed_at_ns_ = MonotonicNowNs();
+}
+
+Error Benchmarks::Run(const string& name,
+                      const std::function<Error(BenchmarkState*)>& body) {
+  BenchmarkState state;
+  const uint64_t min_ns = static_cast<uint64_t>(min_seconds_ * 1e9);
+  do {
+    state.ResumeTiming();
+    PASS_ERROR(body(&state));
+    state.PauseTiming();
+    state.iteration_++;
+  } while (state.elapsed_ns_ < min_ns);
+  results_.push_back({name,
+                      state.iteration_,
+                      state.elapsed_ns_,
+                      state.bytes_,
+                      state.items_});
+  return Error::Ok();
+}
+
+void Benchmarks::AddContext(const string& key, uint64_t value) {
+  ContextValue context_value;
+  context_value.key = key;
+  context_value.type = ContextValue::UINT;
+  context_value.uint_value = value;
+  context_.push_back(context_value);
+}
+
+void Benchmarks::AddContext(const string& key, double value) {
+  ContextValue context_value;
+  context_value.key = key;
+  context_value.type = ContextValue::DOUBLE;
+  context_value.double_value = value;
+  context_.push_back(context_value);
+}
+
+void Benchmarks::AddContext(const string& key, const string& value) {
+  ContextValue context_value;
+  context_value.key = key;
+  context_value.type = ContextValue::STRING;
+  context_value.string_value = value;
+  context_.push_back(context_value);
+}
+
+string Benchmarks::ToJson() const {
+  JsonWriter writer;
+  writer.BeginObject();
+  writer.Key("context");
+  writer.BeginObject();
+  for (const ContextValue& value : context_) {
+    writer.Key(value.key);
+    switch (value.type) {
+      case ContextValue::UINT:
+        writer.Uint(value.uint_value);
+        break;
+      case ContextValue::DOUBLE:
+        writer.Double(value.double_value);
+        break;
+      case ContextValue::STRING:
+        writer.String(value.string_value);
+        break;
+    }
+  }
+  writer.EndObject();
+  writer.Key("benchmarks");
+  writer.BeginArray();
+  for (const BenchmarkResult& result : results_) {
+    const double seconds = result.elapsed_ns / 1e9;
+    writer.BeginObject();
+    writer.Key("name");
+    writer.String(result.name);
+    writer.Key("iterations");
+    writer.Uint(result.iterations);
+    writer.Key("elapsed_ns");
+    writer.Uint(result.elapsed_ns);
+    writer.Key("ns_per_iteration");
+    writer.Double(static_cast<double>(result.elapsed_ns) / result.iterations);
+    writer.Key("bytes_per_second");
+    writer.Double(seconds > 0 ? result.bytes / seconds : 0);
+    writer.Key("items_per_second");
+    writer.Double(seconds > 0 ? result.items / seconds : 0);
+    writer.EndObject();
+  }
+  writer.EndArray();
+  writer.EndObject();
+  writer.Newline();
+  return writer.str();
+}
+
+ErrorOr<string> MakeTempDir(const string& parent) {
+  const string path_template = parent + "/boombox_bench.XXXXXX";
+  vector<char> path(path_template.begin(), path_template.end());
+  path.push_back('\0');
+  RETURN_ERROR_IF(mkdtemp(path.data()) == nullptr,
+                  string("Could not create temp dir: ") + strerror(errno));
+  return ErrorOr<string>(string(path.data()));
+}
+
+Error RemoveTree(const string& path) {
+  const int result =
+      nftw(path.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+  RETURN_ERROR_SYSCALL(result, "Could not remove " + path);
+  return Error::Ok();
+}
+
+Error WriteReport(const Benchmarks& benchmarks, const string& out_path) {
+  const string json = benchmarks.ToJson();
+  if (out_path.empty()) {
+    std::cout << json << std::flush;
+    return Error::Ok();
+  }
+  ErrorOr<File> error_or_out_file = File::Create(out_path, 0664);
+  PASS_ERROR(error_or_out_file.error());
+  File out_file = error_or_out_file.move();
+  PASS_ERROR(out_file.Write(json.data(), json.size()).error());
+  return Error::Ok();
+}
+
+} // namespace bench
@@ -0,0 +1,88 @@
+#ifndef BENCH_BENCH_H_
+#define BENCH_BENCH_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "cc/utils/error.h"
+#include "cc/utils/json_writer.h"
+
+namespace bench {
+
+// Handed to every iteration of a benchmark so it can report how much work it
+// did and exclude setup or cleanup from the measurement.
+class BenchmarkState {
+ public:
+  uint64_t iteration() const { return iteration_; }
+  void AddBytes(uint64_t bytes) { bytes_ += bytes; }
+  void AddItems(uint64_t items) { items_ += items; }
+  void PauseTiming();
+  void ResumeTiming();
+
+ private:
+  uint64_t iteration_ = 0;
+  uint64_t bytes_ = 0;
+  uint64_t items_ = 0;
+  uint64_t elapsed_ns_ = 0;
+  uint64_t resumed_at_ns_ = 0;
+
+  friend class Benchmarks;
+};
+
+struct BenchmarkResult {
+  std::string name;
+  uint64_t iterations;
+  uint64_t elapsed_ns;
+  uint64_t bytes;
+  uint64_t items;
+};
+
+// Runs benchmarks and reports them as a single JSON document:
+//
+//   {"context": {...}, "benchmarks": [{"name": ..., "ns_per_iteration": ...,
+//    "bytes_per_second": ..., "items_per_second": ...}, ...]}
+class Benchmarks {
+ public:
+  explicit Benchmarks(double min_seconds) : min_seconds_(min_seconds) {}
+
+  // Repeats body until min_seconds of measured time have passed, running it at
+  // least once. Stops at the first error.
+  utils::Error Run(const std::string& name,
+                   const std::function<utils::Error(BenchmarkState*)>& body);
+
+  // Recorded verbatim under "context" so results can be tied to the input.
+  void AddContext(const std::string& key, uint64_t value);
+  void AddContext(const std::string& key, double value);
+  void AddContext(const std::string& key, const std::string& value);
+
+  const std::vector<BenchmarkResult>& results() const { return results_; }
+  std::string ToJson() const;
+
+ private:
+  struct ContextValue {
+    std::string key;
+    enum { UINT, DOUBLE, STRING } type;
+    uint64_t uint_value;
+    double double_value;
+    std::string string_value;
+  };
+
+  const double min_seconds_;
+  std::vector<ContextValue> context_;
+  std::vector<BenchmarkResult> results_;
+};
+
+// Creates a fresh directory below parent and returns its path.
+utils::ErrorOr<std::string> MakeTempDir(const std::string& parent);
+
+// Removes path and everything below it.
+utils::Error RemoveTree(const std::string& path);
+
+// Writes the report to the file named by --out, or to stdout if unset.
+utils::Error WriteReport(const Benchmarks& benchmarks,
+                         const std::string& out_path);
+
+} // namespace bench
+
+#endif // BENCH_BENCH_H_
@@ -0,0 +1,155 @@
+#include <random>
+#include <string>
+#include <vector>
+
+#include "cc/bench/bench.h"
+#include "cc/bench/synthetic_image.h"
+#include "cc/exec/elf/elf.h"
+#include "cc/exec/xbe/kernel_thunks.h"
+#include "cc/exec/xbe/signature_scanner.h"
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/io/file.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+
+using std::string;
+using std::vector;
+using bench::Benchmarks;
+using bench::BenchmarkState;
+using bench::MakeTempDir;
+using bench::RemoveTree;
+using bench::SyntheticXbe;
+using bench::SyntheticXbeSpec;
+using bench::SyntheticXbeSpecFromFlags;
+using bench::WriteReport;
+using bench::WriteSyntheticXbe;
+using exec::elf::MakeElfFromXbe;
+using exec::xbe::ArrayView;
+using exec::xbe::DecodeKernelThunks;
+using exec::xbe::kSectionFlagExecutableMask;
+using exec::xbe::KernelImport;
+using exec::xbe::Signature;
+using exec::xbe::SignatureMatch;
+using exec::xbe::SignatureScanner;
+using exec::xbe::XbeSectionHeader;
+using exec::xbe::XbeImage;
+using io::File;
+using utils::Error;
+using utils::ErrorOr;
+using utils::Flags;
+
+// Benchmarks XBE to ELF conversion and analysis of a generated XBE. Flags:
+//   --sections, --section_size, --kernel_imports, --seed: shape of the
+//   generated XBE.
+//   --signatures: size of the signature database to scan with (default 2000).
+//   --min_time: seconds to spend in each benchmark (default 1).
+//   --work_dir: where the XBE and ELF go (default /tmp).
+//   --out: file to write the JSON report to (default stdout).
+
+// Half of the signatures are cut out of the first section, so they match at
+// least once, with every eighth byte a wildcard; the rest are random.
+vector<Signature> MakeSignatures(const XbeImage& xbe,
+                                 uint32_t signature_num,
+                                 uint32_t seed) {
+  static const size_t kSignatureSize = 16;
+  std::mt19937 random(seed);
+  const ArrayView<char> text = xbe.section_bytes(0);
+  vector<Signature> signatures;
+  for (uint32_t i = 0; i < signature_num; i++) {
+    Signature signature;
+    signature.name = "sig" + std::to_string(i);
+    const size_t offset = random() % (text.size() - kSignatureSize);
+    for (size_t j = 0; j < kSignatureSize; j++) {
+      signature.bytes.push_back(i % 2 == 0 ? text[offset + j] : random());
+      signature.mask.push_back(j % 8 != 7);
+    }
+    signatures.push_back(std::move(signature));
+  }
+  return signatures;
+}
+
+Error RunBenchmarks(Benchmarks* benchmarks,
+                    const SyntheticXbe& xbe,
+                    const string& xbe_path,
+                    const string& elf_path,
+                    uint32_t signature_num) {
+  auto convert = [&](BenchmarkState* state) -> Error {
+    ErrorOr<XbeImage> error_or_xbe = XbeImage::Open(xbe_path);
+    PASS_ERROR(error_or_xbe.error());
+    ErrorOr<File> error_or_elf_file = File::Create(elf_path, 0775);
+    PASS_ERROR(error_or_elf_file.error());
+    File elf_file = error_or_elf_file.move();
+    PASS_ERROR(MakeElfFromXbe(error_or_xbe.get(), &elf_file));
+    state->AddBytes(xbe.image_size_bytes);
+    state->AddItems(1);
+    return Error::Ok();
+  };
+  PASS_ERROR(benchmarks->Run("make_elf_from_xbe", convert));
+
+  ErrorOr<XbeImage> error_or_xbe = XbeImage::Open(xbe_path);
+  PASS_ERROR(error_or_xbe.error());
+  auto decode_thunks = [&](BenchmarkState* state) -> Error {
+    ErrorOr<vector<KernelImport>> error_or_imports =
+        DecodeKernelThunks(error_or_xbe.get());
+    PASS_ERROR(error_or_imports.error());
+    state->AddItems(error_or_imports.get().size());
+    return Error::Ok();
+  };
+  PASS_ERROR(benchmarks->Run("decode_kernel_thunks", decode_thunks));
+
+  const vector<Signature> signatures =
+      MakeSignatures(error_or_xbe.get(), signature_num, 1);
+  ErrorOr<SignatureScanner> error_or_scanner =
+      SignatureScanner::Compile(signatures);
+  PASS_ERROR(error_or_scanner.error());
+  auto scan = [&](BenchmarkState* state) -> Error {
+    const vector<SignatureMatch> matches =
+        error_or_scanner.get().ScanXbe(error_or_xbe.get());
+    for (const XbeSectionHeader& section_header :
+         error_or_xbe.get().section_headers()) {
+      if (section_header.section_flags & kSectionFlagExecutableMask) {
+        state->AddBytes(section_header.file_size);
+      }
+    }
+    state->AddItems(matches.size());
+    return Error::Ok();
+  };
+  PASS_ERROR(benchmarks->Run("scan_signatures", scan));
+  return Error::Ok();
+}
+
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  const SyntheticXbeSpec spec = SyntheticXbeSpecFromFlags(flags);
+  ErrorOr<string> error_or_work_dir =
+      MakeTempDir(flags.GetString("work_dir", "/tmp"));
+  CHECK_ERROR(error_or_work_dir.error());
+  const string work_dir = error_or_work_dir.get();
+  const string xbe_path = work_dir + "/default.xbe";
+
+  ErrorOr<File> error_or_xbe_file = File::Create(xbe_path, 0664);
+  CHECK_ERROR(error_or_xbe_file.error());
+  File xbe_file = error_or_xbe_file.move();
+  ErrorOr<SyntheticXbe> error_or_xbe = WriteSyntheticXbe(spec, &xbe_file);
+  CHECK_ERROR(error_or_xbe.error());
+  CHECK_ERROR(xbe_file.Close());
+
+  Benchmarks benchmarks(flags.GetDouble("min_time", 1));
+  benchmarks.AddContext("seed", static_cast<uint64_t>(spec.seed));
+  benchmarks.AddContext("sections", static_cast<uint64_t>(spec.section_count));
+  benchmarks.AddContext("section_size",
+                        static_cast<uint64_t>(spec.section_size));
+  benchmarks.AddContext("signatures", flags.GetUint("signatures", 2000));
+  benchmarks.AddContext("kernel_imports",
+                        static_cast<uint64_t>(spec.kernel_import_count));
+  benchmarks.AddContext("image_size_bytes",
+                        error_or_xbe.get().image_size_bytes);
+  CHECK_ERROR(RunBenchmarks(&benchmarks,
+                            error_or_xbe.get(),
+                            xbe_path,
+                            xbe_path + ".bin",
+                            flags.GetUint("signatures", 2000)));
+  CHECK_ERROR(RemoveTree(work_dir));
+  CHECK_ERROR(WriteReport(benchmarks, flags.GetString("out", "")));
+  return 0;
+}
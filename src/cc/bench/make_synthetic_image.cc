@@ -0,0 +1,48 @@
+#include <iostream>
+#include <string>
+
+#include "cc/bench/synthetic_image.h"
+#include "cc/io/file.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+
+using std::string;
+using bench::SyntheticXbe;
+using bench::SyntheticXbeSpecFromFlags;
+using bench::SyntheticXdfsImage;
+using bench::SyntheticXdfsSpecFromFlags;
+using bench::WriteSyntheticXbe;
+using bench::WriteSyntheticXdfsImage;
+using io::File;
+using utils::ErrorOr;
+using utils::Flags;
+
+// Usage: make_synthetic_image (xdfs|xbe) <output path> [flags]
+// See synthetic_image.h for the flags accepted by each kind.
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 2,
+             "Must specify image kind (xdfs or xbe) and output path.");
+  const string& kind = flags.positional()[0];
+  CHECK_INFO(kind == "xdfs" || kind == "xbe",
+             "Image kind must be xdfs or xbe.");
+
+  ErrorOr<File> error_or_file = File::Create(flags.positional()[1], 0664);
+  CHECK_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  if (kind == "xdfs") {
+    ErrorOr<SyntheticXdfsImage> error_or_image =
+        WriteSyntheticXdfsImage(SyntheticXdfsSpecFromFlags(flags), &file);
+    CHECK_ERROR(error_or_image.error());
+    std::cout << "Wrote " << error_or_image.get().file_paths.size()
+              << " files in " << error_or_image.get().dir_paths.size()
+              << " directories." << std::endl;
+  } else {
+    ErrorOr<SyntheticXbe> error_or_xbe =
+        WriteSyntheticXbe(SyntheticXbeSpecFromFlags(flags), &file);
+    CHECK_ERROR(error_or_xbe.error());
+    std::cout << "Wrote " << error_or_xbe.get().image_size_bytes
+              << " byte XBE." << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,470 @@
+#include "cc/bench/synthetic_image.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+#include "cc/exec/xbe/kernel_exports.h"
+#include "cc/exec/xbe/kernel_thunks.h"
+#include "cc/exec/xbe/xbe_common.h"
+#include "cc/io/xdfs/xdfs_common.h"
+
+using std::string;
+using std::vector;
+using exec::xbe::kEntryMemAddrXorKey;
+using exec::xbe::kKernelThunkMemAddrXorKey;
+using exec::xbe::kKernelThunkOrdinalFlag;
+using exec::xbe::kMaxKernelOrdinal;
+using exec::xbe::kSectionFlagExecutableMask;
+using exec::xbe::kSectionFlagPreloadMask;
+using exec::xbe::kSectionFlagWritableMask;
+using exec::xbe::kXbeCertificateSize;
+using exec::xbe::kXbeMagicNumber;
+using exec::xbe::XbeImageHeader;
+using exec::xbe::XbeSectionHeader;
+using io::File;
+using io::xdfs::kAttributeIsDirectoryMask;
+using io::xdfs::kAttributeIsNormalMask;
+using io::xdfs::kDirEntryMaskSizeBytes;
+using io::xdfs::kDWordsBytes;
+using io::xdfs::kSectorSizeBytes;
+using io::xdfs::SectorToOffset;
+using utils::Error;
+using utils::ErrorOr;
+using utils::Flags;
+
+namespace bench {
+namespace {
+static const uint32_t kVolumeDescriptorSector = 32;
+static const size_t kVolumeDescriptorPart2OffsetBytes = 2028;
+static const char kMicrosoftXboxMedia[] = "MICROSOFT*XBOX*MEDIA";
+static const size_t kMicrosoftXboxMediaSize = 20;
+static const size_t kWriteChunkBytes = 64 * 1024;
+
+// xorshift64*; good enough for filler data and cheap enough not to dominate
+// generation time.
+class Random {
+ public:
+  explicit Random(uint64_t seed) : state_(seed * 0x9e3779b97f4a7c15ull + 1) {}
+
+  uint64_t Next() {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return state_ * 0x2545f4914f6cdd1dull;
+  }
+
+  // Returns a value in [low, high].
+  uint32_t Uniform(uint32_t low, uint32_t high) {
+    return low + Next() % (static_cast<uint64_t>(high) - low + 1);
+  }
+
+  void Fill(char* buffer, size_t size) {
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+      const uint64_t value = Next();
+      memcpy(buffer + i, &value, sizeof(uint64_t));
+    }
+    if (i < size) {
+      const uint64_t value = Next();
+      memcpy(buffer + i, &value, size - i);
+    }
+  }
+
+ private:
+  uint64_t state_;
+};
+
+struct Node {
+  string name;
+  string path;
+  bool is_dir;
+  uint32_t size_bytes;
+  uint32_t start_sector;
+  uint64_t content_seed;
+  vector<size_t> children;
+};
+
+struct TableEntry {
+  size_t node;
+  int left;
+  int right;
+  uint32_t offset_bytes;
+};
+
+// Same ordering Xdfs uses to search directory tables.
+bool NameLess(const string& left, const string& right) {
+  return std::lexicographical_compare(
+      left.begin(), left.end(), right.begin(), right.end(),
+      [](char l, char r) { return std::toupper(l) < std::toupper(r); });
+}
+
+uint32_t EntrySizeBytes(const string& name) {
+  const uint32_t size = kDirEntryMaskSizeBytes + name.size();
+  return (size + kDWordsBytes - 1) / kDWordsBytes * kDWordsBytes;
+}
+
+// Lays the children of a directory out as a search tree in pre-order, which
+// puts the tree root at the start of the table as Xdfs expects.
+ErrorOr<vector<TableEntry>> LayoutTable(const vector<Node>& nodes,
+                                        vector<size_t> children,
+                                        double imbalance) {
+  std::sort(children.begin(), children.end(),
+            [&nodes](size_t left, size_t right) {
+              return NameLess(nodes[left].name, nodes[right].name);
+            });
+  struct Range {
+    size_t low;
+    size_t high;
+    int parent;
+    bool is_left;
+  };
+  vector<TableEntry> entries;
+  vector<Range> ranges = { {0, children.size(), -1, false} };
+  while (!ranges.empty()) {
+    const Range range = ranges.back();
+    ranges.pop_back();
+    if (range.low >= range.high) {
+      continue;
+    }
+    const size_t pivot = range.low + static_cast<size_t>(
+        (range.high - range.low - 1) * (0.5 + imbalance / 2));
+    const int index = entries.size();
+    entries.push_back({children[pivot], -1, -1, 0});
+    if (range.parent >= 0) {
+      if (range.is_left) {
+        entries[range.parent].left = index;
+      } else {
+        entries[range.parent].right = index;
+      }
+    }
+    // Pushed in reverse so the left subtree is emitted first.
+    ranges.push_back({pivot + 1, range.high, index, false});
+    ranges.push_back({range.low, pivot, index, true});
+  }
+
+  uint32_t offset_bytes = 0;
+  for (TableEntry& entry : entries) {
+    const uint32_t size = EntrySizeBytes(nodes[entry.node].name);
+    // Entries never straddle a sector boundary.
+    if (offset_bytes % kSectorSizeBytes + size > kSectorSizeBytes) {
+      offset_bytes += kSectorSizeBytes - offset_bytes % kSectorSizeBytes;
+    }
+    entry.offset_bytes = offset_bytes;
+    offset_bytes += size;
+  }
+  RETURN_ERROR_IF(offset_bytes / kDWordsBytes > UINT16_MAX,
+                  "Directory table too large for 16 bit child offsets.");
+  return ErrorOr<vector<TableEntry>>(std::move(entries));
+}
+
+uint32_t TableSizeBytes(const vector<Node>& nodes,
+                        const vector<TableEntry>& entries) {
+  uint32_t end = 0;
+  for (const TableEntry& entry : entries) {
+    end = std::max(end,
+                   entry.offset_bytes + EntrySizeBytes(nodes[entry.node].name));
+  }
+  return end;
+}
+
+vector<char> SerializeTable(const vector<Node>& nodes,
+                            const vector<TableEntry>& entries,
+                            uint32_t size_bytes) {
+  const uint32_t sectors =
+      (size_bytes + kSectorSizeBytes - 1) / kSectorSizeBytes;
+  vector<char> table(SectorToOffset(sectors), '\xff');
+  for (const TableEntry& entry : entries) {
+    const Node& node = nodes[entry.node];
+    const uint16_t left = entry.left < 0
+        ? 0 : entries[entry.left].offset_bytes / kDWordsBytes;
+    const uint16_t right = entry.right < 0
+        ? 0 : entries[entry.right].offset_bytes / kDWordsBytes;
+    const uint8_t attributes =
+        node.is_dir ? kAttributeIsDirectoryMask : kAttributeIsNormalMask;
+    const uint8_t name_size = node.name.size();
+    char* out = table.data() + entry.offset_bytes;
+    memcpy(out, &left, 2);
+    memcpy(out + 2, &right, 2);
+    memcpy(out + 4, &node.start_sector, 4);
+    memcpy(out + 8, &node.size_bytes, 4);
+    memcpy(out + 12, &attributes, 1);
+    memcpy(out + 13, &name_size, 1);
+    memcpy(out + kDirEntryMaskSizeBytes, node.name.data(), name_size);
+  }
+  return table;
+}
+
+Error WriteAll(File* file, const char* buffer, size_t size) {
+  while (size > 0) {
+    ErrorOr<ssize_t> error_or_written = file->Write(buffer, size);
+    PASS_ERROR(error_or_written.error());
+    RETURN_ERROR_IF(error_or_written.get() == 0, "Write made no progress.");
+    buffer += error_or_written.get();
+    size -= error_or_written.get();
+  }
+  return Error::Ok();
+}
+
+Error WriteFileContents(const Node& node, File* image_file) {
+  PASS_ERROR(image_file->Seek(SectorToOffset(node.start_sector)).error());
+  Random random(node.content_seed);
+  vector<char> buffer(kWriteChunkBytes);
+  for (uint32_t written = 0; written < node.size_bytes;) {
+    const size_t size = std::min<size_t>(buffer.size(),
+                                         node.size_bytes - written);
+    random.Fill(buffer.data(), size);
+    PASS_ERROR(WriteAll(image_file, buffer.data(), size));
+    written += size;
+  }
+  return Error::Ok();
+}
+
+string RandomName(Random* random, const string& prefix, size_t index) {
+  static const char kLetters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  // The random part comes first so that creation order and name order differ.
+  string name;
+  for (int i = 0; i < 4; i++) {
+    name += kLetters[random->Next() % 26];
+  }
+  return name + "_" + prefix + std::to_string(index);
+}
+} // namespace
+
+ErrorOr<SyntheticXdfsImage> WriteSyntheticXdfsImage(
+    const SyntheticXdfsSpec& spec, File* image_file) {
+  RETURN_ERROR_IF(spec.min_file_size > spec.max_file_size,
+                  "min_file_size must not exceed max_file_size.");
+  RETURN_ERROR_IF(spec.imbalance < 0 || spec.imbalance > 1,
+                  "imbalance must be in [0, 1].");
+  Random random(spec.seed);
+
+  vector<Node> nodes;
+  nodes.push_back({"", "/", true, 0, 0, 0, {}});
+  vector<size_t> level = {0};
+  for (uint32_t depth = 0; depth < spec.dir_depth; depth++) {
+    vector<size_t> next_level;
+    for (const size_t parent : level) {
+      for (uint32_t i = 0; i < spec.dir_fanout; i++) {
+        const size_t index = nodes.size();
+        const string name = RandomName(&random, "DIR", index);
+        nodes.push_back(
+            {name, nodes[parent].path + name + "/", true, 0, 0, 0, {}});
+        nodes[parent].children.push_back(index);
+        next_level.push_back(index);
+      }
+    }
+    if (next_level.empty()) {
+      break;
+    }
+    level = next_level;
+  }
+  const size_t dir_count = nodes.size();
+  // Every leaf directory gets a file, since empty directories have no table.
+  RETURN_ERROR_IF(spec.file_count < level.size(),
+                  "file_count must be at least the number of leaf "
+                  "directories (" + std::to_string(level.size()) + ").");
+
+  for (uint32_t i = 0; i < spec.file_count; i++) {
+    const size_t parent = i < level.size()
+        ? level[i] : random.Uniform(0, dir_count - 1);
+    const size_t index = nodes.size();
+    const string name = RandomName(&random, "FILE", index) + ".BIN";
+    nodes.push_back({name,
+                     nodes[parent].path + name,
+                     false,
+                     random.Uniform(spec.min_file_size, spec.max_file_size),
+                     0,
+                     random.Next(),
+                     {}});
+    nodes[parent].children.push_back(index);
+  }
+
+  // Directory tables only depend on names, so they can be sized before any
+  // sector is allocated.
+  vector<vector<TableEntry>> tables(dir_count);
+  for (size_t i = 0; i < dir_count; i++) {
+    ErrorOr<vector<TableEntry>> error_or_table =
+        LayoutTable(nodes, nodes[i].children, spec.imbalance);
+    PASS_ERROR(error_or_table.error());
+    tables[i] = error_or_table.move();
+    nodes[i].size_bytes = TableSizeBytes(nodes, tables[i]);
+  }
+
+  uint32_t next_sector = kVolumeDescriptorSector + 1;
+  for (Node& node : nodes) {
+    node.start_sector = next_sector;
+    next_sector += (node.size_bytes + kSectorSizeBytes - 1) / kSectorSizeBytes;
+  }
+
+  SyntheticXdfsImage image;
+  image.image_size_bytes = SectorToOffset(next_sector);
+  for (size_t i = 0; i < nodes.size(); i++) {
+    if (i >= dir_count) {
+      image.file_paths.push_back(nodes[i].path);
+      image.total_file_bytes += nodes[i].size_bytes;
+    } else if (i > 0) {
+      image.dir_paths.push_back(nodes[i].path);
+    }
+  }
+  image.dir_paths.insert(image.dir_paths.begin(), "/");
+
+  vector<char> descriptor(kSectorSizeBytes, 0);
+  memcpy(descriptor.data(), kMicrosoftXboxMedia, kMicrosoftXboxMediaSize);
+  memcpy(descriptor.data() + 20, &nodes[0].start_sector, 4);
+  memcpy(descriptor.data() + 24, &nodes[0].size_bytes, 4);
+  memcpy(descriptor.data() + kVolumeDescriptorPart2OffsetBytes,
+         kMicrosoftXboxMedia, kMicrosoftXboxMediaSize);
+  PASS_ERROR(image_file->Seek(SectorToOffset(kVolumeDescriptorSector)).error());
+  PASS_ERROR(WriteAll(image_file, descriptor.data(), descriptor.size()));
+
+  for (size_t i = 0; i < dir_count; i++) {
+    const vector<char> table =
+        SerializeTable(nodes, tables[i], nodes[i].size_bytes);
+    PASS_ERROR(image_file->Seek(SectorToOffset(nodes[i].start_sector)).error());
+    PASS_ERROR(WriteAll(image_file, table.data(), table.size()));
+  }
+  for (size_t i = dir_count; i < nodes.size(); i++) {
+    PASS_ERROR(WriteFileContents(nodes[i], image_file));
+  }
+  // Pad the image so that the last sector can be read in full.
+  const char zero = 0;
+  PASS_ERROR(image_file->Seek(image.image_size_bytes - 1).error());
+  PASS_ERROR(WriteAll(image_file, &zero, 1));
+  return ErrorOr<SyntheticXdfsImage>(std::move(image));
+}
+
+namespace {
+static const uint32_t kXbeBaseMemAddr = 0x10000;
+static const uint32_t kXbePageSize = 0x1000;
+static const uint32_t kCertificateOffset = sizeof(XbeImageHeader);
+static const uint32_t kSectionHeadersOffset =
+    kCertificateOffset + kXbeCertificateSize;
+uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+void PutString(vector<char>* image, uint32_t offset, const string& value) {
+  memcpy(image->data() + offset, value.c_str(), value.size() + 1);
+}
+} // namespace
+
+ErrorOr<SyntheticXbe> WriteSyntheticXbe(const SyntheticXbeSpec& spec,
+                                        File* xbe_file) {
+  RETURN_ERROR_IF(spec.section_count == 0, "section_count must be positive.");
+  RETURN_ERROR_IF((spec.kernel_import_count + 1) * sizeof(uint32_t)
+                  > spec.section_size,
+                  "The kernel thunk table does not fit in a section.");
+
+  vector<string> names;
+  for (uint32_t i = 0; i < spec.section_count; i++) {
+    names.push_back(i == 0 ? ".text" : ".sect" + std::to_string(i));
+  }
+  uint32_t offset =
+      kSectionHeadersOffset + spec.section_count * sizeof(XbeSectionHeader);
+  vector<uint32_t> name_offsets;
+  for (const string& name : names) {
+    name_offsets.push_back(offset);
+    offset += name.size() + 1;
+  }
+  // Head and tail shared page reference counts, two bytes each.
+  offset = AlignUp(offset, 4);
+  const uint32_t page_ref_counts_offset = offset;
+  offset += spec.section_count * 2 * sizeof(uint16_t);
+  const uint32_t headers_size = AlignUp(offset, 4);
+  const uint32_t first_section_offset = AlignUp(headers_size, kXbePageSize);
+  const uint32_t section_stride = AlignUp(spec.section_size, kXbePageSize);
+  const uint32_t image_size =
+      first_section_offset + section_stride * spec.section_count;
+
+  vector<char> image(image_size, 0);
+  Random random(spec.seed);
+  vector<XbeSectionHeader> section_headers;
+  for (uint32_t i = 0; i < spec.section_count; i++) {
+    const uint32_t file_offset = first_section_offset + section_stride * i;
+    uint32_t flags = kSectionFlagPreloadMask;
+    if (i == 0) {
+      flags |= kSectionFlagExecutableMask;
+    } else if (i % 2 == 1) {
+      flags |= kSectionFlagWritableMask;
+    }
+    // Leave some sections to be loaded on demand.
+    if (i % 3 == 2) {
+      flags &= ~kSectionFlagPreloadMask;
+    }
+    XbeSectionHeader header = {};
+    header.section_flags = flags;
+    header.virt_mem_addr = kXbeBaseMemAddr + file_offset;
+    header.virt_mem_size = spec.section_size;
+    header.file_offset = file_offset;
+    header.file_size = spec.section_size;
+    header.sect_name_mem_addr = kXbeBaseMemAddr + name_offsets[i];
+    header.head_shared_page_ref_count_mem_addr =
+        kXbeBaseMemAddr + page_ref_counts_offset + i * 4;
+    header.tail_shared_page_ref_count_mem_addr =
+        header.head_shared_page_ref_count_mem_addr + 2;
+    section_headers.push_back(header);
+    random.Fill(image.data() + file_offset, spec.section_size);
+    PutString(&image, name_offsets[i], names[i]);
+  }
+  // Imports are spread over the whole export table.
+  const XbeSectionHeader& thunk_section =
+      section_headers[std::min<uint32_t>(1, spec.section_count - 1)];
+  for (uint32_t i = 0; i <= spec.kernel_import_count; i++) {
+    const uint32_t thunk = i == spec.kernel_import_count
+        ? 0
+        : kKernelThunkOrdinalFlag | (1 + i * 37 % kMaxKernelOrdinal);
+    memcpy(image.data() + thunk_section.file_offset + i * sizeof(uint32_t),
+           &thunk, sizeof(uint32_t));
+  }
+  memcpy(image.data() + kSectionHeadersOffset, section_headers.data(),
+         section_headers.size() * sizeof(XbeSectionHeader));
+
+  // The first four bytes of the certificate are its size.
+  memcpy(image.data() + kCertificateOffset, &kXbeCertificateSize, 4);
+
+  XbeImageHeader image_header = {};
+  image_header.magic_number = kXbeMagicNumber;
+  image_header.base_mem_addr = kXbeBaseMemAddr;
+  image_header.headers_size = headers_size;
+  image_header.image_size = image_size;
+  image_header.image_header_size = sizeof(XbeImageHeader);
+  image_header.cert_mem_addr = kXbeBaseMemAddr + kCertificateOffset;
+  image_header.section_header_num = spec.section_count;
+  image_header.section_header_mem_addr =
+      kXbeBaseMemAddr + kSectionHeadersOffset;
+  image_header.entry_mem_addr =
+      section_headers[0].virt_mem_addr ^ kEntryMemAddrXorKey;
+  image_header.kernel_thunk_mem_addr =
+      thunk_section.virt_mem_addr ^ kKernelThunkMemAddrXorKey;
+  memcpy(image.data(), &image_header, sizeof(XbeImageHeader));
+
+  PASS_ERROR(WriteAll(xbe_file, image.data(), image.size()));
+  SyntheticXbe xbe;
+  xbe.image_size_bytes = image.size();
+  return ErrorOr<SyntheticXbe>(std::move(xbe));
+}
+
+SyntheticXdfsSpec SyntheticXdfsSpecFromFlags(const Flags& flags) {
+  SyntheticXdfsSpec spec;
+  spec.seed = flags.GetUint("seed", spec.seed);
+  spec.file_count = flags.GetUint("files", spec.file_count);
+  spec.dir_depth = flags.GetUint("depth", spec.dir_depth);
+  spec.dir_fanout = flags.GetUint("fanout", spec.dir_fanout);
+  spec.imbalance = flags.GetDouble("imbalance", spec.imbalance);
+  spec.min_file_size = flags.GetUint("min_file_size", spec.min_file_size);
+  spec.max_file_size = flags.GetUint("max_file_size", spec.max_file_size);
+  return spec;
+}
+
+SyntheticXbeSpec SyntheticXbeSpecFromFlags(const Flags& flags) {
+  SyntheticXbeSpec spec;
+  spec.seed = flags.GetUint("seed", spec.seed);
+  spec.section_count = flags.GetUint("sections", spec.section_count);
+  spec.section_size = flags.GetUint("section_size", spec.section_size);
+  spec.kernel_import_count =
+      flags.GetUint("kernel_imports", spec.kernel_import_count);
+  return spec;
+}
+
+} // namespace bench
@@ -0,0 +1,68 @@
+#ifndef BENCH_SYNTHETIC_IMAGE_H_
+#define BENCH_SYNTHETIC_IMAGE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cc/io/file.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+
+namespace bench {
+
+// Describes the shape of a generated XDFS image. The same spec (including the
+// seed) always produces a byte identical image.
+struct SyntheticXdfsSpec {
+  uint32_t seed = 1;
+  uint32_t file_count = 1000;
+  // Number of directory levels below the root.
+  uint32_t dir_depth = 3;
+  // Number of subdirectories created in each non-leaf directory.
+  uint32_t dir_fanout = 2;
+  // Shape of the on disk search tree of every directory table: 0 produces
+  // balanced trees, 1 degenerates them into linked lists.
+  double imbalance = 0;
+  uint32_t min_file_size = 0;
+  uint32_t max_file_size = 64 * 1024;
+};
+
+struct SyntheticXdfsImage {
+  // Absolute paths as accepted by io::xdfs::Xdfs. Directory paths end in '/'.
+  std::vector<std::string> file_paths;
+  std::vector<std::string> dir_paths;
+  uint64_t total_file_bytes = 0;
+  uint64_t image_size_bytes = 0;
+};
+
+// Writes an image to image_file, which must be empty.
+utils::ErrorOr<SyntheticXdfsImage> WriteSyntheticXdfsImage(
+    const SyntheticXdfsSpec& spec, io::File* image_file);
+
+struct SyntheticXbeSpec {
+  uint32_t seed = 1;
+  uint32_t section_count = 8;
+  uint32_t section_size = 256 * 1024;
+  // Size of the kernel thunk table, which is put at the start of the second
+  // section (or the first if there is only one).
+  uint32_t kernel_import_count = 64;
+};
+
+struct SyntheticXbe {
+  uint64_t image_size_bytes = 0;
+};
+
+// Writes an XBE with section_count sections of random contents that
+// exec::elf::MakeElfFromXbe can convert. The image cannot actually run.
+utils::ErrorOr<SyntheticXbe> WriteSyntheticXbe(const SyntheticXbeSpec& spec,
+                                               io::File* xbe_file);
+
+// Reads --seed, --files, --depth, --fanout, --imbalance, --min_file_size and
+// --max_file_size.
+SyntheticXdfsSpec SyntheticXdfsSpecFromFlags(const utils::Flags& flags);
+
+// Reads --seed, --sections, --section_size and --kernel_imports.
+SyntheticXbeSpec SyntheticXbeSpecFromFlags(const utils::Flags& flags);
+
+} // namespace bench
+
+#endif // BENCH_SYNTHETIC_IMAGE_H_
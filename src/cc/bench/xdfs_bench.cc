@@ -0,0 +1,159 @@
+#include <string>
+#include <vector>
+
+#include "cc/bench/bench.h"
+#include "cc/bench/synthetic_image.h"
+#include "cc/io/file.h"
+#include "cc/io/xdfs/extract.h"
+#include "cc/io/xdfs/xdfs.h"
+#include "cc/io/xdfs/xdfs_dir.h"
+#include "cc/io/xdfs/xdfs_file.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+
+using std::string;
+using std::vector;
+using bench::Benchmarks;
+using bench::BenchmarkState;
+using bench::MakeTempDir;
+using bench::RemoveTree;
+using bench::SyntheticXdfsImage;
+using bench::SyntheticXdfsSpec;
+using bench::SyntheticXdfsSpecFromFlags;
+using bench::WriteReport;
+using bench::WriteSyntheticXdfsImage;
+using io::File;
+using io::xdfs::ExtractAllFiles;
+using io::xdfs::Xdfs;
+using io::xdfs::XdfsDir;
+using io::xdfs::XdfsDirEntry;
+using io::xdfs::XdfsFile;
+using utils::Error;
+using utils::ErrorOr;
+using utils::Flags;
+
+// Benchmarks Xdfs against a generated image. Flags:
+//   --files, --depth, --fanout, --imbalance, --min_file_size,
+//   --max_file_size, --seed: shape of the generated image.
+//   --min_time: seconds to spend in each benchmark (default 1).
+//   --work_dir: where the image and extracted files go (default /tmp).
+//   --out: file to write the JSON report to (default stdout).
+
+ErrorOr<Xdfs> OpenImage(const string& image_path) {
+  ErrorOr<File> error_or_file = File::Open(image_path, File::RD_ONLY);
+  PASS_ERROR(error_or_file.error());
+  return Xdfs::CreateXdfs(error_or_file.move());
+}
+
+Error RunBenchmarks(Benchmarks* benchmarks,
+                    const SyntheticXdfsImage& image,
+                    const string& image_path,
+                    const string& work_dir) {
+  ErrorOr<Xdfs> error_or_xdfs = OpenImage(image_path);
+  PASS_ERROR(error_or_xdfs.error());
+  Xdfs xdfs = error_or_xdfs.move();
+
+  auto lookup = [&](BenchmarkState* state) -> Error {
+    const string& path =
+        image.file_paths[state->iteration() % image.file_paths.size()];
+    ErrorOr<XdfsFile> error_or_file = xdfs.OpenFile(path);
+    PASS_ERROR(error_or_file.error());
+    state->AddItems(1);
+    return Error::Ok();
+  };
+  PASS_ERROR(benchmarks->Run("xdfs_lookup", lookup));
+
+  auto read_entries = [&](BenchmarkState* state) -> Error {
+    const string& path =
+        image.dir_paths[state->iteration() % image.dir_paths.size()];
+    state->PauseTiming();
+    ErrorOr<XdfsDir> error_or_dir = xdfs.OpenDir(path);
+    PASS_ERROR(error_or_dir.error());
+    XdfsDir dir = error_or_dir.move();
+    state->ResumeTiming();
+    ErrorOr<vector<XdfsDirEntry>> error_or_entries = dir.ReadEntries();
+    PASS_ERROR(error_or_entries.error());
+    state->AddItems(error_or_entries.get().size());
+    return Error::Ok();
+  };
+  PASS_ERROR(benchmarks->Run("xdfs_read_entries", read_entries));
+
+  vector<char> buffer(64 * 1024);
+  auto file_read = [&](BenchmarkState* state) -> Error {
+    const string& path =
+        image.file_paths[state->iteration() % image.file_paths.size()];
+    state->PauseTiming();
+    ErrorOr<XdfsFile> error_or_file = xdfs.OpenFile(path);
+    PASS_ERROR(error_or_file.error());
+    XdfsFile file = error_or_file.move();
+    state->ResumeTiming();
+    for (;;) {
+      ErrorOr<ssize_t> error_or_read = file.Read(buffer.data(), buffer.size());
+      PASS_ERROR(error_or_read.error());
+      if (error_or_read.get() == 0) {
+        break;
+      }
+      state->AddBytes(error_or_read.get());
+    }
+    return Error::Ok();
+  };
+  PASS_ERROR(benchmarks->Run("xdfs_file_read", file_read));
+
+  auto extract = [&](BenchmarkState* state) -> Error {
+    state->PauseTiming();
+    ErrorOr<string> error_or_dir = MakeTempDir(work_dir);
+    PASS_ERROR(error_or_dir.error());
+    ErrorOr<Xdfs> error_or_extract_xdfs = OpenImage(image_path);
+    PASS_ERROR(error_or_extract_xdfs.error());
+    state->ResumeTiming();
+    PASS_ERROR(ExtractAllFiles(error_or_extract_xdfs.mutable_ptr(),
+                               error_or_dir.get(),
+                               nullptr));
+    state->PauseTiming();
+    PASS_ERROR(RemoveTree(error_or_dir.get()));
+    state->ResumeTiming();
+    state->AddBytes(image.total_file_bytes);
+    state->AddItems(image.file_paths.size());
+    return Error::Ok();
+  };
+  PASS_ERROR(benchmarks->Run("xdfs_extract", extract));
+  return Error::Ok();
+}
+
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  const SyntheticXdfsSpec spec = SyntheticXdfsSpecFromFlags(flags);
+  ErrorOr<string> error_or_work_dir =
+      MakeTempDir(flags.GetString("work_dir", "/tmp"));
+  CHECK_ERROR(error_or_work_dir.error());
+  const string work_dir = error_or_work_dir.get();
+  const string image_path = work_dir + "/image.iso";
+
+  ErrorOr<File> error_or_image_file = File::Create(image_path, 0664);
+  CHECK_ERROR(error_or_image_file.error());
+  File image_file = error_or_image_file.move();
+  ErrorOr<SyntheticXdfsImage> error_or_image =
+      WriteSyntheticXdfsImage(spec, &image_file);
+  CHECK_ERROR(error_or_image.error());
+  CHECK_ERROR(image_file.Close());
+
+  Benchmarks benchmarks(flags.GetDouble("min_time", 1));
+  benchmarks.AddContext("seed", static_cast<uint64_t>(spec.seed));
+  benchmarks.AddContext("files", static_cast<uint64_t>(spec.file_count));
+  benchmarks.AddContext("depth", static_cast<uint64_t>(spec.dir_depth));
+  benchmarks.AddContext("fanout", static_cast<uint64_t>(spec.dir_fanout));
+  benchmarks.AddContext("imbalance", spec.imbalance);
+  benchmarks.AddContext("min_file_size",
+                        static_cast<uint64_t>(spec.min_file_size));
+  benchmarks.AddContext("max_file_size",
+                        static_cast<uint64_t>(spec.max_file_size));
+  benchmarks.AddContext("image_size_bytes",
+                        error_or_image.get().image_size_bytes);
+  CHECK_ERROR(RunBenchmarks(&benchmarks,
+                            error_or_image.get(),
+                            image_path,
+                            work_dir));
+  CHECK_ERROR(RemoveTree(work_dir));
+  CHECK_ERROR(WriteReport(benchmarks, flags.GetString("out", "")));
+  return 0;
+}
@@ -0,0 +1,91 @@
+#include "cc/exec/elf/child_counters.h"
+
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+
+using std::string;
+
+namespace exec {
+namespace elf {
+namespace {
+struct CounterEvent {
+  const char* name;
+  uint32_t type;
+  uint64_t config;
+};
+
+const CounterEvent kEvents[] = {
+  {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {"cache_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+  {"page_faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+  {"context_switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+static_assert(sizeof(kEvents) / sizeof(kEvents[0])
+              == static_cast<int>(ChildCounter::COUNT),
+              "Every counter needs an event.");
+
+// As read with PERF_FORMAT_TOTAL_TIME_ENABLED and
+// PERF_FORMAT_TOTAL_TIME_RUNNING.
+struct CounterValue {
+  uint64_t value;
+  uint64_t time_enabled;
+  uint64_t time_running;
+};
+} // namespace
+
+const char* ChildCounterName(ChildCounter counter) {
+  return kEvents[static_cast<int>(counter)].name;
+}
+
+ChildCounters::ChildCounters(pid_t pid) {
+  for (int i = 0; i < static_cast<int>(ChildCounter::COUNT); i++) {
+    perf_event_attr attr = {};
+    attr.size = sizeof(attr);
+    attr.type = kEvents[i].type;
+    attr.config = kEvents[i].config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    // What an unprivileged process may count of its own children. Software
+    // events are counted by the kernel on the process's behalf, and one that
+    // excluded it would never count a context switch.
+    if (kEvents[i].type == PERF_TYPE_HARDWARE) {
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+    }
+    // Each counter on its own rather than as a group, which the kernel would
+    // refuse as a whole for one missing member.
+    fds_[i] = syscall(SYS_perf_event_open, &attr, pid, -1, -1,
+                      PERF_FLAG_FD_CLOEXEC);
+  }
+}
+
+ChildCounters::~ChildCounters() {
+  for (const int fd : fds_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+utils::ErrorOr<uint64_t> ChildCounters::Read(ChildCounter counter) const {
+  RETURN_ERROR_IF(!available(counter),
+                  string("Counter ") + ChildCounterName(counter)
+                      + " is not available.");
+  CounterValue value;
+  const ssize_t size =
+      read(fds_[static_cast<int>(counter)], &value, sizeof(value));
+  RETURN_ERROR_SYSCALL(size, "Could not read perf counter.");
+  RETURN_ERROR_IF(size != sizeof(value), "Short read of perf counter.");
+  uint64_t count = value.value;
+  if (value.time_running != 0 && value.time_running < value.time_enabled) {
+    count = static_cast<uint64_t>(
+        static_cast<double>(count) * value.time_enabled / value.time_running);
+  }
+  return utils::ErrorOr<uint64_t>(std::move(count));
+}
+
+} // namespace elf
+} // namespace exec
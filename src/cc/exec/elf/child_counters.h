@@ -0,0 +1,50 @@
+#ifndef EXEC_ELF_CHILD_COUNTERS_H_
+#define EXEC_ELF_CHILD_COUNTERS_H_
+
+#include <sys/types.h>
+#include <cstdint>
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace elf {
+
+enum class ChildCounter {
+  INSTRUCTIONS,
+  CYCLES,
+  CACHE_MISSES,
+  PAGE_FAULTS,
+  CONTEXT_SWITCHES,
+  COUNT,
+};
+
+const char* ChildCounterName(ChildCounter counter);
+
+// Counts what a process does with perf_event_open, from when the counters
+// are opened on, without stopping it. Hardware events are counted in user
+// space only. Counters this machine cannot provide, as most virtual machines
+// cannot provide hardware ones, are left unavailable rather than failing the
+// rest. The counts stay readable after the process exits, even once it is
+// reaped.
+class ChildCounters {
+ public:
+  explicit ChildCounters(pid_t pid);
+  ~ChildCounters();
+
+  bool available(ChildCounter counter) const {
+    return fds_[static_cast<int>(counter)] >= 0;
+  }
+  // Scaled up by the time the counter was not scheduled, if the kernel had to
+  // multiplex the hardware counters.
+  utils::ErrorOr<uint64_t> Read(ChildCounter counter) const;
+
+ private:
+  int fds_[static_cast<int>(ChildCounter::COUNT)];
+
+  ChildCounters(const ChildCounters&) = delete;
+  ChildCounters& operator=(const ChildCounters&) = delete;
+};
+
+} // namespace elf
+} // namespace exec
+
+#endif // EXEC_ELF_CHILD_COUNTERS_H_
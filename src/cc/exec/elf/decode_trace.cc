@@ -0,0 +1,74 @@
+#include <cstdio>
+#include <iostream>
+
+#include "cc/exec/elf/instruction_trace.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/trace.h"
+
+using exec::elf::InstructionTraceReader;
+using io::IoStats;
+using io::WriteIoStatsReport;
+using utils::ErrorOr;
+using utils::Flags;
+
+namespace {
+void PrintRegs(const user_regs_struct& regs) {
+  printf("0x%llx eax=%llx ebx=%llx ecx=%llx edx=%llx esi=%llx edi=%llx "
+         "ebp=%llx esp=%llx eflags=%llx\n",
+         regs.rip, regs.rax, regs.rbx, regs.rcx, regs.rdx, regs.rsi,
+         regs.rdi, regs.rbp, regs.rsp, regs.eflags);
+}
+} // namespace
+
+// Usage: decode_trace <trace> [--count] [--stats[=<json path>]]
+//            [--trace=<json path>]
+//
+// Prints one line per instruction in a trace written by exec_xbe --record:
+// its address and, if the trace has them, the guest registers after the
+// previous instruction ran. --count prints only the number of instructions.
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 1, "Must specify path to trace.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  ErrorOr<InstructionTraceReader> error_or_reader =
+      InstructionTraceReader::Open(flags.positional()[0]);
+  CHECK_ERROR(error_or_reader.error());
+  InstructionTraceReader reader = error_or_reader.move();
+
+  const bool count_only = flags.Has("count");
+  uint64_t count = 0;
+  user_regs_struct regs;
+  while (true) {
+    ErrorOr<bool> error_or_has_next = reader.Next(&regs);
+    CHECK_ERROR(error_or_has_next.error());
+    if (!error_or_has_next.get()) {
+      break;
+    }
+    count++;
+    if (count_only) {
+      continue;
+    }
+    if (reader.full_regs()) {
+      PrintRegs(regs);
+    } else {
+      printf("0x%llx\n", regs.rip);
+    }
+  }
+  if (count_only) {
+    printf("%lu\n", count);
+  }
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
+  return 0;
+}
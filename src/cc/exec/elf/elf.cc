@@ -1,28 +1,35 @@
 #include "cc/exec/elf/elf.h"
 
 #include <elf.h>
-#include <unistd.h>
-#include <map>
+#include <string>
 #include <vector>
 #include "cc/exec/xbe/xbe_common.h"
+#include "cc/exec/xbe/xbe_symbols.h"
+#include "cc/utils/trace.h"
 
-using std::map;
 using std::string;
 using std::vector;
-using exec::xbe::kEntryMemAddrXorKey;
+using exec::xbe::ArrayView;
+using exec::xbe::CollectXbeSymbols;
+using exec::xbe::GuestSymbol;
+using exec::xbe::GuestSymbolKind;
 using exec::xbe::kSectionFlagExecutableMask;
 using exec::xbe::kSectionFlagWritableMask;
 using exec::xbe::MakeImageHeaderSectionHeader;
-using exec::xbe::XbeImageHeader;
+using exec::xbe::XbeImage;
 using exec::xbe::XbeSectionHeader;
-using io::File;
+using io::FileLike;
 using utils::Error;
 using utils::ErrorOr;
+using utils::trace::Span;
 
 namespace exec {
 namespace elf {
 
-static const Elf32_Addr kEntryAddress = 0x10000;
+// The Xbox's page size; fixed rather than the host's so that the layout is the
+// same wherever the ELF is made.
+static const uint32_t kPageSize = 0x1000;
+static const char kImageHeaderSectionName[] = ".xbe_headers";
 
 namespace {
 
@@ -70,61 +77,30 @@ uint32_t XbeSectionFlagsToPhdrFlags(const uint32_t xbe_flags) {
   return phdr_flags;
 }
 
-Elf32_Phdr MakeElfProgramHeader(const XbeSectionHeader& xbe_section_header) {
-  const Elf32_Off file_offset = xbe_section_header.file_offset;
-  const Elf32_Addr vaddr = xbe_section_header.virt_mem_addr;
-  const uint32_t page_size = getpagesize();
+Elf32_Phdr MakeElfProgramHeader(const XbeSectionHeader& xbe_section_header,
+                                const Elf32_Off file_offset) {
   Elf32_Phdr header = {
     .p_type = PT_LOAD,
-    .p_offset = file_offset - (file_offset % page_size) + (vaddr % page_size),
+    .p_offset = file_offset,
     .p_vaddr = xbe_section_header.virt_mem_addr,
     .p_paddr = 0, // Not using phys addresses.
     .p_filesz = xbe_section_header.file_size,
     .p_memsz = xbe_section_header.virt_mem_size,
     .p_flags = XbeSectionFlagsToPhdrFlags(xbe_section_header.section_flags),
-    .p_align = page_size, // No alignment required.
+    .p_align = kPageSize,
   };
-  // False header.
-  if (xbe_section_header.tail_shared_page_ref_count_mem_addr == 0
-      && xbe_section_header.head_shared_page_ref_count_mem_addr == 0) {
-    header.p_offset = 0x3000000 + (vaddr % page_size);
-  }
   return header;
 }
 
-size_t SegNumToOffset(const int segment_number) {
-  return sizeof(Elf32_Ehdr) + sizeof(Elf32_Phdr) * segment_number;
-}
-
-size_t SegNumAndSecNumToOffset(const int segment_number,
-                               const int section_number) {
-  return SegNumToOffset(segment_number) + sizeof(Elf32_Shdr) * section_number;
-}
-
-Error CopySegmentFromXbeToElf(File* xbe_file,
-                              File* elf_file,
-                              const XbeSectionHeader& xbe_section_header,
-                              const int segment_number) {
-  const Elf32_Phdr phdr = MakeElfProgramHeader(xbe_section_header);
-  PASS_ERROR(elf_file->Seek(SegNumToOffset(segment_number)).error());
-  PASS_ERROR(
-      elf_file->Write(reinterpret_cast<const char*>(&phdr), sizeof(Elf32_Phdr))
-      .error());
-
-  const size_t buffer_size = 2048;
-  char buffer[buffer_size];
-  size_t amount_written;
-  PASS_ERROR(xbe_file->Seek(xbe_section_header.file_offset).error());
-  PASS_ERROR(elf_file->Seek(phdr.p_offset).error());
-  for (amount_written = 0;
-       amount_written + buffer_size < phdr.p_filesz;
-       amount_written += buffer_size) {
-    PASS_ERROR(xbe_file->Read(buffer, buffer_size).error());
-    PASS_ERROR(elf_file->Write(buffer, buffer_size).error());
+Error WriteAll(FileLike* elf_file, const char* buffer, size_t size) {
+  while (size > 0) {
+    ErrorOr<ssize_t> error_or_written = elf_file->Write(buffer, size);
+    PASS_ERROR(error_or_written.error());
+    RETURN_ERROR_IF(error_or_written.get() == 0,
+                    "Could not write ELF: no bytes written.");
+    buffer += error_or_written.get();
+    size -= error_or_written.get();
   }
-  const size_t remainder = phdr.p_filesz - amount_written;
-  PASS_ERROR(xbe_file->Read(buffer, remainder).error());
-  PASS_ERROR(elf_file->Write(buffer, remainder).error());
   return Error::Ok();
 }
 
@@ -156,14 +132,14 @@ Elf32_Shdr MakeElfNullSectionHeader() {
 }
 
 Elf32_Shdr MakeElfSectionHeader(const XbeSectionHeader& xbe_section_header,
-                                const map<uint32_t, uint32_t>& mem_addr_to_index
-                                ) {
+                                const uint32_t name_index,
+                                const Elf32_Off file_offset) {
   Elf32_Shdr header = {
-    .sh_name = mem_addr_to_index.at(xbe_section_header.sect_name_mem_addr),
+    .sh_name = name_index,
     .sh_type = SHT_PROGBITS,
     .sh_flags = XbeToElfShdrFlags(xbe_section_header.section_flags),
     .sh_addr = xbe_section_header.virt_mem_addr,
-    .sh_offset = xbe_section_header.file_offset,
+    .sh_offset = file_offset,
     .sh_size = xbe_section_header.file_size,
     .sh_link = 0,
     .sh_info = 0,
@@ -173,21 +149,6 @@ Elf32_Shdr MakeElfSectionHeader(const XbeSectionHeader& xbe_section_header,
   return header;
 }
 
-Error ReserveAndZeroElf(File* elf_file, size_t size) {
-  const size_t buffer_size = 2048;
-  vector<char> buffer(buffer_size, 0);
-  size_t amount_written;
-  PASS_ERROR(elf_file->Seek(0).error());
-  for (amount_written = 0;
-       amount_written + buffer_size < size;
-       amount_written += buffer_size) {
-    PASS_ERROR(elf_file->Write(buffer.data(), buffer_size).error());
-  }
-  const size_t remainder = size - amount_written;
-  PASS_ERROR(elf_file->Write(buffer.data(), remainder).error());
-  return Error::Ok();
-}
-
 Elf32_Shdr MakeElfStrTableSectionHeader(const uint32_t str_table_offset,
                                         const uint32_t str_table_size,
                                         const uint32_t name_entry_num) {
@@ -206,148 +167,250 @@ Elf32_Shdr MakeElfStrTableSectionHeader(const uint32_t str_table_offset,
   return header;
 }
 
-ErrorOr<map<uint32_t, string>> ReadShdrStrTable(
-    File* xbe_file,
-    const vector<uint32_t>& offsets) {
-  map<uint32_t, string> str_table;
-  for (const uint32_t start_offset : offsets) {
-    PASS_ERROR(xbe_file->Seek(start_offset).error());
-    string current_str;
-    for (uint32_t current_offset = start_offset;; current_offset++) {
-      char current_char;
-      PASS_ERROR(xbe_file->Read(&current_char, 1).error());
-      if (current_char == '\0') {
-        break;
-      }
-      current_str += current_char;
-    }
-    str_table[start_offset] = current_str;
-  }
-  return ErrorOr<map<uint32_t, string>>(std::move(str_table));
+Elf32_Shdr MakeElfSymTableSectionHeader(const uint32_t sym_table_offset,
+                                        const uint32_t sym_num,
+                                        const uint32_t name_entry_num,
+                                        const uint32_t str_table_index) {
+  Elf32_Shdr header = {
+    .sh_name = name_entry_num,
+    .sh_type = SHT_SYMTAB,
+    .sh_flags = 0,
+    .sh_addr = 0,
+    .sh_offset = sym_table_offset,
+    .sh_size = static_cast<uint32_t>(sym_num * sizeof(Elf32_Sym)),
+    .sh_link = str_table_index,
+    // Index of the first global symbol; only the null symbol is local.
+    .sh_info = 1,
+    .sh_addralign = 4,
+    .sh_entsize = sizeof(Elf32_Sym),
+  };
+  return header;
 }
 
-ErrorOr<map<uint32_t, uint32_t>> CopyShdrStrTableFromXbeToElf(
-    File* xbe_file,
-    File* elf_file,
-    const vector<uint32_t>& offsets,
-    const int segment_number,
-    const int section_number,
-    const uint32_t offset_to_mem_addr_offset)
-{
-  ErrorOr<map<uint32_t, string>> error_or_shdr_str_table =
-      ReadShdrStrTable(xbe_file, offsets);
-  PASS_ERROR(error_or_shdr_str_table.error());
+uint8_t GuestSymbolKindToSymType(const GuestSymbolKind kind) {
+  switch (kind) {
+    case GuestSymbolKind::FUNCTION:
+      return STT_FUNC;
+    case GuestSymbolKind::OBJECT:
+      return STT_OBJECT;
+    case GuestSymbolKind::SECTION:
+      return STT_NOTYPE;
+  }
+  return STT_NOTYPE;
+}
 
-  map<uint32_t, string> shdr_str_table = error_or_shdr_str_table.move();
-  shdr_str_table[0xffffffff] = ".shstrtab";
-  const uint32_t shdr_offset = SegNumAndSecNumToOffset(segment_number,
-                                                     section_number);
-  const uint32_t str_table_offset = shdr_offset + sizeof(Elf32_Shdr);
+// Everything about the ELF that depends on the XBE, worked out before a single
+// byte is written. The file is laid out front to back as:
+//   ELF header | program headers | section headers | .shstrtab | .symtab |
+//   .strtab | segments
+// where each segment starts at the first offset past the previous one that is
+// congruent to its virtual address modulo the page size, as mmap requires.
+struct ElfLayout {
+  Elf32_Ehdr ehdr;
+  vector<Elf32_Phdr> phdrs;
+  // The null section header, one per segment, then .symtab's, .strtab's and
+  // .shstrtab's.
+  vector<Elf32_Shdr> shdrs;
+  string shstrtab;
+  vector<Elf32_Sym> symtab;
+  string strtab;
+  // The file backed bytes of each segment, in the same order as phdrs.
+  vector<ArrayView<char>> segment_bytes;
+  // Where the segments start, i.e. just past .strtab.
+  uint64_t segments_offset;
+  uint64_t size;
+};
+
+// The smallest offset >= offset that is congruent to vaddr modulo the page
+// size.
+uint64_t AlignToVaddr(const uint64_t offset, const Elf32_Addr vaddr) {
+  return offset + ((vaddr - offset) % kPageSize);
+}
 
-  map<uint32_t, uint32_t> mem_addr_to_index;
-  uint32_t shdr_str_table_name_index;
-  uint32_t str_table_size = 0;
-  // uint32_t current_index = 0;
-  const char null_char = '\0';
-  PASS_ERROR(elf_file->Seek(str_table_offset).error());
-  for (const auto& str_table_entry : shdr_str_table) {
-    mem_addr_to_index[str_table_entry.first + offset_to_mem_addr_offset] =
-        str_table_size + 1;
-    if (str_table_entry.first == 0xffffffff) {
-      shdr_str_table_name_index = str_table_size + 1;
+// Symbols are attributed to the section header of the segment holding them,
+// or are absolute if none does.
+void PlanSymbols(const vector<XbeSectionHeader>& section_headers,
+                 const vector<GuestSymbol>& symbols,
+                 ElfLayout* layout) {
+  // Both tables start with an entry meaning none.
+  layout->strtab.assign(1, '\0');
+  layout->symtab.push_back(Elf32_Sym());
+  for (const GuestSymbol& symbol : symbols) {
+    uint16_t section_index = SHN_ABS;
+    for (size_t i = 0; i < section_headers.size(); i++) {
+      if (symbol.addr >= section_headers[i].virt_mem_addr
+          && symbol.addr - section_headers[i].virt_mem_addr
+              < section_headers[i].virt_mem_size) {
+        // After the null section header.
+        section_index = i + 1;
+        break;
+      }
     }
-
-    PASS_ERROR(elf_file->Write(&null_char, 1).error());
-    PASS_ERROR(elf_file->Write(str_table_entry.second.data(),
-                               str_table_entry.second.size()).error());
-    PASS_ERROR(elf_file->Write(&null_char, 1).error());
-    str_table_size += str_table_entry.second.size() + 2;
+    Elf32_Sym sym = {
+      .st_name = static_cast<uint32_t>(layout->strtab.size()),
+      .st_value = symbol.addr,
+      .st_size = symbol.size,
+      .st_info = static_cast<unsigned char>(
+          ELF32_ST_INFO(STB_GLOBAL, GuestSymbolKindToSymType(symbol.kind))),
+      .st_other = STV_DEFAULT,
+      .st_shndx = section_index,
+    };
+    layout->symtab.push_back(sym);
+    layout->strtab += symbol.name;
+    layout->strtab += '\0';
   }
-
-  const Elf32_Shdr shdr = MakeElfStrTableSectionHeader(str_table_offset,
-                                                 str_table_size,
-                                                 shdr_str_table_name_index);
-  PASS_ERROR(elf_file->Seek(shdr_offset).error());
-  PASS_ERROR(elf_file->Write(reinterpret_cast<const char*>(&shdr),
-                             sizeof(Elf32_Shdr)).error());
-
-  return ErrorOr<map<uint32_t, uint32_t>>(std::move(mem_addr_to_index));
 }
 
-} // namespace
-
-Error MakeElfFromXbe(File* xbe_file, File* elf_file) {
-  XbeImageHeader image_header;
-  PASS_ERROR(xbe_file->Read(reinterpret_cast<char*>(&image_header),
-                            sizeof(XbeImageHeader)).error());
-
-  // XXX: This is for the image header and cert segment that is hacked in.
-  // Removed this.
-  image_header.section_header_num++;
-  // This is called security.
-  image_header.entry_mem_addr
-      = image_header.entry_mem_addr ^ kEntryMemAddrXorKey;
-
-  const size_t section_header_offset =
-      image_header.section_header_mem_addr - image_header.base_mem_addr;
-  PASS_ERROR(xbe_file->Seek(section_header_offset).error());
+ErrorOr<ElfLayout> PlanElfLayout(const XbeImage& xbe,
+                                 const vector<GuestSymbol>& symbols) {
+  Span span("PlanElfLayout");
+  // The image header and certificate are loaded as a segment of their own,
+  // ahead of the XBE's sections.
+  ElfLayout layout;
+  vector<XbeSectionHeader> section_headers;
+  vector<const char*> section_names;
+  const XbeSectionHeader image_header_section_header =
+      MakeImageHeaderSectionHeader();
+  RETURN_ERROR_IF(image_header_section_header.file_size > xbe.bytes().size(),
+                  "XBE is smaller than its image header and certificate.");
+  section_headers.push_back(image_header_section_header);
+  section_names.push_back(kImageHeaderSectionName);
+  layout.segment_bytes.push_back(ArrayView<char>(
+      xbe.bytes().data(), image_header_section_header.file_size));
+  for (size_t i = 0; i < xbe.section_headers().size(); i++) {
+    section_headers.push_back(xbe.section_headers()[i]);
+    section_names.push_back(xbe.section_name(i));
+    layout.segment_bytes.push_back(xbe.section_bytes(i));
+  }
 
-  vector<XbeSectionHeader> section_headers(image_header.section_header_num);
-  PASS_ERROR(xbe_file->Read(reinterpret_cast<char*>(section_headers.data()),
-                            sizeof(XbeSectionHeader) * section_headers.size())
-             .error());
-  vector<uint32_t> shdr_name_offsets;
-  for (const XbeSectionHeader& section_header : section_headers) {
-    shdr_name_offsets.push_back(
-        section_header.sect_name_mem_addr - image_header.base_mem_addr);
+  // The table starts with an empty string so that index 0 means no name.
+  layout.shstrtab.assign(1, '\0');
+  vector<uint32_t> name_indexes;
+  for (const char* name : section_names) {
+    name_indexes.push_back(layout.shstrtab.size());
+    layout.shstrtab += name;
+    layout.shstrtab += '\0';
+  }
+  const uint32_t symtab_name_index = layout.shstrtab.size();
+  layout.shstrtab += ".symtab";
+  layout.shstrtab += '\0';
+  const uint32_t strtab_name_index = layout.shstrtab.size();
+  layout.shstrtab += ".strtab";
+  layout.shstrtab += '\0';
+  const uint32_t shstrtab_name_index = layout.shstrtab.size();
+  layout.shstrtab += ".shstrtab";
+  layout.shstrtab += '\0';
+  PlanSymbols(section_headers, symbols, &layout);
+
+  // One segment per section, then the null section header, one per section
+  // and those of the three tables.
+  const uint32_t segment_num = section_headers.size();
+  const uint32_t section_header_num = segment_num + 4;
+  const uint64_t phdr_offset = sizeof(Elf32_Ehdr);
+  const uint64_t shdr_offset = phdr_offset + sizeof(Elf32_Phdr) * segment_num;
+  const uint64_t shstrtab_offset =
+      shdr_offset + sizeof(Elf32_Shdr) * section_header_num;
+  // Elf32_Sym is read in place, so .symtab is 4 byte aligned.
+  const uint64_t symtab_offset =
+      (shstrtab_offset + layout.shstrtab.size() + 3) & ~3ull;
+  const uint64_t strtab_offset =
+      symtab_offset + sizeof(Elf32_Sym) * layout.symtab.size();
+  layout.segments_offset = strtab_offset + layout.strtab.size();
+
+  uint64_t offset = layout.segments_offset;
+  layout.shdrs.push_back(MakeElfNullSectionHeader());
+  for (uint32_t i = 0; i < segment_num; i++) {
+    offset = AlignToVaddr(offset, section_headers[i].virt_mem_addr);
+    layout.phdrs.push_back(MakeElfProgramHeader(section_headers[i], offset));
+    layout.shdrs.push_back(
+        MakeElfSectionHeader(section_headers[i], name_indexes[i], offset));
+    offset += section_headers[i].file_size;
   }
-  // XXX: This is for the image header and cert segment that is hacked in.
-  // Removed this.
-  section_headers.insert(section_headers.begin(),
-                         MakeImageHeaderSectionHeader());
+  layout.shdrs.push_back(MakeElfSymTableSectionHeader(symtab_offset,
+                                                      layout.symtab.size(),
+                                                      symtab_name_index,
+                                                      segment_num + 2));
+  layout.shdrs.push_back(MakeElfStrTableSectionHeader(strtab_offset,
+                                                      layout.strtab.size(),
+                                                      strtab_name_index));
+  layout.shdrs.push_back(MakeElfStrTableSectionHeader(shstrtab_offset,
+                                                      layout.shstrtab.size(),
+                                                      shstrtab_name_index));
+  RETURN_ERROR_IF(offset > UINT32_MAX, "ELF would exceed 4 GiB.");
+  layout.size = offset;
+
+  layout.ehdr = MakeElfHeader(xbe.entry_mem_addr(),
+                              phdr_offset,
+                              shdr_offset,
+                              segment_num,
+                              section_header_num,
+                              section_header_num - 1);
+  span.set_bytes(layout.size);
+  return ErrorOr<ElfLayout>(std::move(layout));
+}
 
-  ErrorOr<map<uint32_t, uint32_t>> error_or_mem_addr_to_index =
-      CopyShdrStrTableFromXbeToElf(xbe_file,
-                                   elf_file,
-                                   shdr_name_offsets,
-                                   image_header.section_header_num,
-                                   image_header.section_header_num + 1,
-                                   image_header.base_mem_addr);
-  PASS_ERROR(error_or_mem_addr_to_index.error());
+// Writes layout in one sequential pass; the gaps that keep segments page
+// congruent are written as zeros rather than seeked over.
+Error EmitElf(const ElfLayout& layout, FileLike* elf_file) {
+  Span span("EmitElf");
+  span.set_bytes(layout.size);
+  PASS_ERROR(elf_file->Seek(0).error());
+  PASS_ERROR(WriteAll(elf_file,
+                      reinterpret_cast<const char*>(&layout.ehdr),
+                      sizeof(Elf32_Ehdr)));
+  PASS_ERROR(WriteAll(elf_file,
+                      reinterpret_cast<const char*>(layout.phdrs.data()),
+                      sizeof(Elf32_Phdr) * layout.phdrs.size()));
+  PASS_ERROR(WriteAll(elf_file,
+                      reinterpret_cast<const char*>(layout.shdrs.data()),
+                      sizeof(Elf32_Shdr) * layout.shdrs.size()));
+  PASS_ERROR(WriteAll(elf_file,
+                      layout.shstrtab.data(),
+                      layout.shstrtab.size()));
+
+  static const char kZeros[kPageSize] = {};
+  const Elf32_Shdr& symtab_shdr = layout.shdrs[layout.shdrs.size() - 3];
+  const uint64_t shstrtab_end =
+      layout.shdrs.back().sh_offset + layout.shstrtab.size();
+  PASS_ERROR(WriteAll(elf_file, kZeros, symtab_shdr.sh_offset - shstrtab_end));
+  PASS_ERROR(WriteAll(elf_file,
+                      reinterpret_cast<const char*>(layout.symtab.data()),
+                      sizeof(Elf32_Sym) * layout.symtab.size()));
+  PASS_ERROR(WriteAll(elf_file, layout.strtab.data(), layout.strtab.size()));
+
+  uint64_t offset = layout.segments_offset;
+  for (size_t i = 0; i < layout.phdrs.size(); i++) {
+    Span segment_span("CopySegmentFromXbeToElf");
+    const Elf32_Phdr& phdr = layout.phdrs[i];
+    segment_span.set_bytes(phdr.p_filesz);
+    PASS_ERROR(WriteAll(elf_file, kZeros, phdr.p_offset - offset));
+    PASS_ERROR(WriteAll(elf_file,
+                        layout.segment_bytes[i].data(),
+                        phdr.p_filesz));
+    offset = phdr.p_offset + phdr.p_filesz;
+  }
+  return Error::Ok();
+}
 
-  map<uint32_t, uint32_t> mem_addr_to_index = error_or_mem_addr_to_index.move();
-  const uint32_t section_header_num = image_header.section_header_num + 2;
-  const Elf32_Ehdr ehdr = MakeElfHeader(image_header.entry_mem_addr,
-                                        sizeof(Elf32_Ehdr),
-                                        SegNumToOffset(
-                                            image_header.section_header_num),
-                                        image_header.section_header_num,
-                                        section_header_num,
-                                        section_header_num - 1);
+} // namespace
 
-  PASS_ERROR(elf_file->Seek(0).error());
-  PASS_ERROR(
-      elf_file->Write(reinterpret_cast<const char*>(&ehdr), sizeof(Elf32_Ehdr))
-      .error());
+Error MakeElfFromXbe(const XbeImage& xbe,
+                     const vector<GuestSymbol>& symbols,
+                     FileLike* elf_file) {
+  Span span("MakeElfFromXbe");
+  ErrorOr<ElfLayout> error_or_layout = PlanElfLayout(xbe, symbols);
+  PASS_ERROR(error_or_layout.error());
+  return EmitElf(error_or_layout.get(), elf_file);
+}
 
-  int segment_number = 0;
-  for (const XbeSectionHeader& section_header : section_headers) {
-    PASS_ERROR(CopySegmentFromXbeToElf(xbe_file,
-                                       elf_file,
-                                       section_header,
-                                       segment_number++));
-  }
+Error MakeElfFromXbe(const XbeImage& xbe, FileLike* elf_file) {
+  return MakeElfFromXbe(xbe, CollectXbeSymbols(xbe), elf_file);
+}
 
-  PASS_ERROR(elf_file->Seek(SegNumToOffset(segment_number)).error());
-  const Elf32_Shdr null_shdr = MakeElfNullSectionHeader();
-  PASS_ERROR(elf_file->Write(reinterpret_cast<const char*>(&null_shdr),
-                             sizeof(Elf32_Shdr)).error());
-  for (const XbeSectionHeader& section_header : section_headers) {
-    const Elf32_Shdr shdr = MakeElfSectionHeader(section_header, mem_addr_to_index);
-    PASS_ERROR(elf_file->Write(reinterpret_cast<const char*>(&shdr),
-                               sizeof(Elf32_Shdr)).error());
-  }
-  return Error::Ok();
+Error MakeElfFromXbe(FileLike* xbe_file, FileLike* elf_file) {
+  ErrorOr<XbeImage> error_or_xbe = XbeImage::FromFileLike(xbe_file);
+  PASS_ERROR(error_or_xbe.error());
+  return MakeElfFromXbe(error_or_xbe.get(), elf_file);
 }
 
 } // namespace elf
@@ -1,13 +1,30 @@
 #ifndef EXEC_ELF_ELF_H_
 #define EXEC_ELF_ELF_H_
 
-#include "cc/io/file.h"
+#include <cstdint>
+#include <vector>
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/exec/xbe/xbe_symbols.h"
+#include "cc/io/file_like.h"
 #include "cc/utils/error.h"
 
 namespace exec {
 namespace elf {
 
-utils::Error MakeElfFromXbe(io::File* xbe_file, io::File* elf_file);
+// Bumped whenever MakeElfFromXbe would produce different bytes for the same
+// XBE, so that ElfCache entries from older converters are not reused.
+static const uint32_t kElfConverterVersion = 3;
+
+// symbols are written to .symtab and .strtab, so that profilers and debuggers
+// can name guest code.
+utils::Error MakeElfFromXbe(const exec::xbe::XbeImage& xbe,
+                            const std::vector<exec::xbe::GuestSymbol>& symbols,
+                            io::FileLike* elf_file);
+// With the symbols of exec::xbe::CollectXbeSymbols.
+utils::Error MakeElfFromXbe(const exec::xbe::XbeImage& xbe,
+                            io::FileLike* elf_file);
+// Reads the whole XBE from xbe_file first.
+utils::Error MakeElfFromXbe(io::FileLike* xbe_file, io::FileLike* elf_file);
 
 } // namespace elf
 } // namespace exec
@@ -0,0 +1,284 @@
+#include "cc/exec/elf/elf_cache.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "cc/exec/elf/elf.h"
+#include "cc/exec/xbe/xbe_loader.h"
+#include "cc/io/file.h"
+#include "cc/utils/sha1.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using exec::xbe::GuestSymbol;
+using exec::xbe::kMemoryImageVersion;
+using exec::xbe::WriteXbeMemoryImage;
+using exec::xbe::XbeImage;
+using io::File;
+using io::FileLike;
+using utils::Error;
+using utils::ErrorOr;
+using utils::Sha1;
+using utils::trace::Span;
+
+namespace exec {
+namespace elf {
+namespace {
+static const char kElfSuffix[] = ".elf";
+static const char kMemoryImageSuffix[] = ".img";
+
+Error MakeDirs(const string& path) {
+  for (size_t slash = path.find('/', 1);; slash = path.find('/', slash + 1)) {
+    const string prefix = path.substr(0, slash);
+    if (mkdir(prefix.c_str(), 0755) < 0 && errno != EEXIST) {
+      RETURN_ERROR("Could not create " + prefix + ": " + strerror(errno));
+    }
+    if (slash == string::npos) {
+      return Error::Ok();
+    }
+  }
+}
+
+bool HasSuffix(const string& value, const string& suffix) {
+  return value.size() >= suffix.size()
+      && value.compare(value.size() - suffix.size(), suffix.size(), suffix)
+          == 0;
+}
+
+// A name no other process, or thread of this one, will pick for its
+// temporary file in dir.
+string TempPath(const string& dir) {
+  static std::atomic<int> counter(0);
+  return dir + "/.tmp-" + std::to_string(getpid()) + "-"
+      + std::to_string(counter.fetch_add(1));
+}
+
+Error CopyFile(const string& from_path, const string& to_path) {
+  ErrorOr<File> error_or_from = File::Open(from_path, File::RD_ONLY);
+  PASS_ERROR(error_or_from.error());
+  File from = error_or_from.move();
+  ErrorOr<File> error_or_to = File::Create(to_path, 0755);
+  PASS_ERROR(error_or_to.error());
+  File to = error_or_to.move();
+  vector<char> buffer(64 * 1024);
+  while (true) {
+    ErrorOr<ssize_t> error_or_amount_read =
+        from.Read(buffer.data(), buffer.size());
+    PASS_ERROR(error_or_amount_read.error());
+    if (error_or_amount_read.get() == 0) {
+      break;
+    }
+    for (ssize_t written = 0; written < error_or_amount_read.get();) {
+      ErrorOr<ssize_t> error_or_written =
+          to.Write(buffer.data() + written,
+                   error_or_amount_read.get() - written);
+      PASS_ERROR(error_or_written.error());
+      written += error_or_written.get();
+    }
+  }
+  return to.Close();
+}
+
+struct Entry {
+  string path;
+  uint64_t size;
+  struct timespec mtime;
+};
+
+bool LessRecentlyUsed(const Entry& a, const Entry& b) {
+  return a.mtime.tv_sec < b.mtime.tv_sec
+      || (a.mtime.tv_sec == b.mtime.tv_sec
+          && a.mtime.tv_nsec < b.mtime.tv_nsec);
+}
+} // namespace
+
+string ElfCache::DefaultDir() {
+  const char* cache_home = getenv("XDG_CACHE_HOME");
+  if (cache_home != nullptr && cache_home[0] != '\0') {
+    return string(cache_home) + "/boombox/elf";
+  }
+  const char* home = getenv("HOME");
+  return string(home != nullptr ? home : "/tmp") + "/.cache/boombox/elf";
+}
+
+ErrorOr<ElfCache> ElfCache::Open(const string& dir, uint64_t max_bytes) {
+  RETURN_ERROR_IF(dir.empty(), "Cache directory must not be empty.");
+  PASS_ERROR(MakeDirs(dir));
+  ElfCache cache(dir, max_bytes);
+  return ErrorOr<ElfCache>(std::move(cache));
+}
+
+ErrorOr<string> ElfCache::GetOrConvert(const XbeImage& xbe) {
+  Span span("ElfCache::GetOrConvert");
+  return GetOrMake(xbe,
+                   kElfConverterVersion,
+                   "",
+                   kElfSuffix,
+                   [](const XbeImage& xbe, FileLike* file) {
+                     return MakeElfFromXbe(xbe, file);
+                   });
+}
+
+ErrorOr<string> ElfCache::GetOrConvert(const XbeImage& xbe,
+                                       const vector<GuestSymbol>& symbols) {
+  Span span("ElfCache::GetOrConvert");
+  string key;
+  for (const GuestSymbol& symbol : symbols) {
+    key += symbol.name;
+    key += '\0';
+    key.append(reinterpret_cast<const char*>(&symbol.addr),
+               sizeof(symbol.addr));
+    key.append(reinterpret_cast<const char*>(&symbol.size),
+               sizeof(symbol.size));
+    key += static_cast<char>(symbol.kind);
+  }
+  return GetOrMake(xbe,
+                   kElfConverterVersion,
+                   key,
+                   kElfSuffix,
+                   [&symbols](const XbeImage& xbe, FileLike* file) {
+                     return MakeElfFromXbe(xbe, symbols, file);
+                   });
+}
+
+ErrorOr<string> ElfCache::GetOrMakeMemoryImage(const XbeImage& xbe) {
+  Span span("ElfCache::GetOrMakeMemoryImage");
+  return GetOrMake(xbe,
+                   kMemoryImageVersion,
+                   "",
+                   kMemoryImageSuffix,
+                   &WriteXbeMemoryImage);
+}
+
+ErrorOr<string> ElfCache::GetOrMake(const XbeImage& xbe,
+                                    uint32_t version,
+                                    const string& extra_key,
+                                    const char* suffix,
+                                    const Maker& make) {
+  Span span("ElfCache::GetOrMake");
+  Sha1 sha1;
+  sha1.Update(&version, sizeof(version));
+  sha1.Update(extra_key.data(), extra_key.size());
+  sha1.Update(xbe.bytes().data(), xbe.bytes().size());
+  const string path = dir_ + "/" + sha1.Finish().ToHex() + suffix;
+
+  // A hit only refreshes the entry's place in the eviction order.
+  if (utimensat(AT_FDCWD, path.c_str(), nullptr, 0) == 0) {
+    span.set_detail("hit " + path);
+    return ErrorOr<string>(string(path));
+  }
+  RETURN_ERROR_IF(errno != ENOENT,
+                  "Could not access " + path + ": " + strerror(errno));
+  span.set_detail("miss " + path);
+
+  const string temp_path = TempPath(dir_);
+  {
+    ErrorOr<File> error_or_file = File::Create(temp_path, 0755);
+    PASS_ERROR(error_or_file.error());
+    File file = error_or_file.move();
+    const Error error = make(xbe, &file);
+    const Error close_error = file.Close();
+    if (!error.is_ok() || !close_error.is_ok()) {
+      unlink(temp_path.c_str());
+      PASS_ERROR(error);
+      PASS_ERROR(close_error);
+    }
+  }
+  if (rename(temp_path.c_str(), path.c_str()) < 0) {
+    const string info = "Could not rename " + temp_path + " to " + path
+        + ": " + strerror(errno);
+    unlink(temp_path.c_str());
+    RETURN_ERROR(info);
+  }
+  PASS_ERROR(Evict(path));
+  return ErrorOr<string>(string(path));
+}
+
+Error ElfCache::Export(const string& cached_path, const string& path) {
+  Span span("ElfCache::Export");
+  struct stat cached_stat;
+  struct stat path_stat;
+  RETURN_ERROR_SYSCALL(stat(cached_path.c_str(), &cached_stat),
+                       "Could not stat " + cached_path);
+  // Already linked; renaming a link onto itself would do nothing and leave
+  // the temporary link behind.
+  if (stat(path.c_str(), &path_stat) == 0
+      && path_stat.st_dev == cached_stat.st_dev
+      && path_stat.st_ino == cached_stat.st_ino) {
+    return Error::Ok();
+  }
+  const string temp_path = path + ".tmp-" + std::to_string(getpid());
+  unlink(temp_path.c_str());
+  if (link(cached_path.c_str(), temp_path.c_str()) < 0) {
+    // Most likely a different file system; copy instead.
+    const Error error = CopyFile(cached_path, temp_path);
+    if (!error.is_ok()) {
+      unlink(temp_path.c_str());
+      PASS_ERROR(error);
+    }
+  }
+  if (rename(temp_path.c_str(), path.c_str()) < 0) {
+    const string info = "Could not rename " + temp_path + " to " + path
+        + ": " + strerror(errno);
+    unlink(temp_path.c_str());
+    RETURN_ERROR(info);
+  }
+  return Error::Ok();
+}
+
+Error ElfCache::Evict(const string& keep_path) {
+  Span span("ElfCache::Evict");
+  DIR* dir = opendir(dir_.c_str());
+  RETURN_ERROR_IF(dir == nullptr,
+                  "Could not open " + dir_ + ": " + strerror(errno));
+  vector<Entry> entries;
+  uint64_t total_bytes = 0;
+  for (dirent* dir_entry = readdir(dir);
+       dir_entry != nullptr;
+       dir_entry = readdir(dir)) {
+    const string name = dir_entry->d_name;
+    if (!HasSuffix(name, kElfSuffix) && !HasSuffix(name, kMemoryImageSuffix)) {
+      continue;
+    }
+    Entry entry;
+    entry.path = dir_ + "/" + name;
+    struct stat entry_stat;
+    // Another process may have evicted it already.
+    if (stat(entry.path.c_str(), &entry_stat) < 0) {
+      continue;
+    }
+    entry.size = entry_stat.st_size;
+    entry.mtime = entry_stat.st_mtim;
+    total_bytes += entry.size;
+    entries.push_back(entry);
+  }
+  closedir(dir);
+
+  std::sort(entries.begin(), entries.end(), LessRecentlyUsed);
+  for (const Entry& entry : entries) {
+    if (total_bytes <= max_bytes_) {
+      break;
+    }
+    // Never evict the entry the caller is about to use, even if it alone
+    // exceeds the limit.
+    if (entry.path == keep_path) {
+      continue;
+    }
+    if (unlink(entry.path.c_str()) == 0 || errno == ENOENT) {
+      total_bytes -= entry.size;
+    }
+  }
+  return Error::Ok();
+}
+
+} // namespace elf
+} // namespace exec
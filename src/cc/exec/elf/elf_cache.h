@@ -0,0 +1,73 @@
+#ifndef EXEC_ELF_ELF_CACHE_H_
+#define EXEC_ELF_ELF_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/exec/xbe/xbe_symbols.h"
+#include "cc/io/file_like.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace elf {
+
+// A directory of converted ELFs named by the SHA-1 of the XBE they were made
+// from and kElfConverterVersion, so a changed XBE or converter never reuses a
+// stale ELF. Entries are written to a temporary file and renamed into place,
+// so readers (including other processes) only ever see complete ELFs.
+// Whenever an entry is added, the least recently used entries are removed
+// until the cache fits in max_bytes.
+//
+// The same directory also holds the memory images exec::xbe::LoadXbeShared
+// maps, keyed the same way by kMemoryImageVersion.
+class ElfCache {
+ public:
+  // $XDG_CACHE_HOME/boombox/elf, falling back to ~/.cache/boombox/elf.
+  static std::string DefaultDir();
+
+  // Creates dir if needed.
+  static utils::ErrorOr<ElfCache> Open(const std::string& dir,
+                                       uint64_t max_bytes);
+
+  // Returns the path of the ELF converted from xbe, converting it first if
+  // it is not cached yet.
+  utils::ErrorOr<std::string> GetOrConvert(const exec::xbe::XbeImage& xbe);
+  // Likewise for an ELF with symbols rather than the default ones; symbols
+  // are part of the key.
+  utils::ErrorOr<std::string> GetOrConvert(
+      const exec::xbe::XbeImage& xbe,
+      const std::vector<exec::xbe::GuestSymbol>& symbols);
+  // Likewise for the memory image made by exec::xbe::WriteXbeMemoryImage.
+  utils::ErrorOr<std::string> GetOrMakeMemoryImage(
+      const exec::xbe::XbeImage& xbe);
+
+  // Makes path a copy of the cached ELF at cached_path: a hard link where
+  // possible, otherwise a full copy. path is replaced atomically.
+  static utils::Error Export(const std::string& cached_path,
+                             const std::string& path);
+
+ private:
+  std::string dir_;
+  uint64_t max_bytes_;
+
+  ElfCache(const std::string& dir, uint64_t max_bytes)
+      : dir_(dir), max_bytes_(max_bytes) {}
+
+  typedef std::function<utils::Error(const exec::xbe::XbeImage& xbe,
+                                     io::FileLike* file)> Maker;
+  // extra_key is hashed along with version and the XBE.
+  utils::ErrorOr<std::string> GetOrMake(const exec::xbe::XbeImage& xbe,
+                                        uint32_t version,
+                                        const std::string& extra_key,
+                                        const char* suffix,
+                                        const Maker& make);
+
+  utils::Error Evict(const std::string& keep_path);
+};
+
+} // namespace elf
+} // namespace exec
+
+#endif // EXEC_ELF_ELF_CACHE_H_
@@ -1,30 +1,134 @@
+#include <signal.h>
 #include <sys/ptrace.h>
+#include <sys/socket.h>
 #include <sys/types.h>
 #include <sys/user.h>
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <vector>
 
+#include "cc/exec/elf/child_counters.h"
 #include "cc/exec/elf/elf.h"
+#include "cc/exec/elf/elf_cache.h"
+#include "cc/exec/elf/guest_profiler.h"
+#include "cc/exec/elf/instruction_trace.h"
+#include "cc/exec/elf/memory_dump.h"
+#include "cc/exec/elf/snapshots.h"
+#include "cc/exec/elf/tracee.h"
+#include "cc/exec/xbe/kernel_calls.h"
+#include "cc/exec/xbe/kernel_exports.h"
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/exec/xbe/xbe_loader.h"
+#include "cc/exec/xbe/xbe_pager.h"
+#include "cc/exec/xbe/xbe_path.h"
+#include "cc/exec/xbe/xbe_symbols.h"
 #include "cc/io/file.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/clock.h"
 #include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/trace.h"
 
 using std::cout;
 using std::endl;
+using std::pair;
 using std::string;
-using std::to_string;
+using std::unique_ptr;
+using std::vector;
+using exec::elf::ChildCounter;
+using exec::elf::ChildCounterName;
+using exec::elf::ChildCounters;
+using exec::elf::DumpProcessMemory;
+using exec::elf::ElfCache;
+using exec::elf::GuestProfiler;
+using exec::elf::InstructionTraceRecorder;
 using exec::elf::MakeElfFromXbe;
+using exec::elf::MemoryDumpOptions;
+using exec::elf::MemoryDumpStats;
+using exec::elf::SnapshotWriter;
+using exec::elf::Stop;
+using exec::elf::StopKind;
+using exec::elf::Tracee;
+using exec::elf::Watchpoint;
+using exec::elf::WatchKind;
+using exec::xbe::CollectXbeSymbols;
+using exec::xbe::GuestSymbol;
+using exec::xbe::HostPathFor;
+using exec::xbe::InitialStackPointerFor;
+using exec::xbe::InstallKernelCalls;
+using exec::xbe::KernelCallCounts;
+using exec::xbe::KernelExport;
+using exec::xbe::KernelExportByOrdinal;
+using exec::xbe::kMaxKernelOrdinal;
+using exec::xbe::LoadXbe;
+using exec::xbe::LoadXbeOnDemand;
+using exec::xbe::LoadXbeShared;
+using exec::xbe::MapKernelCallCounts;
+using exec::xbe::OpenXbe;
+using exec::xbe::PerfMapPathFor;
+using exec::xbe::XbeImage;
+using exec::xbe::XbePager;
+using exec::xbe::WritePerfMap;
 using io::File;
+using io::IoOp;
+using io::IoStats;
+using io::WriteIoStatsReport;
 using utils::Error;
 using utils::ErrorOr;
+using utils::Flags;
+using utils::trace::Span;
 
 #define M_OFFSETOF(STRUCT, ELEMENT) \
       (unsigned long) &((STRUCT *)NULL)->ELEMENT;
 
-static const uint8_t kInt3 = 0xcc;
 static const uint32_t kRegsTraceFlag = 1 << 8;
+static const uint64_t kDefaultCacheMaxBytes = 4ull << 30;
+// Linux's __USER32_CS and __USER_DS: 32 bit compatibility mode code and the
+// flat user data segment.
+static const uint64_t kUser32CodeSelector = 0x23;
+static const uint64_t kUserDataSelector = 0x2b;
+// The --stats groups of the launch's phases and of the child's counters.
+static const char kPhaseGroup[] = "launch_phases_ns";
+static const char kCounterGroup[] = "child_counters";
+
+// Times the phases of a launch for --stats, each from the end of the one
+// before, so that together they add up to the whole launch.
+class PhaseClock {
+ public:
+  PhaseClock() : last_ns_(utils::MonotonicNowNs()) {}
+
+  void End(const string& phase) { EndSplit(phase, "", 0); }
+  // Ends phase, of which part_ns were spent on part.
+  void EndSplit(const string& phase, const string& part, uint64_t part_ns) {
+    const uint64_t now_ns = utils::MonotonicNowNs();
+    const uint64_t phase_ns = now_ns - last_ns_;
+    last_ns_ = now_ns;
+    part_ns = std::min(part_ns, phase_ns);
+    Record(phase, phase_ns - part_ns);
+    if (!part.empty()) {
+      Record(part, part_ns);
+    }
+  }
+
+  const vector<pair<string, uint64_t>>& phases() const { return phases_; }
+
+ private:
+  uint64_t last_ns_;
+  vector<pair<string, uint64_t>> phases_;
+
+  void Record(const string& phase, uint64_t ns) {
+    phases_.push_back({phase, ns});
+    IoStats::Get()->SetValue(kPhaseGroup, phase, ns);
+  }
+};
 
 Error InitExec(const string& elf_path) {
   RETURN_ERROR_SYSCALL(ptrace(PTRACE_TRACEME, 0, nullptr, nullptr),
@@ -37,121 +141,746 @@ Error InitExec(const string& elf_path) {
   return Error::Ok();
 }
 
-Error DumpMem(const string& dump_path, const pid_t pid) {
-  const string mem_path = string("/proc/") + to_string(pid) + "/mem";
-  ErrorOr<File> error_or_mem_file = File::Open(mem_path, File::RD_ONLY);
-  PASS_ERROR(error_or_mem_file.error());
-  File mem_file = error_or_mem_file.move();
+// Passes fd over the unix socket socket_fd, as SCM_RIGHTS.
+Error SendFd(const int socket_fd, const int fd) {
+  char data = 0;
+  iovec iov = {&data, sizeof(data)};
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+  memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+  RETURN_ERROR_SYSCALL(sendmsg(socket_fd, &msg, 0), "Could not send fd.");
+  return Error::Ok();
+}
+
+ErrorOr<int> ReceiveFd(const int socket_fd) {
+  char data;
+  iovec iov = {&data, sizeof(data)};
+  char control[CMSG_SPACE(sizeof(int))] = {};
+  msghdr msg = {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  RETURN_ERROR_SYSCALL(recvmsg(socket_fd, &msg, MSG_CMSG_CLOEXEC),
+                       "Could not receive fd.");
+  cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+  RETURN_ERROR_IF(cmsg == nullptr || cmsg->cmsg_type != SCM_RIGHTS,
+                  "Child did not send an fd.");
+  int fd;
+  memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+  return ErrorOr<int>(std::move(fd));
+}
+
+// The child half of the direct loader: maps the XBE into this (forked) process
+// and stops so that the tracer can jump to its entry point. If image_path is
+// set, the XBE's memory image there is mapped rather than copied. Otherwise,
+// if uffd_socket is a socket rather than -1, non-preload sections are left to
+// be demand loaded and the userfaultfd serving them is sent over uffd_socket.
+// Kernel imports are then pointed at host implementations that count calls in
+// kernel_call_counts.
+Error InitDirect(const XbeImage& xbe,
+                 const int uffd_socket,
+                 const string& image_path,
+                 KernelCallCounts* kernel_call_counts) {
+  RETURN_ERROR_SYSCALL(ptrace(PTRACE_TRACEME, 0, nullptr, nullptr),
+                       "Could not request trace.");
+  if (!image_path.empty()) {
+    PASS_ERROR(LoadXbeShared(xbe, image_path));
+  } else if (uffd_socket < 0) {
+    PASS_ERROR(LoadXbe(xbe));
+  } else {
+    ErrorOr<int> error_or_uffd = LoadXbeOnDemand(xbe);
+    PASS_ERROR(error_or_uffd.error());
+    PASS_ERROR(SendFd(uffd_socket, error_or_uffd.get()));
+    close(error_or_uffd.get());
+  }
+  PASS_ERROR(InstallKernelCalls(xbe, kernel_call_counts));
+  cout << "About to enter xbe ..." << endl;
+  RETURN_ERROR_SYSCALL(raise(SIGSTOP), "Could not stop.");
+  RETURN_ERROR("Tracer did not enter the xbe.");
+}
+
+// Switches the stopped child to 32 bit mode at the XBE's entry point, on the
+// stack LoadXbe mapped.
+Error EnterXbe(const pid_t pid, const XbeImage& xbe) {
+  Span span("EnterXbe");
+  user_regs_struct regs;
+  RETURN_ERROR_SYSCALL(ptrace(PTRACE_GETREGS, pid, 0, &regs),
+                       "Could not read regs.");
+  regs.rip = xbe.entry_mem_addr();
+  regs.rsp = InitialStackPointerFor(xbe);
+  regs.cs = kUser32CodeSelector;
+  regs.ss = kUserDataSelector;
+  regs.ds = kUserDataSelector;
+  regs.es = kUserDataSelector;
+  RETURN_ERROR_SYSCALL(ptrace(PTRACE_SETREGS, pid, 0, &regs),
+                       "Could not write regs.");
+  return Error::Ok();
+}
 
+// Dumps all of the stopped child's memory to dump_path.
+Error DumpChild(const Tracee& tracee, const string& dump_path) {
+  Span span("DumpChild");
+  const uint64_t start_ns = utils::MonotonicNowNs();
   ErrorOr<File> error_or_dump_file = File::Create(dump_path, 0664);
   PASS_ERROR(error_or_dump_file.error());
   File dump_file = error_or_dump_file.move();
+  ErrorOr<MemoryDumpStats> error_or_stats =
+      DumpProcessMemory(tracee.pid(), MemoryDumpOptions(), &dump_file);
+  PASS_ERROR(error_or_stats.error());
+  PASS_ERROR(dump_file.Close());
+  const MemoryDumpStats& stats = error_or_stats.get();
+  cout << "Dumped " << stats.regions << " regions, " << stats.pages_stored
+       << " pages (" << stats.zero_pages << " zero pages skipped) to "
+       << dump_path << " in "
+       << (utils::MonotonicNowNs() - start_ns) / 1000 << " us\n";
+  return Error::Ok();
+}
+
+// Takes the next snapshot, if the run takes snapshots at all.
+Error TakeSnapshot(SnapshotWriter* snapshots) {
+  if (snapshots == nullptr) {
+    return Error::Ok();
+  }
+  const uint64_t start_ns = utils::MonotonicNowNs();
+  ErrorOr<MemoryDumpStats> error_or_stats = snapshots->Take();
+  PASS_ERROR(error_or_stats.error());
+  const MemoryDumpStats& stats = error_or_stats.get();
+  cout << "Snapshot " << snapshots->count() - 1 << ": " << stats.pages_stored
+       << " pages stored, " << stats.zero_pages << " zero, "
+       << stats.pages_unchanged << " unchanged, in "
+       << (utils::MonotonicNowNs() - start_ns) / 1000 << " us\n";
+  return Error::Ok();
+}
+
+void PrintKernelCalls(const KernelCallCounts& counts) {
+  for (uint32_t ordinal = 0; ordinal <= kMaxKernelOrdinal; ordinal++) {
+    if (counts.calls[ordinal] == 0) {
+      continue;
+    }
+    const KernelExport* kernel_export = KernelExportByOrdinal(ordinal);
+    cout << "Kernel call " << ordinal << " ("
+         << (kernel_export != nullptr ? kernel_export->name : "not exported")
+         << "): " << counts.calls[ordinal] << "\n";
+  }
+}
+
+void PrintPhases(const PhaseClock& clock) {
+  cout << "Launch phases:\n" << std::fixed << std::setprecision(3);
+  for (const auto& phase : clock.phases()) {
+    cout << "  " << phase.first << ": " << phase.second / 1e6 << " ms\n";
+  }
+  cout.unsetf(std::ios::floatfield);
+}
+
+// Prints the counters and records them for --stats.
+Error ReportCounters(const ChildCounters& counters) {
+  cout << "Child counters:\n";
+  for (int i = 0; i < static_cast<int>(ChildCounter::COUNT); i++) {
+    const ChildCounter counter = static_cast<ChildCounter>(i);
+    cout << "  " << ChildCounterName(counter) << ": ";
+    if (!counters.available(counter)) {
+      cout << "not available\n";
+      continue;
+    }
+    ErrorOr<uint64_t> error_or_count = counters.Read(counter);
+    PASS_ERROR(error_or_count.error());
+    cout << error_or_count.get() << "\n";
+    IoStats::Get()->SetValue(kCounterGroup, ChildCounterName(counter),
+                             error_or_count.get());
+  }
+  return Error::Ok();
+}
+
+void PrintProfile(const GuestProfiler& profiler, const string& path) {
+  cout << "Profiled " << profiler.samples() << " samples ("
+       << profiler.lost() << " lost) to " << path << "\n";
+  for (const auto& section : profiler.SamplesBySection()) {
+    cout << "  " << section.first << ": " << section.second << "\n";
+  }
+}
+
+// What the tracer does with the child.
+struct WatchOptions {
+  string dump_path;
+  // Set if the child was loaded by InitDirect rather than exec'd.
+  const XbeImage* direct_xbe = nullptr;
+  // Where a child loaded by InitDirect counts its kernel calls.
+  KernelCallCounts* kernel_call_counts = nullptr;
+  // If set, the launch's phases from fork on are timed on it and the child
+  // is counted with ChildCounters from its first stop on.
+  PhaseClock* phases = nullptr;
+  // If set, the run is sampled at profile_frequency and the folded stacks
+  // are written here, named after symbols.
+  string profile_path;
+  uint32_t profile_frequency = GuestProfiler::kDefaultFrequency;
+  const vector<GuestSymbol>* symbols = nullptr;
+  // If set, written to the child's perf map so that perf can name guest code.
+  const vector<GuestSymbol>* perf_map_symbols = nullptr;
+  // Reported whenever the child hits them.
+  vector<uint64_t> breakpoints;
+  vector<Watchpoint> watchpoints;
+  // The non-interactive run, in this order: run until until_addr, step steps
+  // instructions, then continue to exit. With none of them the child is
+  // stepped from stdin.
+  bool run_until = false;
+  uint64_t until_addr = 0;
+  uint64_t steps = 0;
+  bool run_to_exit = false;
+  // If set, every stepped instruction is recorded there; see
+  // InstructionTraceRecorder.
+  string record_path;
+  bool record_regs = false;
+  // Keep only the last this many instructions; 0 keeps all of them.
+  uint64_t record_last = 0;
+  // Dump the child's memory to dump_path once the run is over.
+  bool dump_at_end = false;
+  // If set, snapshots are taken into this directory when the run starts and
+  // at every stop of a non-interactive run; see SnapshotWriter.
+  string snapshot_dir;
+  bool interactive() const { return !run_until && steps == 0 && !run_to_exit; }
+};
+
+void PrintStop(const Stop& stop) {
+  switch (stop.kind) {
+    case StopKind::BREAKPOINT:
+      cout << "Breakpoint at 0x" << std::hex << stop.rip << std::dec << "\n";
+      break;
+    case StopKind::STEP:
+      cout << "Current rip: 0x" << std::hex << stop.rip << std::dec << "\n";
+      break;
+    case StopKind::WATCHPOINT:
+      cout << "Watchpoint at 0x" << std::hex << stop.watch_addr
+           << " hit before 0x" << stop.rip << ", value now 0x"
+           << stop.watch_value << std::dec << "\n";
+      break;
+    case StopKind::SIGNAL:
+      cout << "Signal " << strsignal(stop.signal) << " at 0x" << std::hex
+           << stop.rip << std::dec << "\n";
+      break;
+    case StopKind::EXITED:
+      cout << "Child died with status: " << stop.status << "\n";
+      break;
+  }
+}
+
+Error PrintStop(const ErrorOr<Stop>& error_or_stop) {
+  PASS_ERROR(error_or_stop.error());
+  PrintStop(error_or_stop.get());
+  return Error::Ok();
+}
 
-  const size_t buffer_size = 2048;
-  char buffer[buffer_size];
-  ssize_t amount_read = buffer_size;
-  PASS_ERROR(mem_file.Seek(0x12000).error());
-  PASS_ERROR(dump_file.Seek(0x12000).error());
-  while (amount_read == buffer_size) {
-    ErrorOr<ssize_t> error_or_amount_read = mem_file.Read(buffer, buffer_size);
-    PASS_ERROR(error_or_amount_read.error());
-    amount_read = error_or_amount_read.get();
-    PASS_ERROR(dump_file.Write(buffer, amount_read).error());
+// Continues through every breakpoint and watchpoint hit, snapshotting at
+// each, until the child exits, or stops for a signal it would die of, which
+// is worth looking at before it does.
+ErrorOr<Stop> ContinueToExit(Tracee* tracee, SnapshotWriter* snapshots) {
+  while (true) {
+    ErrorOr<Stop> error_or_stop = tracee->Continue();
+    PASS_ERROR(error_or_stop.error());
+    Stop stop = error_or_stop.get();
+    if (stop.kind != StopKind::BREAKPOINT
+        && stop.kind != StopKind::WATCHPOINT) {
+      return ErrorOr<Stop>(std::move(stop));
+    }
+    PrintStop(stop);
+    PASS_ERROR(TakeSnapshot(snapshots));
+  }
+}
+
+// Reads commands from stdin until "q" or end of input:
+//   s [n]      step n instructions (default 1); so does an empty line
+//   c          continue to the next breakpoint
+//   u <addr>   run until addr
+//   b <addr>   insert a breakpoint
+//   d <addr>   delete a breakpoint
+//   w <addr>   watch the 4 bytes at addr for writes
+//   x <addr>   delete a watchpoint
+//   m          dump memory to dump_path
+//   p          take a snapshot
+Error RunInteractive(Tracee* tracee,
+                     const string& dump_path,
+                     SnapshotWriter* snapshots) {
+  string line;
+  while (!tracee->exited() && std::getline(std::cin, line)) {
+    std::istringstream command(line);
+    string name;
+    string arg;
+    command >> name >> arg;
+    uint64_t value = 0;
+    if (!arg.empty() && !utils::ParseUint(arg, &value)) {
+      cout << "Not a number: " << arg << "\n";
+      continue;
+    }
+    if (name == "q") {
+      break;
+    } else if (name.empty() || name == "s") {
+      PASS_ERROR(PrintStop(tracee->StepN(arg.empty() ? 1 : value)));
+    } else if (name == "c") {
+      PASS_ERROR(PrintStop(tracee->Continue()));
+    } else if (name == "u" && !arg.empty()) {
+      PASS_ERROR(PrintStop(tracee->RunUntil(value)));
+    } else if (name == "b" && !arg.empty()) {
+      PASS_ERROR(tracee->InsertBreakpoint(value));
+    } else if (name == "d" && !arg.empty()) {
+      PASS_ERROR(tracee->RemoveBreakpoint(value));
+    } else if (name == "w" && !arg.empty()) {
+      PASS_ERROR(tracee->InsertWatchpoint({value, 4, WatchKind::WRITE}));
+    } else if (name == "x" && !arg.empty()) {
+      PASS_ERROR(tracee->RemoveWatchpoint(value));
+    } else if (name == "m") {
+      PASS_ERROR(DumpChild(*tracee, dump_path));
+    } else if (name == "p" && snapshots != nullptr) {
+      PASS_ERROR(TakeSnapshot(snapshots));
+    } else {
+      cout << "Unknown command: " << line << "\n";
+    }
+    cout.flush();
   }
   return Error::Ok();
 }
 
-Error WatchExec(const pid_t child_pid, const string& dump_path) {
+Error RunChild(Tracee* tracee,
+               const WatchOptions& options,
+               SnapshotWriter* snapshots) {
+  if (options.interactive()) {
+    return RunInteractive(tracee, options.dump_path, snapshots);
+  }
+  Span span("RunChild");
+  if (options.run_until) {
+    PASS_ERROR(PrintStop(tracee->RunUntil(options.until_addr)));
+    if (!tracee->exited()) {
+      PASS_ERROR(TakeSnapshot(snapshots));
+    }
+  }
+  if (options.steps > 0 && !tracee->exited()) {
+    PASS_ERROR(PrintStop(tracee->StepN(options.steps)));
+    cout << "Stepped " << tracee->steps() << " instructions\n";
+    if (!tracee->exited()) {
+      PASS_ERROR(TakeSnapshot(snapshots));
+    }
+  }
+  if (options.run_to_exit && !tracee->exited()) {
+    PASS_ERROR(PrintStop(ContinueToExit(tracee, snapshots)));
+  }
+  return Error::Ok();
+}
+
+// RunChild, recording the instruction the child starts at and every one it
+// steps to.
+Error RecordChild(Tracee* tracee,
+                  const WatchOptions& options,
+                  SnapshotWriter* snapshots) {
+  ErrorOr<File> error_or_file = File::Create(options.record_path, 0664);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  InstructionTraceRecorder recorder(
+      &file,
+      options.record_regs,
+      options.record_last > 0 ? options.record_last
+                              : InstructionTraceRecorder::kDefaultCapacity,
+      options.record_last > 0);
+  ErrorOr<user_regs_struct> error_or_regs = tracee->GetRegs();
+  PASS_ERROR(error_or_regs.error());
+  PASS_ERROR(recorder.Record(error_or_regs.get()));
+  tracee->set_step_observer([&recorder](const user_regs_struct& regs) {
+    return recorder.Record(regs);
+  });
+  const Error error = RunChild(tracee, options, snapshots);
+  tracee->set_step_observer(nullptr);
+  PASS_ERROR(error);
+  PASS_ERROR(recorder.Finish());
+  PASS_ERROR(file.Close());
+  cout << "Recorded " << recorder.recorded() << " instructions in "
+       << recorder.bytes_written() << " bytes to " << options.record_path
+       << "\n";
+  return Error::Ok();
+}
+
+Error WatchExec(const pid_t child_pid, const WatchOptions& options) {
+  if (options.perf_map_symbols != nullptr) {
+    PASS_ERROR(WritePerfMap(*options.perf_map_symbols,
+                            PerfMapPathFor(child_pid)));
+  }
   int status;
-  // Wait for child to call execve.
+  // Wait for child to call execve (or stop itself, when loaded directly).
   cout << "About to wait for child: pid " << child_pid << endl;
-  RETURN_ERROR_SYSCALL(waitpid(child_pid, &status, WSTOPPED), "Wait failed.");
+  {
+    Span span("WaitForExec");
+    RETURN_ERROR_SYSCALL(waitpid(child_pid, &status, WSTOPPED),
+                         "Wait failed.");
+  }
   if (!WIFSTOPPED(status)) {
     RETURN_ERROR("Program did not stop.");
   }
+  unique_ptr<ChildCounters> counters;
+  if (options.phases != nullptr) {
+    options.phases->End("fork_exec");
+    counters.reset(new ChildCounters(child_pid));
+  }
+  if (options.direct_xbe != nullptr) {
+    PASS_ERROR(EnterXbe(child_pid, *options.direct_xbe));
+  }
 
-  // PASS_ERROR(DumpMem(dump_path, child_pid));
-
-  int cmd;
-  while ((cmd = getchar()) != 'q') {
-    RETURN_ERROR_SYSCALL(ptrace(PTRACE_SINGLESTEP, child_pid, nullptr, 0),
-                         "Inserting sigtrap failed.");
-
-    RETURN_ERROR_SYSCALL(waitpid(child_pid, &status, WSTOPPED), "Wait failed.");
-    if (!WIFSTOPPED(status)) {
-      RETURN_ERROR("Program did not stop.");
+  Tracee tracee(child_pid);
+  for (const uint64_t addr : options.breakpoints) {
+    PASS_ERROR(tracee.InsertBreakpoint(addr));
+  }
+  for (const Watchpoint& watchpoint : options.watchpoints) {
+    PASS_ERROR(tracee.InsertWatchpoint(watchpoint));
+  }
+  unique_ptr<SnapshotWriter> snapshots;
+  if (!options.snapshot_dir.empty()) {
+    ErrorOr<SnapshotWriter> error_or_snapshots =
+        SnapshotWriter::Open(child_pid, options.snapshot_dir);
+    PASS_ERROR(error_or_snapshots.error());
+    snapshots.reset(new SnapshotWriter(error_or_snapshots.move()));
+    if (!snapshots->soft_dirty()) {
+      cout << "No soft dirty bits; snapshots compare page contents instead\n";
     }
+    PASS_ERROR(TakeSnapshot(snapshots.get()));
+  }
+  unique_ptr<GuestProfiler> profiler;
+  if (!options.profile_path.empty()) {
+    profiler.reset(new GuestProfiler(child_pid, *options.symbols));
+    PASS_ERROR(profiler->Start(options.profile_frequency));
+  }
+  if (options.phases != nullptr) {
+    options.phases->End("first_instruction");
+  }
+  if (options.record_path.empty()) {
+    PASS_ERROR(RunChild(&tracee, options, snapshots.get()));
+  } else {
+    PASS_ERROR(RecordChild(&tracee, options, snapshots.get()));
+  }
+  if (options.phases != nullptr) {
+    options.phases->End("exit");
+    PASS_ERROR(ReportCounters(*counters));
+  }
+  if (profiler != nullptr) {
+    PASS_ERROR(profiler->Stop());
+    PASS_ERROR(profiler->WriteFolded(options.profile_path));
+    PrintProfile(*profiler, options.profile_path);
+  }
+  // --continue that stops short of exit stopped for a signal.
+  if (options.run_to_exit && !tracee.exited()) {
+    PASS_ERROR(TakeSnapshot(snapshots.get()));
+  }
+  if (options.dump_at_end && !tracee.exited()) {
+    PASS_ERROR(DumpChild(tracee, options.dump_path));
+  }
 
-    user_regs_struct regs;
-    RETURN_ERROR_SYSCALL(ptrace(PTRACE_GETREGS, child_pid, 0, &regs),
-                         "Could not read regs.");
-    cout << "Current rip: 0x" << std::hex << regs.rip << endl;
-  }
-  // int opcode = ptrace(PTRACE_PEEKTEXT, child_pid, 0xf48d5, 0);
-  // RETURN_ERROR_SYSCALL(opcode,
-  //                      "Could not read text.");
-  // cout << "Read opcode: " << std::hex << opcode << endl;
-  // cout << "Continuing child ..." << endl;
-  // RETURN_ERROR_SYSCALL(ptrace(PTRACE_CONT, child_pid, nullptr, nullptr),
-  //                      "Could not continue child.");
-
-  // RETURN_ERROR_SYSCALL(waitpid(child_pid, &status, WSTOPPED), "Wait failed.");
-  // if (!WIFSTOPPED(status)) {
-  //   RETURN_ERROR("Program did not stop.");
-  // }
-  // cout << "Caught sigtrap." << endl;
-
-  // cout << "Continuing child ..." << endl;
-  // RETURN_ERROR_SYSCALL(ptrace(PTRACE_CONT, child_pid, nullptr, nullptr),
-  //                      "Could not continue child.");
-
-  // RETURN_ERROR_SYSCALL(waitpid(child_pid, &status, WSTOPPED), "Wait failed.");
-  // if (!WIFSTOPPED(status)) {
-  //   RETURN_ERROR("Program did not stop.");
-  // }
-  // cout << "Caught sigtrap." << endl;
-
-  // user_regs_struct regs;
-  // RETURN_ERROR_SYSCALL(ptrace(PTRACE_GETREGS, child_pid, 0, &regs),
-  //                      "Could not read regs.");
-  // cout << "Current rip: 0x" << std::hex << regs.rip << endl;
-
-  // Wait for child death.
-  RETURN_ERROR_SYSCALL(waitpid(child_pid, &status, WEXITED), "Wait failed.");
-  cout << "Child died with status: " << status << endl;
+  // Unless it exited, the child is still stopped under trace; it only dies if
+  // killed.
+  if (!tracee.exited()) {
+    PASS_ERROR(PrintStop(tracee.Kill()));
+  }
+  if (options.kernel_call_counts != nullptr) {
+    PrintKernelCalls(*options.kernel_call_counts);
+  }
+  cout.flush();
   return Error::Ok();
 }
 
-Error ExecElf(const string& elf_path, const string& dump_path) {
+Error ExecElf(const string& elf_path, const WatchOptions& options) {
+  Span span("ExecElf");
   pid_t pid = fork();
   RETURN_ERROR_SYSCALL(pid, "Could not fork.");
   if (pid) {
-    PASS_ERROR(WatchExec(pid, dump_path));
+    PASS_ERROR(WatchExec(pid, options));
   } else {
     PASS_ERROR(InitExec(elf_path));
   }
   return Error::Ok();
 }
 
+// image_path is as for InitDirect.
+Error ExecXbeDirect(const XbeImage& xbe,
+                    const string& image_path,
+                    WatchOptions options) {
+  Span span("ExecXbeDirect");
+  options.direct_xbe = &xbe;
+  pid_t pid = fork();
+  RETURN_ERROR_SYSCALL(pid, "Could not fork.");
+  if (pid) {
+    PASS_ERROR(WatchExec(pid, options));
+  } else {
+    PASS_ERROR(InitDirect(xbe, -1, image_path, options.kernel_call_counts));
+  }
+  return Error::Ok();
+}
+
+// Like ExecXbeDirect, but this process pages in the child's non-preload
+// sections as they are first touched.
+Error ExecXbeOnDemand(const XbeImage& xbe, WatchOptions options) {
+  Span span("ExecXbeOnDemand");
+  options.direct_xbe = &xbe;
+  int sockets[2];
+  RETURN_ERROR_SYSCALL(
+      socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets),
+      "Could not create socket pair.");
+  pid_t pid = fork();
+  RETURN_ERROR_SYSCALL(pid, "Could not fork.");
+  if (pid) {
+    close(sockets[1]);
+    ErrorOr<int> error_or_uffd = ReceiveFd(sockets[0]);
+    close(sockets[0]);
+    PASS_ERROR(error_or_uffd.error());
+    XbePager pager(xbe, error_or_uffd.get());
+    PASS_ERROR(pager.Start());
+    PASS_ERROR(WatchExec(pid, options));
+    PASS_ERROR(pager.Stop());
+    cout << "Loaded " << pager.pages_loaded() << " demand pages." << endl;
+  } else {
+    close(sockets[0]);
+    PASS_ERROR(
+        InitDirect(xbe, sockets[1], "", options.kernel_call_counts));
+  }
+  return Error::Ok();
+}
+
+// Usage: exec_xbe <xbe> [--stats[=<json path>]] [--trace=<json path>]
+//                 [--loader=elf|direct|demand|shared]
+//                 [--cache_dir=<dir>] [--cache_max_bytes=<n>] [--no_cache]
+//                 [--signatures=<file>] [--perf_map]
+//                 [--break=<addr>,...]
+//                 [--watch=<addr>[:<size>[:w|rw]],...]
+//                 [--until=<addr>] [--steps=<n>]
+//                 [--continue]
+//                 [--record=<path> [--record_regs] [--record_last=<n>]]
+//                 [--dump[=<path>]] [--snapshots=<dir>]
+//                 [--profile[=<path>] [--profile_hz=<n>]]
+//
+// <xbe> may be "<image>:/<path in image>". With --loader=elf (the default) the
+// XBE is converted to an ELF and exec'd; unless --no_cache is given, the ELF
+// is executed straight out of the ELF cache, so an unchanged XBE is only
+// converted once. --loader=direct skips the ELF and maps the XBE into a
+// forked child (see exec::xbe::LoadXbe). --loader=demand does the same but
+// only preloads sections with the preload flag; the rest are paged in on first
+// touch, and --stats reports how many pages and sections that took.
+// --loader=shared maps a memory image of the XBE from the cache instead, so
+// that concurrent instances of a title share its read only pages.
+//
+// Under every loader but elf, the XBE's kernel imports call host code in the
+// child itself rather than trapping to this process (see
+// exec::xbe::InstallKernelCalls); the calls made to each ordinal are printed
+// once the run is over. Ordinals without a host implementation raise SIGSYS.
+//
+// The ELF loader gives the ELF a symbol table of the guest's entry point,
+// sections, kernel imports and, with --signatures, library functions.
+// --perf_map writes the same symbols to /tmp/perf-<pid>.map for the child, so
+// that perf can name guest code whichever loader ran it.
+//
+// The child starts stopped at its entry point. --until runs it to an address,
+// --steps then single steps it and --continue then lets it run to exit,
+// reporting each --break it hits on the way; --until and --continue cost
+// nothing per instruction. So does --watch, which has the CPU's debug
+// registers trap accesses to up to four addresses, each <size> bytes (1, 2, 4
+// or 8, 4 by default) aligned to their size, either writes (w, the default)
+// or reads and writes (rw); each hit is reported with the rip after the
+// accessing instruction and the value the bytes hold after it. With none of
+// them, commands are read from stdin (see RunInteractive) until "q" or end of
+// input. Breakpoints cannot be set in code mapped by --loader=shared, which is
+// shared with other instances.
+//
+// --record writes every instruction the child is stepped through to a binary
+// trace (see InstructionTraceRecorder), with all registers if --record_regs is
+// given and only the last n instructions if --record_last is; decode it with
+// decode_trace.
+//
+// --dump writes all of the child's memory, every region in its maps, to
+// <path> (by default <xbe>.memdump) once the run is over, if the child is
+// still alive; see memory_dump.h for the format and print_dump to read it.
+// Under --loader=demand, regions with pages that were never touched are
+// recorded as unreadable from the first such page on.
+//
+// --snapshots takes a series of snapshots of the child's memory into <dir>:
+// one at the entry point and one at every stop of the run that the child
+// survives, or, interactively, one for each "p". Each after the first only
+// holds the pages written since the one before, found with the kernel's soft
+// dirty bits or, where it has none, by comparing page contents;
+// reconstruct_snapshot turns any of them back into a full dump.
+//
+// --stats also times the phases of the launch, each printed and reported
+// under "launch_phases_ns": open_xbe, convert (to an ELF or memory image, if
+// the loader needs one and the cache has none) and file_write (the part of
+// that spent writing files), fork_exec (up to the child's first stop, so
+// including the loading under the direct loaders), first_instruction (until
+// the child is set up at its entry point and let go) and exit (the run until
+// the child exits or the run ends). The child's instructions, cycles, cache
+// misses, page faults and context switches in user space are counted from its
+// first stop on with perf_event_open and reported under "child_counters";
+// counters the machine lacks, such as hardware counters in most virtual
+// machines, are printed as not available.
+//
+// --profile samples where the child runs, <n> times a second of its CPU time
+// (997 by default), without stopping it (see exec::elf::GuestProfiler), and
+// writes the stacks sampled to <path> (by default <xbe>.folded) in the
+// folded format flame graph tools read; samples per section are printed. It
+// is only worth anything for runs that let the child run: --until or
+// --continue.
 int main(int argc, char* argv[]) {
-  CHECK_INFO(argc == 2, "Must specify path to xbe.");
-  const string xbe_path = argv[1];
-  const string elf_path = xbe_path + ".bin";
-  const string dump_path = xbe_path + ".memdump";
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 1, "Must specify path to xbe.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  PhaseClock phases;
+  const string xbe_path = flags.positional()[0];
+  ErrorOr<XbeImage> error_or_xbe = OpenXbe(xbe_path);
+  CHECK_ERROR(error_or_xbe.error());
 
-  ErrorOr<File> error_or_xbe_file = File::Open(xbe_path, File::RD_ONLY);
-  CHECK_ERROR(error_or_xbe_file.error());
-  File xbe_file = error_or_xbe_file.move();
+  vector<GuestSymbol> symbols;
+  if (flags.Has("signatures")) {
+    ErrorOr<vector<GuestSymbol>> error_or_symbols = CollectXbeSymbols(
+        error_or_xbe.get(), flags.GetString("signatures", ""));
+    CHECK_ERROR(error_or_symbols.error());
+    symbols = error_or_symbols.move();
+  } else {
+    symbols = CollectXbeSymbols(error_or_xbe.get());
+  }
+  phases.End("open_xbe");
+  const uint64_t write_ns_before =
+      IoStats::Get()->Latency(IoOp::FILE_WRITE).total_ns();
+  auto end_convert = [&phases, write_ns_before]() {
+    phases.EndSplit("convert", "file_write",
+                    IoStats::Get()->Latency(IoOp::FILE_WRITE).total_ns()
+                        - write_ns_before);
+  };
+  WatchOptions options;
+  options.dump_path = flags.GetString("dump", "");
+  if (options.dump_path.empty()) {
+    options.dump_path = HostPathFor(xbe_path) + ".memdump";
+  }
+  options.dump_at_end = flags.Has("dump");
+  options.snapshot_dir = flags.GetString("snapshots", "");
+  if (flags.Has("perf_map")) {
+    options.perf_map_symbols = &symbols;
+  }
+  options.symbols = &symbols;
+  if (flags.Has("profile")) {
+    options.profile_path = flags.GetString("profile", "");
+    if (options.profile_path.empty()) {
+      options.profile_path = HostPathFor(xbe_path) + ".folded";
+    }
+    options.profile_frequency =
+        flags.GetUint("profile_hz", GuestProfiler::kDefaultFrequency);
+  }
+  std::istringstream breakpoints(flags.GetString("break", ""));
+  string breakpoint;
+  while (std::getline(breakpoints, breakpoint, ',')) {
+    uint64_t addr;
+    CHECK_INFO(utils::ParseUint(breakpoint, &addr),
+               "--break must be a comma separated list of addresses.");
+    options.breakpoints.push_back(addr);
+  }
+  std::istringstream watchpoints(flags.GetString("watch", ""));
+  string watch;
+  while (std::getline(watchpoints, watch, ',')) {
+    CHECK_INFO(
+        static_cast<int>(options.watchpoints.size()) < Tracee::kMaxWatchpoints,
+        "--watch takes at most 4 watchpoints.");
+    std::istringstream fields(watch);
+    string addr;
+    string size = "4";
+    string kind = "w";
+    std::getline(fields, addr, ':');
+    std::getline(fields, size, ':');
+    std::getline(fields, kind, ':');
+    Watchpoint watchpoint;
+    uint64_t watch_size;
+    CHECK_INFO(utils::ParseUint(addr, &watchpoint.addr)
+                   && utils::ParseUint(size, &watch_size)
+                   && (kind == "w" || kind == "rw"),
+               "--watch must be a comma separated list of "
+               "<addr>[:<size>[:w|rw]].");
+    watchpoint.size = watch_size;
+    watchpoint.kind = kind == "w" ? WatchKind::WRITE : WatchKind::READ_WRITE;
+    options.watchpoints.push_back(watchpoint);
+  }
+  options.run_until = flags.Has("until");
+  options.until_addr = flags.GetUint("until", 0);
+  options.steps = flags.GetUint("steps", 0);
+  options.run_to_exit = flags.Has("continue");
+  options.record_path = flags.GetString("record", "");
+  options.record_regs = flags.Has("record_regs");
+  options.record_last = flags.GetUint("record_last", 0);
+  if (flags.Has("stats")) {
+    options.phases = &phases;
+  }
 
-  ErrorOr<File> error_or_elf_file = File::Create(elf_path, 0777);
-  CHECK_ERROR(error_or_elf_file.error());
-  File elf_file = error_or_elf_file.move();
+  const string loader = flags.GetString("loader", "elf");
+  CHECK_INFO(loader == "elf" || loader == "direct" || loader == "demand"
+                 || loader == "shared",
+             "--loader must be elf, direct, demand or shared.");
+  if (loader != "elf") {
+    ErrorOr<KernelCallCounts*> error_or_counts = MapKernelCallCounts();
+    CHECK_ERROR(error_or_counts.error());
+    options.kernel_call_counts = error_or_counts.get();
+  }
+  if (loader == "direct") {
+    end_convert();
+    CHECK_ERROR(ExecXbeDirect(error_or_xbe.get(), "", options));
+  } else if (loader == "shared") {
+    ErrorOr<ElfCache> error_or_cache = ElfCache::Open(
+        flags.GetString("cache_dir", ElfCache::DefaultDir()),
+        flags.GetUint("cache_max_bytes", kDefaultCacheMaxBytes));
+    CHECK_ERROR(error_or_cache.error());
+    ElfCache cache = error_or_cache.move();
+    ErrorOr<string> error_or_image_path =
+        cache.GetOrMakeMemoryImage(error_or_xbe.get());
+    CHECK_ERROR(error_or_image_path.error());
+    end_convert();
+    CHECK_ERROR(ExecXbeDirect(error_or_xbe.get(),
+                              error_or_image_path.get(),
+                              options));
+  } else if (loader == "demand") {
+    end_convert();
+    CHECK_ERROR(ExecXbeOnDemand(error_or_xbe.get(), options));
+  } else {
+    string elf_path;
+    if (flags.Has("no_cache")) {
+      elf_path = HostPathFor(xbe_path) + ".bin";
+      // elf_path may be a link to a cache entry, which must not be rewritten.
+      unlink(elf_path.c_str());
+      ErrorOr<File> error_or_elf_file = File::Create(elf_path, 0777);
+      CHECK_ERROR(error_or_elf_file.error());
+      File elf_file = error_or_elf_file.move();
 
-  CHECK_ERROR(MakeElfFromXbe(&xbe_file, &elf_file));
-  CHECK_ERROR(xbe_file.Close());
-  CHECK_ERROR(elf_file.Close());
+      CHECK_ERROR(MakeElfFromXbe(error_or_xbe.get(), symbols, &elf_file));
+      CHECK_ERROR(elf_file.Close());
+    } else {
+      ErrorOr<ElfCache> error_or_cache = ElfCache::Open(
+          flags.GetString("cache_dir", ElfCache::DefaultDir()),
+          flags.GetUint("cache_max_bytes", kDefaultCacheMaxBytes));
+      CHECK_ERROR(error_or_cache.error());
+      ElfCache cache = error_or_cache.move();
+      ErrorOr<string> error_or_elf_path =
+          cache.GetOrConvert(error_or_xbe.get(), symbols);
+      CHECK_ERROR(error_or_elf_path.error());
+      elf_path = error_or_elf_path.move();
+    }
+    end_convert();
 
-  CHECK_ERROR(ExecElf(elf_path, dump_path));
+    CHECK_ERROR(ExecElf(elf_path, options));
+  }
 
+  if (flags.Has("stats")) {
+    PrintPhases(phases);
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
   return 0;
 }
@@ -0,0 +1,257 @@
+#include "cc/exec/elf/guest_profiler.h"
+
+#include <linux/perf_event.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include "cc/io/file.h"
+#include "cc/utils/trace.h"
+
+using std::map;
+using std::string;
+using std::vector;
+using exec::xbe::GuestSymbol;
+using exec::xbe::GuestSymbolKind;
+using io::File;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace elf {
+namespace {
+const size_t kPageSize = 0x1000;
+// Data pages of the ring buffer, a power of 2: room for several thousand
+// samples with deep stacks between drains.
+const size_t kRingDataPages = 64;
+const char kHostFrame[] = "[host]";
+
+struct SymbolAddrLess {
+  bool operator()(uint64_t addr, const GuestSymbol& symbol) const {
+    return addr < symbol.addr;
+  }
+};
+} // namespace
+
+GuestProfiler::GuestProfiler(pid_t pid, const vector<GuestSymbol>& symbols)
+    : pid_(pid), symbols_(symbols), error_(Error::Ok()) {}
+
+GuestProfiler::~GuestProfiler() {
+  Stop();
+  if (ring_ != nullptr) {
+    munmap(ring_, ring_size_);
+  }
+  if (perf_fd_ >= 0) {
+    close(perf_fd_);
+  }
+}
+
+Error GuestProfiler::Start(uint32_t frequency) {
+  RETURN_ERROR_IF(frequency == 0, "Sampling frequency must not be 0.");
+  perf_event_attr attr = {};
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_SOFTWARE;
+  attr.config = PERF_COUNT_SW_CPU_CLOCK;
+  attr.freq = 1;
+  attr.sample_freq = frequency;
+  attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_CALLCHAIN;
+  // What an unprivileged process may sample of its own children.
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.exclude_callchain_kernel = 1;
+  attr.watermark = 1;
+  attr.wakeup_watermark = kRingDataPages * kPageSize / 4;
+  perf_fd_ = syscall(SYS_perf_event_open, &attr, pid_, -1, -1,
+                     PERF_FLAG_FD_CLOEXEC);
+  RETURN_ERROR_SYSCALL(perf_fd_, "Could not open perf event.");
+  ring_size_ = (1 + kRingDataPages) * kPageSize;
+  void* ring = mmap(nullptr, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    perf_fd_, 0);
+  RETURN_ERROR_IF(ring == MAP_FAILED,
+                  string("Could not map perf ring buffer: ")
+                      + strerror(errno));
+  ring_ = static_cast<char*>(ring);
+  stop_fd_ = eventfd(0, EFD_CLOEXEC);
+  RETURN_ERROR_SYSCALL(stop_fd_, "Could not create eventfd.");
+  thread_ = std::thread(&GuestProfiler::Serve, this);
+  return Error::Ok();
+}
+
+Error GuestProfiler::Stop() {
+  if (!thread_.joinable()) {
+    return error_;
+  }
+  const uint64_t one = 1;
+  RETURN_ERROR_SYSCALL(write(stop_fd_, &one, sizeof(one)),
+                       "Could not stop profiler.");
+  thread_.join();
+  close(stop_fd_);
+  stop_fd_ = -1;
+  Drain();
+  return error_;
+}
+
+void GuestProfiler::Serve() {
+  pollfd fds[2] = {
+    {stop_fd_, POLLIN, 0},
+    {perf_fd_, POLLIN, 0},
+  };
+  // Once the process exits, only the stop request is worth waiting for.
+  nfds_t nfds = 2;
+  while (true) {
+    if (poll(fds, nfds, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error_ = Error(string("Could not poll perf event: ") + strerror(errno),
+                     __FILE__, __LINE__);
+      return;
+    }
+    if (fds[0].revents != 0) {
+      return;
+    }
+    Drain();
+    if (fds[1].revents & (POLLERR | POLLHUP)) {
+      nfds = 1;
+    }
+  }
+}
+
+void GuestProfiler::Drain() {
+  perf_event_mmap_page* meta = reinterpret_cast<perf_event_mmap_page*>(ring_);
+  const char* data = ring_ + kPageSize;
+  const uint64_t data_size = kRingDataPages * kPageSize;
+  const uint64_t head = __atomic_load_n(&meta->data_head, __ATOMIC_ACQUIRE);
+  uint64_t tail = meta->data_tail;
+  vector<char> record;
+  while (tail < head) {
+    // Records may wrap around the end of the ring.
+    perf_event_header header;
+    for (size_t i = 0; i < sizeof(header); i++) {
+      reinterpret_cast<char*>(&header)[i] = data[(tail + i) % data_size];
+    }
+    record.resize(header.size);
+    for (size_t i = 0; i < header.size; i++) {
+      record[i] = data[(tail + i) % data_size];
+    }
+    tail += header.size;
+    const uint64_t* fields =
+        reinterpret_cast<const uint64_t*>(record.data() + sizeof(header));
+    if (header.type == PERF_RECORD_LOST) {
+      // id, then the number lost.
+      lost_ += fields[1];
+    } else if (header.type == PERF_RECORD_SAMPLE) {
+      // ip, then the callchain: nr, then nr addresses from the callee out,
+      // with context markers mixed in.
+      const uint64_t ip = fields[0];
+      const uint64_t nr = fields[1];
+      vector<uint64_t> stack;
+      for (uint64_t i = 0; i < nr; i++) {
+        const uint64_t addr = fields[2 + i];
+        if (addr < static_cast<uint64_t>(PERF_CONTEXT_MAX)) {
+          stack.push_back(addr);
+        }
+      }
+      if (stack.empty()) {
+        stack.push_back(ip);
+      }
+      std::reverse(stack.begin(), stack.end());
+      stacks_[stack]++;
+      samples_++;
+    }
+  }
+  __atomic_store_n(&meta->data_tail, tail, __ATOMIC_RELEASE);
+}
+
+string GuestProfiler::SectionOf(uint64_t addr) const {
+  for (const GuestSymbol& symbol : symbols_) {
+    if (symbol.kind == GuestSymbolKind::SECTION && addr >= symbol.addr
+        && addr < static_cast<uint64_t>(symbol.addr) + symbol.size) {
+      return symbol.name;
+    }
+  }
+  return kHostFrame;
+}
+
+string GuestProfiler::FrameName(uint64_t addr) const {
+  const string section = SectionOf(addr);
+  if (section == kHostFrame) {
+    return section;
+  }
+  // The closest function at or before addr, if it reaches that far.
+  auto it = std::upper_bound(symbols_.begin(), symbols_.end(), addr,
+                             SymbolAddrLess());
+  while (it != symbols_.begin()) {
+    --it;
+    if (it->kind != GuestSymbolKind::FUNCTION) {
+      continue;
+    }
+    if ((it->size == 0 || addr < static_cast<uint64_t>(it->addr) + it->size)
+        && SectionOf(it->addr) == section) {
+      return section + "`" + it->name;
+    }
+    break;
+  }
+  char name[32];
+  snprintf(name, sizeof(name), "`0x%08" PRIx64, addr);
+  return section + name;
+}
+
+map<string, uint64_t> GuestProfiler::SamplesBySection() const {
+  map<string, uint64_t> samples;
+  for (const auto& stack : stacks_) {
+    samples[SectionOf(stack.first.back())] += stack.second;
+  }
+  return samples;
+}
+
+Error GuestProfiler::WriteFolded(const string& path) const {
+  Span span("WriteFolded");
+  span.set_detail(path);
+  // Stacks that differ only in addresses within one function fold together.
+  map<string, uint64_t> folded;
+  for (const auto& stack : stacks_) {
+    string line;
+    string last_frame;
+    for (const uint64_t addr : stack.first) {
+      const string frame = FrameName(addr);
+      // A host call's own frames are of no interest.
+      if (frame == kHostFrame && last_frame == kHostFrame) {
+        continue;
+      }
+      if (!line.empty()) {
+        line += ";";
+      }
+      line += frame;
+      last_frame = frame;
+    }
+    folded[line] += stack.second;
+  }
+  string text;
+  for (const auto& line : folded) {
+    text += line.first + " " + std::to_string(line.second) + "\n";
+  }
+  ErrorOr<File> error_or_file = File::Create(path, 0664);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  for (size_t written = 0; written < text.size();) {
+    ErrorOr<ssize_t> error_or_written =
+        file.Write(text.data() + written, text.size() - written);
+    PASS_ERROR(error_or_written.error());
+    written += error_or_written.get();
+  }
+  PASS_ERROR(file.Close());
+  span.set_bytes(text.size());
+  return Error::Ok();
+}
+
+} // namespace elf
+} // namespace exec
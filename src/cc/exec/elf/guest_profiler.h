@@ -0,0 +1,82 @@
+#ifndef EXEC_ELF_GUEST_PROFILER_H_
+#define EXEC_ELF_GUEST_PROFILER_H_
+
+#include <sys/types.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cc/exec/xbe/xbe_symbols.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace elf {
+
+// Samples where a running process is, at a fixed frequency of its CPU time,
+// with perf_event_open: the kernel interrupts the process and records its
+// user space rip and, walking frame pointers, callers into a ring buffer that
+// a thread of this process drains, so the process runs at close to full speed
+// with nobody stopping it.
+//
+// Addresses are named after the guest symbols: "<section>`<function>" if a
+// function symbol covers them, "<section>`0x<address>" otherwise, and
+// "[host]" for everything outside the XBE's sections, such as host kernel
+// call implementations.
+//
+// Usage:
+//   GuestProfiler profiler(pid, symbols);
+//   PASS_ERROR(profiler.Start(frequency));
+//   ... let pid run ...
+//   PASS_ERROR(profiler.Stop());
+//   PASS_ERROR(profiler.WriteFolded(path));
+class GuestProfiler {
+ public:
+  static const uint32_t kDefaultFrequency = 997;
+
+  // symbols must be sorted as CollectXbeSymbols returns them and must outlive
+  // the profiler.
+  GuestProfiler(pid_t pid, const std::vector<xbe::GuestSymbol>& symbols);
+  ~GuestProfiler();
+
+  utils::Error Start(uint32_t frequency);
+  // Takes the last samples. Returns the first error the draining thread hit,
+  // if any.
+  utils::Error Stop();
+
+  uint64_t samples() const { return samples_; }
+  // Samples the kernel dropped because the ring buffer was full.
+  uint64_t lost() const { return lost_; }
+  // Samples whose rip was in each section, or in "[host]".
+  std::map<std::string, uint64_t> SamplesBySection() const;
+  // One "<caller>;...;<callee> <samples>" line per distinct stack, the folded
+  // stack format flame graph tools read.
+  utils::Error WriteFolded(const std::string& path) const;
+
+ private:
+  const pid_t pid_;
+  const std::vector<xbe::GuestSymbol>& symbols_;
+  int perf_fd_ = -1;
+  int stop_fd_ = -1;
+  char* ring_ = nullptr;
+  size_t ring_size_ = 0;
+  std::thread thread_;
+  utils::Error error_;
+  // Stacks of addresses, outermost caller first.
+  std::map<std::vector<uint64_t>, uint64_t> stacks_;
+  uint64_t samples_ = 0;
+  uint64_t lost_ = 0;
+
+  void Drain();
+  void Serve();
+  std::string SectionOf(uint64_t addr) const;
+  std::string FrameName(uint64_t addr) const;
+
+  GuestProfiler(const GuestProfiler&) = delete;
+  GuestProfiler& operator=(const GuestProfiler&) = delete;
+};
+
+} // namespace elf
+} // namespace exec
+
+#endif // EXEC_ELF_GUEST_PROFILER_H_
@@ -0,0 +1,240 @@
+#include "cc/exec/elf/instance_harness.h"
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "cc/utils/clock.h"
+#include "cc/utils/trace.h"
+
+extern char** environ;
+
+using std::string;
+using std::to_string;
+using std::vector;
+using utils::CsvWriter;
+using utils::Error;
+using utils::ErrorOr;
+using utils::JsonWriter;
+using utils::trace::Span;
+
+namespace exec {
+namespace elf {
+namespace {
+const int kMaxEvents = 64;
+
+struct Running {
+  size_t index;
+  int pidfd;
+  uint64_t start_ns;
+  // 0 for none.
+  uint64_t deadline_ns;
+};
+
+// Forks and execs spec in the child. Only returns in the parent.
+ErrorOr<pid_t> Launch(const InstanceSpec& spec, const string& log_path) {
+  const pid_t pid = fork();
+  RETURN_ERROR_SYSCALL(pid, "Could not fork.");
+  if (pid == 0) {
+    if (!log_path.empty()) {
+      const int log_fd =
+          open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0664);
+      if (log_fd < 0 || dup2(log_fd, STDOUT_FILENO) < 0
+          || dup2(log_fd, STDERR_FILENO) < 0) {
+        _exit(127);
+      }
+      close(log_fd);
+    }
+    char* const argv[2] = {const_cast<char*>(spec.elf_path.c_str()), nullptr};
+    execve(spec.elf_path.c_str(), argv, environ);
+    _exit(127);
+  }
+  return ErrorOr<pid_t>(pid_t(pid));
+}
+
+int EpollTimeoutMs(const vector<Running>& running, uint64_t now_ns) {
+  uint64_t earliest = 0;
+  for (const Running& instance : running) {
+    if (instance.deadline_ns != 0
+        && (earliest == 0 || instance.deadline_ns < earliest)) {
+      earliest = instance.deadline_ns;
+    }
+  }
+  if (earliest == 0) {
+    return -1;
+  }
+  if (earliest <= now_ns) {
+    return 0;
+  }
+  // Rounded up, so the loop does not wake just before the deadline.
+  return (earliest - now_ns + 999999) / 1000000;
+}
+
+string StatusText(const InstanceResult& result) {
+  if (!result.error.empty()) {
+    return "error";
+  }
+  if (result.timed_out) {
+    return "timeout";
+  }
+  if (WIFSIGNALED(result.status)) {
+    return string("signal ") + strsignal(WTERMSIG(result.status));
+  }
+  return "exit " + to_string(WEXITSTATUS(result.status));
+}
+} // namespace
+
+bool InstanceResult::ok() const {
+  return error.empty() && !timed_out && WIFEXITED(status)
+      && WEXITSTATUS(status) == 0;
+}
+
+ErrorOr<vector<InstanceResult>> RunInstances(const vector<InstanceSpec>& specs,
+                                             const HarnessOptions& options) {
+  Span span("RunInstances");
+  const size_t max_running = std::max<size_t>(options.max_running, 1);
+  const int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  RETURN_ERROR_SYSCALL(epoll_fd, "Could not create epoll instance.");
+  vector<InstanceResult> results(specs.size());
+  vector<Running> running;
+  size_t next = 0;
+  Error error = Error::Ok();
+  while (error.is_ok() && (next < specs.size() || !running.empty())) {
+    for (; next < specs.size() && running.size() < max_running; next++) {
+      InstanceResult& result = results[next];
+      result.name = specs[next].name;
+      const string log_path = options.log_dir.empty()
+          ? ""
+          : options.log_dir + "/" + to_string(next) + ".log";
+      const uint64_t start_ns = utils::MonotonicNowNs();
+      ErrorOr<pid_t> error_or_pid = Launch(specs[next], log_path);
+      if (!error_or_pid.error().is_ok()) {
+        result.error = error_or_pid.error().error_info();
+        continue;
+      }
+      result.pid = error_or_pid.get();
+      const int pidfd = syscall(SYS_pidfd_open, result.pid, 0);
+      epoll_event event = {};
+      event.events = EPOLLIN;
+      event.data.u64 = next;
+      if (pidfd < 0 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, pidfd, &event) < 0) {
+        result.error = string("Could not watch instance: ") + strerror(errno);
+        kill(result.pid, SIGKILL);
+        waitpid(result.pid, nullptr, 0);
+        if (pidfd >= 0) {
+          close(pidfd);
+        }
+        continue;
+      }
+      running.push_back({next,
+                         pidfd,
+                         start_ns,
+                         options.timeout_ms == 0
+                             ? 0
+                             : start_ns + options.timeout_ms * 1000000});
+    }
+    if (running.empty()) {
+      continue;
+    }
+
+    epoll_event events[kMaxEvents];
+    const int event_count = epoll_wait(
+        epoll_fd, events, kMaxEvents,
+        EpollTimeoutMs(running, utils::MonotonicNowNs()));
+    if (event_count < 0 && errno != EINTR) {
+      error = Error(string("epoll_wait failed: ") + strerror(errno),
+                    __FILE__, __LINE__);
+      break;
+    }
+    const uint64_t now_ns = utils::MonotonicNowNs();
+    for (int i = 0; i < event_count; i++) {
+      const size_t index = events[i].data.u64;
+      auto it = std::find_if(running.begin(), running.end(),
+                             [index](const Running& instance) {
+                               return instance.index == index;
+                             });
+      InstanceResult& result = results[index];
+      rusage usage;
+      if (wait4(result.pid, &result.status, 0, &usage) < 0) {
+        result.error = string("Could not wait for instance: ")
+            + strerror(errno);
+      } else {
+        result.peak_rss_kb = usage.ru_maxrss;
+      }
+      result.wall_ns = now_ns - it->start_ns;
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->pidfd, nullptr);
+      close(it->pidfd);
+      running.erase(it);
+    }
+    // Instances past their deadline are killed; their pidfds report the exit
+    // on a later turn of the loop.
+    for (Running& instance : running) {
+      if (instance.deadline_ns == 0 || instance.deadline_ns > now_ns) {
+        continue;
+      }
+      syscall(SYS_pidfd_send_signal, instance.pidfd, SIGKILL, nullptr, 0);
+      results[instance.index].timed_out = true;
+      instance.deadline_ns = 0;
+    }
+  }
+  // Only after an error: nothing may outlive the harness.
+  for (const Running& instance : running) {
+    syscall(SYS_pidfd_send_signal, instance.pidfd, SIGKILL, nullptr, 0);
+    waitpid(results[instance.index].pid, nullptr, 0);
+    close(instance.pidfd);
+  }
+  close(epoll_fd);
+  PASS_ERROR(error);
+  span.set_detail(to_string(specs.size()) + " instances");
+  return ErrorOr<vector<InstanceResult>>(std::move(results));
+}
+
+void WriteInstanceRecord(const InstanceResult& result, JsonWriter* writer) {
+  writer->BeginObject();
+  writer->Key("name");
+  writer->String(result.name);
+  writer->Key("pid");
+  writer->Int(result.pid);
+  writer->Key("status");
+  writer->String(StatusText(result));
+  writer->Key("ok");
+  writer->Bool(result.ok());
+  writer->Key("wall_us");
+  writer->Uint(result.wall_ns / 1000);
+  writer->Key("peak_rss_kb");
+  writer->Uint(result.peak_rss_kb);
+  if (!result.error.empty()) {
+    writer->Key("error");
+    writer->String(result.error);
+  }
+  writer->EndObject();
+}
+
+void WriteInstanceCsvHeader(CsvWriter* writer) {
+  for (const char* field :
+       {"name", "pid", "status", "ok", "wall_us", "peak_rss_kb", "error"}) {
+    writer->Field(field);
+  }
+  writer->EndRecord();
+}
+
+void WriteInstanceRecord(const InstanceResult& result, CsvWriter* writer) {
+  writer->Field(result.name);
+  writer->Field(result.pid);
+  writer->Field(StatusText(result));
+  writer->Field(result.ok() ? 1 : 0);
+  writer->Field(result.wall_ns / 1000);
+  writer->Field(result.peak_rss_kb);
+  writer->Field(result.error);
+  writer->EndRecord();
+}
+
+} // namespace elf
+} // namespace exec
@@ -0,0 +1,67 @@
+#ifndef EXEC_ELF_INSTANCE_HARNESS_H_
+#define EXEC_ELF_INSTANCE_HARNESS_H_
+
+#include <sys/types.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cc/utils/csv_writer.h"
+#include "cc/utils/error.h"
+#include "cc/utils/json_writer.h"
+
+namespace exec {
+namespace elf {
+
+struct InstanceSpec {
+  // Identifies the instance in the report.
+  std::string name;
+  // Exec'd as is, with no arguments.
+  std::string elf_path;
+};
+
+struct InstanceResult {
+  std::string name;
+  pid_t pid = 0;
+  // As from waitpid; meaningless if error is set.
+  int status = 0;
+  // Killed for running past HarnessOptions::timeout_ms.
+  bool timed_out = false;
+  uint64_t wall_ns = 0;
+  // The largest resident set the instance had, from its rusage.
+  uint64_t peak_rss_kb = 0;
+  // Set if the instance could not be started.
+  std::string error;
+
+  // Exited with status 0 in time.
+  bool ok() const;
+};
+
+struct HarnessOptions {
+  // Instances running at once; the rest wait for a slot.
+  size_t max_running = 1;
+  // 0 for no limit.
+  uint64_t timeout_ms = 0;
+  // If set, each instance's stdout and stderr go to <log_dir>/<index>.log
+  // rather than to this process's.
+  std::string log_dir;
+};
+
+// Runs every instance in specs, max_running at a time, from a single event
+// loop: each running instance has a pidfd registered with one epoll
+// instance, which wakes the loop when it exits or when the earliest deadline
+// passes, in which case the instance is killed through its pidfd. Nothing is
+// traced; the instances run at full speed. Results are in the order of specs.
+utils::ErrorOr<std::vector<InstanceResult>> RunInstances(
+    const std::vector<InstanceSpec>& specs,
+    const HarnessOptions& options);
+
+void WriteInstanceRecord(const InstanceResult& result,
+                         utils::JsonWriter* writer);
+void WriteInstanceRecord(const InstanceResult& result,
+                         utils::CsvWriter* writer);
+void WriteInstanceCsvHeader(utils::CsvWriter* writer);
+
+} // namespace elf
+} // namespace exec
+
+#endif // EXEC_ELF_INSTANCE_HARNESS_H_
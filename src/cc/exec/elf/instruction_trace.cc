@@ -0,0 +1,226 @@
+#include "cc/exec/elf/instruction_trace.h"
+
+#include <cstring>
+
+#include "cc/io/file.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using io::File;
+using io::FileLike;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace elf {
+namespace {
+const size_t kRegCount = sizeof(user_regs_struct) / sizeof(uint64_t);
+static_assert(sizeof(user_regs_struct) == kRegCount * sizeof(uint64_t),
+              "user_regs_struct must be a plain array of 64 bit registers.");
+static_assert(kRegCount < 64, "The changed register mask must fit a varint.");
+
+void RegsToArray(const user_regs_struct& regs, uint64_t* array) {
+  memcpy(array, &regs, sizeof(regs));
+}
+
+void ArrayToRegs(const uint64_t* array, user_regs_struct* regs) {
+  memcpy(regs, array, sizeof(*regs));
+}
+
+void AppendVarint(uint64_t value, string* out) {
+  while (value >= 0x80) {
+    *out += static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  *out += static_cast<char>(value);
+}
+
+// Small deltas in either direction encode to small varints.
+void AppendZigzag(uint64_t delta, string* out) {
+  const int64_t signed_delta = delta;
+  AppendVarint((delta << 1) ^ static_cast<uint64_t>(signed_delta >> 63), out);
+}
+
+uint64_t FromZigzag(uint64_t value) {
+  return (value >> 1) ^ (0 - (value & 1));
+}
+
+void AppendUint32(uint32_t value, string* out) {
+  out->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+} // namespace
+
+InstructionTraceRecorder::InstructionTraceRecorder(FileLike* file,
+                                                   bool full_regs,
+                                                   size_t capacity,
+                                                   bool keep_last)
+    : file_(file),
+      full_regs_(full_regs),
+      keep_last_(keep_last),
+      rips_(capacity > 0 ? capacity : 1) {
+  if (full_regs_) {
+    regs_.resize(rips_.size());
+  }
+  memset(&previous_, 0, sizeof(previous_));
+}
+
+Error InstructionTraceRecorder::Record(const user_regs_struct& regs) {
+  if (count_ == rips_.size() && !keep_last_) {
+    PASS_ERROR(Drain());
+  }
+  rips_[head_] = regs.rip;
+  if (full_regs_) {
+    regs_[head_] = regs;
+  }
+  head_ = (head_ + 1) % rips_.size();
+  if (count_ < rips_.size()) {
+    count_++;
+  }
+  recorded_++;
+  return Error::Ok();
+}
+
+Error InstructionTraceRecorder::Finish() {
+  return Drain();
+}
+
+Error InstructionTraceRecorder::Drain() {
+  Span span("InstructionTraceRecorder::Drain");
+  encoded_.clear();
+  if (!header_written_) {
+    encoded_.append(kInstructionTraceMagic, sizeof(kInstructionTraceMagic));
+    AppendUint32(kInstructionTraceVersion, &encoded_);
+    AppendUint32(full_regs_ ? kInstructionTraceFullRegsFlag : 0, &encoded_);
+    AppendUint32(0, &encoded_);
+    header_written_ = true;
+  }
+  const size_t capacity = rips_.size();
+  size_t slot = (head_ + capacity - count_) % capacity;
+  for (size_t i = 0; i < count_; i++, slot = (slot + 1) % capacity) {
+    if (!full_regs_) {
+      AppendZigzag(rips_[slot] - previous_.rip, &encoded_);
+      previous_.rip = rips_[slot];
+      continue;
+    }
+    uint64_t current[kRegCount];
+    uint64_t previous[kRegCount];
+    RegsToArray(regs_[slot], current);
+    RegsToArray(previous_, previous);
+    uint64_t changed = 0;
+    for (size_t reg = 0; reg < kRegCount; reg++) {
+      if (current[reg] != previous[reg]) {
+        changed |= 1ull << reg;
+      }
+    }
+    AppendVarint(changed, &encoded_);
+    for (size_t reg = 0; reg < kRegCount; reg++) {
+      if (changed & (1ull << reg)) {
+        AppendZigzag(current[reg] - previous[reg], &encoded_);
+      }
+    }
+    previous_ = regs_[slot];
+  }
+  count_ = 0;
+  span.set_bytes(encoded_.size());
+  return Write(encoded_.data(), encoded_.size());
+}
+
+Error InstructionTraceRecorder::Write(const char* buffer, size_t size) {
+  while (size > 0) {
+    ErrorOr<ssize_t> error_or_written = file_->Write(buffer, size);
+    PASS_ERROR(error_or_written.error());
+    buffer += error_or_written.get();
+    size -= error_or_written.get();
+    bytes_written_ += error_or_written.get();
+  }
+  return Error::Ok();
+}
+
+ErrorOr<InstructionTraceReader> InstructionTraceReader::Open(
+    const string& path) {
+  Span span("InstructionTraceReader::Open");
+  span.set_detail(path);
+  ErrorOr<File> error_or_file = File::Open(path, File::RD_ONLY);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+
+  static const size_t kChunkSizeBytes = 1 << 20;
+  InstructionTraceReader reader;
+  size_t size = 0;
+  while (true) {
+    reader.data_.resize(size + kChunkSizeBytes);
+    ErrorOr<ssize_t> error_or_amount_read =
+        file.Read(reader.data_.data() + size, kChunkSizeBytes);
+    PASS_ERROR(error_or_amount_read.error());
+    if (error_or_amount_read.get() == 0) {
+      break;
+    }
+    size += error_or_amount_read.get();
+  }
+  reader.data_.resize(size);
+  span.set_bytes(size);
+
+  RETURN_ERROR_IF(size < kInstructionTraceHeaderSize
+                  || memcmp(reader.data_.data(),
+                            kInstructionTraceMagic,
+                            sizeof(kInstructionTraceMagic)) != 0,
+                  path + " is not an instruction trace.");
+  uint32_t version;
+  uint32_t flags;
+  memcpy(&version, reader.data_.data() + 4, sizeof(version));
+  memcpy(&flags, reader.data_.data() + 8, sizeof(flags));
+  RETURN_ERROR_IF(version != kInstructionTraceVersion,
+                  path + " has unsupported version "
+                  + std::to_string(version));
+  reader.full_regs_ = flags & kInstructionTraceFullRegsFlag;
+  reader.offset_ = kInstructionTraceHeaderSize;
+  memset(&reader.previous_, 0, sizeof(reader.previous_));
+  return ErrorOr<InstructionTraceReader>(std::move(reader));
+}
+
+ErrorOr<bool> InstructionTraceReader::Next(user_regs_struct* regs) {
+  bool has_next = offset_ < data_.size();
+  if (!has_next) {
+    return ErrorOr<bool>(std::move(has_next));
+  }
+  if (!full_regs_) {
+    ErrorOr<uint64_t> error_or_delta = ReadVarint();
+    PASS_ERROR(error_or_delta.error());
+    previous_.rip += FromZigzag(error_or_delta.get());
+  } else {
+    ErrorOr<uint64_t> error_or_changed = ReadVarint();
+    PASS_ERROR(error_or_changed.error());
+    const uint64_t changed = error_or_changed.get();
+    RETURN_ERROR_IF(changed >> kRegCount != 0, "Corrupt register mask.");
+    uint64_t current[kRegCount];
+    RegsToArray(previous_, current);
+    for (size_t reg = 0; reg < kRegCount; reg++) {
+      if (changed & (1ull << reg)) {
+        ErrorOr<uint64_t> error_or_delta = ReadVarint();
+        PASS_ERROR(error_or_delta.error());
+        current[reg] += FromZigzag(error_or_delta.get());
+      }
+    }
+    ArrayToRegs(current, &previous_);
+  }
+  *regs = previous_;
+  return ErrorOr<bool>(std::move(has_next));
+}
+
+ErrorOr<uint64_t> InstructionTraceReader::ReadVarint() {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    RETURN_ERROR_IF(offset_ >= data_.size(), "Truncated record.");
+    const uint8_t byte = data_[offset_++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return ErrorOr<uint64_t>(std::move(value));
+    }
+  }
+  RETURN_ERROR("Varint is too long.");
+}
+
+} // namespace elf
+} // namespace exec
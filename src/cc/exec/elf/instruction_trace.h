@@ -0,0 +1,101 @@
+#ifndef EXEC_ELF_INSTRUCTION_TRACE_H_
+#define EXEC_ELF_INSTRUCTION_TRACE_H_
+
+#include <sys/user.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cc/io/file_like.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace elf {
+
+// An instruction trace is a 16 byte header followed by one record per
+// instruction, each delta encoded against the record before it:
+//
+//   header: "BBIT", uint32 version, uint32 flags, uint32 reserved
+//   record: zigzag varint of the change in rip                  (rip only)
+//           varint bitmask of the changed user_regs_struct fields, then a
+//           zigzag varint of the change in each, in field order (full regs)
+//
+// Straight line code costs one byte per instruction without registers, and
+// only the registers an instruction wrote with them.
+static const char kInstructionTraceMagic[4] = {'B', 'B', 'I', 'T'};
+static const uint32_t kInstructionTraceVersion = 1;
+static const uint32_t kInstructionTraceFullRegsFlag = 1 << 0;
+static const size_t kInstructionTraceHeaderSize = 16;
+
+// Records single stepped instructions into a ring of fixed capacity and
+// encodes them in bulk, so a step costs a copy into the ring rather than
+// formatted output. By default the ring is written out whenever it fills;
+// with keep_last only the last capacity records survive, for tracing up to a
+// crash without keeping everything before it.
+//
+// Usage:
+//   InstructionTraceRecorder recorder(&file, full_regs, capacity, keep_last);
+//   ... PASS_ERROR(recorder.Record(regs)) after every step ...
+//   PASS_ERROR(recorder.Finish());
+class InstructionTraceRecorder {
+ public:
+  static const size_t kDefaultCapacity = 1 << 16;
+
+  // file must outlive the recorder.
+  InstructionTraceRecorder(io::FileLike* file,
+                           bool full_regs,
+                           size_t capacity,
+                           bool keep_last);
+
+  utils::Error Record(const user_regs_struct& regs);
+  // Writes whatever is still in the ring.
+  utils::Error Finish();
+
+  // Including any records keep_last dropped.
+  uint64_t recorded() const { return recorded_; }
+  uint64_t bytes_written() const { return bytes_written_; }
+
+ private:
+  io::FileLike* const file_;
+  const bool full_regs_;
+  const bool keep_last_;
+  // rips_ always holds the ring; regs_ does too, but only with full_regs_.
+  std::vector<uint64_t> rips_;
+  std::vector<user_regs_struct> regs_;
+  // Next slot to write and number of records in the ring.
+  size_t head_ = 0;
+  size_t count_ = 0;
+  bool header_written_ = false;
+  // What the next encoded record is a delta against.
+  user_regs_struct previous_;
+  std::string encoded_;
+  uint64_t recorded_ = 0;
+  uint64_t bytes_written_ = 0;
+
+  utils::Error Drain();
+  utils::Error Write(const char* buffer, size_t size);
+};
+
+// Decodes a trace written by InstructionTraceRecorder.
+class InstructionTraceReader {
+ public:
+  static utils::ErrorOr<InstructionTraceReader> Open(const std::string& path);
+
+  bool full_regs() const { return full_regs_; }
+  // Sets *regs to the next record and returns true, or returns false at the
+  // end of the trace. Without full_regs() only rip is meaningful.
+  utils::ErrorOr<bool> Next(user_regs_struct* regs);
+
+ private:
+  std::vector<char> data_;
+  size_t offset_ = 0;
+  bool full_regs_ = false;
+  user_regs_struct previous_;
+
+  InstructionTraceReader() {}
+  utils::ErrorOr<uint64_t> ReadVarint();
+};
+
+} // namespace elf
+} // namespace exec
+
+#endif // EXEC_ELF_INSTRUCTION_TRACE_H_
@@ -1,27 +1,102 @@
+#include <unistd.h>
+
 #include <string>
+#include <vector>
 
 #include "cc/exec/elf/elf.h"
+#include "cc/exec/elf/elf_cache.h"
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/exec/xbe/xbe_path.h"
+#include "cc/exec/xbe/xbe_symbols.h"
 #include "cc/io/file.h"
+#include "cc/io/io_stats.h"
 #include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/trace.h"
 
 using std::string;
+using std::vector;
+using exec::elf::ElfCache;
 using exec::elf::MakeElfFromXbe;
+using exec::xbe::CollectXbeSymbols;
+using exec::xbe::GuestSymbol;
+using exec::xbe::HostPathFor;
+using exec::xbe::OpenXbe;
+using exec::xbe::WritePerfMap;
+using exec::xbe::XbeImage;
 using io::File;
+using io::IoStats;
+using io::WriteIoStatsReport;
 using utils::ErrorOr;
+using utils::Flags;
+
+static const uint64_t kDefaultCacheMaxBytes = 4ull << 30;
 
+// Usage: make_elf <xbe> [--stats[=<json path>]] [--trace=<json path>]
+//                 [--cache_dir=<dir>] [--cache_max_bytes=<n>] [--no_cache]
+//                 [--signatures=<path>] [--perf_map=<path>]
+//
+// <xbe> may be "<image>:/<path in image>"; the ELF is then written next to the
+// image (see exec::xbe::HostPathFor). Unless --no_cache is given, the ELF is
+// taken from (or added to) the ELF cache and linked into place.
+//
+// The ELF's symbol table names the entry point, sections and kernel thunks,
+// plus any library functions found with --signatures. --perf_map also writes
+// the symbols in perf's map format.
 int main(int argc, char* argv[]) {
-  CHECK_INFO(argc == 2, "Must specify path to xbe.");
-  const string xbe_path = argv[1];
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 1, "Must specify path to xbe.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  const string xbe_path = flags.positional()[0];
+
+  ErrorOr<XbeImage> error_or_xbe = OpenXbe(xbe_path);
+  CHECK_ERROR(error_or_xbe.error());
 
-  ErrorOr<File> error_or_xbe_file = File::Open(xbe_path, File::RD_ONLY);
-  CHECK_ERROR(error_or_xbe_file.error());
-  File xbe_file = error_or_xbe_file.move();
+  vector<GuestSymbol> symbols;
+  if (flags.Has("signatures")) {
+    ErrorOr<vector<GuestSymbol>> error_or_symbols = CollectXbeSymbols(
+        error_or_xbe.get(), flags.GetString("signatures", ""));
+    CHECK_ERROR(error_or_symbols.error());
+    symbols = error_or_symbols.move();
+  } else {
+    symbols = CollectXbeSymbols(error_or_xbe.get());
+  }
+  if (flags.Has("perf_map")) {
+    CHECK_ERROR(WritePerfMap(symbols, flags.GetString("perf_map", "")));
+  }
 
-  ErrorOr<File> error_or_elf_file = File::Create(xbe_path + ".bin", 0777);
-  CHECK_ERROR(error_or_elf_file.error());
-  File elf_file = error_or_elf_file.move();
+  const string elf_path = HostPathFor(xbe_path) + ".bin";
+  if (flags.Has("no_cache")) {
+    // elf_path may be a link to a cache entry, which must not be rewritten.
+    unlink(elf_path.c_str());
+    ErrorOr<File> error_or_elf_file = File::Create(elf_path, 0777);
+    CHECK_ERROR(error_or_elf_file.error());
+    File elf_file = error_or_elf_file.move();
 
-  CHECK_ERROR(MakeElfFromXbe(&xbe_file, &elf_file));
+    CHECK_ERROR(MakeElfFromXbe(error_or_xbe.get(), symbols, &elf_file));
+    CHECK_ERROR(elf_file.Close());
+  } else {
+    ErrorOr<ElfCache> error_or_cache = ElfCache::Open(
+        flags.GetString("cache_dir", ElfCache::DefaultDir()),
+        flags.GetUint("cache_max_bytes", kDefaultCacheMaxBytes));
+    CHECK_ERROR(error_or_cache.error());
+    ElfCache cache = error_or_cache.move();
+    ErrorOr<string> error_or_cached_path =
+        cache.GetOrConvert(error_or_xbe.get(), symbols);
+    CHECK_ERROR(error_or_cached_path.error());
+    CHECK_ERROR(ElfCache::Export(error_or_cached_path.get(), elf_path));
+  }
 
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
   return 0;
 }
@@ -0,0 +1,634 @@
+#include "cc/exec/elf/memory_dump.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include "cc/io/file.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using io::File;
+using io::FileLike;
+using io::IoCounter;
+using io::IoStats;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace elf {
+namespace {
+// Large enough that a 64 MiB guest takes a handful of reads.
+const size_t kBatchSize = 16 << 20;
+const size_t kWriteBufferSize = 4 << 20;
+const size_t kMaxIovecs = IOV_MAX;
+
+struct MappedRegion {
+  uint64_t begin;
+  uint64_t end;
+  uint32_t prot;
+  bool shared;
+  string name;
+};
+
+// A piece of a region queued for the next process_vm_readv.
+struct Piece {
+  size_t region;
+  uint64_t addr;
+  size_t size;
+  size_t batch_offset;
+};
+
+ErrorOr<string> ReadProcFile(const string& path) {
+  ErrorOr<File> error_or_file = File::Open(path, File::RD_ONLY);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  string contents;
+  char buffer[4096];
+  while (true) {
+    ErrorOr<ssize_t> error_or_amount_read = file.Read(buffer, sizeof(buffer));
+    PASS_ERROR(error_or_amount_read.error());
+    if (error_or_amount_read.get() == 0) {
+      break;
+    }
+    contents.append(buffer, error_or_amount_read.get());
+  }
+  return ErrorOr<string>(std::move(contents));
+}
+
+// Lines look like "00400000-00452000 r-xp 00000000 08:02 173521 /bin/x".
+ErrorOr<vector<MappedRegion>> ReadMaps(pid_t pid) {
+  const string path = "/proc/" + std::to_string(pid) + "/maps";
+  ErrorOr<string> error_or_maps = ReadProcFile(path);
+  PASS_ERROR(error_or_maps.error());
+  const string& maps = error_or_maps.get();
+  vector<MappedRegion> regions;
+  size_t line_begin = 0;
+  while (line_begin < maps.size()) {
+    size_t line_end = maps.find('\n', line_begin);
+    if (line_end == string::npos) {
+      line_end = maps.size();
+    }
+    const string line = maps.substr(line_begin, line_end - line_begin);
+    line_begin = line_end + 1;
+
+    MappedRegion region;
+    char perms[5];
+    int name_begin = 0;
+    RETURN_ERROR_IF(sscanf(line.c_str(),
+                           "%" SCNx64 "-%" SCNx64 " %4s %*s %*s %*s %n",
+                           &region.begin, &region.end, perms, &name_begin) < 3,
+                    "Could not parse " + path + " line: " + line);
+    region.prot = (perms[0] == 'r' ? PROT_READ : 0)
+        | (perms[1] == 'w' ? PROT_WRITE : 0)
+        | (perms[2] == 'x' ? PROT_EXEC : 0);
+    region.shared = perms[3] == 's';
+    if (name_begin > 0) {
+      region.name = line.substr(name_begin);
+    }
+    regions.push_back(std::move(region));
+  }
+  return ErrorOr<vector<MappedRegion>>(std::move(regions));
+}
+
+bool IsZeroPage(const char* page) {
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(page);
+  uint64_t bits = 0;
+  for (size_t i = 0; i < kMemoryDumpPageSize / sizeof(uint64_t); i++) {
+    bits |= words[i];
+  }
+  return bits == 0;
+}
+
+// Not cryptographic; only has to tell a page from its previous contents.
+uint64_t HashPage(const char* page) {
+  const uint64_t* words = reinterpret_cast<const uint64_t*>(page);
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < kMemoryDumpPageSize / sizeof(uint64_t); i++) {
+    hash = (hash ^ words[i]) * 0x100000001b3ull;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+// Reads ranges of regions into a batch buffer, one process_vm_readv per
+// batch, and hands the pages worth keeping to a MemoryDumpWriter.
+class PageCollector {
+ public:
+  PageCollector(pid_t pid,
+                const MemoryDumpOptions& options,
+                MemoryDumpWriter* writer,
+                MemoryDumpStats* stats)
+      : pid_(pid),
+        options_(options),
+        writer_(writer),
+        stats_(stats),
+        batch_(kBatchSize) {}
+
+  // Queues [begin, end) of region.
+  Error AddRange(size_t region, uint64_t begin, uint64_t end) {
+    for (uint64_t addr = begin; addr < end;) {
+      if (batch_size_ == batch_.size() || pieces_.size() == kMaxIovecs) {
+        PASS_ERROR(Flush());
+      }
+      const size_t size = std::min<uint64_t>(end - addr,
+                                             batch_.size() - batch_size_);
+      pieces_.push_back(Piece{region, addr, size, batch_size_});
+      batch_size_ += size;
+      addr += size;
+    }
+    return Error::Ok();
+  }
+
+  Error Flush() {
+    size_t first = 0;
+    while (first < pieces_.size()) {
+      vector<iovec> remote;
+      for (size_t i = first; i < pieces_.size(); i++) {
+        remote.push_back(iovec{reinterpret_cast<void*>(pieces_[i].addr),
+                               pieces_[i].size});
+      }
+      iovec local{batch_.data() + pieces_[first].batch_offset,
+                  batch_size_ - pieces_[first].batch_offset};
+      IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+      ssize_t amount_read =
+          process_vm_readv(pid_, &local, 1, remote.data(), remote.size(), 0);
+      // The read stops at the first piece it cannot read; if that is the
+      // first piece it fails outright.
+      if (amount_read < 0 && errno == EFAULT) {
+        amount_read = 0;
+      }
+      RETURN_ERROR_SYSCALL(amount_read, "Could not read process memory.");
+      stats_->bytes_read += amount_read;
+
+      size_t i = first;
+      for (; i < pieces_.size() && pieces_[i].size <= (size_t) amount_read;
+           i++) {
+        PASS_ERROR(Keep(pieces_[i], pieces_[i].size));
+        amount_read -= pieces_[i].size;
+      }
+      if (i == pieces_.size()) {
+        break;
+      }
+      // Keep what was read of the failed piece and give up on the rest of
+      // its region.
+      const size_t failed_region = pieces_[i].region;
+      PASS_ERROR(Keep(pieces_[i],
+                      amount_read / kMemoryDumpPageSize * kMemoryDumpPageSize));
+      writer_->MarkUnreadable(failed_region);
+      while (i < pieces_.size() && pieces_[i].region == failed_region) {
+        i++;
+      }
+      first = i;
+    }
+    pieces_.clear();
+    batch_size_ = 0;
+    return Error::Ok();
+  }
+
+ private:
+  const pid_t pid_;
+  const MemoryDumpOptions& options_;
+  MemoryDumpWriter* const writer_;
+  MemoryDumpStats* const stats_;
+  vector<char> batch_;
+  size_t batch_size_ = 0;
+  vector<Piece> pieces_;
+
+  // Passes on the pages in the first size bytes of piece that belong in the
+  // dump.
+  Error Keep(const Piece& piece, size_t size) {
+    for (size_t offset = 0; offset < size; offset += kMemoryDumpPageSize) {
+      const uint64_t addr = piece.addr + offset;
+      const char* page = batch_.data() + piece.batch_offset + offset;
+      if (options_.page_hashes != nullptr) {
+        const uint64_t hash = HashPage(page);
+        auto previous = options_.page_hashes->find(addr);
+        const bool unchanged = previous != options_.page_hashes->end()
+            && previous->second == hash;
+        if (unchanged && options_.mode == DumpMode::CHANGED_CONTENT) {
+          stats_->pages_unchanged++;
+          continue;
+        }
+        (*options_.page_hashes)[addr] = hash;
+      }
+      if (IsZeroPage(page)) {
+        stats_->zero_pages++;
+        // A delta has to say that a page became zero.
+        if (options_.mode != DumpMode::FULL) {
+          PASS_ERROR(writer_->AddZeroPage(piece.region, addr));
+        }
+        continue;
+      }
+      PASS_ERROR(writer_->AddPage(piece.region, addr, page));
+      stats_->pages_stored++;
+    }
+    return Error::Ok();
+  }
+};
+
+// Queues the pages of region the kernel marked soft dirty, read from
+// pagemap, which holds one uint64 per page with the soft dirty bit at 55.
+Error AddSoftDirtyPages(int pagemap_fd,
+                        size_t region,
+                        const MappedRegion& mapped,
+                        PageCollector* collector,
+                        MemoryDumpStats* stats) {
+  static const uint64_t kSoftDirtyBit = 1ull << 55;
+  static const size_t kEntriesPerRead = 1 << 16;
+  vector<uint64_t> entries(kEntriesPerRead);
+  uint64_t run_begin = 0;
+  bool in_run = false;
+  for (uint64_t chunk = mapped.begin; chunk < mapped.end;
+       chunk += kEntriesPerRead * kMemoryDumpPageSize) {
+    const size_t count = std::min<uint64_t>(
+        kEntriesPerRead, (mapped.end - chunk) / kMemoryDumpPageSize);
+    IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+    const ssize_t amount_read =
+        pread(pagemap_fd,
+              entries.data(),
+              count * sizeof(uint64_t),
+              chunk / kMemoryDumpPageSize * sizeof(uint64_t));
+    RETURN_ERROR_SYSCALL(amount_read, "Could not read pagemap.");
+    RETURN_ERROR_IF((size_t) amount_read != count * sizeof(uint64_t),
+                    "Short read of pagemap.");
+    for (size_t i = 0; i < count; i++) {
+      const uint64_t addr = chunk + i * kMemoryDumpPageSize;
+      const bool dirty = entries[i] & kSoftDirtyBit;
+      if (!dirty) {
+        stats->pages_unchanged++;
+      }
+      if (dirty && !in_run) {
+        run_begin = addr;
+        in_run = true;
+      } else if (!dirty && in_run) {
+        PASS_ERROR(collector->AddRange(region, run_begin, addr));
+        in_run = false;
+      }
+    }
+  }
+  if (in_run) {
+    PASS_ERROR(collector->AddRange(region, run_begin, mapped.end));
+  }
+  return Error::Ok();
+}
+} // namespace
+
+string ProtToString(uint32_t prot) {
+  string text = "---";
+  if (prot & PROT_READ) {
+    text[0] = 'r';
+  }
+  if (prot & PROT_WRITE) {
+    text[1] = 'w';
+  }
+  if (prot & PROT_EXEC) {
+    text[2] = 'x';
+  }
+  return text;
+}
+
+MemoryDumpWriter::MemoryDumpWriter(FileLike* file,
+                                   uint32_t flags,
+                                   uint64_t sequence)
+    : file_(file), buffer_(kWriteBufferSize) {
+  memcpy(header_.magic, kMemoryDumpMagic, sizeof(header_.magic));
+  header_.version = kMemoryDumpVersion;
+  header_.flags = flags;
+  header_.region_count = 0;
+  header_.page_size = kMemoryDumpPageSize;
+  header_.sequence = sequence;
+}
+
+Error MemoryDumpWriter::Start(const vector<RegionInfo>& regions) {
+  header_.region_count = regions.size();
+  records_.resize(regions.size());
+  indexes_.resize(regions.size());
+  zero_indexes_.resize(regions.size());
+  for (size_t i = 0; i < regions.size(); i++) {
+    memset(&records_[i], 0, sizeof(records_[i]));
+    records_[i].begin = regions[i].begin;
+    records_[i].end = regions[i].end;
+    records_[i].prot = regions[i].prot;
+    records_[i].flags = regions[i].flags;
+    names_.push_back(regions[i].name);
+  }
+  // The region table is written again once it is filled in.
+  PASS_ERROR(Write(reinterpret_cast<const char*>(&header_), sizeof(header_)));
+  PASS_ERROR(Write(reinterpret_cast<const char*>(records_.data()),
+                   records_.size() * sizeof(DumpRegionRecord)));
+  data_end_ = bytes_written_;
+  return Error::Ok();
+}
+
+ErrorOr<uint32_t> MemoryDumpWriter::PageNumber(size_t region,
+                                               uint64_t addr) const {
+  RETURN_ERROR_IF(region >= records_.size(), "No such region.");
+  const DumpRegionRecord& record = records_[region];
+  RETURN_ERROR_IF(addr < record.begin || addr >= record.end
+                  || (addr - record.begin) % kMemoryDumpPageSize != 0,
+                  "Page is not in its region.");
+  uint32_t page_number = (addr - record.begin) / kMemoryDumpPageSize;
+  const vector<uint32_t>& index = indexes_[region];
+  const vector<uint32_t>& zero_index = zero_indexes_[region];
+  RETURN_ERROR_IF((!index.empty() && page_number <= index.back())
+                  || (!zero_index.empty() && page_number <= zero_index.back()),
+                  "Pages must be added in ascending order.");
+  return ErrorOr<uint32_t>(std::move(page_number));
+}
+
+Error MemoryDumpWriter::AddPage(size_t region,
+                                uint64_t addr,
+                                const char* page) {
+  ErrorOr<uint32_t> error_or_page_number = PageNumber(region, addr);
+  PASS_ERROR(error_or_page_number.error());
+  // Each region's pages are contiguous, so pages must come region by region.
+  RETURN_ERROR_IF(region < last_region_,
+                  "Pages must be added in region order.");
+  last_region_ = region;
+  if (indexes_[region].empty()) {
+    records_[region].pages_offset = data_end_;
+  }
+  indexes_[region].push_back(error_or_page_number.get());
+  memcpy(buffer_.data() + buffered_, page, kMemoryDumpPageSize);
+  buffered_ += kMemoryDumpPageSize;
+  data_end_ += kMemoryDumpPageSize;
+  if (buffered_ == buffer_.size()) {
+    PASS_ERROR(FlushPages());
+  }
+  return Error::Ok();
+}
+
+Error MemoryDumpWriter::AddZeroPage(size_t region, uint64_t addr) {
+  ErrorOr<uint32_t> error_or_page_number = PageNumber(region, addr);
+  PASS_ERROR(error_or_page_number.error());
+  zero_indexes_[region].push_back(error_or_page_number.get());
+  return Error::Ok();
+}
+
+void MemoryDumpWriter::MarkUnreadable(size_t region) {
+  records_[region].flags |= kDumpRegionUnreadable;
+}
+
+Error MemoryDumpWriter::Finish() {
+  PASS_ERROR(FlushPages());
+  for (size_t i = 0; i < records_.size(); i++) {
+    records_[i].page_count = indexes_[i].size();
+    records_[i].index_offset = bytes_written_;
+    PASS_ERROR(Write(reinterpret_cast<const char*>(indexes_[i].data()),
+                     indexes_[i].size() * sizeof(uint32_t)));
+    records_[i].zero_page_count = zero_indexes_[i].size();
+    records_[i].zero_index_offset = bytes_written_;
+    PASS_ERROR(Write(reinterpret_cast<const char*>(zero_indexes_[i].data()),
+                     zero_indexes_[i].size() * sizeof(uint32_t)));
+  }
+  for (size_t i = 0; i < records_.size(); i++) {
+    records_[i].name_offset = bytes_written_;
+    PASS_ERROR(Write(names_[i].c_str(), names_[i].size() + 1));
+  }
+  const uint64_t size = bytes_written_;
+  PASS_ERROR(file_->Seek(sizeof(header_)).error());
+  PASS_ERROR(Write(reinterpret_cast<const char*>(records_.data()),
+                   records_.size() * sizeof(DumpRegionRecord)));
+  bytes_written_ = size;
+  return Error::Ok();
+}
+
+Error MemoryDumpWriter::Write(const char* buffer, size_t size) {
+  while (size > 0) {
+    ErrorOr<ssize_t> error_or_written = file_->Write(buffer, size);
+    PASS_ERROR(error_or_written.error());
+    buffer += error_or_written.get();
+    size -= error_or_written.get();
+    bytes_written_ += error_or_written.get();
+  }
+  return Error::Ok();
+}
+
+Error MemoryDumpWriter::FlushPages() {
+  PASS_ERROR(Write(buffer_.data(), buffered_));
+  buffered_ = 0;
+  return Error::Ok();
+}
+
+ErrorOr<MemoryDumpStats> DumpProcessMemory(pid_t pid,
+                                           const MemoryDumpOptions& options,
+                                           FileLike* file) {
+  Span span("DumpProcessMemory");
+  RETURN_ERROR_IF(options.mode == DumpMode::CHANGED_CONTENT
+                  && options.page_hashes == nullptr,
+                  "CHANGED_CONTENT dumps need page hashes.");
+  ErrorOr<vector<MappedRegion>> error_or_maps = ReadMaps(pid);
+  PASS_ERROR(error_or_maps.error());
+  const vector<MappedRegion>& maps = error_or_maps.get();
+
+  vector<MemoryDumpWriter::RegionInfo> regions;
+  for (const MappedRegion& mapped : maps) {
+    regions.push_back(MemoryDumpWriter::RegionInfo{
+        mapped.begin,
+        mapped.end,
+        mapped.prot,
+        mapped.shared ? kDumpRegionShared : 0,
+        mapped.name});
+  }
+  MemoryDumpWriter writer(file,
+                          options.mode == DumpMode::FULL ? 0 : kMemoryDumpDelta,
+                          options.sequence);
+  PASS_ERROR(writer.Start(regions));
+
+  int pagemap_fd = -1;
+  if (options.mode == DumpMode::SOFT_DIRTY) {
+    const string path = "/proc/" + std::to_string(pid) + "/pagemap";
+    IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+    pagemap_fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    RETURN_ERROR_SYSCALL(pagemap_fd, "Could not open " + path);
+  }
+  MemoryDumpStats stats;
+  stats.regions = maps.size();
+  PageCollector collector(pid, options, &writer, &stats);
+  Error error = Error::Ok();
+  for (size_t i = 0; i < maps.size() && error.is_ok(); i++) {
+    if (!(maps[i].prot & PROT_READ)) {
+      writer.MarkUnreadable(i);
+    } else if (options.mode == DumpMode::SOFT_DIRTY) {
+      error = AddSoftDirtyPages(pagemap_fd, i, maps[i], &collector, &stats);
+    } else {
+      error = collector.AddRange(i, maps[i].begin, maps[i].end);
+    }
+  }
+  if (pagemap_fd >= 0) {
+    close(pagemap_fd);
+  }
+  PASS_ERROR(error);
+  PASS_ERROR(collector.Flush());
+  PASS_ERROR(writer.Finish());
+  stats.bytes_written = writer.bytes_written();
+  span.set_bytes(stats.bytes_written);
+  return ErrorOr<MemoryDumpStats>(std::move(stats));
+}
+
+ErrorOr<MemoryDump> MemoryDump::Open(const string& path) {
+  Span span("MemoryDump::Open");
+  span.set_detail(path);
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 4);
+  const int fd = open(path.c_str(), O_RDONLY);
+  RETURN_ERROR_SYSCALL(fd, "Could not open " + path);
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0) {
+    const string info = string("Could not stat ") + path + ": "
+        + strerror(errno);
+    close(fd);
+    RETURN_ERROR(info);
+  }
+  const size_t size = file_stat.st_size;
+  if (size < sizeof(MemoryDumpHeader)) {
+    close(fd);
+    RETURN_ERROR(path + " is too small to be a memory dump.");
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  RETURN_ERROR_IF(data == MAP_FAILED,
+                  string("Could not map ") + path + ": " + strerror(errno));
+  IoStats::Get()->Add(IoCounter::BYTES_MAPPED, size);
+
+  MemoryDump dump;
+  dump.data_ = static_cast<const char*>(data);
+  dump.size_ = size;
+  PASS_ERROR(dump.Parse());
+  return ErrorOr<MemoryDump>(std::move(dump));
+}
+
+MemoryDump::MemoryDump(MemoryDump&& dump)
+    : data_(dump.data_),
+      size_(dump.size_),
+      header_(dump.header_),
+      regions_(std::move(dump.regions_)) {
+  dump.data_ = nullptr;
+  dump.size_ = 0;
+}
+
+MemoryDump::~MemoryDump() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+Error MemoryDump::Parse() {
+  header_ = reinterpret_cast<const MemoryDumpHeader*>(data_);
+  RETURN_ERROR_IF(memcmp(header_->magic,
+                         kMemoryDumpMagic,
+                         sizeof(kMemoryDumpMagic)) != 0,
+                  "Not a memory dump: bad magic number.");
+  RETURN_ERROR_IF(header_->version != kMemoryDumpVersion,
+                  "Unsupported memory dump version "
+                  + std::to_string(header_->version));
+  RETURN_ERROR_IF(header_->page_size != kMemoryDumpPageSize,
+                  "Unsupported page size.");
+  RETURN_ERROR_IF(header_->region_count
+                  > (size_ - sizeof(MemoryDumpHeader))
+                      / sizeof(DumpRegionRecord),
+                  "Too many regions.");
+  const DumpRegionRecord* records = reinterpret_cast<const DumpRegionRecord*>(
+      data_ + sizeof(MemoryDumpHeader));
+  for (uint32_t i = 0; i < header_->region_count; i++) {
+    const DumpRegionRecord& record = records[i];
+    RETURN_ERROR_IF(record.end < record.begin, "Region ends before it begins.");
+    const uint64_t region_pages =
+        (record.end - record.begin) / kMemoryDumpPageSize;
+    RETURN_ERROR_IF(record.page_count > region_pages,
+                    "Region stores more pages than it has.");
+    RETURN_ERROR_IF(record.pages_offset > size_
+                    || record.page_count * kMemoryDumpPageSize
+                        > size_ - record.pages_offset,
+                    "Region pages are outside of the file.");
+    RETURN_ERROR_IF(record.name_offset >= size_
+                    || memchr(data_ + record.name_offset,
+                              '\0',
+                              size_ - record.name_offset) == nullptr,
+                    "Region name is outside of the file.");
+    Region region;
+    region.begin = record.begin;
+    region.end = record.end;
+    region.prot = record.prot;
+    region.flags = record.flags;
+    region.name = data_ + record.name_offset;
+    region.data = data_ + record.pages_offset;
+    ErrorOr<const uint32_t*> error_or_pages =
+        IndexAt(record.index_offset, record.page_count, region_pages);
+    PASS_ERROR(error_or_pages.error());
+    region.pages = error_or_pages.get();
+    region.page_count = record.page_count;
+    ErrorOr<const uint32_t*> error_or_zero_pages = IndexAt(
+        record.zero_index_offset, record.zero_page_count, region_pages);
+    PASS_ERROR(error_or_zero_pages.error());
+    region.zero_pages = error_or_zero_pages.get();
+    region.zero_page_count = record.zero_page_count;
+    regions_.push_back(std::move(region));
+  }
+  return Error::Ok();
+}
+
+ErrorOr<const uint32_t*> MemoryDump::IndexAt(uint64_t offset,
+                                             uint64_t count,
+                                             uint64_t region_pages) const {
+  RETURN_ERROR_IF(offset > size_ || count > (size_ - offset) / sizeof(uint32_t)
+                  || offset % sizeof(uint32_t) != 0,
+                  "Region index is outside of the file.");
+  const uint32_t* index = reinterpret_cast<const uint32_t*>(data_ + offset);
+  for (uint64_t i = 0; i < count; i++) {
+    RETURN_ERROR_IF(index[i] >= region_pages
+                    || (i > 0 && index[i] <= index[i - 1]),
+                    "Region index is not ascending page numbers.");
+  }
+  return ErrorOr<const uint32_t*>(std::move(index));
+}
+
+const MemoryDump::Region* MemoryDump::RegionAt(uint64_t addr) const {
+  auto region = std::upper_bound(
+      regions_.begin(), regions_.end(), addr,
+      [](uint64_t addr, const Region& region) { return addr < region.end; });
+  if (region == regions_.end() || addr < region->begin) {
+    return nullptr;
+  }
+  return &*region;
+}
+
+bool MemoryDump::HasZeroPageAt(uint64_t addr) const {
+  const Region* region = RegionAt(addr);
+  if (region == nullptr) {
+    return false;
+  }
+  const uint32_t page_number = (addr - region->begin) / kMemoryDumpPageSize;
+  return std::binary_search(region->zero_pages,
+                            region->zero_pages + region->zero_page_count,
+                            page_number);
+}
+
+const char* MemoryDump::PageAt(uint64_t addr) const {
+  const Region* region = RegionAt(addr);
+  if (region == nullptr) {
+    return nullptr;
+  }
+  const uint32_t page_number = (addr - region->begin) / kMemoryDumpPageSize;
+  const uint32_t* pages_end = region->pages + region->page_count;
+  const uint32_t* page =
+      std::lower_bound(region->pages, pages_end, page_number);
+  if (page == pages_end || *page != page_number) {
+    return nullptr;
+  }
+  return region->data + (page - region->pages) * kMemoryDumpPageSize;
+}
+
+} // namespace elf
+} // namespace exec
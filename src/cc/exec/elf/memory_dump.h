@@ -0,0 +1,217 @@
+#ifndef EXEC_ELF_MEMORY_DUMP_H_
+#define EXEC_ELF_MEMORY_DUMP_H_
+
+#include <sys/types.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "cc/io/file_like.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace elf {
+
+// A memory dump records every region in a process's /proc/<pid>/maps and the
+// pages of those regions that are not all zero:
+//
+//   header:  "BBMD", uint32 version, uint32 flags, uint32 region_count,
+//            uint64 page_size, uint64 sequence
+//   regions: region_count DumpRegionRecords
+//   pages:   the stored pages of each region in turn, page_size bytes each
+//   indexes: for each region, the uint32 page number within the region of
+//            each of its stored pages, then of each of its zero pages, both
+//            ascending
+//   names:   for each region, its path or pseudo path, NUL terminated
+//
+// In a full dump, pages missing from a region's index were all zero and no
+// zero pages are listed. A delta dump (kMemoryDumpDelta) is one snapshot in
+// a series: it only holds the pages that changed since the snapshot before
+// it, listing those that became all zero, and every other page is unchanged.
+static const char kMemoryDumpMagic[4] = {'B', 'B', 'M', 'D'};
+static const uint32_t kMemoryDumpVersion = 2;
+static const uint64_t kMemoryDumpPageSize = 0x1000;
+
+// MemoryDumpHeader::flags.
+static const uint32_t kMemoryDumpDelta = 1 << 0;
+
+// DumpRegionRecord::flags.
+static const uint32_t kDumpRegionShared = 1 << 0;
+// Not readable in full, e.g. a guard page or [vvar]; pages that could not be
+// read are missing.
+static const uint32_t kDumpRegionUnreadable = 1 << 1;
+
+struct MemoryDumpHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t region_count;
+  uint64_t page_size;
+  // The dump's position in a series of snapshots; 0 for a lone dump.
+  uint64_t sequence;
+};
+static_assert(sizeof(MemoryDumpHeader) == 32, "MemoryDumpHeader is packed.");
+
+struct DumpRegionRecord {
+  uint64_t begin;
+  uint64_t end;
+  // PROT_READ, PROT_WRITE and PROT_EXEC.
+  uint32_t prot;
+  uint32_t flags;
+  uint64_t page_count;
+  uint64_t pages_offset;
+  uint64_t index_offset;
+  uint64_t zero_page_count;
+  uint64_t zero_index_offset;
+  uint64_t name_offset;
+};
+static_assert(sizeof(DumpRegionRecord) == 72, "DumpRegionRecord is packed.");
+
+struct MemoryDumpStats {
+  uint64_t regions = 0;
+  uint64_t pages_stored = 0;
+  // All zero pages: dropped from a full dump, listed in a delta.
+  uint64_t zero_pages = 0;
+  // Pages a delta left out because they had not changed.
+  uint64_t pages_unchanged = 0;
+  uint64_t bytes_read = 0;
+  uint64_t bytes_written = 0;
+};
+
+// Hashes of page contents by address, for CHANGED_CONTENT dumps.
+typedef std::unordered_map<uint64_t, uint64_t> PageHashes;
+
+enum class DumpMode {
+  // Every readable page.
+  FULL,
+  // A delta of the pages the kernel marked soft dirty since the last write
+  // of "4" to /proc/<pid>/clear_refs; only those pages are read.
+  SOFT_DIRTY,
+  // A delta of the pages whose contents hash differently from the last dump
+  // that filled in the same PageHashes. Every page is read, but only changed
+  // ones are written; for kernels without soft dirty bits.
+  CHANGED_CONTENT,
+};
+
+struct MemoryDumpOptions {
+  DumpMode mode = DumpMode::FULL;
+  uint64_t sequence = 0;
+  // If set, updated with the hash of every page read. Required for
+  // CHANGED_CONTENT.
+  PageHashes* page_hashes = nullptr;
+};
+
+// Writes a memory dump to a file, which must be empty and seekable, holding
+// pages in a large buffer so that it writes in big chunks.
+//
+// Usage:
+//   MemoryDumpWriter writer(&file, flags, sequence);
+//   PASS_ERROR(writer.Start(regions));
+//   ... writer.AddPage() / AddZeroPage() in order of region, then address ...
+//   PASS_ERROR(writer.Finish());
+class MemoryDumpWriter {
+ public:
+  struct RegionInfo {
+    uint64_t begin;
+    uint64_t end;
+    uint32_t prot;
+    uint32_t flags;
+    std::string name;
+  };
+
+  MemoryDumpWriter(io::FileLike* file, uint32_t flags, uint64_t sequence);
+
+  utils::Error Start(const std::vector<RegionInfo>& regions);
+  utils::Error AddPage(size_t region, uint64_t addr, const char* page);
+  utils::Error AddZeroPage(size_t region, uint64_t addr);
+  void MarkUnreadable(size_t region);
+  utils::Error Finish();
+
+  uint64_t bytes_written() const { return bytes_written_; }
+
+ private:
+  io::FileLike* const file_;
+  MemoryDumpHeader header_;
+  std::vector<DumpRegionRecord> records_;
+  std::vector<std::string> names_;
+  std::vector<std::vector<uint32_t>> indexes_;
+  std::vector<std::vector<uint32_t>> zero_indexes_;
+  std::vector<char> buffer_;
+  size_t buffered_ = 0;
+  // The region of the last page added.
+  size_t last_region_ = 0;
+  // File offset just past the last page written or buffered.
+  uint64_t data_end_ = 0;
+  uint64_t bytes_written_ = 0;
+
+  utils::ErrorOr<uint32_t> PageNumber(size_t region, uint64_t addr) const;
+  utils::Error Write(const char* buffer, size_t size);
+  utils::Error FlushPages();
+};
+
+// Dumps every region of the stopped process pid to file, which must be empty
+// and seekable. Regions are read with process_vm_readv, many at a time into
+// one large buffer, rather than through /proc/<pid>/mem.
+utils::ErrorOr<MemoryDumpStats> DumpProcessMemory(
+    pid_t pid,
+    const MemoryDumpOptions& options,
+    io::FileLike* file);
+
+// A memory dump mapped read only.
+class MemoryDump {
+ public:
+  struct Region {
+    uint64_t begin;
+    uint64_t end;
+    uint32_t prot;
+    uint32_t flags;
+    std::string name;
+    // Page numbers within the region, ascending, and the bytes of each.
+    const uint32_t* pages;
+    const char* data;
+    size_t page_count;
+    // Page numbers of pages listed as all zero, ascending.
+    const uint32_t* zero_pages;
+    size_t zero_page_count;
+  };
+
+  static utils::ErrorOr<MemoryDump> Open(const std::string& path);
+
+  MemoryDump(MemoryDump&& dump);
+  ~MemoryDump();
+
+  bool delta() const { return header_->flags & kMemoryDumpDelta; }
+  uint64_t sequence() const { return header_->sequence; }
+  const std::vector<Region>& regions() const { return regions_; }
+  // The stored copy of the page at addr, or nullptr if it was not stored.
+  const char* PageAt(uint64_t addr) const;
+  // True if the page at addr is listed as all zero.
+  bool HasZeroPageAt(uint64_t addr) const;
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  const MemoryDumpHeader* header_ = nullptr;
+  std::vector<Region> regions_;
+
+  MemoryDump() {}
+  utils::Error Parse();
+  // Checks count page numbers at offset, which must be ascending and less
+  // than region_pages.
+  utils::ErrorOr<const uint32_t*> IndexAt(uint64_t offset,
+                                          uint64_t count,
+                                          uint64_t region_pages) const;
+  // The region containing addr, or nullptr.
+  const Region* RegionAt(uint64_t addr) const;
+
+  MemoryDump(const MemoryDump&) = delete;
+  MemoryDump& operator=(const MemoryDump&) = delete;
+};
+
+std::string ProtToString(uint32_t prot);
+
+} // namespace elf
+} // namespace exec
+
+#endif // EXEC_ELF_MEMORY_DUMP_H_
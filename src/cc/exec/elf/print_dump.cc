@@ -0,0 +1,79 @@
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "cc/exec/elf/memory_dump.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/trace.h"
+
+using exec::elf::kDumpRegionShared;
+using exec::elf::kDumpRegionUnreadable;
+using exec::elf::kMemoryDumpPageSize;
+using exec::elf::MemoryDump;
+using exec::elf::ProtToString;
+using io::IoStats;
+using io::WriteIoStatsReport;
+using utils::ErrorOr;
+using utils::Flags;
+
+// Usage: print_dump <dump> [--page=<addr>] [--stats[=<json path>]]
+//            [--trace=<json path>]
+//
+// Prints the regions of a memory dump written by exec_xbe --dump, one per
+// line as "<begin>-<end> <prot> <stored pages>/<pages> <name>", or with
+// --page writes the page containing addr to stdout, zeros if it was not
+// stored. For a delta snapshot (exec_xbe --snapshots) it first prints
+// "delta <sequence>", and a region's line includes "+<n>z" when n of its
+// pages became all zero; --page then fails for pages the delta left out.
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 1, "Must specify path to dump.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  ErrorOr<MemoryDump> error_or_dump = MemoryDump::Open(flags.positional()[0]);
+  CHECK_ERROR(error_or_dump.error());
+  const MemoryDump& dump = error_or_dump.get();
+
+  if (flags.Has("page")) {
+    const uint64_t addr = flags.GetUint("page", 0) & ~(kMemoryDumpPageSize - 1);
+    static const char kZeroPage[kMemoryDumpPageSize] = {};
+    const char* page = dump.PageAt(addr);
+    CHECK_INFO(page != nullptr || !dump.delta() || dump.HasZeroPageAt(addr),
+               "Page is unchanged in this delta; reconstruct_snapshot it.");
+    fwrite(page != nullptr ? page : kZeroPage, 1, kMemoryDumpPageSize, stdout);
+  } else {
+    if (dump.delta()) {
+      printf("delta %" PRIu64 "\n", dump.sequence());
+    }
+    for (const MemoryDump::Region& region : dump.regions()) {
+      const std::string zero_pages =
+          region.zero_page_count > 0
+              ? "+" + std::to_string(region.zero_page_count) + "z"
+              : "";
+      printf("%08" PRIx64 "-%08" PRIx64 " %s%c %zu%s/%" PRIu64 "%s %s\n",
+             region.begin,
+             region.end,
+             ProtToString(region.prot).c_str(),
+             region.flags & kDumpRegionShared ? 's' : 'p',
+             region.page_count,
+             zero_pages.c_str(),
+             (region.end - region.begin) / kMemoryDumpPageSize,
+             region.flags & kDumpRegionUnreadable ? " unreadable" : "",
+             region.name.c_str());
+    }
+  }
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
+  return 0;
+}
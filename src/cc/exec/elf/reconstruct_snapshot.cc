@@ -0,0 +1,53 @@
+#include <iostream>
+
+#include "cc/exec/elf/snapshots.h"
+#include "cc/io/file.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/trace.h"
+
+using exec::elf::MemoryDumpStats;
+using exec::elf::ReconstructSnapshot;
+using io::File;
+using io::IoStats;
+using io::WriteIoStatsReport;
+using utils::ErrorOr;
+using utils::Flags;
+
+// Usage: reconstruct_snapshot <dir> <sequence> <out> [--stats[=<json path>]]
+//            [--trace=<json path>]
+//
+// Writes snapshot <sequence> of the series exec_xbe --snapshots took into
+// <dir> to <out> as a full memory dump, for print_dump to read.
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 3,
+             "Must specify snapshot directory, sequence and output path.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  uint64_t sequence;
+  CHECK_INFO(utils::ParseUint(flags.positional()[1], &sequence),
+             "Sequence must be a number.");
+  ErrorOr<File> error_or_file = File::Create(flags.positional()[2], 0664);
+  CHECK_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  ErrorOr<MemoryDumpStats> error_or_stats =
+      ReconstructSnapshot(flags.positional()[0], sequence, &file);
+  CHECK_ERROR(error_or_stats.error());
+  CHECK_ERROR(file.Close());
+  const MemoryDumpStats& stats = error_or_stats.get();
+  std::cout << "Reconstructed " << stats.regions << " regions, "
+            << stats.pages_stored << " pages\n";
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
+  return 0;
+}
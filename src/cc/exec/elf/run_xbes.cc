@@ -0,0 +1,184 @@
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cc/exec/elf/elf_cache.h"
+#include "cc/exec/elf/instance_harness.h"
+#include "cc/exec/xbe/xbe_batch.h"
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/exec/xbe/xbe_path.h"
+#include "cc/io/file.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/clock.h"
+#include "cc/utils/csv_writer.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/json_writer.h"
+#include "cc/utils/trace.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::to_string;
+using std::vector;
+using exec::elf::ElfCache;
+using exec::elf::HarnessOptions;
+using exec::elf::InstanceResult;
+using exec::elf::InstanceSpec;
+using exec::elf::RunInstances;
+using exec::elf::WriteInstanceCsvHeader;
+using exec::elf::WriteInstanceRecord;
+using exec::xbe::FindXbePaths;
+using exec::xbe::OpenXbe;
+using exec::xbe::XbeImage;
+using io::File;
+using io::IoStats;
+using io::WriteIoStatsReport;
+using utils::CsvWriter;
+using utils::Error;
+using utils::ErrorOr;
+using utils::Flags;
+using utils::JsonWriter;
+
+static const uint64_t kDefaultCacheMaxBytes = 4ull << 30;
+
+namespace {
+void WriteReport(const vector<InstanceResult>& results,
+                 JsonWriter* writer) {
+  for (const InstanceResult& result : results) {
+    WriteInstanceRecord(result, writer);
+    writer->Newline();
+  }
+}
+
+void WriteReport(const vector<InstanceResult>& results,
+                 CsvWriter* writer) {
+  WriteInstanceCsvHeader(writer);
+  for (const InstanceResult& result : results) {
+    WriteInstanceRecord(result, writer);
+  }
+}
+
+Error WriteOut(const string& path, const string& text) {
+  ErrorOr<File> error_or_file = File::Create(path, 0664);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  for (size_t written = 0; written < text.size();) {
+    ErrorOr<ssize_t> error_or_written =
+        file.Write(text.data() + written, text.size() - written);
+    PASS_ERROR(error_or_written.error());
+    written += error_or_written.get();
+  }
+  return file.Close();
+}
+} // namespace
+
+// Usage: run_xbes <xbe or directory>... [--copies=<n>] [--parallel=<n>]
+//            [--timeout_ms=<n>] [--log_dir=<dir>] [--format=json|csv]
+//            [--out=<path>] [--cache_dir=<dir>] [--cache_max_bytes=<n>]
+//            [--stats[=<json path>]] [--trace=<json path>]
+//
+// Converts every XBE (directories are searched for .xbe files, as by
+// print_xbe --batch) through the ELF cache and runs --copies instances of
+// each (1 by default), --parallel at a time (all of them by default), each
+// killed if it runs longer than --timeout_ms. Instances are not traced.
+// Writes one record per instance, with its exit status, wall time and peak
+// RSS, to --out or stdout, and prints a summary. Each instance's output goes
+// to <log_dir>/<index>.log if --log_dir is given. Exits with 1 if any
+// instance failed or timed out.
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(!flags.positional().empty(), "Must specify path to xbe.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  const string format = flags.GetString("format", "json");
+  CHECK_INFO(format == "json" || format == "csv",
+             "--format must be json or csv.");
+
+  ErrorOr<vector<string>> error_or_paths = FindXbePaths(flags.positional());
+  CHECK_ERROR(error_or_paths.error());
+  ErrorOr<ElfCache> error_or_cache = ElfCache::Open(
+      flags.GetString("cache_dir", ElfCache::DefaultDir()),
+      flags.GetUint("cache_max_bytes", kDefaultCacheMaxBytes));
+  CHECK_ERROR(error_or_cache.error());
+  ElfCache cache = error_or_cache.move();
+
+  const uint64_t copies = flags.GetUint("copies", 1);
+  vector<InstanceSpec> specs;
+  for (const string& xbe_path : error_or_paths.get()) {
+    ErrorOr<XbeImage> error_or_xbe = OpenXbe(xbe_path);
+    CHECK_ERROR(error_or_xbe.error());
+    ErrorOr<string> error_or_elf_path = cache.GetOrConvert(error_or_xbe.get());
+    CHECK_ERROR(error_or_elf_path.error());
+    for (uint64_t copy = 0; copy < copies; copy++) {
+      specs.push_back({copies == 1 ? xbe_path
+                                   : xbe_path + "#" + to_string(copy),
+                       error_or_elf_path.get()});
+    }
+  }
+
+  HarnessOptions options;
+  options.max_running = flags.GetUint("parallel", specs.size());
+  options.timeout_ms = flags.GetUint("timeout_ms", 0);
+  options.log_dir = flags.GetString("log_dir", "");
+  if (!options.log_dir.empty()) {
+    CHECK_INFO(mkdir(options.log_dir.c_str(), 0755) == 0 || errno == EEXIST,
+               "Could not create " + options.log_dir + ": " + strerror(errno));
+  }
+  const uint64_t start_ns = utils::MonotonicNowNs();
+  ErrorOr<vector<InstanceResult>> error_or_results =
+      RunInstances(specs, options);
+  CHECK_ERROR(error_or_results.error());
+  const uint64_t wall_ns = utils::MonotonicNowNs() - start_ns;
+  const vector<InstanceResult>& results = error_or_results.get();
+
+  string report;
+  if (format == "csv") {
+    CsvWriter writer;
+    WriteReport(results, &writer);
+    report = writer.str();
+  } else {
+    JsonWriter writer;
+    WriteReport(results, &writer);
+    report = writer.str();
+  }
+  if (flags.Has("out")) {
+    CHECK_ERROR(WriteOut(flags.GetString("out", ""), report));
+  } else {
+    cout << report << std::flush;
+    CHECK_INFO(cout, "Could not write the report.");
+  }
+
+  size_t ok_count = 0;
+  size_t timed_out_count = 0;
+  uint64_t max_wall_ns = 0;
+  uint64_t max_peak_rss_kb = 0;
+  for (const InstanceResult& result : results) {
+    ok_count += result.ok();
+    timed_out_count += result.timed_out;
+    max_wall_ns = std::max(max_wall_ns, result.wall_ns);
+    max_peak_rss_kb = std::max(max_peak_rss_kb, result.peak_rss_kb);
+  }
+  cerr << "Ran " << results.size() << " instances in " << wall_ns / 1000000
+       << " ms: " << ok_count << " ok, " << timed_out_count << " timed out, "
+       << results.size() - ok_count - timed_out_count << " failed; longest "
+       << max_wall_ns / 1000000 << " ms, peak RSS " << max_peak_rss_kb
+       << " KiB." << endl;
+
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
+  return ok_count == results.size() ? 0 : 1;
+}
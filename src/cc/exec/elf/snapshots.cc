@@ -0,0 +1,197 @@
+#include "cc/exec/elf/snapshots.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "cc/io/file.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using io::File;
+using io::FileLike;
+using io::IoCounter;
+using io::IoStats;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace elf {
+namespace {
+const uint64_t kSoftDirtyBit = 1ull << 55;
+
+Error MakeDirs(const string& path) {
+  for (size_t slash = path.find('/', 1);; slash = path.find('/', slash + 1)) {
+    const string prefix = path.substr(0, slash);
+    if (mkdir(prefix.c_str(), 0755) < 0 && errno != EEXIST) {
+      RETURN_ERROR("Could not create " + prefix + ": " + strerror(errno));
+    }
+    if (slash == string::npos) {
+      return Error::Ok();
+    }
+  }
+}
+
+Error WriteProcFile(const string& path, const string& contents) {
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 3);
+  const int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+  RETURN_ERROR_SYSCALL(fd, "Could not open " + path);
+  const ssize_t written = write(fd, contents.data(), contents.size());
+  const int write_errno = errno;
+  close(fd);
+  RETURN_ERROR_IF(written != (ssize_t) contents.size(),
+                  "Could not write " + path + ": " + strerror(write_errno));
+  return Error::Ok();
+}
+
+Error ClearSoftDirty(const string& pid) {
+  return WriteProcFile("/proc/" + pid + "/clear_refs", "4");
+}
+
+// Whether the kernel tracks soft dirty pages, found by clearing the bits of
+// this process and writing to a page of its own.
+ErrorOr<bool> HasSoftDirty() {
+  void* page = mmap(nullptr,
+                    kMemoryDumpPageSize,
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS,
+                    -1,
+                    0);
+  RETURN_ERROR_IF(page == MAP_FAILED,
+                  string("Could not map probe page: ") + strerror(errno));
+  *static_cast<volatile char*>(page) = 1;
+  Error error = ClearSoftDirty("self");
+  uint64_t entry = 0;
+  if (error.is_ok()) {
+    *static_cast<volatile char*>(page) = 2;
+    const int fd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+    if (fd < 0
+        || pread(fd,
+                 &entry,
+                 sizeof(entry),
+                 reinterpret_cast<uint64_t>(page) / kMemoryDumpPageSize
+                     * sizeof(entry)) != sizeof(entry)) {
+      error = Error(string("Could not read pagemap: ") + strerror(errno),
+                    __FILE__,
+                    __LINE__);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  munmap(page, kMemoryDumpPageSize);
+  PASS_ERROR(error);
+  bool soft_dirty = entry & kSoftDirtyBit;
+  return ErrorOr<bool>(std::move(soft_dirty));
+}
+} // namespace
+
+string SnapshotPath(const string& dir, uint64_t sequence) {
+  char name[32];
+  snprintf(name, sizeof(name), "snapshot-%06" PRIu64 ".memdump", sequence);
+  return dir + "/" + name;
+}
+
+ErrorOr<SnapshotWriter> SnapshotWriter::Open(pid_t pid, const string& dir) {
+  RETURN_ERROR_IF(dir.empty(), "Snapshot directory must not be empty.");
+  PASS_ERROR(MakeDirs(dir));
+  ErrorOr<bool> error_or_soft_dirty = HasSoftDirty();
+  PASS_ERROR(error_or_soft_dirty.error());
+  SnapshotWriter writer;
+  writer.pid_ = pid;
+  writer.dir_ = dir;
+  writer.soft_dirty_ = error_or_soft_dirty.get();
+  return ErrorOr<SnapshotWriter>(std::move(writer));
+}
+
+ErrorOr<MemoryDumpStats> SnapshotWriter::Take() {
+  Span span("SnapshotWriter::Take");
+  MemoryDumpOptions options;
+  options.sequence = count_;
+  if (count_ == 0) {
+    options.mode = DumpMode::FULL;
+  } else {
+    options.mode =
+        soft_dirty_ ? DumpMode::SOFT_DIRTY : DumpMode::CHANGED_CONTENT;
+  }
+  if (!soft_dirty_) {
+    options.page_hashes = &page_hashes_;
+  }
+  const string path = SnapshotPath(dir_, count_);
+  span.set_detail(path);
+  ErrorOr<File> error_or_file = File::Create(path, 0664);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  ErrorOr<MemoryDumpStats> error_or_stats =
+      DumpProcessMemory(pid_, options, &file);
+  PASS_ERROR(error_or_stats.error());
+  PASS_ERROR(file.Close());
+  if (soft_dirty_) {
+    PASS_ERROR(ClearSoftDirty(std::to_string(pid_)));
+  }
+  count_++;
+  return ErrorOr<MemoryDumpStats>(error_or_stats.move());
+}
+
+ErrorOr<MemoryDumpStats> ReconstructSnapshot(const string& dir,
+                                             uint64_t sequence,
+                                             FileLike* file) {
+  Span span("ReconstructSnapshot");
+  vector<MemoryDump> dumps;
+  for (uint64_t i = 0; i <= sequence; i++) {
+    ErrorOr<MemoryDump> error_or_dump = MemoryDump::Open(SnapshotPath(dir, i));
+    PASS_ERROR(error_or_dump.error());
+    dumps.push_back(error_or_dump.move());
+    RETURN_ERROR_IF(dumps.back().sequence() != i
+                    || dumps.back().delta() != (i > 0),
+                    SnapshotPath(dir, i) + " is out of place in its series.");
+  }
+  const MemoryDump& target = dumps.back();
+
+  vector<MemoryDumpWriter::RegionInfo> regions;
+  for (const MemoryDump::Region& region : target.regions()) {
+    regions.push_back(MemoryDumpWriter::RegionInfo{
+        region.begin, region.end, region.prot, region.flags, region.name});
+  }
+  MemoryDumpWriter writer(file, 0, sequence);
+  PASS_ERROR(writer.Start(regions));
+  MemoryDumpStats stats;
+  stats.regions = regions.size();
+  for (size_t i = 0; i < regions.size(); i++) {
+    for (uint64_t addr = regions[i].begin; addr < regions[i].end;
+         addr += kMemoryDumpPageSize) {
+      // The newest snapshot that says anything about the page has it; a full
+      // dump that does not store it had it zero.
+      const char* page = nullptr;
+      for (size_t k = dumps.size(); k-- > 0;) {
+        page = dumps[k].PageAt(addr);
+        if (page != nullptr || dumps[k].HasZeroPageAt(addr)
+            || !dumps[k].delta()) {
+          break;
+        }
+      }
+      if (page == nullptr) {
+        stats.zero_pages++;
+        continue;
+      }
+      PASS_ERROR(writer.AddPage(i, addr, page));
+      stats.pages_stored++;
+    }
+  }
+  PASS_ERROR(writer.Finish());
+  stats.bytes_written = writer.bytes_written();
+  span.set_bytes(stats.bytes_written);
+  return ErrorOr<MemoryDumpStats>(std::move(stats));
+}
+
+} // namespace elf
+} // namespace exec
@@ -0,0 +1,59 @@
+#ifndef EXEC_ELF_SNAPSHOTS_H_
+#define EXEC_ELF_SNAPSHOTS_H_
+
+#include <sys/types.h>
+#include <cstdint>
+#include <string>
+#include "cc/exec/elf/memory_dump.h"
+#include "cc/io/file_like.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace elf {
+
+// A series of snapshots of one process's memory lives in a directory, one
+// memory dump per snapshot: the first is a full dump and every later one a
+// delta against the snapshot before it, so a snapshot costs in proportion to
+// the pages written since the last one rather than to all of memory.
+std::string SnapshotPath(const std::string& dir, uint64_t sequence);
+
+// Takes the snapshots of a stopped process.
+//
+// The kernel's soft dirty bits say which pages were written: after each
+// snapshot "4" is written to /proc/<pid>/clear_refs, and the next reads only
+// the pages /proc/<pid>/pagemap marks soft dirty. Kernels built without soft
+// dirty tracking never set the bit; there every page is read and only pages
+// whose contents changed are written.
+class SnapshotWriter {
+ public:
+  // Creates dir if it does not exist.
+  static utils::ErrorOr<SnapshotWriter> Open(pid_t pid, const std::string& dir);
+
+  utils::ErrorOr<MemoryDumpStats> Take();
+
+  // Snapshots taken so far; the next one gets this sequence number.
+  uint64_t count() const { return count_; }
+  bool soft_dirty() const { return soft_dirty_; }
+  const std::string& dir() const { return dir_; }
+
+ private:
+  pid_t pid_ = 0;
+  std::string dir_;
+  bool soft_dirty_ = false;
+  uint64_t count_ = 0;
+  // Without soft dirty bits, the hash of every page as of the last snapshot.
+  PageHashes page_hashes_;
+
+  SnapshotWriter() {}
+};
+
+// Writes snapshot sequence of the series in dir to file as a full memory
+// dump.
+utils::ErrorOr<MemoryDumpStats> ReconstructSnapshot(const std::string& dir,
+                                                    uint64_t sequence,
+                                                    io::FileLike* file);
+
+} // namespace elf
+} // namespace exec
+
+#endif // EXEC_ELF_SNAPSHOTS_H_
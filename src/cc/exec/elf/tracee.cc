@@ -0,0 +1,370 @@
+#include "cc/exec/elf/tracee.h"
+
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using std::string;
+using utils::Error;
+using utils::ErrorOr;
+
+namespace exec {
+namespace elf {
+namespace {
+const uint8_t kInt3 = 0xcc;
+// PEEKTEXT and POKETEXT move a word at a time; an aligned word never crosses
+// into a page that might not be mapped.
+const uint64_t kWordMask = sizeof(long) - 1;
+const int kDebugStatusReg = 6;
+const int kDebugControlReg = 7;
+
+// DR7's length field for a watchpoint of size bytes.
+uint64_t DebugLength(uint32_t size) {
+  switch (size) {
+    case 1:
+      return 0;
+    case 2:
+      return 1;
+    case 8:
+      return 2;
+    default:
+      return 3;
+  }
+}
+
+string HexAddr(uint64_t addr) {
+  char text[19];
+  snprintf(text, sizeof(text), "0x%lx", addr);
+  return text;
+}
+} // namespace
+
+Error Tracee::InsertBreakpoint(uint64_t addr) {
+  if (HasBreakpoint(addr)) {
+    return Error::Ok();
+  }
+  ErrorOr<uint8_t> error_or_original = PeekByte(addr);
+  PASS_ERROR(error_or_original.error());
+  PASS_ERROR(PokeByte(addr, kInt3));
+  breakpoints_[addr] = error_or_original.get();
+  return Error::Ok();
+}
+
+Error Tracee::RemoveBreakpoint(uint64_t addr) {
+  auto breakpoint = breakpoints_.find(addr);
+  RETURN_ERROR_IF(breakpoint == breakpoints_.end(),
+                  "No breakpoint at " + HexAddr(addr));
+  PASS_ERROR(PokeByte(addr, breakpoint->second));
+  breakpoints_.erase(breakpoint);
+  return Error::Ok();
+}
+
+Error Tracee::InsertWatchpoint(const Watchpoint& watchpoint) {
+  const uint32_t size = watchpoint.size;
+  RETURN_ERROR_IF(size != 1 && size != 2 && size != 4 && size != 8,
+                  "Watchpoints must be 1, 2, 4 or 8 bytes.");
+  RETURN_ERROR_IF(watchpoint.addr % size != 0,
+                  "Watchpoint at " + HexAddr(watchpoint.addr)
+                      + " is not aligned to its size.");
+  int index = -1;
+  for (int i = 0; i < kMaxWatchpoints; i++) {
+    if (watchpoints_[i].size != 0 && watchpoints_[i].addr == watchpoint.addr) {
+      index = i;
+      break;
+    }
+    if (watchpoints_[i].size == 0 && index < 0) {
+      index = i;
+    }
+  }
+  RETURN_ERROR_IF(index < 0, "All debug registers are in use.");
+  // The kernel checks DR7 against the addresses, so the register is disabled
+  // while its address changes.
+  watchpoints_[index].size = 0;
+  PASS_ERROR(PokeDebugReg(kDebugControlReg, DebugControl()));
+  PASS_ERROR(PokeDebugReg(index, watchpoint.addr));
+  watchpoints_[index] = watchpoint;
+  const Error error = PokeDebugReg(kDebugControlReg, DebugControl());
+  if (!error.is_ok()) {
+    watchpoints_[index].size = 0;
+  }
+  return error;
+}
+
+Error Tracee::RemoveWatchpoint(uint64_t addr) {
+  for (int i = 0; i < kMaxWatchpoints; i++) {
+    if (watchpoints_[i].size != 0 && watchpoints_[i].addr == addr) {
+      watchpoints_[i].size = 0;
+      return PokeDebugReg(kDebugControlReg, DebugControl());
+    }
+  }
+  RETURN_ERROR("No watchpoint at " + HexAddr(addr));
+}
+
+ErrorOr<Stop> Tracee::Step() {
+  RETURN_ERROR_IF(exited_, "Child has exited.");
+  ErrorOr<uint64_t> error_or_rip = CurrentRip();
+  PASS_ERROR(error_or_rip.error());
+  const uint64_t rip = error_or_rip.get();
+  user_regs_struct regs;
+  ErrorOr<Stop> error_or_stop = HasBreakpoint(rip)
+      ? StepOverBreakpoint(rip, &regs)
+      : Resume(PTRACE_SINGLESTEP, &regs);
+  PASS_ERROR(error_or_stop.error());
+  Stop stop = error_or_stop.get();
+  // A watchpoint trap on a step still ran the instruction.
+  if (stop.kind == StopKind::STEP || stop.kind == StopKind::WATCHPOINT) {
+    steps_++;
+    if (step_observer_) {
+      PASS_ERROR(step_observer_(regs));
+    }
+  }
+  return ErrorOr<Stop>(std::move(stop));
+}
+
+ErrorOr<Stop> Tracee::Continue() {
+  RETURN_ERROR_IF(exited_, "Child has exited.");
+  ErrorOr<uint64_t> error_or_rip = CurrentRip();
+  PASS_ERROR(error_or_rip.error());
+  const uint64_t rip = error_or_rip.get();
+  user_regs_struct regs;
+  if (HasBreakpoint(rip)) {
+    ErrorOr<Stop> error_or_stop = StepOverBreakpoint(rip, &regs);
+    PASS_ERROR(error_or_stop.error());
+    Stop stop = error_or_stop.get();
+    if (stop.kind != StopKind::STEP) {
+      return ErrorOr<Stop>(std::move(stop));
+    }
+    // The step may land straight on the next breakpoint.
+    if (HasBreakpoint(stop.rip)) {
+      stop.kind = StopKind::BREAKPOINT;
+      return ErrorOr<Stop>(std::move(stop));
+    }
+  }
+  return Resume(PTRACE_CONT, &regs);
+}
+
+ErrorOr<Stop> Tracee::RunUntil(uint64_t addr) {
+  const bool temporary = !HasBreakpoint(addr);
+  PASS_ERROR(InsertBreakpoint(addr));
+  ErrorOr<Stop> error_or_stop = Continue();
+  PASS_ERROR(error_or_stop.error());
+  if (temporary && !exited_) {
+    PASS_ERROR(RemoveBreakpoint(addr));
+  }
+  return ErrorOr<Stop>(error_or_stop.move());
+}
+
+ErrorOr<Stop> Tracee::StepN(uint64_t count) {
+  RETURN_ERROR_IF(exited_, "Child has exited.");
+  ErrorOr<uint64_t> error_or_rip = CurrentRip();
+  PASS_ERROR(error_or_rip.error());
+  Stop stop;
+  stop.kind = StopKind::STEP;
+  stop.rip = error_or_rip.get();
+  for (uint64_t i = 0; i < count; i++) {
+    ErrorOr<Stop> error_or_stop = Step();
+    PASS_ERROR(error_or_stop.error());
+    stop = error_or_stop.get();
+    if (stop.kind != StopKind::STEP) {
+      break;
+    }
+  }
+  return ErrorOr<Stop>(std::move(stop));
+}
+
+ErrorOr<user_regs_struct> Tracee::GetRegs() const {
+  user_regs_struct regs;
+  RETURN_ERROR_SYSCALL(ptrace(PTRACE_GETREGS, pid_, 0, &regs),
+                       "Could not read regs.");
+  return ErrorOr<user_regs_struct>(std::move(regs));
+}
+
+Error Tracee::SetRegs(const user_regs_struct& regs) {
+  RETURN_ERROR_SYSCALL(ptrace(PTRACE_SETREGS, pid_, 0, &regs),
+                       "Could not write regs.");
+  rip_known_ = true;
+  rip_ = regs.rip;
+  return Error::Ok();
+}
+
+ErrorOr<uint64_t> Tracee::CurrentRip() {
+  if (!rip_known_) {
+    ErrorOr<user_regs_struct> error_or_regs = GetRegs();
+    PASS_ERROR(error_or_regs.error());
+    rip_known_ = true;
+    rip_ = error_or_regs.get().rip;
+  }
+  uint64_t rip = rip_;
+  return ErrorOr<uint64_t>(std::move(rip));
+}
+
+ErrorOr<Stop> Tracee::Kill() {
+  Stop stop;
+  stop.kind = StopKind::EXITED;
+  if (exited_) {
+    return ErrorOr<Stop>(std::move(stop));
+  }
+  RETURN_ERROR_SYSCALL(kill(pid_, SIGKILL), "Could not kill child.");
+  RETURN_ERROR_SYSCALL(waitpid(pid_, &stop.status, 0), "Wait failed.");
+  exited_ = true;
+  return ErrorOr<Stop>(std::move(stop));
+}
+
+ErrorOr<uint8_t> Tracee::PeekByte(uint64_t addr) const {
+  const uint64_t word_addr = addr & ~kWordMask;
+  errno = 0;
+  const long word = ptrace(PTRACE_PEEKTEXT, pid_, word_addr, 0);
+  RETURN_ERROR_IF(errno != 0,
+                  "Could not read " + HexAddr(addr) + ": " + strerror(errno));
+  uint8_t value = word >> (8 * (addr - word_addr));
+  return ErrorOr<uint8_t>(std::move(value));
+}
+
+Error Tracee::PokeByte(uint64_t addr, uint8_t value) {
+  const uint64_t word_addr = addr & ~kWordMask;
+  errno = 0;
+  const long word = ptrace(PTRACE_PEEKTEXT, pid_, word_addr, 0);
+  RETURN_ERROR_IF(errno != 0,
+                  "Could not read " + HexAddr(addr) + ": " + strerror(errno));
+  const int shift = 8 * (addr - word_addr);
+  const unsigned long new_word = (word & ~(0xfful << shift))
+      | (static_cast<unsigned long>(value) << shift);
+  // Pages mapped shared from a read only file, as LoadXbeShared maps code,
+  // refuse the write rather than changing the file.
+  RETURN_ERROR_SYSCALL(ptrace(PTRACE_POKETEXT, pid_, word_addr, new_word),
+                       "Could not write " + HexAddr(addr));
+  return Error::Ok();
+}
+
+ErrorOr<uint64_t> Tracee::PeekDebugReg(int index) const {
+  errno = 0;
+  uint64_t value = ptrace(PTRACE_PEEKUSER, pid_,
+                          offsetof(user, u_debugreg) + index * sizeof(long), 0);
+  RETURN_ERROR_IF(errno != 0,
+                  "Could not read DR" + std::to_string(index) + ": "
+                      + strerror(errno));
+  return ErrorOr<uint64_t>(std::move(value));
+}
+
+Error Tracee::PokeDebugReg(int index, uint64_t value) {
+  RETURN_ERROR_SYSCALL(
+      ptrace(PTRACE_POKEUSER, pid_,
+             offsetof(user, u_debugreg) + index * sizeof(long), value),
+      "Could not write DR" + std::to_string(index));
+  return Error::Ok();
+}
+
+uint64_t Tracee::DebugControl() const {
+  uint64_t control = 0;
+  for (int i = 0; i < kMaxWatchpoints; i++) {
+    const Watchpoint& watchpoint = watchpoints_[i];
+    if (watchpoint.size == 0) {
+      continue;
+    }
+    // Local enable, then the access (01 for writes, 11 for reads and writes)
+    // and length fields.
+    const uint64_t access = watchpoint.kind == WatchKind::WRITE ? 1 : 3;
+    control |= (1ull << (2 * i)) | (access << (16 + 4 * i))
+        | (DebugLength(watchpoint.size) << (18 + 4 * i));
+  }
+  return control;
+}
+
+ErrorOr<int> Tracee::TakeWatchpointHit() {
+  bool watching = false;
+  for (const Watchpoint& watchpoint : watchpoints_) {
+    watching = watching || watchpoint.size != 0;
+  }
+  // Saves two syscalls per trap when there is nothing to hit.
+  if (!watching) {
+    return ErrorOr<int>(-1);
+  }
+  ErrorOr<uint64_t> error_or_status = PeekDebugReg(kDebugStatusReg);
+  PASS_ERROR(error_or_status.error());
+  // The CPU never clears DR6's hit bits itself.
+  PASS_ERROR(PokeDebugReg(kDebugStatusReg, 0));
+  int index = -1;
+  for (int i = 0; i < kMaxWatchpoints; i++) {
+    if ((error_or_status.get() & (1ull << i)) && watchpoints_[i].size != 0) {
+      index = i;
+      break;
+    }
+  }
+  return ErrorOr<int>(std::move(index));
+}
+
+ErrorOr<Stop> Tracee::Resume(int request, user_regs_struct* regs) {
+  const int signal = pending_signal_;
+  pending_signal_ = 0;
+  rip_known_ = false;
+  RETURN_ERROR_SYSCALL(
+      ptrace(static_cast<__ptrace_request>(request), pid_, nullptr, signal),
+      "Could not resume child.");
+  Stop stop;
+  RETURN_ERROR_SYSCALL(waitpid(pid_, &stop.status, 0), "Wait failed.");
+  if (WIFEXITED(stop.status) || WIFSIGNALED(stop.status)) {
+    exited_ = true;
+    stop.kind = StopKind::EXITED;
+    return ErrorOr<Stop>(std::move(stop));
+  }
+  RETURN_ERROR_SYSCALL(ptrace(PTRACE_GETREGS, pid_, 0, regs),
+                       "Could not read regs.");
+  rip_known_ = true;
+  rip_ = regs->rip;
+  stop.rip = regs->rip;
+
+  const int stop_signal = WSTOPSIG(stop.status);
+  int watchpoint = -1;
+  if (stop_signal == SIGTRAP) {
+    ErrorOr<int> error_or_watchpoint = TakeWatchpointHit();
+    PASS_ERROR(error_or_watchpoint.error());
+    watchpoint = error_or_watchpoint.get();
+  }
+  if (watchpoint >= 0) {
+    const Watchpoint& hit = watchpoints_[watchpoint];
+    const uint64_t word_addr = hit.addr & ~kWordMask;
+    errno = 0;
+    const uint64_t word = ptrace(PTRACE_PEEKDATA, pid_, word_addr, 0);
+    RETURN_ERROR_IF(errno != 0,
+                    "Could not read " + HexAddr(hit.addr) + ": "
+                        + strerror(errno));
+    // Aligned to its size, a watchpoint never crosses a word.
+    const uint64_t value = word >> (8 * (hit.addr - word_addr));
+    stop.kind = StopKind::WATCHPOINT;
+    stop.watch_addr = hit.addr;
+    stop.watch_value =
+        hit.size == 8 ? value : value & ((1ull << (8 * hit.size)) - 1);
+  } else if (stop_signal == SIGTRAP && request == PTRACE_SINGLESTEP) {
+    stop.kind = StopKind::STEP;
+  } else if (stop_signal == SIGTRAP && HasBreakpoint(regs->rip - 1)) {
+    // int3 traps after itself; rewind so that rip names the breakpoint.
+    regs->rip--;
+    PASS_ERROR(SetRegs(*regs));
+    stop.kind = StopKind::BREAKPOINT;
+    stop.rip = regs->rip;
+  } else {
+    stop.kind = StopKind::SIGNAL;
+    stop.signal = stop_signal;
+    pending_signal_ = stop_signal;
+  }
+  return ErrorOr<Stop>(std::move(stop));
+}
+
+ErrorOr<Stop> Tracee::StepOverBreakpoint(uint64_t rip,
+                                         user_regs_struct* regs) {
+  PASS_ERROR(PokeByte(rip, breakpoints_[rip]));
+  ErrorOr<Stop> error_or_stop = Resume(PTRACE_SINGLESTEP, regs);
+  PASS_ERROR(error_or_stop.error());
+  if (!exited_) {
+    PASS_ERROR(PokeByte(rip, kInt3));
+  }
+  return ErrorOr<Stop>(error_or_stop.move());
+}
+
+} // namespace elf
+} // namespace exec
@@ -0,0 +1,155 @@
+#ifndef EXEC_ELF_TRACEE_H_
+#define EXEC_ELF_TRACEE_H_
+
+#include <sys/types.h>
+#include <sys/user.h>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace elf {
+
+// Why a traced child last stopped.
+enum class StopKind {
+  // Hit an inserted breakpoint; rip has been rewound to its address.
+  BREAKPOINT,
+  // Finished a single step.
+  STEP,
+  // Accessed memory under a watchpoint; rip is that of the instruction after
+  // the one that did.
+  WATCHPOINT,
+  // Stopped by any other signal, which is delivered when the child resumes.
+  SIGNAL,
+  // Exited or was killed; the child is gone.
+  EXITED,
+};
+
+struct Stop {
+  StopKind kind;
+  // The raw wait status.
+  int status = 0;
+  // Only meaningful for SIGNAL.
+  int signal = 0;
+  // Not meaningful for EXITED.
+  uint64_t rip = 0;
+  // Only meaningful for WATCHPOINT: the watchpoint's address and what its
+  // bytes hold after the access, little endian.
+  uint64_t watch_addr = 0;
+  uint64_t watch_value = 0;
+};
+
+enum class WatchKind {
+  WRITE,
+  READ_WRITE,
+};
+
+struct Watchpoint {
+  uint64_t addr;
+  // 1, 2, 4 or 8, with addr aligned to it.
+  uint32_t size;
+  WatchKind kind;
+};
+
+// A ptrace'd child that is stopped between calls, with int3 breakpoints.
+// Breakpoints replace the first byte of an instruction with int3, so running
+// to one costs nothing until it is hit, unlike single stepping, which costs
+// two context switches per instruction. Resuming from a breakpoint puts the
+// original byte back for exactly one step.
+//
+// Watchpoints are the CPU's debug registers, DR0 to DR3 with DR7 enabling
+// them, set through PTRACE_POKEUSER: the CPU traps after an instruction that
+// accesses a watched address, so the child runs at full speed until one does,
+// however much it runs. There are only four of them.
+//
+// Usage:
+//   ... wait for the child's first stop ...
+//   Tracee tracee(pid);
+//   CHECK_ERROR(tracee.InsertBreakpoint(addr));
+//   ErrorOr<Stop> error_or_stop = tracee.Continue();
+class Tracee {
+ public:
+  // Called with the registers after every instruction Step() runs; they are
+  // read to classify the stop anyway, so observing costs no extra syscalls.
+  typedef std::function<utils::Error(const user_regs_struct&)> StepObserver;
+
+  explicit Tracee(pid_t pid) : pid_(pid) {}
+
+  void set_step_observer(StepObserver observer) {
+    step_observer_ = std::move(observer);
+  }
+
+  pid_t pid() const { return pid_; }
+  bool exited() const { return exited_; }
+  // Instructions run by Step() so far.
+  uint64_t steps() const { return steps_; }
+
+  // Breakpoints are keyed by address; inserting one twice is a no-op.
+  utils::Error InsertBreakpoint(uint64_t addr);
+  utils::Error RemoveBreakpoint(uint64_t addr);
+  bool HasBreakpoint(uint64_t addr) const {
+    return breakpoints_.count(addr) > 0;
+  }
+
+  static const int kMaxWatchpoints = 4;
+  // Watchpoints are keyed by address, like breakpoints; inserting one at an
+  // address that has one replaces it.
+  utils::Error InsertWatchpoint(const Watchpoint& watchpoint);
+  utils::Error RemoveWatchpoint(uint64_t addr);
+
+  // Runs one instruction.
+  utils::ErrorOr<Stop> Step();
+  // Runs until a breakpoint, a watchpoint, a signal or exit.
+  utils::ErrorOr<Stop> Continue();
+  // Runs until addr is reached with a breakpoint that is removed again
+  // afterwards unless it was already inserted. Stops early like Continue().
+  utils::ErrorOr<Stop> RunUntil(uint64_t addr);
+  // Steps up to count instructions, stopping early for anything other than a
+  // completed step, including a step that hits a watchpoint.
+  utils::ErrorOr<Stop> StepN(uint64_t count);
+
+  utils::ErrorOr<user_regs_struct> GetRegs() const;
+  utils::Error SetRegs(const user_regs_struct& regs);
+
+  // Kills the child, if it has not exited, and reaps it.
+  utils::ErrorOr<Stop> Kill();
+
+ private:
+  const pid_t pid_;
+  bool exited_ = false;
+  uint64_t steps_ = 0;
+  // Delivered on the next resume.
+  int pending_signal_ = 0;
+  // Address to the byte int3 replaced.
+  std::map<uint64_t, uint8_t> breakpoints_;
+  // By debug register; size 0 for a free one.
+  Watchpoint watchpoints_[kMaxWatchpoints] = {};
+  StepObserver step_observer_;
+  // rip as of the last stop, so that stepping needs no extra GETREGS.
+  bool rip_known_ = false;
+  uint64_t rip_ = 0;
+
+  utils::ErrorOr<uint64_t> CurrentRip();
+  utils::ErrorOr<uint8_t> PeekByte(uint64_t addr) const;
+  utils::Error PokeByte(uint64_t addr, uint8_t value);
+  utils::ErrorOr<uint64_t> PeekDebugReg(int index) const;
+  utils::Error PokeDebugReg(int index, uint64_t value);
+  // DR7 for watchpoints_.
+  uint64_t DebugControl() const;
+  // The debug register of the watchpoint that trapped, or -1 if the trap had
+  // nothing to do with watchpoints, and resets DR6 for the next trap.
+  utils::ErrorOr<int> TakeWatchpointHit();
+  // Resumes with request, PTRACE_SINGLESTEP or PTRACE_CONT, and classifies
+  // the stop that follows. Unless the child exited, *regs is left holding its
+  // registers.
+  utils::ErrorOr<Stop> Resume(int request, user_regs_struct* regs);
+  // Steps over the breakpoint at rip with its original byte in place.
+  utils::ErrorOr<Stop> StepOverBreakpoint(uint64_t rip,
+                                          user_regs_struct* regs);
+};
+
+} // namespace elf
+} // namespace exec
+
+#endif // EXEC_ELF_TRACEE_H_
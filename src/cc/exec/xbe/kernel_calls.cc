@@ -0,0 +1,352 @@
+#include "cc/exec/xbe/kernel_calls.h"
+
+#include <signal.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "cc/exec/xbe/kernel_thunks.h"
+#include "cc/exec/xbe/xbe_loader.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using io::IoCounter;
+using io::IoStats;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+namespace {
+// Linux's __USER32_CS, __USER_CS and __USER_DS.
+const uint16_t kUser32CodeSelector = 0x23;
+const uint16_t kUser64CodeSelector = 0x33;
+const uint16_t kUserDataSelector = 0x2b;
+
+const size_t kHostStackSize = 256 * 1024;
+// Zeroed storage for each kernel variable, indexed by ordinal; enough for
+// the largest, XboxAlternateSignatureKeys.
+const size_t kKernelVariableSize = 0x100;
+
+// The low, 32 bit addressable code area: a far pointer to the entry stub, the
+// top of the host stack, the 64 bit entry stub and then one trampoline per
+// ordinal.
+const size_t kFarPointerOffset = 0x0;
+const size_t kHostStackTopOffset = 0x8;
+const size_t kEntryOffset = 0x10;
+const size_t kTrampolinesOffset = 0x80;
+const size_t kTrampolineSize = 0x10;
+const size_t kCodeAreaSize =
+    kTrampolinesOffset + (kMaxKernelOrdinal + 1) * kTrampolineSize;
+
+// What the entry stub leaves on the host stack for Dispatch: the guest's
+// registers, then an iretq frame that Dispatch fills in, but for rflags,
+// which the stub saves there before anything changes them.
+struct EntryFrame {
+  uint64_t rax;
+  uint64_t rcx;
+  uint64_t rdx;
+  uint64_t rbx;
+  uint64_t rbp;
+  uint64_t rsi;
+  uint64_t rdi;
+  // Points at the ordinal the trampoline pushed, then the return address.
+  uint64_t guest_esp;
+  uint64_t rip;
+  uint64_t cs;
+  uint64_t rflags;
+  uint64_t rsp;
+  uint64_t ss;
+};
+
+KernelCallHandler g_handlers[kMaxKernelOrdinal + 1];
+KernelCallCounts* g_counts = nullptr;
+
+void Dispatch(EntryFrame* frame) {
+  const uint32_t* guest_stack =
+      reinterpret_cast<const uint32_t*>(frame->guest_esp);
+  KernelCall call;
+  call.ordinal = guest_stack[0];
+  call.eax = frame->rax;
+  call.ecx = frame->rcx;
+  call.edx = frame->rdx;
+  call.args = guest_stack + 2;
+  if (g_counts != nullptr) {
+    g_counts->calls[call.ordinal]++;
+  }
+  g_handlers[call.ordinal](&call);
+  const uint32_t popped = CalleePoppedBytes(kKernelExports[call.ordinal]);
+  frame->rax = call.eax;
+  frame->rcx = call.ecx;
+  frame->rdx = call.edx;
+  frame->rip = guest_stack[1];
+  frame->cs = kUser32CodeSelector;
+  frame->rsp = frame->guest_esp + 2 * sizeof(uint32_t) + popped;
+  frame->ss = kUserDataSelector;
+}
+
+void Append(vector<uint8_t>* code, const vector<uint8_t>& bytes) {
+  code->insert(code->end(), bytes.begin(), bytes.end());
+}
+
+void AppendUint32(vector<uint8_t>* code, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    code->push_back(value >> (8 * i));
+  }
+}
+
+void AppendUint64(vector<uint8_t>* code, uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    code->push_back(value >> (8 * i));
+  }
+}
+
+// 64 bit code reached by a far jump from a trampoline, with the guest's esp
+// pointing at the ordinal. Switches to the host stack without touching
+// rflags, builds an EntryFrame there, calls Dispatch and irets back to the
+// 32 bit guest.
+vector<uint8_t> EntryStub(uint64_t stub_addr, uint64_t host_stack_top_addr) {
+  vector<uint8_t> code;
+  Append(&code, {0x41, 0x89, 0xe3}); // mov r11d, esp
+  Append(&code, {0x48, 0x8b, 0x25}); // mov rsp, [rip + disp32]
+  AppendUint32(&code, host_stack_top_addr - (stub_addr + code.size() + 4));
+  Append(&code, {0x48, 0x8d, 0x64, 0x24, 0xe8}); // lea rsp, [rsp - 24]
+  Append(&code, {0x9c}); // pushfq
+  Append(&code, {0x48, 0x8d, 0x64, 0x24, 0xf0}); // lea rsp, [rsp - 16]
+  // push r11, rdi, rsi, rbp, rbx, rdx, rcx, rax
+  Append(&code, {0x41, 0x53, 0x57, 0x56, 0x55, 0x53, 0x52, 0x51, 0x50});
+  Append(&code, {0x48, 0x89, 0xe7}); // mov rdi, rsp
+  Append(&code, {0x48, 0xb8}); // movabs rax, imm64
+  AppendUint64(&code, reinterpret_cast<uint64_t>(&Dispatch));
+  Append(&code, {0xff, 0xd0}); // call rax
+  // pop rax, rcx, rdx, rbx, rbp, rsi, rdi, r11
+  Append(&code, {0x58, 0x59, 0x5a, 0x5b, 0x5d, 0x5e, 0x5f, 0x41, 0x5b});
+  Append(&code, {0x48, 0xcf}); // iretq
+  return code;
+}
+
+// 32 bit code the thunk slot of a function points at.
+vector<uint8_t> Trampoline(uint32_t ordinal, uint32_t far_pointer_addr) {
+  vector<uint8_t> code;
+  code.push_back(0x68); // push imm32
+  AppendUint32(&code, ordinal);
+  Append(&code, {0xff, 0x2d}); // jmp far [disp32]
+  AppendUint32(&code, far_pointer_addr);
+  code.resize(kTrampolineSize, 0xcc); // int3
+  return code;
+}
+
+ErrorOr<uint64_t> MapLow(size_t size) {
+  void* addr = mmap(nullptr,
+                    size,
+                    PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT,
+                    -1,
+                    0);
+  RETURN_ERROR_IF(addr == MAP_FAILED,
+                  string("Could not map kernel call area: ") + strerror(errno));
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+  uint64_t low_addr = reinterpret_cast<uint64_t>(addr);
+  return ErrorOr<uint64_t>(std::move(low_addr));
+}
+
+// Replaces the pages holding [begin, end) with private, writable copies.
+Error MakePrivateCopy(uint64_t begin, uint64_t end) {
+  vector<char> page(kXbePageSize);
+  for (uint64_t addr = begin & ~static_cast<uint64_t>(kXbePageSize - 1);
+       addr < end;
+       addr += kXbePageSize) {
+    memcpy(page.data(), reinterpret_cast<const void*>(addr), kXbePageSize);
+    void* copy = mmap(reinterpret_cast<void*>(addr),
+                      kXbePageSize,
+                      PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED,
+                      -1,
+                      0);
+    RETURN_ERROR_IF(copy == MAP_FAILED,
+                    string("Could not copy kernel thunk table: ")
+                        + strerror(errno));
+    memcpy(copy, page.data(), kXbePageSize);
+    IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+  }
+  return Error::Ok();
+}
+
+Error Protect(const XbeImage& xbe, uint64_t begin, uint64_t end) {
+  for (uint64_t addr = begin & ~static_cast<uint64_t>(kXbePageSize - 1);
+       addr < end;
+       addr += kXbePageSize) {
+    RETURN_ERROR_SYSCALL(mprotect(reinterpret_cast<void*>(addr),
+                                  kXbePageSize,
+                                  PageProtFor(xbe, addr)),
+                         "Could not protect kernel thunk table.");
+    IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+  }
+  return Error::Ok();
+}
+
+void Unimplemented(KernelCall* call) {
+  const KernelExport* kernel_export = KernelExportByOrdinal(call->ordinal);
+  fprintf(stderr,
+          "Unimplemented kernel call %u (%s)\n",
+          call->ordinal,
+          kernel_export != nullptr ? kernel_export->name : "not exported");
+  raise(SIGSYS);
+}
+
+// DbgPrint(format, ...): the format string, unformatted.
+void DbgPrint(KernelCall* call) {
+  fputs(call->ArgPointer<const char>(0), stderr);
+  call->eax = 0; // STATUS_SUCCESS
+}
+
+// HalReturnToFirmware(routine): the title is done.
+void HalReturnToFirmware(KernelCall*) {
+  _exit(0);
+}
+
+// RtlCompareMemory(source1, source2, length): the length of the common
+// prefix.
+void RtlCompareMemory(KernelCall* call) {
+  const char* source1 = call->ArgPointer<const char>(0);
+  const char* source2 = call->ArgPointer<const char>(1);
+  uint32_t equal = 0;
+  while (equal < call->Arg(2) && source1[equal] == source2[equal]) {
+    equal++;
+  }
+  call->eax = equal;
+}
+
+// RtlFillMemory(destination, length, fill).
+void RtlFillMemory(KernelCall* call) {
+  memset(call->ArgPointer<void>(0), call->Arg(2) & 0xff, call->Arg(1));
+}
+
+// RtlZeroMemory(destination, length).
+void RtlZeroMemory(KernelCall* call) {
+  memset(call->ArgPointer<void>(0), 0, call->Arg(1));
+}
+} // namespace
+
+ErrorOr<KernelCallCounts*> MapKernelCallCounts() {
+  void* counts = mmap(nullptr,
+                      sizeof(KernelCallCounts),
+                      PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS,
+                      -1,
+                      0);
+  RETURN_ERROR_IF(counts == MAP_FAILED,
+                  string("Could not map kernel call counts: ")
+                      + strerror(errno));
+  KernelCallCounts* kernel_call_counts =
+      static_cast<KernelCallCounts*>(counts);
+  return ErrorOr<KernelCallCounts*>(std::move(kernel_call_counts));
+}
+
+KernelCallHandler KernelCallHandlerFor(uint32_t ordinal) {
+  switch (ordinal) {
+    case 8:
+      return &DbgPrint;
+    case 49:
+      return &HalReturnToFirmware;
+    case 268:
+      return &RtlCompareMemory;
+    case 284:
+      return &RtlFillMemory;
+    case 320:
+      return &RtlZeroMemory;
+    default:
+      return &Unimplemented;
+  }
+}
+
+Error InstallKernelCalls(const XbeImage& xbe, KernelCallCounts* counts) {
+  Span span("InstallKernelCalls");
+  ErrorOr<vector<KernelImport>> error_or_imports = DecodeKernelThunks(xbe);
+  PASS_ERROR(error_or_imports.error());
+  const vector<KernelImport>& imports = error_or_imports.get();
+  for (const KernelImport& kernel_import : imports) {
+    RETURN_ERROR_IF(kernel_import.ordinal > kMaxKernelOrdinal,
+                    "Kernel ordinal " + std::to_string(kernel_import.ordinal)
+                        + " is out of range.");
+  }
+
+  for (uint32_t ordinal = 0; ordinal <= kMaxKernelOrdinal; ordinal++) {
+    g_handlers[ordinal] = KernelCallHandlerFor(ordinal);
+  }
+  g_counts = counts;
+
+  void* host_stack = mmap(nullptr,
+                          kHostStackSize,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK,
+                          -1,
+                          0);
+  RETURN_ERROR_IF(host_stack == MAP_FAILED,
+                  string("Could not map kernel call stack: ")
+                      + strerror(errno));
+  ErrorOr<uint64_t> error_or_code = MapLow(kCodeAreaSize);
+  PASS_ERROR(error_or_code.error());
+  const uint64_t code_addr = error_or_code.get();
+  ErrorOr<uint64_t> error_or_variables =
+      MapLow((kMaxKernelOrdinal + 1) * kKernelVariableSize);
+  PASS_ERROR(error_or_variables.error());
+  const uint64_t variables_addr = error_or_variables.get();
+
+  char* code = reinterpret_cast<char*>(code_addr);
+  const uint32_t entry_addr = code_addr + kEntryOffset;
+  memcpy(code + kFarPointerOffset, &entry_addr, sizeof(entry_addr));
+  memcpy(code + kFarPointerOffset + sizeof(entry_addr),
+         &kUser64CodeSelector,
+         sizeof(kUser64CodeSelector));
+  const uint64_t host_stack_top =
+      reinterpret_cast<uint64_t>(host_stack) + kHostStackSize;
+  memcpy(code + kHostStackTopOffset, &host_stack_top, sizeof(host_stack_top));
+  const vector<uint8_t> entry_stub =
+      EntryStub(entry_addr, code_addr + kHostStackTopOffset);
+  RETURN_ERROR_IF(kEntryOffset + entry_stub.size() > kTrampolinesOffset,
+                  "Kernel call entry stub is too big.");
+  memcpy(code + kEntryOffset, entry_stub.data(), entry_stub.size());
+  for (uint32_t ordinal = 0; ordinal <= kMaxKernelOrdinal; ordinal++) {
+    const vector<uint8_t> trampoline =
+        Trampoline(ordinal, code_addr + kFarPointerOffset);
+    memcpy(code + kTrampolinesOffset + ordinal * kTrampolineSize,
+           trampoline.data(),
+           trampoline.size());
+  }
+  RETURN_ERROR_SYSCALL(
+      mprotect(code, kCodeAreaSize, PROT_READ | PROT_EXEC),
+      "Could not protect kernel call trampolines.");
+
+  if (imports.empty()) {
+    return Error::Ok();
+  }
+  const uint64_t table_begin = imports.front().thunk_mem_addr;
+  const uint64_t table_end = imports.back().thunk_mem_addr + sizeof(uint32_t);
+  PASS_ERROR(MakePrivateCopy(table_begin, table_end));
+  for (const KernelImport& kernel_import : imports) {
+    const bool variable =
+        kernel_import.kernel_export != nullptr
+        && kernel_import.kernel_export->kind == KernelExportKind::VARIABLE;
+    const uint32_t target = variable
+        ? variables_addr + kernel_import.ordinal * kKernelVariableSize
+        : code_addr + kTrampolinesOffset
+            + kernel_import.ordinal * kTrampolineSize;
+    memcpy(reinterpret_cast<void*>(kernel_import.thunk_mem_addr),
+           &target,
+           sizeof(target));
+  }
+  PASS_ERROR(Protect(xbe, table_begin, table_end));
+  span.set_bytes(imports.size() * sizeof(uint32_t));
+  return Error::Ok();
+}
+
+} // namespace xbe
+} // namespace exec
@@ -0,0 +1,65 @@
+#ifndef EXEC_XBE_KERNEL_CALLS_H_
+#define EXEC_XBE_KERNEL_CALLS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "cc/exec/xbe/kernel_exports.h"
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace xbe {
+
+// Calls per kernel ordinal, kept in memory shared between the loaded process,
+// which counts, and the tracer that forked it, which reads the counts even
+// after the process is gone.
+struct KernelCallCounts {
+  uint64_t calls[kMaxKernelOrdinal + 1];
+};
+
+// Maps zeroed counts shared with children forked afterwards.
+utils::ErrorOr<KernelCallCounts*> MapKernelCallCounts();
+
+// A kernel call in progress, as seen by its host implementation: the guest's
+// registers when it made the call and its arguments on the guest stack.
+struct KernelCall {
+  uint32_t ordinal;
+  // In: the guest's registers. Out: eax (and edx, for 64 bit results) is
+  // what the call returns; the handler may change any other register the
+  // calling convention lets the callee clobber.
+  uint32_t eax;
+  uint32_t ecx;
+  uint32_t edx;
+  const uint32_t* args;
+
+  uint32_t Arg(size_t i) const { return args[i]; }
+  template <typename T>
+  T* ArgPointer(size_t i) const {
+    return reinterpret_cast<T*>(static_cast<uintptr_t>(args[i]));
+  }
+};
+
+// Host implementation of a kernel function. The arguments it pops on return
+// are popped for it, as kKernelExports has them.
+typedef void (*KernelCallHandler)(KernelCall* call);
+
+// The handler kernel calls to ordinal dispatch to; one that reports the call
+// and raises SIGSYS for ordinals without a host implementation.
+KernelCallHandler KernelCallHandlerFor(uint32_t ordinal);
+
+// Points every slot of the XBE's kernel thunk table, in the calling process,
+// at host code: functions at a trampoline that switches the guest from 32 bit
+// compatibility mode to 64 bit mode, calls the ordinal's KernelCallHandler
+// through a flat table indexed by ordinal on a host stack, and switches
+// back, all without leaving the process; variables at zeroed storage of
+// their own. Each call adds one to counts (if not nullptr) for its ordinal.
+//
+// Meant for a process that LoadXbe (or LoadXbeOnDemand, with its pager
+// running, or LoadXbeShared) just loaded xbe into. The thunk table's pages
+// are replaced by private copies, so a shared image is left alone.
+utils::Error InstallKernelCalls(const XbeImage& xbe, KernelCallCounts* counts);
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_KERNEL_CALLS_H_
@@ -0,0 +1,456 @@
+#include "cc/exec/xbe/kernel_exports.h"
+
+namespace exec {
+namespace xbe {
+namespace {
+constexpr KernelExport Stdcall(uint32_t ordinal,
+                               const char* name,
+                               uint32_t stack_bytes) {
+  return {ordinal,
+          name,
+          KernelExportKind::FUNCTION,
+          CallingConvention::STDCALL,
+          stack_bytes};
+}
+
+constexpr KernelExport Fastcall(uint32_t ordinal,
+                                const char* name,
+                                uint32_t stack_bytes) {
+  return {ordinal,
+          name,
+          KernelExportKind::FUNCTION,
+          CallingConvention::FASTCALL,
+          stack_bytes};
+}
+
+constexpr KernelExport Cdecl(uint32_t ordinal,
+                             const char* name,
+                             uint32_t stack_bytes) {
+  return {ordinal,
+          name,
+          KernelExportKind::FUNCTION,
+          CallingConvention::CDECL,
+          stack_bytes};
+}
+
+constexpr KernelExport Variable(uint32_t ordinal, const char* name) {
+  return {ordinal, name, KernelExportKind::VARIABLE, CallingConvention::NONE,
+          0};
+}
+
+constexpr KernelExport Unused(uint32_t ordinal) {
+  return {ordinal, nullptr, KernelExportKind::NONE, CallingConvention::NONE,
+          0};
+}
+} // namespace
+
+extern constexpr KernelExport kKernelExports[kMaxKernelOrdinal + 1] = {
+  Unused(0),
+  Stdcall(1, "AvGetSavedDataAddress", 0),
+  Stdcall(2, "AvSendTVEncoderOption", 16),
+  Stdcall(3, "AvSetDisplayMode", 24),
+  Stdcall(4, "AvSetSavedDataAddress", 4),
+  Stdcall(5, "DbgBreakPoint", 0),
+  Stdcall(6, "DbgBreakPointWithStatus", 4),
+  Stdcall(7, "DbgLoadImageSymbols", 12),
+  Cdecl(8, "DbgPrint", 4),
+  Stdcall(9, "HalReadSMCTrayState", 8),
+  Stdcall(10, "DbgPrompt", 12),
+  Stdcall(11, "DbgUnLoadImageSymbols", 12),
+  Stdcall(12, "ExAcquireReadWriteLockExclusive", 4),
+  Stdcall(13, "ExAcquireReadWriteLockShared", 4),
+  Stdcall(14, "ExAllocatePool", 4),
+  Stdcall(15, "ExAllocatePoolWithTag", 8),
+  Variable(16, "ExEventObjectType"),
+  Stdcall(17, "ExFreePool", 4),
+  Stdcall(18, "ExInitializeReadWriteLock", 4),
+  Stdcall(19, "ExInterlockedAddLargeInteger", 12),
+  Fastcall(20, "ExInterlockedAddLargeStatistic", 0),
+  Fastcall(21, "ExInterlockedCompareExchange64", 4),
+  Variable(22, "ExMutantObjectType"),
+  Stdcall(23, "ExQueryPoolBlockSize", 4),
+  Stdcall(24, "ExQueryNonVolatileSetting", 20),
+  Stdcall(25, "ExReadWriteRefurbInfo", 12),
+  Stdcall(26, "ExRaiseException", 4),
+  Stdcall(27, "ExRaiseStatus", 4),
+  Stdcall(28, "ExReleaseReadWriteLock", 4),
+  Stdcall(29, "ExSaveNonVolatileSetting", 16),
+  Variable(30, "ExSemaphoreObjectType"),
+  Variable(31, "ExTimerObjectType"),
+  Fastcall(32, "ExfInterlockedInsertHeadList", 0),
+  Fastcall(33, "ExfInterlockedInsertTailList", 0),
+  Fastcall(34, "ExfInterlockedRemoveHeadList", 0),
+  Stdcall(35, "FscGetCacheSize", 0),
+  Stdcall(36, "FscInvalidateIdleBlocks", 0),
+  Stdcall(37, "FscSetCacheSize", 4),
+  Fastcall(38, "HalClearSoftwareInterrupt", 0),
+  Stdcall(39, "HalDisableSystemInterrupt", 4),
+  Variable(40, "HalDiskCachePartitionCount"),
+  Variable(41, "HalDiskModelNumber"),
+  Variable(42, "HalDiskSerialNumber"),
+  Stdcall(43, "HalEnableSystemInterrupt", 8),
+  Stdcall(44, "HalGetInterruptVector", 8),
+  Stdcall(45, "HalReadSMBusValue", 16),
+  Stdcall(46, "HalReadWritePCISpace", 24),
+  Stdcall(47, "HalRegisterShutdownNotification", 8),
+  Fastcall(48, "HalRequestSoftwareInterrupt", 0),
+  Stdcall(49, "HalReturnToFirmware", 4),
+  Stdcall(50, "HalWriteSMBusValue", 16),
+  Fastcall(51, "InterlockedCompareExchange", 4),
+  Fastcall(52, "InterlockedDecrement", 0),
+  Fastcall(53, "InterlockedIncrement", 0),
+  Fastcall(54, "InterlockedExchange", 0),
+  Fastcall(55, "InterlockedExchangeAdd", 0),
+  Fastcall(56, "InterlockedFlushSList", 0),
+  Fastcall(57, "InterlockedPopEntrySList", 0),
+  Fastcall(58, "InterlockedPushEntrySList", 0),
+  Stdcall(59, "IoAllocateIrp", 4),
+  Stdcall(60, "IoBuildAsynchronousFsdRequest", 24),
+  Stdcall(61, "IoBuildDeviceIoControlRequest", 36),
+  Stdcall(62, "IoBuildSynchronousFsdRequest", 28),
+  Stdcall(63, "IoCheckShareAccess", 20),
+  Variable(64, "IoCompletionObjectType"),
+  Stdcall(65, "IoCreateDevice", 24),
+  Stdcall(66, "IoCreateFile", 40),
+  Stdcall(67, "IoCreateSymbolicLink", 8),
+  Stdcall(68, "IoDeleteDevice", 4),
+  Stdcall(69, "IoDeleteSymbolicLink", 4),
+  Variable(70, "IoDeviceObjectType"),
+  Variable(71, "IoFileObjectType"),
+  Stdcall(72, "IoFreeIrp", 4),
+  Stdcall(73, "IoInitializeIrp", 12),
+  Stdcall(74, "IoInvalidDeviceRequest", 8),
+  Stdcall(75, "IoQueryFileInformation", 20),
+  Stdcall(76, "IoQueryVolumeInformation", 20),
+  Stdcall(77, "IoQueueThreadIrp", 4),
+  Stdcall(78, "IoRemoveShareAccess", 8),
+  Stdcall(79, "IoSetIoCompletion", 20),
+  Stdcall(80, "IoSetShareAccess", 16),
+  Stdcall(81, "IoStartNextPacket", 4),
+  Stdcall(82, "IoStartNextPacketByKey", 8),
+  Stdcall(83, "IoStartPacket", 12),
+  Stdcall(84, "IoSynchronousDeviceIoControlRequest", 32),
+  Stdcall(85, "IoSynchronousFsdRequest", 20),
+  Fastcall(86, "IofCallDriver", 0),
+  Fastcall(87, "IofCompleteRequest", 0),
+  Variable(88, "KdDebuggerEnabled"),
+  Variable(89, "KdDebuggerNotPresent"),
+  Stdcall(90, "IoDismountVolume", 4),
+  Stdcall(91, "IoDismountVolumeByName", 4),
+  Stdcall(92, "KeAlertResumeThread", 4),
+  Stdcall(93, "KeAlertThread", 8),
+  Stdcall(94, "KeBoostPriorityThread", 8),
+  Stdcall(95, "KeBugCheck", 4),
+  Stdcall(96, "KeBugCheckEx", 20),
+  Stdcall(97, "KeCancelTimer", 4),
+  Stdcall(98, "KeConnectInterrupt", 4),
+  Stdcall(99, "KeDelayExecutionThread", 12),
+  Stdcall(100, "KeDisconnectInterrupt", 4),
+  Stdcall(101, "KeEnterCriticalRegion", 0),
+  Variable(102, "MmGlobalData"),
+  Stdcall(103, "KeGetCurrentIrql", 0),
+  Stdcall(104, "KeGetCurrentThread", 0),
+  Stdcall(105, "KeInitializeApc", 28),
+  Stdcall(106, "KeInitializeDeviceQueue", 4),
+  Stdcall(107, "KeInitializeDpc", 12),
+  Stdcall(108, "KeInitializeEvent", 12),
+  Stdcall(109, "KeInitializeInterrupt", 28),
+  Stdcall(110, "KeInitializeMutant", 8),
+  Stdcall(111, "KeInitializeQueue", 8),
+  Stdcall(112, "KeInitializeSemaphore", 12),
+  Stdcall(113, "KeInitializeTimerEx", 8),
+  Stdcall(114, "KeInsertByKeyDeviceQueue", 12),
+  Stdcall(115, "KeInsertDeviceQueue", 8),
+  Stdcall(116, "KeInsertHeadQueue", 8),
+  Stdcall(117, "KeInsertQueue", 8),
+  Stdcall(118, "KeInsertQueueApc", 16),
+  Stdcall(119, "KeInsertQueueDpc", 12),
+  Variable(120, "KeInterruptTime"),
+  Stdcall(121, "KeIsExecutingDpc", 0),
+  Stdcall(122, "KeLeaveCriticalRegion", 0),
+  Stdcall(123, "KePulseEvent", 12),
+  Stdcall(124, "KeQueryBasePriorityThread", 4),
+  Stdcall(125, "KeQueryInterruptTime", 0),
+  Stdcall(126, "KeQueryPerformanceCounter", 0),
+  Stdcall(127, "KeQueryPerformanceFrequency", 0),
+  Stdcall(128, "KeQuerySystemTime", 4),
+  Stdcall(129, "KeRaiseIrqlToDpcLevel", 0),
+  Stdcall(130, "KeRaiseIrqlToSynchLevel", 0),
+  Stdcall(131, "KeReleaseMutant", 16),
+  Stdcall(132, "KeReleaseSemaphore", 16),
+  Stdcall(133, "KeRemoveByKeyDeviceQueue", 8),
+  Stdcall(134, "KeRemoveDeviceQueue", 4),
+  Stdcall(135, "KeRemoveEntryDeviceQueue", 8),
+  Stdcall(136, "KeRemoveQueue", 12),
+  Stdcall(137, "KeRemoveQueueDpc", 4),
+  Stdcall(138, "KeResetEvent", 4),
+  Stdcall(139, "KeRestoreFloatingPointState", 4),
+  Stdcall(140, "KeResumeThread", 4),
+  Stdcall(141, "KeRundownQueue", 4),
+  Stdcall(142, "KeSaveFloatingPointState", 4),
+  Stdcall(143, "KeSetBasePriorityThread", 8),
+  Stdcall(144, "KeSetDisableBoostThread", 8),
+  Stdcall(145, "KeSetEvent", 12),
+  Stdcall(146, "KeSetEventBoostPriority", 8),
+  Stdcall(147, "KeSetPriorityProcess", 8),
+  Stdcall(148, "KeSetPriorityThread", 8),
+  Stdcall(149, "KeSetTimer", 16),
+  Stdcall(150, "KeSetTimerEx", 20),
+  Stdcall(151, "KeStallExecutionProcessor", 4),
+  Stdcall(152, "KeSuspendThread", 4),
+  Stdcall(153, "KeSynchronizeExecution", 12),
+  Variable(154, "KeSystemTime"),
+  Stdcall(155, "KeTestAlertThread", 4),
+  Variable(156, "KeTickCount"),
+  Variable(157, "KeTimeIncrement"),
+  Stdcall(158, "KeWaitForMultipleObjects", 32),
+  Stdcall(159, "KeWaitForSingleObject", 20),
+  Fastcall(160, "KfRaiseIrql", 0),
+  Fastcall(161, "KfLowerIrql", 0),
+  Variable(162, "KiBugCheckData"),
+  Fastcall(163, "KiUnlockDispatcherDatabase", 0),
+  Variable(164, "LaunchDataPage"),
+  Stdcall(165, "MmAllocateContiguousMemory", 4),
+  Stdcall(166, "MmAllocateContiguousMemoryEx", 20),
+  Stdcall(167, "MmAllocateSystemMemory", 8),
+  Stdcall(168, "MmClaimGpuInstanceMemory", 8),
+  Stdcall(169, "MmCreateKernelStack", 8),
+  Stdcall(170, "MmDeleteKernelStack", 8),
+  Stdcall(171, "MmFreeContiguousMemory", 4),
+  Stdcall(172, "MmFreeSystemMemory", 8),
+  Stdcall(173, "MmGetPhysicalAddress", 4),
+  Stdcall(174, "MmIsAddressValid", 4),
+  Stdcall(175, "MmLockUnlockBufferPages", 12),
+  Stdcall(176, "MmLockUnlockPhysicalPage", 8),
+  Stdcall(177, "MmMapIoSpace", 12),
+  Stdcall(178, "MmPersistContiguousMemory", 12),
+  Stdcall(179, "MmQueryAddressProtect", 4),
+  Stdcall(180, "MmQueryAllocationSize", 4),
+  Stdcall(181, "MmQueryStatistics", 4),
+  Stdcall(182, "MmSetAddressProtect", 12),
+  Stdcall(183, "MmUnmapIoSpace", 8),
+  Stdcall(184, "NtAllocateVirtualMemory", 20),
+  Stdcall(185, "NtCancelTimer", 8),
+  Stdcall(186, "NtClearEvent", 4),
+  Stdcall(187, "NtClose", 4),
+  Stdcall(188, "NtCreateDirectoryObject", 8),
+  Stdcall(189, "NtCreateEvent", 16),
+  Stdcall(190, "NtCreateFile", 36),
+  Stdcall(191, "NtCreateIoCompletion", 16),
+  Stdcall(192, "NtCreateMutant", 12),
+  Stdcall(193, "NtCreateSemaphore", 16),
+  Stdcall(194, "NtCreateTimer", 12),
+  Stdcall(195, "NtDeleteFile", 4),
+  Stdcall(196, "NtDeviceIoControlFile", 40),
+  Stdcall(197, "NtDuplicateObject", 12),
+  Stdcall(198, "NtFlushBuffersFile", 8),
+  Stdcall(199, "NtFreeVirtualMemory", 12),
+  Stdcall(200, "NtFsControlFile", 40),
+  Stdcall(201, "NtOpenDirectoryObject", 8),
+  Stdcall(202, "NtOpenFile", 24),
+  Stdcall(203, "NtOpenSymbolicLinkObject", 8),
+  Stdcall(204, "NtProtectVirtualMemory", 16),
+  Stdcall(205, "NtPulseEvent", 8),
+  Stdcall(206, "NtQueueApcThread", 20),
+  Stdcall(207, "NtQueryDirectoryFile", 40),
+  Stdcall(208, "NtQueryDirectoryObject", 24),
+  Stdcall(209, "NtQueryEvent", 8),
+  Stdcall(210, "NtQueryFullAttributesFile", 8),
+  Stdcall(211, "NtQueryInformationFile", 20),
+  Stdcall(212, "NtQueryIoCompletion", 8),
+  Stdcall(213, "NtQueryMutant", 8),
+  Stdcall(214, "NtQuerySemaphore", 8),
+  Stdcall(215, "NtQuerySymbolicLinkObject", 12),
+  Stdcall(216, "NtQueryTimer", 8),
+  Stdcall(217, "NtQueryVirtualMemory", 8),
+  Stdcall(218, "NtQueryVolumeInformationFile", 20),
+  Stdcall(219, "NtReadFile", 32),
+  Stdcall(220, "NtReadFileScatter", 32),
+  Stdcall(221, "NtReleaseMutant", 8),
+  Stdcall(222, "NtReleaseSemaphore", 12),
+  Stdcall(223, "NtRemoveIoCompletion", 20),
+  Stdcall(224, "NtResumeThread", 8),
+  Stdcall(225, "NtSetEvent", 8),
+  Stdcall(226, "NtSetInformationFile", 20),
+  Stdcall(227, "NtSetIoCompletion", 20),
+  Stdcall(228, "NtSetSystemTime", 8),
+  Stdcall(229, "NtSetTimerEx", 32),
+  Stdcall(230, "NtSignalAndWaitForSingleObjectEx", 20),
+  Stdcall(231, "NtSuspendThread", 8),
+  Stdcall(232, "NtUserIoApcDispatcher", 12),
+  Stdcall(233, "NtWaitForSingleObject", 12),
+  Stdcall(234, "NtWaitForSingleObjectEx", 16),
+  Stdcall(235, "NtWaitForMultipleObjectsEx", 24),
+  Stdcall(236, "NtWriteFile", 32),
+  Stdcall(237, "NtWriteFileGather", 32),
+  Stdcall(238, "NtYieldExecution", 0),
+  Stdcall(239, "ObCreateObject", 16),
+  Variable(240, "ObDirectoryObjectType"),
+  Stdcall(241, "ObInsertObject", 16),
+  Stdcall(242, "ObMakeTemporaryObject", 4),
+  Stdcall(243, "ObOpenObjectByName", 16),
+  Stdcall(244, "ObOpenObjectByPointer", 12),
+  Variable(245, "ObpObjectHandleTable"),
+  Stdcall(246, "ObReferenceObjectByHandle", 12),
+  Stdcall(247, "ObReferenceObjectByName", 20),
+  Stdcall(248, "ObReferenceObjectByPointer", 8),
+  Variable(249, "ObSymbolicLinkObjectType"),
+  Fastcall(250, "ObfDereferenceObject", 0),
+  Fastcall(251, "ObfReferenceObject", 0),
+  Stdcall(252, "PhyGetLinkState", 4),
+  Stdcall(253, "PhyInitialize", 8),
+  Stdcall(254, "PsCreateSystemThread", 20),
+  Stdcall(255, "PsCreateSystemThreadEx", 40),
+  Stdcall(256, "PsQueryStatistics", 4),
+  Stdcall(257, "PsSetCreateThreadNotifyRoutine", 4),
+  Stdcall(258, "PsTerminateSystemThread", 4),
+  Variable(259, "PsThreadObjectType"),
+  Stdcall(260, "RtlAnsiStringToUnicodeString", 12),
+  Stdcall(261, "RtlAppendStringToString", 8),
+  Stdcall(262, "RtlAppendUnicodeStringToString", 8),
+  Stdcall(263, "RtlAppendUnicodeToString", 8),
+  Stdcall(264, "RtlAssert", 16),
+  Stdcall(265, "RtlCaptureContext", 4),
+  Stdcall(266, "RtlCaptureStackBackTrace", 16),
+  Stdcall(267, "RtlCharToInteger", 12),
+  Stdcall(268, "RtlCompareMemory", 12),
+  Stdcall(269, "RtlCompareMemoryUlong", 12),
+  Stdcall(270, "RtlCompareString", 12),
+  Stdcall(271, "RtlCompareUnicodeString", 12),
+  Stdcall(272, "RtlCopyString", 8),
+  Stdcall(273, "RtlCopyUnicodeString", 8),
+  Stdcall(274, "RtlCreateUnicodeString", 8),
+  Stdcall(275, "RtlDowncaseUnicodeChar", 4),
+  Stdcall(276, "RtlDowncaseUnicodeString", 12),
+  Stdcall(277, "RtlEnterCriticalSection", 4),
+  Stdcall(278, "RtlEnterCriticalSectionAndRegion", 4),
+  Stdcall(279, "RtlEqualString", 12),
+  Stdcall(280, "RtlEqualUnicodeString", 12),
+  Stdcall(281, "RtlExtendedIntegerMultiply", 12),
+  Stdcall(282, "RtlExtendedLargeIntegerDivide", 16),
+  Stdcall(283, "RtlExtendedMagicDivide", 20),
+  Stdcall(284, "RtlFillMemory", 12),
+  Stdcall(285, "RtlFillMemoryUlong", 12),
+  Stdcall(286, "RtlFreeAnsiString", 4),
+  Stdcall(287, "RtlFreeUnicodeString", 4),
+  Stdcall(288, "RtlGetCallersAddress", 8),
+  Stdcall(289, "RtlInitAnsiString", 8),
+  Stdcall(290, "RtlInitUnicodeString", 8),
+  Stdcall(291, "RtlInitializeCriticalSection", 4),
+  Stdcall(292, "RtlIntegerToChar", 16),
+  Stdcall(293, "RtlIntegerToUnicodeString", 12),
+  Stdcall(294, "RtlLeaveCriticalSection", 4),
+  Stdcall(295, "RtlLeaveCriticalSectionAndRegion", 4),
+  Stdcall(296, "RtlLowerChar", 4),
+  Stdcall(297, "RtlMapGenericMask", 8),
+  Stdcall(298, "RtlMoveMemory", 12),
+  Stdcall(299, "RtlMultiByteToUnicodeN", 20),
+  Stdcall(300, "RtlMultiByteToUnicodeSize", 12),
+  Stdcall(301, "RtlNtStatusToDosError", 4),
+  Stdcall(302, "RtlRaiseException", 4),
+  Stdcall(303, "RtlRaiseStatus", 4),
+  Stdcall(304, "RtlTimeFieldsToTime", 8),
+  Stdcall(305, "RtlTimeToTimeFields", 8),
+  Stdcall(306, "RtlTryEnterCriticalSection", 4),
+  Fastcall(307, "RtlUlongByteSwap", 0),
+  Stdcall(308, "RtlUnicodeStringToAnsiString", 12),
+  Stdcall(309, "RtlUnicodeStringToInteger", 12),
+  Stdcall(310, "RtlUnicodeToMultiByteN", 20),
+  Stdcall(311, "RtlUnicodeToMultiByteSize", 12),
+  Stdcall(312, "RtlUnwind", 16),
+  Stdcall(313, "RtlUpcaseUnicodeChar", 4),
+  Stdcall(314, "RtlUpcaseUnicodeString", 12),
+  Stdcall(315, "RtlUpcaseUnicodeToMultiByteN", 20),
+  Stdcall(316, "RtlUpperChar", 4),
+  Stdcall(317, "RtlUpperString", 8),
+  Fastcall(318, "RtlUshortByteSwap", 0),
+  Stdcall(319, "RtlWalkFrameChain", 12),
+  Stdcall(320, "RtlZeroMemory", 8),
+  Variable(321, "XboxEEPROMKey"),
+  Variable(322, "XboxHardwareInfo"),
+  Variable(323, "XboxHDKey"),
+  Variable(324, "XboxKrnlVersion"),
+  Variable(325, "XboxSignatureKey"),
+  Variable(326, "XeImageFileName"),
+  Stdcall(327, "XeLoadSection", 4),
+  Stdcall(328, "XeUnloadSection", 4),
+  Stdcall(329, "READ_PORT_BUFFER_UCHAR", 12),
+  Stdcall(330, "READ_PORT_BUFFER_USHORT", 12),
+  Stdcall(331, "READ_PORT_BUFFER_ULONG", 12),
+  Stdcall(332, "WRITE_PORT_BUFFER_UCHAR", 12),
+  Stdcall(333, "WRITE_PORT_BUFFER_USHORT", 12),
+  Stdcall(334, "WRITE_PORT_BUFFER_ULONG", 12),
+  Stdcall(335, "XcSHAInit", 4),
+  Stdcall(336, "XcSHAUpdate", 12),
+  Stdcall(337, "XcSHAFinal", 8),
+  Stdcall(338, "XcRC4Key", 12),
+  Stdcall(339, "XcRC4Crypt", 12),
+  Stdcall(340, "XcHMAC", 28),
+  Stdcall(341, "XcPKEncPublic", 12),
+  Stdcall(342, "XcPKDecPrivate", 12),
+  Stdcall(343, "XcPKGetKeyLen", 4),
+  Stdcall(344, "XcVerifyPKCS1Signature", 12),
+  Stdcall(345, "XcModExp", 20),
+  Stdcall(346, "XcDESKeyParity", 8),
+  Stdcall(347, "XcKeyTable", 12),
+  Stdcall(348, "XcBlockCrypt", 20),
+  Stdcall(349, "XcBlockCryptCBC", 28),
+  Stdcall(350, "XcCryptService", 8),
+  Stdcall(351, "XcUpdateCrypto", 8),
+  Stdcall(352, "RtlRip", 12),
+  Variable(353, "XboxLANKey"),
+  Variable(354, "XboxAlternateSignatureKeys"),
+  Variable(355, "XePublicKeyData"),
+  Variable(356, "HalBootSMCVideoMode"),
+  Variable(357, "IdexChannelObject"),
+  Stdcall(358, "HalIsResetOrShutdownPending", 0),
+  Stdcall(359, "IoMarkIrpMustComplete", 4),
+  Stdcall(360, "HalInitiateShutdown", 0),
+  Cdecl(361, "RtlSnprintf", 12),
+  Cdecl(362, "RtlSprintf", 8),
+  Cdecl(363, "RtlVsnprintf", 16),
+  Cdecl(364, "RtlVsprintf", 12),
+  Stdcall(365, "HalEnableSecureTrayEject", 0),
+  Stdcall(366, "HalWriteSMCScratchRegister", 4),
+  Unused(367),
+  Unused(368),
+  Unused(369),
+  Unused(370),
+  Unused(371),
+  Unused(372),
+  Unused(373),
+  Stdcall(374, "MmDbgAllocateMemory", 8),
+  Stdcall(375, "MmDbgFreeMemory", 8),
+  Stdcall(376, "MmDbgQueryAvailablePages", 0),
+  Stdcall(377, "MmDbgReleaseAddress", 8),
+  Stdcall(378, "MmDbgWriteCheck", 8)
+};
+
+namespace {
+// Lookup is a plain index, so a misplaced row would silently resolve the
+// wrong name.
+constexpr bool OrdinalsMatchIndexes(uint32_t index) {
+  return index > kMaxKernelOrdinal
+      || (kKernelExports[index].ordinal == index
+          && OrdinalsMatchIndexes(index + 1));
+}
+static_assert(OrdinalsMatchIndexes(0),
+              "kKernelExports must be indexed by ordinal.");
+} // namespace
+
+const char* ToString(CallingConvention calling_convention) {
+  switch (calling_convention) {
+    case CallingConvention::NONE:
+      return "none";
+    case CallingConvention::STDCALL:
+      return "stdcall";
+    case CallingConvention::FASTCALL:
+      return "fastcall";
+    case CallingConvention::CDECL:
+      return "cdecl";
+  }
+  return "unknown";
+}
+
+} // namespace xbe
+} // namespace exec
@@ -0,0 +1,62 @@
+#ifndef EXEC_XBE_KERNEL_EXPORTS_H_
+#define EXEC_XBE_KERNEL_EXPORTS_H_
+
+#include <cstdint>
+
+namespace exec {
+namespace xbe {
+
+enum class KernelExportKind {
+  // Ordinals the kernel does not export.
+  NONE,
+  FUNCTION,
+  VARIABLE,
+};
+
+enum class CallingConvention {
+  // Variables and unused ordinals.
+  NONE,
+  STDCALL,
+  FASTCALL,
+  CDECL,
+};
+
+struct KernelExport {
+  uint32_t ordinal;
+  // nullptr for unused ordinals.
+  const char* name;
+  KernelExportKind kind;
+  CallingConvention calling_convention;
+  // Bytes of arguments passed on the stack: all of them for stdcall, those
+  // after the two in ecx and edx for fastcall, and the fixed ones for cdecl.
+  // 64 bit arguments passed by value take 8.
+  uint32_t stack_bytes;
+};
+
+// Ordinals 374 and up are only exported by debug kernels.
+static const uint32_t kMaxKernelOrdinal = 378;
+
+// Every xboxkrnl.exe export, indexed by ordinal. Built at compile time.
+extern const KernelExport kKernelExports[kMaxKernelOrdinal + 1];
+
+// Returns nullptr for ordinals the kernel does not export.
+inline const KernelExport* KernelExportByOrdinal(uint32_t ordinal) {
+  if (ordinal > kMaxKernelOrdinal || kKernelExports[ordinal].name == nullptr) {
+    return nullptr;
+  }
+  return &kKernelExports[ordinal];
+}
+
+// The argument bytes a call to kernel_export pops off the stack when it
+// returns: its stack_bytes, unless the caller cleans up, as for cdecl.
+inline uint32_t CalleePoppedBytes(const KernelExport& kernel_export) {
+  return kernel_export.calling_convention == CallingConvention::CDECL
+      ? 0 : kernel_export.stack_bytes;
+}
+
+const char* ToString(CallingConvention calling_convention);
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_KERNEL_EXPORTS_H_
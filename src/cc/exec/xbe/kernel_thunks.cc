@@ -0,0 +1,73 @@
+#include "cc/exec/xbe/kernel_thunks.h"
+
+#include <cstring>
+
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::to_string;
+using std::vector;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+
+ErrorOr<vector<KernelImport>> DecodeKernelThunks(const XbeImage& xbe) {
+  Span span("DecodeKernelThunks");
+  const uint32_t table_mem_addr = xbe.kernel_thunk_mem_addr();
+  const int index = xbe.SectionIndexAt(table_mem_addr);
+  RETURN_ERROR_IF(index < 0, "Kernel thunk table is not in a section.");
+  const XbeSectionHeader& section_header = xbe.section_headers()[index];
+  const uint32_t table_offset = table_mem_addr - section_header.virt_mem_addr;
+  // The table runs to its terminator, which must be stored in the file.
+  const ArrayView<char> section_bytes = xbe.section_bytes(index);
+  RETURN_ERROR_IF(table_offset >= section_bytes.size(),
+                  "Kernel thunk table is not stored in the file.");
+  const char* table = section_bytes.data() + table_offset;
+  const size_t max_thunks =
+      (section_bytes.size() - table_offset) / sizeof(uint32_t);
+
+  vector<KernelImport> imports;
+  for (size_t i = 0;; i++) {
+    RETURN_ERROR_IF(i == max_thunks, "Kernel thunk table is not terminated.");
+    uint32_t thunk;
+    memcpy(&thunk, table + i * sizeof(uint32_t), sizeof(uint32_t));
+    if (thunk == 0) {
+      break;
+    }
+    RETURN_ERROR_IF(!(thunk & kKernelThunkOrdinalFlag),
+                    "Kernel thunk does not import by ordinal.");
+    const uint32_t ordinal = thunk & ~kKernelThunkOrdinalFlag;
+    imports.push_back({static_cast<uint32_t>(table_mem_addr
+                                             + i * sizeof(uint32_t)),
+                       ordinal,
+                       KernelExportByOrdinal(ordinal)});
+  }
+  span.set_bytes(imports.size() * sizeof(uint32_t));
+  return ErrorOr<vector<KernelImport>>(std::move(imports));
+}
+
+string ToString(const KernelImport& kernel_import) {
+  const KernelExport* kernel_export = kernel_import.kernel_export;
+  return string()
+      + "KernelImport {\n"
+      + "  thunk_mem_addr = " + to_string(kernel_import.thunk_mem_addr) + "\n"
+      + "  ordinal = " + to_string(kernel_import.ordinal) + "\n"
+      + "  name = "
+          + (kernel_export != nullptr ? kernel_export->name : "UNKNOWN") + "\n"
+      + "  kind = "
+          + (kernel_export == nullptr ? "UNKNOWN"
+             : kernel_export->kind == KernelExportKind::VARIABLE ? "VARIABLE"
+             : "FUNCTION") + "\n"
+      + "  calling_convention = "
+          + (kernel_export != nullptr
+             ? ToString(kernel_export->calling_convention) : "none") + "\n"
+      + "  stack_bytes = "
+          + to_string(kernel_export != nullptr ? kernel_export->stack_bytes
+                                               : 0) + "\n"
+      + "}\n";
+}
+
+} // namespace xbe
+} // namespace exec
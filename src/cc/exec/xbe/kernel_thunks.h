@@ -0,0 +1,36 @@
+#ifndef EXEC_XBE_KERNEL_THUNKS_H_
+#define EXEC_XBE_KERNEL_THUNKS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cc/exec/xbe/kernel_exports.h"
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace xbe {
+
+// Set on thunks that import by ordinal, which is the only way the kernel is
+// imported.
+static const uint32_t kKernelThunkOrdinalFlag = 0x80000000;
+
+struct KernelImport {
+  // Where the loader writes the address of the export.
+  uint32_t thunk_mem_addr;
+  uint32_t ordinal;
+  // nullptr if the kernel does not export ordinal.
+  const KernelExport* kernel_export;
+};
+
+// Decodes the zero terminated thunk table at xbe.kernel_thunk_mem_addr(), in
+// table order.
+utils::ErrorOr<std::vector<KernelImport>> DecodeKernelThunks(
+    const XbeImage& xbe);
+
+std::string ToString(const KernelImport& kernel_import);
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_KERNEL_THUNKS_H_
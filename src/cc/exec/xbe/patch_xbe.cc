@@ -0,0 +1,88 @@
+#include <iostream>
+#include <string>
+
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/exec/xbe/xbe_patch.h"
+#include "cc/io/file.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/trace.h"
+
+using std::cerr;
+using std::endl;
+using std::string;
+using exec::xbe::ApplyXbePatch;
+using exec::xbe::MakeXbePatch;
+using exec::xbe::XbeImage;
+using exec::xbe::XbePatchStats;
+using io::File;
+using io::IoStats;
+using io::WriteIoStatsReport;
+using utils::ErrorOr;
+using utils::Flags;
+
+namespace {
+void PrintStats(const XbePatchStats& stats) {
+  cerr << "Patch: " << stats.patch_bytes << " bytes; " << stats.bytes_copied
+       << " bytes copied, " << stats.bytes_added << " added; "
+       << stats.sections_carried << " sections carried";
+  if (stats.sections_verified > 0) {
+    cerr << ", " << stats.sections_verified << " verified";
+  }
+  cerr << "." << endl;
+}
+} // namespace
+
+// Usage: patch_xbe make <old xbe> <new xbe> <patch>
+//        patch_xbe apply <old xbe> <patch> <new xbe> [--trust_source]
+//        [--stats[=<json path>]] [--trace=<json path>]
+//
+// make writes a patch that turns <old xbe> into <new xbe>, and apply writes
+// the new XBE back from the old one and the patch; see xbe_patch.h for how
+// the patch is laid out. apply checks every byte it writes against the
+// patch's digests and leaves nothing at <new xbe> if any does not match.
+// --trust_source checks sections the patch carries over unchanged against
+// the old XBE's section_digest instead of reading them back.
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 4,
+             "Must specify make or apply and three paths.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  const string& command = flags.positional()[0];
+  if (command == "make") {
+    ErrorOr<XbeImage> error_or_source = XbeImage::Open(flags.positional()[1]);
+    CHECK_ERROR(error_or_source.error());
+    ErrorOr<XbeImage> error_or_target = XbeImage::Open(flags.positional()[2]);
+    CHECK_ERROR(error_or_target.error());
+    ErrorOr<File> error_or_patch = File::Create(flags.positional()[3], 0664);
+    CHECK_ERROR(error_or_patch.error());
+    File patch = error_or_patch.move();
+    ErrorOr<XbePatchStats> error_or_stats = MakeXbePatch(
+        error_or_source.get(), error_or_target.get(), &patch);
+    CHECK_ERROR(error_or_stats.error());
+    CHECK_ERROR(patch.Close());
+    PrintStats(error_or_stats.get());
+  } else if (command == "apply") {
+    ErrorOr<XbePatchStats> error_or_stats =
+        ApplyXbePatch(flags.positional()[1], flags.positional()[2],
+                      flags.positional()[3], flags.Has("trust_source"));
+    CHECK_ERROR(error_or_stats.error());
+    PrintStats(error_or_stats.get());
+  } else {
+    FAIL("Unknown command " + command);
+  }
+
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
+  return 0;
+}
@@ -1,42 +1,137 @@
 #include <iostream>
+#include <sstream>
+#include <string>
 #include <vector>
 
+#include "cc/exec/xbe/kernel_thunks.h"
+#include "cc/exec/xbe/xbe_batch.h"
 #include "cc/exec/xbe/xbe_common.h"
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/exec/xbe/xbe_path.h"
 #include "cc/io/file.h"
+#include "cc/io/io_stats.h"
 #include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/parallel_for.h"
+#include "cc/utils/trace.h"
 
+using std::cerr;
 using std::cout;
 using std::endl;
+using std::string;
 using std::vector;
-using exec::xbe::kXbeCertificateSize;
+using exec::xbe::AnalyzeXbes;
+using exec::xbe::BatchFormat;
+using exec::xbe::BatchOptions;
+using exec::xbe::DecodeKernelThunks;
+using exec::xbe::FindXbePaths;
+using exec::xbe::KernelImport;
+using exec::xbe::OpenXbe;
 using exec::xbe::ToString;
-using exec::xbe::XbeImageHeader;
+using exec::xbe::XbeImage;
+using exec::xbe::XbeLibraryVersion;
 using exec::xbe::XbeSectionHeader;
 using io::File;
+using io::IoStats;
+using io::WriteIoStatsReport;
+using utils::Error;
 using utils::ErrorOr;
+using utils::Flags;
 
-int main(int argc, char* argv[]) {
-  CHECK_INFO(argc == 2, "Must specify path to xbe.");
-  ErrorOr<File> error_or_xbe_file = File::Open(argv[1], File::RD_ONLY);
-  CHECK_ERROR(error_or_xbe_file.error());
-  File xbe_file = error_or_xbe_file.move();
+void PrintXbe(const string& path) {
+  ErrorOr<XbeImage> error_or_image = OpenXbe(path);
+  CHECK_ERROR(error_or_image.error());
+  const XbeImage& image = error_or_image.get();
 
-  XbeImageHeader image_header;
-  CHECK_ERROR(xbe_file.Read(reinterpret_cast<char*>(&image_header),
-                            sizeof(XbeImageHeader)).error());
+  cout << ToString(image.image_header()) << endl;
+  cout << ToString(image.certificate()) << endl;
+  for (size_t i = 0; i < image.section_headers().size(); i++) {
+    cout << "name: " << image.section_name(i) << endl;
+    cout << ToString(image.section_headers()[i]) << endl;
+  }
+  for (const XbeLibraryVersion& library_version : image.library_versions()) {
+    cout << ToString(library_version) << endl;
+  }
+  if (image.tls_directory() != nullptr) {
+    cout << ToString(*image.tls_directory()) << endl;
+  }
+  ErrorOr<vector<KernelImport>> error_or_imports = DecodeKernelThunks(image);
+  CHECK_ERROR(error_or_imports.error());
+  for (const KernelImport& kernel_import : error_or_imports.get()) {
+    cout << ToString(kernel_import) << endl;
+  }
+}
+
+Error WriteOut(const string& path, const string& text) {
+  ErrorOr<File> error_or_file = File::Create(path, 0664);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  for (size_t written = 0; written < text.size();) {
+    ErrorOr<ssize_t> error_or_written =
+        file.Write(text.data() + written, text.size() - written);
+    PASS_ERROR(error_or_written.error());
+    written += error_or_written.get();
+  }
+  return file.Close();
+}
 
-  const size_t section_header_offset =
-      image_header.section_header_mem_addr - image_header.base_mem_addr;
-  CHECK_ERROR(xbe_file.Seek(section_header_offset).error());
+// Returns the number of XBEs that could not be analyzed.
+size_t AnalyzeBatch(const Flags& flags) {
+  BatchOptions options;
+  const string format = flags.GetString("format", "json");
+  CHECK_INFO(format == "json" || format == "csv",
+             "--format must be json or csv.");
+  options.format = format == "csv" ? BatchFormat::CSV : BatchFormat::JSON;
+  options.worker_count =
+      flags.GetUint("threads", utils::DefaultWorkerCount());
 
-  vector<XbeSectionHeader> section_headers(image_header.section_header_num);
-  CHECK_ERROR(xbe_file.Read(reinterpret_cast<char*>(section_headers.data()),
-                            sizeof(XbeSectionHeader) * section_headers.size())
-              .error());
+  ErrorOr<vector<string>> error_or_paths = FindXbePaths(flags.positional());
+  CHECK_ERROR(error_or_paths.error());
 
-  cout << ToString(image_header) << endl;
-  for (const XbeSectionHeader& section_header : section_headers) {
-    cout << ToString(section_header) << endl;
+  // --out is collected and written through File once the batch is done.
+  std::ostringstream out_buffer;
+  std::ostream* out = flags.Has("out") ? &out_buffer : &cout;
+  ErrorOr<size_t> error_or_failure_count =
+      AnalyzeXbes(error_or_paths.get(), options, out);
+  CHECK_ERROR(error_or_failure_count.error());
+  if (flags.Has("out")) {
+    CHECK_ERROR(WriteOut(flags.GetString("out", ""), out_buffer.str()));
+  }
+  cerr << "Analyzed " << error_or_paths.get().size() << " XBEs, "
+       << error_or_failure_count.get() << " failed." << endl;
+  return error_or_failure_count.get();
+}
+
+// Usage: print_xbe <xbe> [--stats[=<json path>]] [--trace=<json path>]
+//        print_xbe --batch <xbe or directory>... [--format=json|csv]
+//            [--threads=<n>] [--out=<path>] [--stats...] [--trace=...]
+//
+// An XBE may be named "<image>:/<path in image>" to read it straight out of an
+// XDFS image. Batch mode writes one record per XBE; directories are searched
+// for .xbe files recursively, and exits with 1 if any XBE failed.
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  const bool batch = flags.Has("batch");
+  CHECK_INFO(batch ? !flags.positional().empty()
+                   : flags.positional().size() == 1,
+             "Must specify path to xbe.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  size_t failure_count = 0;
+  if (batch) {
+    failure_count = AnalyzeBatch(flags);
+  } else {
+    PrintXbe(flags.positional()[0]);
+  }
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
   }
-  return 0;
+  return failure_count == 0 ? 0 : 1;
 }
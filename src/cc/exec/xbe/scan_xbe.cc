@@ -0,0 +1,64 @@
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "cc/exec/xbe/signature_scanner.h"
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/exec/xbe/xbe_path.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/trace.h"
+
+using std::vector;
+using exec::xbe::LoadSignatures;
+using exec::xbe::OpenXbe;
+using exec::xbe::Signature;
+using exec::xbe::SignatureMatch;
+using exec::xbe::SignatureScanner;
+using exec::xbe::XbeImage;
+using io::IoStats;
+using io::WriteIoStatsReport;
+using utils::ErrorOr;
+using utils::Flags;
+
+// Usage: scan_xbe <xbe> --signatures=<path> [--stats[=<json path>]]
+//            [--trace=<json path>]
+//
+// Prints "<virtual address> <signature name>" for every signature found in
+// the executable sections of <xbe>. See signature_scanner.h for the format of
+// the signature database.
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 1, "Must specify path to xbe.");
+  CHECK_INFO(flags.Has("signatures"), "Must specify --signatures.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  ErrorOr<vector<Signature>> error_or_signatures =
+      LoadSignatures(flags.GetString("signatures", ""));
+  CHECK_ERROR(error_or_signatures.error());
+  const vector<Signature>& signatures = error_or_signatures.get();
+  ErrorOr<SignatureScanner> error_or_scanner =
+      SignatureScanner::Compile(signatures);
+  CHECK_ERROR(error_or_scanner.error());
+
+  ErrorOr<XbeImage> error_or_xbe = OpenXbe(flags.positional()[0]);
+  CHECK_ERROR(error_or_xbe.error());
+  for (const SignatureMatch& match :
+       error_or_scanner.get().ScanXbe(error_or_xbe.get())) {
+    printf("0x%08x %s\n",
+           match.virt_addr,
+           signatures[match.signature_index].name.c_str());
+  }
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
+  return 0;
+}
@@ -0,0 +1,271 @@
+#include "cc/exec/xbe/signature_scanner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+namespace {
+int HexDigitValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+uint32_t LoadAnchor(const char* data) {
+  uint32_t anchor;
+  memcpy(&anchor, data, sizeof(anchor));
+  return anchor;
+}
+
+uint32_t HashAnchor(uint32_t anchor) {
+  return anchor * 0x9e3779b1u;
+}
+
+// Bytes that fill padding and common prologues say little about where a
+// match is; anchors avoid them when they can.
+bool IsCommonByte(uint8_t byte) {
+  return byte == 0x00 || byte == 0xff || byte == 0x90 || byte == 0xcc;
+}
+
+// Instruction sequences most functions start or end with, which would anchor
+// a signature at nearly every function.
+struct ByteSequence {
+  uint8_t bytes[3];
+  size_t size;
+};
+
+constexpr ByteSequence kCommonSequences[] = {
+  {{0x55, 0x8b, 0xec}, 3}, // push ebp; mov ebp, esp
+  {{0x8b, 0xff}, 2}, // mov edi, edi
+  {{0x83, 0xec}, 2}, // sub esp, imm8
+  {{0x81, 0xec}, 2}, // sub esp, imm32
+  {{0x8b, 0xe5}, 2}, // mov esp, ebp
+  {{0x5d, 0xc3}, 2}, // pop ebp; ret
+  {{0xc9, 0xc3}, 2}, // leave; ret
+};
+
+// Which bytes of signature are part of a literal kCommonSequences run.
+vector<bool> FindCommonSequences(const Signature& signature) {
+  vector<bool> in_sequence(signature.bytes.size(), false);
+  for (const ByteSequence& sequence : kCommonSequences) {
+    for (size_t offset = 0;
+         offset + sequence.size <= signature.bytes.size();
+         offset++) {
+      bool found = true;
+      for (size_t i = 0; i < sequence.size && found; i++) {
+        found = signature.mask[offset + i]
+            && signature.bytes[offset + i] == sequence.bytes[i];
+      }
+      if (found) {
+        std::fill(in_sequence.begin() + offset,
+                  in_sequence.begin() + offset + sequence.size,
+                  true);
+      }
+    }
+  }
+  return in_sequence;
+}
+
+// Returns the offset of the best run of kAnchorSize literal bytes, or -1:
+// the one with the fewest bytes of common sequences, then of common bytes.
+int ChooseAnchorOffset(const Signature& signature) {
+  const size_t anchor_size = SignatureScanner::kAnchorSize;
+  const vector<bool> in_sequence = FindCommonSequences(signature);
+  int best_offset = -1;
+  int best_sequence_num = anchor_size + 1;
+  int best_common_num = anchor_size + 1;
+  for (size_t offset = 0;
+       offset + anchor_size <= signature.bytes.size();
+       offset++) {
+    int sequence_num = 0;
+    int common_num = 0;
+    bool all_literal = true;
+    for (size_t i = offset; i < offset + anchor_size; i++) {
+      all_literal = all_literal && signature.mask[i];
+      sequence_num += in_sequence[i];
+      common_num += IsCommonByte(signature.bytes[i]);
+    }
+    if (all_literal
+        && (sequence_num < best_sequence_num
+            || (sequence_num == best_sequence_num
+                && common_num < best_common_num))) {
+      best_offset = offset;
+      best_sequence_num = sequence_num;
+      best_common_num = common_num;
+    }
+  }
+  return best_offset;
+}
+} // namespace
+
+ErrorOr<vector<Signature>> ParseSignatures(const string& text) {
+  vector<Signature> signatures;
+  std::istringstream lines(text);
+  string line;
+  for (int line_number = 1; std::getline(lines, line); line_number++) {
+    std::istringstream tokens(line);
+    Signature signature;
+    if (!(tokens >> signature.name) || signature.name[0] == '#') {
+      continue;
+    }
+    const string where = "line " + std::to_string(line_number) + ": ";
+    string token;
+    while (tokens >> token) {
+      RETURN_ERROR_IF(token.size() != 2, where + "Bad byte \"" + token + "\".");
+      if (token == "??") {
+        signature.bytes.push_back(0);
+        signature.mask.push_back(false);
+        continue;
+      }
+      const int high = HexDigitValue(token[0]);
+      const int low = HexDigitValue(token[1]);
+      RETURN_ERROR_IF(high < 0 || low < 0,
+                      where + "Bad byte \"" + token + "\".");
+      signature.bytes.push_back(high << 4 | low);
+      signature.mask.push_back(true);
+    }
+    RETURN_ERROR_IF(signature.bytes.empty(), where + "Signature has no bytes.");
+    signatures.push_back(std::move(signature));
+  }
+  return ErrorOr<vector<Signature>>(std::move(signatures));
+}
+
+ErrorOr<vector<Signature>> LoadSignatures(const string& path) {
+  std::ifstream file(path);
+  RETURN_ERROR_IF(!file, "Could not open " + path);
+  std::stringstream text;
+  text << file.rdbuf();
+  return ParseSignatures(text.str());
+}
+
+ErrorOr<SignatureScanner> SignatureScanner::Compile(
+    const vector<Signature>& signatures) {
+  Span span("SignatureScanner::Compile");
+  SignatureScanner scanner;
+  int bucket_bits = 4;
+  while ((1u << bucket_bits) < signatures.size() * 2) {
+    bucket_bits++;
+  }
+  scanner.bucket_shift_ = 32 - bucket_bits;
+  scanner.buckets_.assign(1u << bucket_bits, -1);
+  scanner.filter_.assign((1 << kFilterBits) / 64, 0);
+
+  for (const Signature& signature : signatures) {
+    const int anchor_offset = ChooseAnchorOffset(signature);
+    RETURN_ERROR_IF(anchor_offset < 0,
+                    "Signature " + signature.name + " needs "
+                    + std::to_string(kAnchorSize)
+                    + " consecutive literal bytes.");
+    Pattern pattern;
+    pattern.bytes = signature.bytes;
+    for (const bool literal : signature.mask) {
+      pattern.mask.push_back(literal ? 0xff : 0);
+    }
+    pattern.anchor_offset = anchor_offset;
+
+    const uint32_t anchor = LoadAnchor(
+        reinterpret_cast<const char*>(pattern.bytes.data()) + anchor_offset);
+    const uint32_t hash = HashAnchor(anchor);
+    const uint32_t filter_index = hash >> (32 - kFilterBits);
+    scanner.filter_[filter_index / 64] |= 1ull << (filter_index % 64);
+    int32_t* bucket = &scanner.buckets_[hash >> scanner.bucket_shift_];
+    scanner.entries_.push_back({anchor,
+                                static_cast<uint32_t>(scanner.patterns_.size()),
+                                *bucket});
+    *bucket = scanner.entries_.size() - 1;
+    scanner.patterns_.push_back(std::move(pattern));
+  }
+  return ErrorOr<SignatureScanner>(std::move(scanner));
+}
+
+void SignatureScanner::Scan(const char* data,
+                            size_t size,
+                            uint32_t virt_addr,
+                            vector<SignatureMatch>* matches) const {
+  if (size < kAnchorSize) {
+    return;
+  }
+  // Matches are found in anchor order; they are sorted by address after.
+  const size_t first_match = matches->size();
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+  for (size_t position = 0; position + kAnchorSize <= size; position++) {
+    const uint32_t anchor = LoadAnchor(data + position);
+    const uint32_t hash = HashAnchor(anchor);
+    const uint32_t filter_index = hash >> (32 - kFilterBits);
+    if (!(filter_[filter_index / 64] & (1ull << (filter_index % 64)))) {
+      continue;
+    }
+    for (int32_t i = buckets_[hash >> bucket_shift_];
+         i >= 0;
+         i = entries_[i].next) {
+      const AnchorEntry& entry = entries_[i];
+      if (entry.anchor != anchor) {
+        continue;
+      }
+      const Pattern& pattern = patterns_[entry.pattern_index];
+      if (position < pattern.anchor_offset) {
+        continue;
+      }
+      const size_t start = position - pattern.anchor_offset;
+      const size_t pattern_size = pattern.bytes.size();
+      if (pattern_size > size - start) {
+        continue;
+      }
+      const uint8_t* candidate = bytes + start;
+      size_t j = 0;
+      while (j < pattern_size
+             && ((candidate[j] ^ pattern.bytes[j]) & pattern.mask[j]) == 0) {
+        j++;
+      }
+      if (j == pattern_size) {
+        matches->push_back({static_cast<uint32_t>(virt_addr + start),
+                            entry.pattern_index});
+      }
+    }
+  }
+  std::sort(matches->begin() + first_match, matches->end(),
+            [](const SignatureMatch& a, const SignatureMatch& b) {
+              return a.virt_addr < b.virt_addr
+                  || (a.virt_addr == b.virt_addr
+                      && a.signature_index < b.signature_index);
+            });
+}
+
+vector<SignatureMatch> SignatureScanner::ScanXbe(const XbeImage& xbe) const {
+  Span span("SignatureScanner::ScanXbe");
+  vector<SignatureMatch> matches;
+  for (size_t i = 0; i < xbe.section_headers().size(); i++) {
+    const XbeSectionHeader& section_header = xbe.section_headers()[i];
+    if (!(section_header.section_flags & kSectionFlagExecutableMask)) {
+      continue;
+    }
+    const ArrayView<char> section_bytes = xbe.section_bytes(i);
+    span.add_bytes(section_bytes.size());
+    Scan(section_bytes.data(),
+         section_bytes.size(),
+         section_header.virt_mem_addr,
+         &matches);
+  }
+  return matches;
+}
+
+} // namespace xbe
+} // namespace exec
@@ -0,0 +1,105 @@
+#ifndef EXEC_XBE_SIGNATURE_SCANNER_H_
+#define EXEC_XBE_SIGNATURE_SCANNER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace xbe {
+
+// A byte pattern identifying a statically linked library function.
+struct Signature {
+  std::string name;
+  std::vector<uint8_t> bytes;
+  // One per byte; false for wildcards.
+  std::vector<bool> mask;
+};
+
+struct SignatureMatch {
+  uint32_t virt_addr;
+  // Index into the signatures the scanner was compiled from.
+  uint32_t signature_index;
+};
+
+// Parses a signature database: one signature per line, written as a name and
+// then hex bytes, with "??" for a wildcard byte, e.g.
+//
+//   XapiInitProcess 55 8B EC 83 EC ?? 53 56 57
+//
+// Blank lines and lines starting with '#' are ignored.
+utils::ErrorOr<std::vector<Signature>> ParseSignatures(
+    const std::string& text);
+utils::ErrorOr<std::vector<Signature>> LoadSignatures(const std::string& path);
+
+// Finds every occurrence of many signatures in one pass over the data.
+//
+// Each signature is indexed by an anchor: a run of kAnchorSize literal bytes
+// inside it, kept clear where possible of padding bytes and of the prologue
+// and epilogue instructions nearly every function shares. The scan slides a
+// kAnchorSize byte window over the data and checks each window against a
+// small bitmap of anchor hashes, which fits in L1 and rejects nearly every
+// position with one load; only positions that pass are looked up in the
+// anchor hash table and verified against the full pattern, wildcards
+// included.
+class SignatureScanner {
+ public:
+  static const size_t kAnchorSize = 4;
+
+  // Fails for signatures without kAnchorSize consecutive literal bytes.
+  static utils::ErrorOr<SignatureScanner> Compile(
+      const std::vector<Signature>& signatures);
+
+  SignatureScanner(SignatureScanner&& scanner) = default;
+
+  // Appends a match for every occurrence in data, which is loaded at
+  // virt_addr, in address order.
+  void Scan(const char* data,
+            size_t size,
+            uint32_t virt_addr,
+            std::vector<SignatureMatch>* matches) const;
+
+  // Scans every executable section of xbe.
+  std::vector<SignatureMatch> ScanXbe(const XbeImage& xbe) const;
+
+  size_t signature_num() const { return patterns_.size(); }
+
+ private:
+  static const int kFilterBits = 16;
+
+  struct Pattern {
+    std::vector<uint8_t> bytes;
+    // 0xff for literal bytes, 0 for wildcards.
+    std::vector<uint8_t> mask;
+    uint32_t anchor_offset;
+  };
+
+  struct AnchorEntry {
+    uint32_t anchor;
+    uint32_t pattern_index;
+    // Next entry in the same bucket, or -1.
+    int32_t next;
+  };
+
+  std::vector<Pattern> patterns_;
+  // One bit per anchor hash.
+  std::vector<uint64_t> filter_;
+  // Heads of the bucket chains in entries_, or -1.
+  std::vector<int32_t> buckets_;
+  std::vector<AnchorEntry> entries_;
+  // Buckets are indexed by the top bits of the anchor hash; the low bits of
+  // a multiplicative hash only depend on the low bits of the anchor.
+  uint32_t bucket_shift_ = 0;
+
+  SignatureScanner() {}
+
+  SignatureScanner(const SignatureScanner&) = delete;
+  SignatureScanner& operator=(const SignatureScanner&) = delete;
+};
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_SIGNATURE_SCANNER_H_
@@ -0,0 +1,363 @@
+#include "cc/exec/xbe/xbe_batch.h"
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include "cc/exec/xbe/xbe_path.h"
+#include "cc/utils/parallel_for.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using utils::CsvWriter;
+using utils::Error;
+using utils::ErrorOr;
+using utils::JsonWriter;
+using utils::ParallelFor;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+namespace {
+// Buffered output is handed to the shared stream once it is this large.
+static const size_t kFlushThresholdBytes = 64 * 1024;
+
+const char* const kCsvColumns[] = {
+  "path", "error", "kind", "title_id", "title_name", "version",
+  "base_mem_addr", "image_size", "entry_mem_addr", "init_flags",
+  "section_num", "library_version_num", "sections",
+};
+const size_t kCsvColumnNum = sizeof(kCsvColumns) / sizeof(kCsvColumns[0]);
+
+struct SectionFlagName {
+  uint32_t mask;
+  const char* name;
+};
+
+const SectionFlagName kSectionFlagNames[] = {
+  {kSectionFlagWritableMask, "WRITABLE"},
+  {kSectionFlagPreloadMask, "PRELOAD"},
+  {kSectionFlagExecutableMask, "EXEC"},
+  {kSectionFlagInsertedFileMask, "INSERT_FILE"},
+  {kSectionFlagHeadPageReadOnly, "HEAD_PAGE"},
+  {kSectionFlagTailPageReadOnly, "TAIL_PAGE"},
+};
+
+bool HasXbeExtension(const string& name) {
+  static const char kExtension[] = ".xbe";
+  const size_t extension_size = sizeof(kExtension) - 1;
+  if (name.size() < extension_size) {
+    return false;
+  }
+  for (size_t i = 0; i < extension_size; i++) {
+    if (tolower(name[name.size() - extension_size + i]) != kExtension[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Error FindXbePathsInDir(const string& dir_path, vector<string>* xbe_paths) {
+  DIR* dir = opendir(dir_path.c_str());
+  RETURN_ERROR_IF(dir == nullptr,
+                  "Could not open " + dir_path + ": " + strerror(errno));
+  vector<string> sub_dirs;
+  for (dirent* entry = readdir(dir); entry != nullptr; entry = readdir(dir)) {
+    const string name = entry->d_name;
+    if (name == "." || name == "..") {
+      continue;
+    }
+    const string path = dir_path + "/" + name;
+    bool is_dir = entry->d_type == DT_DIR;
+    if (entry->d_type == DT_UNKNOWN) {
+      struct stat path_stat;
+      is_dir = stat(path.c_str(), &path_stat) == 0
+          && S_ISDIR(path_stat.st_mode);
+    }
+    if (is_dir) {
+      sub_dirs.push_back(path);
+    } else if (HasXbeExtension(name)) {
+      xbe_paths->push_back(path);
+    }
+  }
+  closedir(dir);
+  for (const string& sub_dir : sub_dirs) {
+    PASS_ERROR(FindXbePathsInDir(sub_dir, xbe_paths));
+  }
+  return Error::Ok();
+}
+
+// Hex without allocating, e.g. "0x00010000".
+void WriteHex(uint32_t value, char (*text)[11]) {
+  snprintf(*text, sizeof(*text), "0x%08x", value);
+}
+
+// Title IDs are conventionally written as eight upper case hex digits.
+void WriteTitleId(uint32_t title_id, char (*text)[9]) {
+  snprintf(*text, sizeof(*text), "%08X", title_id);
+}
+
+// Title names are UTF-16; anything outside of ASCII is replaced.
+size_t WriteTitleName(const XbeCertificate& certificate,
+                      char (*text)[kTitleNameSize]) {
+  size_t size = 0;
+  for (; size < kTitleNameSize && certificate.title_name[size] != 0; size++) {
+    const uint16_t c = certificate.title_name[size];
+    (*text)[size] = c < 0x80 ? static_cast<char>(c) : '?';
+  }
+  return size;
+}
+
+const char* KindName(XbeKind kind) {
+  return kind == XbeKind::DEBUG ? "debug" : "retail";
+}
+
+void WriteErrorRecord(const string& path,
+                      const Error& error,
+                      JsonWriter* writer) {
+  writer->BeginObject();
+  writer->Key("path");
+  writer->String(path);
+  writer->Key("error");
+  writer->String(error.error_info());
+  writer->EndObject();
+}
+
+void WriteErrorRecord(const string& path,
+                      const Error& error,
+                      CsvWriter* writer) {
+  writer->Field(path);
+  writer->Field(error.error_info());
+  for (size_t i = 2; i < kCsvColumnNum; i++) {
+    writer->Field("", 0);
+  }
+  writer->EndRecord();
+}
+
+void EndRecord(JsonWriter* writer) {
+  writer->Newline();
+}
+
+void EndRecord(CsvWriter*) {}
+
+// Analyzes the XBE at path into writer, flushing to out when the buffer is
+// full. Returns false if the XBE could not be parsed.
+template <typename Writer>
+bool AnalyzeXbe(const string& path,
+                Writer* writer,
+                std::mutex* out_mutex,
+                std::ostream* out) {
+  Span span("AnalyzeXbe");
+  span.set_detail(path);
+  ErrorOr<XbeImage> error_or_xbe = OpenXbe(path);
+  if (error_or_xbe.is_ok()) {
+    WriteXbeRecord(path, error_or_xbe.get(), writer);
+  } else {
+    WriteErrorRecord(path, error_or_xbe.error(), writer);
+  }
+  EndRecord(writer);
+  if (writer->str().size() >= kFlushThresholdBytes) {
+    std::lock_guard<std::mutex> lock(*out_mutex);
+    out->write(writer->str().data(), writer->str().size());
+    writer->Clear();
+  }
+  return error_or_xbe.is_ok();
+}
+
+template <typename Writer>
+size_t AnalyzeXbesWith(const vector<string>& xbe_paths,
+                       int worker_count,
+                       std::ostream* out) {
+  vector<Writer> writers(worker_count);
+  std::mutex out_mutex;
+  std::atomic<size_t> failure_count(0);
+  ParallelFor(xbe_paths.size(), worker_count, [&](int worker, size_t index) {
+    if (!AnalyzeXbe(xbe_paths[index], &writers[worker], &out_mutex, out)) {
+      failure_count.fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+  for (const Writer& writer : writers) {
+    out->write(writer.str().data(), writer.str().size());
+  }
+  return failure_count.load();
+}
+} // namespace
+
+ErrorOr<vector<string>> FindXbePaths(const vector<string>& paths) {
+  Span span("FindXbePaths");
+  vector<string> xbe_paths;
+  for (const string& path : paths) {
+    struct stat path_stat;
+    if (stat(path.c_str(), &path_stat) == 0 && S_ISDIR(path_stat.st_mode)) {
+      PASS_ERROR(FindXbePathsInDir(path, &xbe_paths));
+    } else {
+      xbe_paths.push_back(path);
+    }
+  }
+  std::sort(xbe_paths.begin(), xbe_paths.end());
+  return ErrorOr<vector<string>>(std::move(xbe_paths));
+}
+
+void WriteXbeRecord(const string& path,
+                    const XbeImage& xbe,
+                    JsonWriter* writer) {
+  const XbeImageHeader& image_header = xbe.image_header();
+  const XbeCertificate& certificate = xbe.certificate();
+  char hex[11];
+  writer->BeginObject();
+  writer->Key("path");
+  writer->String(path);
+  writer->Key("kind");
+  writer->String(KindName(xbe.kind()));
+  char title_id[9];
+  WriteTitleId(certificate.title_id, &title_id);
+  writer->Key("title_id");
+  writer->String(title_id, 8);
+  char title_name[kTitleNameSize];
+  writer->Key("title_name");
+  writer->String(title_name, WriteTitleName(certificate, &title_name));
+  writer->Key("version");
+  writer->Uint(certificate.version);
+  writer->Key("game_region");
+  writer->Uint(certificate.game_region);
+  writer->Key("allowed_media");
+  writer->Uint(certificate.allowed_media);
+
+  writer->Key("base_mem_addr");
+  WriteHex(image_header.base_mem_addr, &hex);
+  writer->String(hex, 10);
+  writer->Key("headers_size");
+  writer->Uint(image_header.headers_size);
+  writer->Key("image_size");
+  writer->Uint(image_header.image_size);
+  writer->Key("date_time");
+  writer->Uint(image_header.date_time);
+  writer->Key("init_flags");
+  writer->Uint(image_header.init_flags);
+  writer->Key("entry_mem_addr");
+  WriteHex(xbe.entry_mem_addr(), &hex);
+  writer->String(hex, 10);
+  writer->Key("kernel_thunk_mem_addr");
+  WriteHex(xbe.kernel_thunk_mem_addr(), &hex);
+  writer->String(hex, 10);
+  writer->Key("tls_mem_addr");
+  WriteHex(image_header.tls_mem_addr, &hex);
+  writer->String(hex, 10);
+  writer->Key("pe_stack_commit");
+  writer->Uint(image_header.pe_stack_commit);
+  writer->Key("pe_heap_reserve");
+  writer->Uint(image_header.pe_heap_reserve);
+  writer->Key("pe_heap_commit");
+  writer->Uint(image_header.pe_heap_commit);
+  writer->Key("library_version_num");
+  writer->Uint(image_header.library_version_num);
+
+  writer->Key("sections");
+  writer->BeginArray();
+  for (size_t i = 0; i < xbe.section_headers().size(); i++) {
+    const XbeSectionHeader& section_header = xbe.section_headers()[i];
+    writer->BeginObject();
+    writer->Key("name");
+    writer->String(xbe.section_name(i), strlen(xbe.section_name(i)));
+    writer->Key("flags");
+    writer->BeginArray();
+    for (const SectionFlagName& flag : kSectionFlagNames) {
+      if (section_header.section_flags & flag.mask) {
+        writer->String(flag.name, strlen(flag.name));
+      }
+    }
+    writer->EndArray();
+    writer->Key("virt_mem_addr");
+    WriteHex(section_header.virt_mem_addr, &hex);
+    writer->String(hex, 10);
+    writer->Key("virt_mem_size");
+    writer->Uint(section_header.virt_mem_size);
+    writer->Key("file_offset");
+    writer->Uint(section_header.file_offset);
+    writer->Key("file_size");
+    writer->Uint(section_header.file_size);
+    writer->EndObject();
+  }
+  writer->EndArray();
+  writer->EndObject();
+}
+
+void WriteCsvHeader(CsvWriter* writer) {
+  for (const char* column : kCsvColumns) {
+    writer->Field(column, strlen(column));
+  }
+  writer->EndRecord();
+}
+
+// Sections are packed as "name:flags:virt_mem_addr:virt_mem_size" joined by
+// ';', with flags as the raw bit mask in hex.
+void WriteXbeRecord(const string& path,
+                    const XbeImage& xbe,
+                    CsvWriter* writer) {
+  const XbeImageHeader& image_header = xbe.image_header();
+  const XbeCertificate& certificate = xbe.certificate();
+  char hex[11];
+  writer->Field(path);
+  writer->Field("", 0);
+  writer->Field(KindName(xbe.kind()), strlen(KindName(xbe.kind())));
+  char title_id[9];
+  WriteTitleId(certificate.title_id, &title_id);
+  writer->Field(title_id, 8);
+  char title_name[kTitleNameSize];
+  writer->Field(title_name, WriteTitleName(certificate, &title_name));
+  writer->Field(certificate.version);
+  WriteHex(image_header.base_mem_addr, &hex);
+  writer->Field(hex, 10);
+  writer->Field(image_header.image_size);
+  WriteHex(xbe.entry_mem_addr(), &hex);
+  writer->Field(hex, 10);
+  writer->Field(image_header.init_flags);
+  writer->Field(image_header.section_header_num);
+  writer->Field(image_header.library_version_num);
+
+  // Built in place; section names are short, so one field stays small.
+  string sections;
+  for (size_t i = 0; i < xbe.section_headers().size(); i++) {
+    const XbeSectionHeader& section_header = xbe.section_headers()[i];
+    char numbers[40];
+    const int size = snprintf(numbers, sizeof(numbers), ":%x:0x%08x:%u",
+                              section_header.section_flags,
+                              section_header.virt_mem_addr,
+                              section_header.virt_mem_size);
+    if (i > 0) {
+      sections += ';';
+    }
+    sections += xbe.section_name(i);
+    sections.append(numbers, size);
+  }
+  writer->Field(sections);
+  writer->EndRecord();
+}
+
+ErrorOr<size_t> AnalyzeXbes(const vector<string>& xbe_paths,
+                            const BatchOptions& options,
+                            std::ostream* out) {
+  Span span("AnalyzeXbes");
+  const int worker_count = std::max(options.worker_count, 1);
+  size_t failure_count;
+  if (options.format == BatchFormat::CSV) {
+    CsvWriter header;
+    WriteCsvHeader(&header);
+    out->write(header.str().data(), header.str().size());
+    failure_count = AnalyzeXbesWith<CsvWriter>(xbe_paths, worker_count, out);
+  } else {
+    failure_count = AnalyzeXbesWith<JsonWriter>(xbe_paths, worker_count, out);
+  }
+  out->flush();
+  RETURN_ERROR_IF(!*out, "Could not write the analysis.");
+  return ErrorOr<size_t>(std::move(failure_count));
+}
+
+} // namespace xbe
+} // namespace exec
@@ -0,0 +1,53 @@
+#ifndef EXEC_XBE_XBE_BATCH_H_
+#define EXEC_XBE_XBE_BATCH_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/utils/csv_writer.h"
+#include "cc/utils/error.h"
+#include "cc/utils/json_writer.h"
+
+namespace exec {
+namespace xbe {
+
+enum class BatchFormat {
+  // One JSON object per line.
+  JSON,
+  // A header row and then one row per XBE; sections are packed into a
+  // single field.
+  CSV,
+};
+
+struct BatchOptions {
+  BatchFormat format = BatchFormat::JSON;
+  int worker_count = 1;
+};
+
+// Expands paths into the XBEs to analyze: directories are searched
+// recursively for files ending in .xbe (any case), anything else (including
+// "<image>:/<path>" image paths) is taken as is. The result is sorted.
+utils::ErrorOr<std::vector<std::string>> FindXbePaths(
+    const std::vector<std::string>& paths);
+
+void WriteXbeRecord(const std::string& path,
+                    const XbeImage& xbe,
+                    utils::JsonWriter* writer);
+void WriteXbeRecord(const std::string& path,
+                    const XbeImage& xbe,
+                    utils::CsvWriter* writer);
+void WriteCsvHeader(utils::CsvWriter* writer);
+
+// Parses every XBE in xbe_paths on options.worker_count threads and writes
+// one record per XBE to out. Records are written in completion order. XBEs
+// that fail to parse still get a record, carrying the error, and are counted
+// in the returned value.
+utils::ErrorOr<size_t> AnalyzeXbes(const std::vector<std::string>& xbe_paths,
+                                   const BatchOptions& options,
+                                   std::ostream* out);
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_XBE_BATCH_H_
@@ -1,5 +1,7 @@
 #include "cc/exec/xbe/xbe_common.h"
 
+#include <cstring>
+
 using std::string;
 using std::to_string;
 
@@ -36,6 +38,15 @@ string SectionFlagsToString(uint32_t section_flags) {
   }
   return flags;
 }
+
+// Title names are UTF-16; anything outside of ASCII is replaced.
+string TitleNameToString(const uint16_t* title_name) {
+  string name;
+  for (uint32_t i = 0; i < kTitleNameSize && title_name[i] != 0; i++) {
+    name += title_name[i] < 0x80 ? static_cast<char>(title_name[i]) : '?';
+  }
+  return name;
+}
 } // namespace
 
 XbeSectionHeader MakeImageHeaderSectionHeader() {
@@ -45,7 +56,7 @@ XbeSectionHeader MakeImageHeaderSectionHeader() {
     .virt_mem_size = 0x0178 + 0x1d0,
     .file_offset = 0,
     .file_size = 0x0178 + 0x1d0,
-    .sect_name_mem_addr = 69720, // 69727,
+    .sect_name_mem_addr = 0, // Named by whoever inserts it.
     .sect_name_ref_count = 0,
     .head_shared_page_ref_count_mem_addr = 0,
     .tail_shared_page_ref_count_mem_addr = 0,
@@ -128,5 +139,50 @@ string ToString(const XbeSectionHeader& section_header) {
       + "}\n";
 }
 
+string ToString(const XbeCertificate& certificate) {
+  return string()
+      + "XbeCertificate {\n"
+      + "  size = " + to_string(certificate.size) + "\n"
+      + "  date_time = " + to_string(certificate.date_time) + "\n"
+      + "  title_id = " + to_string(certificate.title_id) + "\n"
+      + "  title_name = " + TitleNameToString(certificate.title_name) + "\n"
+      + "  alternate_title_ids = ...\n"
+      + "  allowed_media = " + to_string(certificate.allowed_media) + "\n"
+      + "  game_region = " + to_string(certificate.game_region) + "\n"
+      + "  game_ratings = " + to_string(certificate.game_ratings) + "\n"
+      + "  disk_number = " + to_string(certificate.disk_number) + "\n"
+      + "  version = " + to_string(certificate.version) + "\n"
+      + "  lan_key = ...\n"
+      + "  signature_key = ...\n"
+      + "  alternate_signature_keys = ...\n"
+      + "}\n";
+}
+
+string ToString(const XbeLibraryVersion& library_version) {
+  const string library_name(
+      library_version.library_name,
+      strnlen(library_version.library_name, kLibraryNameSize));
+  return string()
+      + "XbeLibraryVersion {\n"
+      + "  library_name = " + library_name + "\n"
+      + "  major_version = " + to_string(library_version.major_version) + "\n"
+      + "  minor_version = " + to_string(library_version.minor_version) + "\n"
+      + "  build_version = " + to_string(library_version.build_version) + "\n"
+      + "  library_flags = " + to_string(library_version.library_flags) + "\n"
+      + "}\n";
+}
+
+string ToString(const XbeTls& tls) {
+  return string()
+      + "XbeTls {\n"
+      + "  data_start_addr = " + to_string(tls.data_start_addr) + "\n"
+      + "  data_end_addr = " + to_string(tls.data_end_addr) + "\n"
+      + "  tls_index_addr = " + to_string(tls.tls_index_addr) + "\n"
+      + "  tls_callback_addr = " + to_string(tls.tls_callback_addr) + "\n"
+      + "  size_of_zero_fill = " + to_string(tls.size_of_zero_fill) + "\n"
+      + "  characteristics = " + to_string(tls.characteristics) + "\n"
+      + "}\n";
+}
+
 } // namespace xbe
 } // namespace xbe
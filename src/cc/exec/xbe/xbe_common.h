@@ -11,6 +11,9 @@ namespace xbe {
 static const uint32_t kXbeMagicNumber = 0x48454258;
 static const uint32_t kDigitalSignatureSize = 256;
 static const uint32_t kEntryMemAddrXorKey = 0xa8fc57ab;
+static const uint32_t kEntryMemAddrDebugXorKey = 0x94859d4b;
+static const uint32_t kKernelThunkMemAddrXorKey = 0x5b6d40b6;
+static const uint32_t kKernelThunkMemAddrDebugXorKey = 0xefb1f152;
 
 struct XbeImageHeader {
   uint32_t magic_number;
@@ -47,6 +50,47 @@ struct XbeImageHeader {
 };
 
 static const uint32_t kXbeCertificateSize = 0x1d0;
+static const uint32_t kTitleNameSize = 40;
+static const uint32_t kAlternateTitleIdNum = 16;
+static const uint32_t kKeySize = 16;
+
+struct XbeCertificate {
+  uint32_t size;
+  uint32_t date_time;
+  uint32_t title_id;
+  // UTF-16.
+  uint16_t title_name[kTitleNameSize];
+  uint32_t alternate_title_ids[kAlternateTitleIdNum];
+  uint32_t allowed_media;
+  uint32_t game_region;
+  uint32_t game_ratings;
+  uint32_t disk_number;
+  uint32_t version;
+  uint8_t lan_key[kKeySize];
+  uint8_t signature_key[kKeySize];
+  uint8_t alternate_signature_keys[kAlternateTitleIdNum][kKeySize];
+};
+static_assert(sizeof(XbeCertificate) == kXbeCertificateSize,
+              "XbeCertificate must match the on disk layout.");
+
+static const uint32_t kLibraryNameSize = 8;
+
+struct XbeLibraryVersion {
+  char library_name[kLibraryNameSize];
+  uint16_t major_version;
+  uint16_t minor_version;
+  uint16_t build_version;
+  uint16_t library_flags;
+};
+
+struct XbeTls {
+  uint32_t data_start_addr;
+  uint32_t data_end_addr;
+  uint32_t tls_index_addr;
+  uint32_t tls_callback_addr;
+  uint32_t size_of_zero_fill;
+  uint32_t characteristics;
+};
 
 static const uint32_t kSectionDigestSize = 20;
 static const uint32_t kSectionFlagWritableMask = 1;
@@ -73,6 +117,9 @@ XbeSectionHeader MakeImageHeaderSectionHeader();
 
 std::string ToString(const XbeImageHeader& image_header);
 std::string ToString(const XbeSectionHeader& section_header);
+std::string ToString(const XbeCertificate& certificate);
+std::string ToString(const XbeLibraryVersion& library_version);
+std::string ToString(const XbeTls& tls);
 
 } // namespace xbe
 } // namespace xbe
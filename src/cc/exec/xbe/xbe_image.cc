@@ -0,0 +1,240 @@
+#include "cc/exec/xbe/xbe_image.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+
+#include "cc/io/io_stats.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using io::IoCounter;
+using io::IoStats;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+namespace {
+// True if [offset, offset + size) lies in [0, limit); safe against overflow.
+bool InRange(uint64_t offset, uint64_t size, uint64_t limit) {
+  return offset <= limit && size <= limit - offset;
+}
+} // namespace
+
+ErrorOr<XbeImage> XbeImage::Open(const string& path) {
+  Span span("XbeImage::Open");
+  span.set_detail(path);
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 4);
+  const int fd = open(path.c_str(), O_RDONLY);
+  RETURN_ERROR_SYSCALL(fd, "Could not open " + path);
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) < 0) {
+    const string info = string("Could not stat ") + path + ": "
+        + strerror(errno);
+    close(fd);
+    RETURN_ERROR(info);
+  }
+  const size_t size = file_stat.st_size;
+  if (size == 0) {
+    close(fd);
+    RETURN_ERROR(path + " is empty.");
+  }
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+  RETURN_ERROR_IF(data == MAP_FAILED,
+                  string("Could not map ") + path + ": " + strerror(errno));
+  IoStats::Get()->Add(IoCounter::BYTES_MAPPED, size);
+
+  XbeImage image;
+  image.data_ = static_cast<const char*>(data);
+  image.size_ = size;
+  image.mapped_ = true;
+  PASS_ERROR(image.Parse());
+  return ErrorOr<XbeImage>(std::move(image));
+}
+
+ErrorOr<XbeImage> XbeImage::FromBuffer(vector<char>&& buffer) {
+  XbeImage image;
+  image.buffer_ = std::move(buffer);
+  image.data_ = image.buffer_.data();
+  image.size_ = image.buffer_.size();
+  PASS_ERROR(image.Parse());
+  return ErrorOr<XbeImage>(std::move(image));
+}
+
+ErrorOr<XbeImage> XbeImage::FromFileLike(io::FileLike* file) {
+  Span span("XbeImage::FromFileLike");
+  static const size_t kChunkSizeBytes = 64 * 1024;
+  vector<char> buffer;
+  size_t size = 0;
+  while (true) {
+    buffer.resize(size + kChunkSizeBytes);
+    ErrorOr<ssize_t> error_or_amount_read =
+        file->Read(buffer.data() + size, kChunkSizeBytes);
+    PASS_ERROR(error_or_amount_read.error());
+    if (error_or_amount_read.get() == 0) {
+      break;
+    }
+    size += error_or_amount_read.get();
+  }
+  buffer.resize(size);
+  span.set_bytes(size);
+  return FromBuffer(std::move(buffer));
+}
+
+// Moving a vector keeps its storage, so every pointer into buffer_ stays
+// valid.
+XbeImage::XbeImage(XbeImage&& image)
+    : data_(image.data_),
+      size_(image.size_),
+      mapped_(image.mapped_),
+      buffer_(std::move(image.buffer_)),
+      image_header_(image.image_header_),
+      section_headers_(image.section_headers_),
+      section_names_(std::move(image.section_names_)),
+      certificate_(image.certificate_),
+      library_versions_(image.library_versions_),
+      tls_(image.tls_),
+      kind_(image.kind_),
+      entry_mem_addr_(image.entry_mem_addr_) {
+  image.data_ = nullptr;
+  image.size_ = 0;
+  image.mapped_ = false;
+}
+
+XbeImage::~XbeImage() {
+  if (mapped_) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+}
+
+Error XbeImage::Parse() {
+  Span span("XbeImage::Parse");
+  RETURN_ERROR_IF(size_ < sizeof(XbeImageHeader), "Too small to be an XBE.");
+  image_header_ = reinterpret_cast<const XbeImageHeader*>(data_);
+  RETURN_ERROR_IF(image_header_->magic_number != kXbeMagicNumber,
+                  "Not an XBE: bad magic number.");
+  RETURN_ERROR_IF(image_header_->headers_size < sizeof(XbeImageHeader),
+                  "headers_size is smaller than the image header.");
+  // Counts are checked first so that the sizes below cannot overflow.
+  RETURN_ERROR_IF(image_header_->section_header_num
+                  > image_header_->headers_size / sizeof(XbeSectionHeader),
+                  "Too many section headers.");
+  RETURN_ERROR_IF(image_header_->library_version_num
+                  > image_header_->headers_size / sizeof(XbeLibraryVersion),
+                  "Too many library versions.");
+
+  ErrorOr<ArrayView<char>> error_or_bytes = HeaderBytesAt(
+      image_header_->section_header_mem_addr,
+      image_header_->section_header_num * sizeof(XbeSectionHeader));
+  PASS_ERROR(error_or_bytes.error());
+  section_headers_ = reinterpret_cast<const XbeSectionHeader*>(
+      error_or_bytes.get().data());
+
+  const size_t headers_end =
+      std::min<size_t>(image_header_->headers_size, size_);
+  for (const XbeSectionHeader& section_header : section_headers()) {
+    RETURN_ERROR_IF(!InRange(section_header.file_offset,
+                             section_header.file_size,
+                             size_),
+                    "Section data is outside of the file.");
+    RETURN_ERROR_IF(section_header.file_size > section_header.virt_mem_size,
+                    "Section file_size exceeds virt_mem_size.");
+    ErrorOr<ArrayView<char>> error_or_name =
+        HeaderBytesAt(section_header.sect_name_mem_addr, 1);
+    PASS_ERROR(error_or_name.error());
+    const char* name = error_or_name.get().data();
+    RETURN_ERROR_IF(memchr(name, '\0', data_ + headers_end - name) == nullptr,
+                    "Section name is not terminated.");
+    section_names_.push_back(name);
+  }
+
+  ErrorOr<const XbeCertificate*> error_or_certificate =
+      StructAt<XbeCertificate>(image_header_->cert_mem_addr);
+  PASS_ERROR(error_or_certificate.error());
+  certificate_ = error_or_certificate.get();
+
+  if (image_header_->library_version_num > 0) {
+    ErrorOr<ArrayView<char>> error_or_versions = HeaderBytesAt(
+        image_header_->library_version_mem_addr,
+        image_header_->library_version_num * sizeof(XbeLibraryVersion));
+    PASS_ERROR(error_or_versions.error());
+    library_versions_ = reinterpret_cast<const XbeLibraryVersion*>(
+        error_or_versions.get().data());
+  }
+
+  if (image_header_->tls_mem_addr != 0) {
+    ErrorOr<const XbeTls*> error_or_tls =
+        StructAt<XbeTls>(image_header_->tls_mem_addr);
+    PASS_ERROR(error_or_tls.error());
+    tls_ = error_or_tls.get();
+  }
+
+  // Retail and debug kits obfuscate the entry point with different keys; only
+  // one of them yields an address inside a section.
+  const uint32_t retail_entry =
+      image_header_->entry_mem_addr ^ kEntryMemAddrXorKey;
+  const uint32_t debug_entry =
+      image_header_->entry_mem_addr ^ kEntryMemAddrDebugXorKey;
+  if (SectionIndexAt(retail_entry) < 0 && SectionIndexAt(debug_entry) >= 0) {
+    kind_ = XbeKind::DEBUG;
+    entry_mem_addr_ = debug_entry;
+  } else {
+    kind_ = XbeKind::RETAIL;
+    entry_mem_addr_ = retail_entry;
+  }
+  return Error::Ok();
+}
+
+ArrayView<char> XbeImage::section_bytes(size_t index) const {
+  const XbeSectionHeader& section_header = section_headers()[index];
+  return ArrayView<char>(data_ + section_header.file_offset,
+                         section_header.file_size);
+}
+
+int XbeImage::SectionIndexAt(uint32_t virt_addr) const {
+  const ArrayView<XbeSectionHeader> headers = section_headers();
+  for (size_t i = 0; i < headers.size(); i++) {
+    if (virt_addr >= headers[i].virt_mem_addr
+        && virt_addr - headers[i].virt_mem_addr < headers[i].virt_mem_size) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+ErrorOr<ArrayView<char>> XbeImage::HeaderBytesAt(uint32_t virt_addr,
+                                                 uint32_t size) const {
+  const uint32_t base = image_header_->base_mem_addr;
+  const size_t headers_end =
+      std::min<size_t>(image_header_->headers_size, size_);
+  RETURN_ERROR_IF(virt_addr < base
+                  || !InRange(virt_addr - base, size, headers_end),
+                  "Address is outside of the XBE headers.");
+  return ErrorOr<ArrayView<char>>(
+      ArrayView<char>(data_ + (virt_addr - base), size));
+}
+
+ErrorOr<ArrayView<char>> XbeImage::BytesAt(uint32_t virt_addr,
+                                           uint32_t size) const {
+  const int index = SectionIndexAt(virt_addr);
+  if (index < 0) {
+    return HeaderBytesAt(virt_addr, size);
+  }
+  const XbeSectionHeader& section_header = section_headers()[index];
+  const uint32_t offset = virt_addr - section_header.virt_mem_addr;
+  RETURN_ERROR_IF(!InRange(offset, size, section_header.file_size),
+                  "Range is not backed by the file.");
+  return ErrorOr<ArrayView<char>>(
+      ArrayView<char>(data_ + section_header.file_offset + offset, size));
+}
+
+} // namespace xbe
+} // namespace exec
@@ -0,0 +1,140 @@
+#ifndef EXEC_XBE_XBE_IMAGE_H_
+#define EXEC_XBE_XBE_IMAGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cc/exec/xbe/xbe_common.h"
+#include "cc/io/file_like.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace xbe {
+
+// A bounds checked, non-owning view of size consecutive T.
+template <typename T>
+class ArrayView {
+ public:
+  ArrayView() : data_(nullptr), size_(0) {}
+  ArrayView(const T* data, size_t size) : data_(data), size_(size) {}
+
+  const T* data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T* begin() const { return data_; }
+  const T* end() const { return data_ + size_; }
+  const T& operator[](size_t index) const {
+    CHECK(index < size_);
+    return data_[index];
+  }
+
+ private:
+  const T* data_;
+  size_t size_;
+};
+
+enum class XbeKind {
+  RETAIL,
+  DEBUG,
+};
+
+// An XBE parsed once and then queried through typed views that point straight
+// into the underlying bytes; nothing is copied. Every structure is bounds
+// checked when the image is opened, so the accessors cannot fail.
+class XbeImage {
+ public:
+  // Maps the file at path read only.
+  static utils::ErrorOr<XbeImage> Open(const std::string& path);
+  // Takes ownership of an in memory copy of an XBE.
+  static utils::ErrorOr<XbeImage> FromBuffer(std::vector<char>&& buffer);
+  // Reads file from its current offset to its end into a buffer; for XBEs
+  // that are not host files, e.g. an XdfsFile.
+  static utils::ErrorOr<XbeImage> FromFileLike(io::FileLike* file);
+
+  XbeImage(XbeImage&& image);
+  ~XbeImage();
+
+  // The whole file.
+  ArrayView<char> bytes() const { return ArrayView<char>(data_, size_); }
+
+  const XbeImageHeader& image_header() const { return *image_header_; }
+  XbeKind kind() const { return kind_; }
+  // The entry point with the retail or debug XOR key removed.
+  uint32_t entry_mem_addr() const { return entry_mem_addr_; }
+  // The kernel import thunk table, decoded with the same kind of key.
+  uint32_t kernel_thunk_mem_addr() const {
+    return image_header_->kernel_thunk_mem_addr
+        ^ (kind_ == XbeKind::DEBUG ? kKernelThunkMemAddrDebugXorKey
+                                   : kKernelThunkMemAddrXorKey);
+  }
+
+  ArrayView<XbeSectionHeader> section_headers() const {
+    return ArrayView<XbeSectionHeader>(section_headers_,
+                                       image_header_->section_header_num);
+  }
+  // NUL terminated.
+  const char* section_name(size_t index) const {
+    return section_names_[index];
+  }
+  // The part of the section stored in the file; the rest of virt_mem_size is
+  // zero filled when loaded.
+  ArrayView<char> section_bytes(size_t index) const;
+  // Index of the section whose virtual memory contains virt_addr, or -1.
+  int SectionIndexAt(uint32_t virt_addr) const;
+
+  const XbeCertificate& certificate() const { return *certificate_; }
+  ArrayView<XbeLibraryVersion> library_versions() const {
+    return ArrayView<XbeLibraryVersion>(library_versions_,
+                                        image_header_->library_version_num);
+  }
+  // nullptr if the image has no TLS directory.
+  const XbeTls* tls_directory() const { return tls_; }
+
+  // Resolves size bytes at virt_addr, which may lie in the headers or in the
+  // file backed part of a section. Fails for ranges that are not entirely in
+  // one of those.
+  utils::ErrorOr<ArrayView<char>> BytesAt(uint32_t virt_addr,
+                                          uint32_t size) const;
+
+  template <typename T>
+  utils::ErrorOr<const T*> StructAt(uint32_t virt_addr) const {
+    utils::ErrorOr<ArrayView<char>> error_or_bytes =
+        BytesAt(virt_addr, sizeof(T));
+    PASS_ERROR(error_or_bytes.error());
+    const T* value = reinterpret_cast<const T*>(error_or_bytes.get().data());
+    return utils::ErrorOr<const T*>(std::move(value));
+  }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+  // Set if data_ is a mapping that must be unmapped.
+  bool mapped_ = false;
+  // Backs data_ for images made from a buffer.
+  std::vector<char> buffer_;
+
+  const XbeImageHeader* image_header_ = nullptr;
+  const XbeSectionHeader* section_headers_ = nullptr;
+  std::vector<const char*> section_names_;
+  const XbeCertificate* certificate_ = nullptr;
+  const XbeLibraryVersion* library_versions_ = nullptr;
+  const XbeTls* tls_ = nullptr;
+  XbeKind kind_ = XbeKind::RETAIL;
+  uint32_t entry_mem_addr_ = 0;
+
+  XbeImage() {}
+  utils::Error Parse();
+  // Like BytesAt but restricted to the headers, which are loaded at
+  // base_mem_addr.
+  utils::ErrorOr<ArrayView<char>> HeaderBytesAt(uint32_t virt_addr,
+                                                uint32_t size) const;
+
+  XbeImage(const XbeImage&) = delete;
+  XbeImage& operator=(const XbeImage&) = delete;
+};
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_XBE_IMAGE_H_
@@ -0,0 +1,386 @@
+#include "cc/exec/xbe/xbe_loader.h"
+
+#include <fcntl.h>
+#include <linux/userfaultfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+
+#include "cc/io/io_stats.h"
+#include "cc/utils/trace.h"
+
+using std::map;
+using std::string;
+using std::vector;
+using io::IoCounter;
+using io::IoStats;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+namespace {
+uint64_t PageDown(uint64_t addr) {
+  return addr & ~static_cast<uint64_t>(kXbePageSize - 1);
+}
+
+uint64_t PageUp(uint64_t addr) {
+  return PageDown(addr + kXbePageSize - 1);
+}
+
+string HexAddr(uint64_t addr) {
+  char text[19];
+  snprintf(text, sizeof(text), "0x%08lx", static_cast<unsigned long>(addr));
+  return text;
+}
+
+// [begin, end) in the XBE's address space, initialized from bytes (which may
+// be shorter; the rest stays zero).
+struct Region {
+  uint64_t begin;
+  uint64_t end;
+  ArrayView<char> bytes;
+  int prot;
+  bool preload;
+};
+
+struct PagePlan {
+  int prot = 0;
+  // Set unless every region on the page may be loaded on demand.
+  bool preload = false;
+};
+
+int SectionFlagsToProt(uint32_t section_flags) {
+  int prot = PROT_READ; // All XBE sections are readable.
+  if (section_flags & kSectionFlagWritableMask) {
+    prot |= PROT_WRITE;
+  }
+  if (section_flags & kSectionFlagExecutableMask) {
+    prot |= PROT_EXEC;
+  }
+  return prot;
+}
+
+// Everything in the XBE's address space except the stack.
+vector<Region> ImageRegionsOf(const XbeImage& xbe) {
+  vector<Region> regions;
+  const XbeImageHeader& image_header = xbe.image_header();
+  const size_t headers_size =
+      std::min<size_t>(image_header.headers_size, xbe.bytes().size());
+  regions.push_back({image_header.base_mem_addr,
+                     image_header.base_mem_addr
+                         + static_cast<uint64_t>(image_header.headers_size),
+                     ArrayView<char>(xbe.bytes().data(), headers_size),
+                     PROT_READ,
+                     true});
+  for (size_t i = 0; i < xbe.section_headers().size(); i++) {
+    const XbeSectionHeader& section_header = xbe.section_headers()[i];
+    if (section_header.virt_mem_size == 0) {
+      continue;
+    }
+    regions.push_back({section_header.virt_mem_addr,
+                       section_header.virt_mem_addr
+                           + static_cast<uint64_t>(
+                               section_header.virt_mem_size),
+                       xbe.section_bytes(i),
+                       SectionFlagsToProt(section_header.section_flags),
+                       (section_header.section_flags
+                        & kSectionFlagPreloadMask) != 0});
+  }
+  return regions;
+}
+
+// With on_demand unset every page is preloaded.
+map<uint64_t, PagePlan> PlanPages(const vector<Region>& regions,
+                                  bool on_demand) {
+  map<uint64_t, PagePlan> pages;
+  for (const Region& region : regions) {
+    for (uint64_t page = PageDown(region.begin);
+         page < region.end;
+         page += kXbePageSize) {
+      PagePlan& plan = pages[page];
+      plan.prot |= region.prot;
+      plan.preload |= region.preload || !on_demand;
+    }
+  }
+  return pages;
+}
+
+// Maps [begin, end) writable and zero filled or, given an fd, from the file at
+// offset with prot and flags.
+Error MapPages(uint64_t begin,
+               uint64_t end,
+               int prot = PROT_READ | PROT_WRITE,
+               int flags = MAP_PRIVATE | MAP_ANONYMOUS,
+               int fd = -1,
+               uint64_t offset = 0) {
+  void* addr = mmap(reinterpret_cast<void*>(begin),
+                    end - begin,
+                    prot,
+                    flags | MAP_FIXED_NOREPLACE,
+                    fd,
+                    offset);
+  RETURN_ERROR_IF(addr == MAP_FAILED,
+                  "Could not map XBE pages at " + HexAddr(begin) + ": "
+                      + strerror(errno));
+  // Kernels before 4.17 ignore MAP_FIXED_NOREPLACE and treat the address as
+  // a hint.
+  if (reinterpret_cast<uint64_t>(addr) != begin) {
+    munmap(addr, end - begin);
+    RETURN_ERROR(HexAddr(begin) + " is already in use.");
+  }
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+  return Error::Ok();
+}
+
+ErrorOr<int> OpenUserfaultfd() {
+  // Without privileges userfaultfd only works for faults from user space,
+  // which is all a loaded XBE can cause.
+  int uffd = syscall(SYS_userfaultfd,
+                     O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+  if (uffd < 0 && errno == EINVAL) {
+    // Kernels before 5.11 do not know UFFD_USER_MODE_ONLY.
+    uffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+  }
+  RETURN_ERROR_SYSCALL(uffd, "Could not open userfaultfd.");
+  uffdio_api api = {};
+  api.api = UFFD_API;
+  if (ioctl(uffd, UFFDIO_API, &api) < 0) {
+    const string info = string("UFFDIO_API failed: ") + strerror(errno);
+    close(uffd);
+    RETURN_ERROR(info);
+  }
+  return ErrorOr<int>(std::move(uffd));
+}
+
+Error RegisterPages(int uffd, uint64_t begin, uint64_t end) {
+  uffdio_register reg = {};
+  reg.range.start = begin;
+  reg.range.len = end - begin;
+  reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+  RETURN_ERROR_SYSCALL(ioctl(uffd, UFFDIO_REGISTER, &reg),
+                       "Could not register XBE pages at " + HexAddr(begin));
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+  return Error::Ok();
+}
+
+// uffd is only used if some pages are loaded on demand.
+Error LoadPages(const XbeImage& xbe, bool on_demand, int uffd) {
+  Span span(on_demand ? "LoadXbeOnDemand" : "LoadXbe");
+  vector<Region> regions = ImageRegionsOf(xbe);
+  const uint64_t stack_base = StackBaseFor(xbe);
+  const uint64_t stack_top = StackTopFor(xbe);
+  RETURN_ERROR_IF(stack_base < kXbePageSize || stack_top > UINT32_MAX,
+                  "XBE does not fit in a 32 bit address space.");
+  regions.push_back({stack_base,
+                     stack_top,
+                     ArrayView<char>(),
+                     PROT_READ | PROT_WRITE,
+                     true});
+
+  // Protections are per page, so a page shared by two regions gets both;
+  // pages are mapped writable first so that the bytes can be copied in.
+  const map<uint64_t, PagePlan> pages = PlanPages(regions, on_demand);
+  // Consecutive runs of pages become one mapping and, within that, one
+  // registration per run of demand pages and one mprotect per run of equal
+  // protections.
+  for (auto it = pages.begin(); it != pages.end();) {
+    const uint64_t begin = it->first;
+    uint64_t end = begin;
+    for (; it != pages.end() && it->first == end; ++it) {
+      end += kXbePageSize;
+    }
+    PASS_ERROR(MapPages(begin, end));
+  }
+  for (auto it = pages.begin(); it != pages.end();) {
+    const uint64_t begin = it->first;
+    const bool preload = it->second.preload;
+    uint64_t end = begin;
+    for (; it != pages.end() && it->first == end
+             && it->second.preload == preload;
+         ++it) {
+      end += kXbePageSize;
+    }
+    if (!preload) {
+      PASS_ERROR(RegisterPages(uffd, begin, end));
+    }
+  }
+  for (const Region& region : regions) {
+    const uint64_t bytes_end =
+        region.begin + std::min<uint64_t>(region.bytes.size(),
+                                          region.end - region.begin);
+    for (uint64_t addr = region.begin; addr < bytes_end;) {
+      const uint64_t page_end = std::min(PageDown(addr) + kXbePageSize,
+                                         bytes_end);
+      if (pages.at(PageDown(addr)).preload) {
+        memcpy(reinterpret_cast<void*>(addr),
+               region.bytes.data() + (addr - region.begin),
+               page_end - addr);
+        span.add_bytes(page_end - addr);
+      }
+      addr = page_end;
+    }
+  }
+  for (auto it = pages.begin(); it != pages.end();) {
+    const uint64_t begin = it->first;
+    const int prot = it->second.prot;
+    uint64_t end = begin;
+    for (; it != pages.end() && it->first == end && it->second.prot == prot;
+         ++it) {
+      end += kXbePageSize;
+    }
+    if (prot == (PROT_READ | PROT_WRITE)) {
+      continue;
+    }
+    RETURN_ERROR_SYSCALL(
+        mprotect(reinterpret_cast<void*>(begin), end - begin, prot),
+        "Could not protect XBE pages at " + HexAddr(begin));
+    IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+  }
+  return Error::Ok();
+}
+} // namespace
+
+uint32_t StackBaseFor(const XbeImage& xbe) {
+  uint64_t end = xbe.image_header().base_mem_addr
+      + static_cast<uint64_t>(xbe.image_header().headers_size);
+  for (const XbeSectionHeader& section_header : xbe.section_headers()) {
+    end = std::max<uint64_t>(
+        end, section_header.virt_mem_addr
+            + static_cast<uint64_t>(section_header.virt_mem_size));
+  }
+  return PageUp(end) + kXbePageSize;
+}
+
+uint32_t StackTopFor(const XbeImage& xbe) {
+  const uint32_t stack_size = PageUp(
+      std::max(xbe.image_header().pe_stack_commit, kMinStackSize));
+  return StackBaseFor(xbe) + stack_size;
+}
+
+Error LoadXbe(const XbeImage& xbe) {
+  return LoadPages(xbe, false, -1);
+}
+
+Error WriteXbeMemoryImage(const XbeImage& xbe, io::FileLike* file) {
+  Span span("WriteXbeMemoryImage");
+  const uint64_t image_base = PageDown(xbe.image_header().base_mem_addr);
+  uint64_t image_end = image_base;
+  for (const Region& region : ImageRegionsOf(xbe)) {
+    RETURN_ERROR_IF(region.begin < image_base,
+                    "Section at " + HexAddr(region.begin)
+                        + " is below the XBE's base address.");
+    if (region.bytes.size() > 0) {
+      PASS_ERROR(file->Seek(region.begin - image_base).error());
+      const size_t size =
+          std::min<uint64_t>(region.bytes.size(), region.end - region.begin);
+      for (size_t written = 0; written < size;) {
+        utils::ErrorOr<ssize_t> error_or_written =
+            file->Write(region.bytes.data() + written, size - written);
+        PASS_ERROR(error_or_written.error());
+        written += error_or_written.get();
+      }
+      span.add_bytes(size);
+    }
+    image_end = std::max(image_end, PageUp(region.end));
+  }
+  // Mapping past the end of a file faults, so the last page must exist even
+  // if it is all zeros.
+  const char zero = 0;
+  PASS_ERROR(file->Seek(image_end - image_base - 1).error());
+  PASS_ERROR(file->Write(&zero, 1).error());
+  return Error::Ok();
+}
+
+Error LoadXbeShared(const XbeImage& xbe, const string& image_path) {
+  Span span("LoadXbeShared");
+  span.set_detail(image_path);
+  const uint64_t image_base = PageDown(xbe.image_header().base_mem_addr);
+  const uint64_t stack_base = StackBaseFor(xbe);
+  const uint64_t stack_top = StackTopFor(xbe);
+  RETURN_ERROR_IF(image_base < kXbePageSize || stack_top > UINT32_MAX,
+                  "XBE does not fit in a 32 bit address space.");
+  const int fd = open(image_path.c_str(), O_RDONLY | O_CLOEXEC);
+  RETURN_ERROR_SYSCALL(fd, "Could not open " + image_path);
+  const map<uint64_t, PagePlan> pages = PlanPages(ImageRegionsOf(xbe), false);
+  for (auto it = pages.begin(); it != pages.end();) {
+    const uint64_t begin = it->first;
+    const int prot = it->second.prot;
+    uint64_t end = begin;
+    for (; it != pages.end() && it->first == end && it->second.prot == prot;
+         ++it) {
+      end += kXbePageSize;
+    }
+    const Error error = MapPages(
+        begin,
+        end,
+        prot,
+        (prot & PROT_WRITE) ? MAP_PRIVATE : MAP_SHARED,
+        fd,
+        begin - image_base);
+    if (!error.is_ok()) {
+      close(fd);
+      PASS_ERROR(error);
+    }
+    IoStats::Get()->Add(IoCounter::BYTES_MAPPED, end - begin);
+  }
+  // The mappings keep their own references to the file.
+  close(fd);
+  PASS_ERROR(MapPages(stack_base, stack_top));
+  return Error::Ok();
+}
+
+ErrorOr<int> LoadXbeOnDemand(const XbeImage& xbe) {
+  ErrorOr<int> error_or_uffd = OpenUserfaultfd();
+  PASS_ERROR(error_or_uffd.error());
+  int uffd = error_or_uffd.get();
+  const Error error = LoadPages(xbe, true, uffd);
+  if (!error.is_ok()) {
+    close(uffd);
+    PASS_ERROR(error);
+  }
+  return ErrorOr<int>(std::move(uffd));
+}
+
+vector<uint32_t> DemandPagesOf(const XbeImage& xbe) {
+  vector<uint32_t> demand_pages;
+  for (const auto& page : PlanPages(ImageRegionsOf(xbe), true)) {
+    if (!page.second.preload) {
+      demand_pages.push_back(page.first);
+    }
+  }
+  return demand_pages;
+}
+
+int PageProtFor(const XbeImage& xbe, uint32_t page_addr) {
+  const map<uint64_t, PagePlan> pages = PlanPages(ImageRegionsOf(xbe), false);
+  const auto it = pages.find(PageDown(page_addr));
+  return it != pages.end() ? it->second.prot : 0;
+}
+
+void CopyXbePage(const XbeImage& xbe, uint32_t page_addr, char* page) {
+  const uint64_t page_end = static_cast<uint64_t>(page_addr) + kXbePageSize;
+  for (const Region& region : ImageRegionsOf(xbe)) {
+    const uint64_t begin = std::max<uint64_t>(region.begin, page_addr);
+    const uint64_t end = std::min<uint64_t>(
+        region.begin + std::min<uint64_t>(region.bytes.size(),
+                                          region.end - region.begin),
+        page_end);
+    if (begin < end) {
+      memcpy(page + (begin - page_addr),
+             region.bytes.data() + (begin - region.begin),
+             end - begin);
+    }
+  }
+}
+
+} // namespace xbe
+} // namespace exec
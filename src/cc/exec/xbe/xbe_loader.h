@@ -0,0 +1,73 @@
+#ifndef EXEC_XBE_XBE_LOADER_H_
+#define EXEC_XBE_XBE_LOADER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/io/file_like.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace xbe {
+
+static const uint32_t kXbePageSize = 0x1000;
+
+// Loads an XBE straight into the calling process, the way the Xbox kernel
+// does, instead of converting it to an ELF for execve: the headers are mapped
+// read only at base_mem_addr and every section at its virt_mem_addr, zero
+// filled past its file_size. Pages shared by several sections get the union
+// of their protections.
+//
+// Meant for a freshly forked child that is about to be pointed at
+// xbe.entry_mem_addr() by a tracer; the 32 bit address space the XBE needs
+// must not already be in use.
+utils::Error LoadXbe(const XbeImage& xbe);
+
+// Like LoadXbe, but only the headers, the stack and sections flagged with
+// kSectionFlagPreloadMask are filled in. The pages that belong only to other
+// sections (see DemandPagesOf) are left empty and registered with a new
+// userfaultfd, which is returned; an XbePager must then serve them on first
+// touch. Fails if userfaultfd is not available.
+utils::ErrorOr<int> LoadXbeOnDemand(const XbeImage& xbe);
+
+// A memory image is the XBE's headers and sections laid out as they are in
+// memory, starting at the page holding base_mem_addr; zero filled ranges are
+// left as holes. Bumped whenever WriteXbeMemoryImage's output changes.
+static const uint32_t kMemoryImageVersion = 1;
+utils::Error WriteXbeMemoryImage(const XbeImage& xbe, io::FileLike* file);
+
+// Like LoadXbe, but maps the memory image at image_path (made by
+// WriteXbeMemoryImage from xbe) instead of copying: pages that are not
+// writable are mapped shared and read only, so every process loading the same
+// image shares one copy of them, and writable pages are mapped copy on write.
+utils::Error LoadXbeShared(const XbeImage& xbe, const std::string& image_path);
+
+// The pages LoadXbeOnDemand leaves empty, in address order.
+std::vector<uint32_t> DemandPagesOf(const XbeImage& xbe);
+
+// The protection (PROT_*) LoadXbe gives the page at page_addr, or 0 if it
+// maps nothing there.
+int PageProtFor(const XbeImage& xbe, uint32_t page_addr);
+
+// Copies whatever the XBE has at the kXbePageSize bytes at page_addr into
+// page; bytes the XBE leaves zero filled are not written.
+void CopyXbePage(const XbeImage& xbe, uint32_t page_addr, char* page);
+
+// The main thread's stack is pe_stack_commit bytes (at least kMinStackSize)
+// placed one guard page past the end of the highest section. Deterministic,
+// so that a tracer can compute it without asking the loaded process.
+static const uint32_t kMinStackSize = 64 * 1024;
+uint32_t StackBaseFor(const XbeImage& xbe);
+uint32_t StackTopFor(const XbeImage& xbe);
+// Where esp starts: below a zeroed frame at the top of the stack, so the entry
+// point sees a null return address rather than unmapped memory.
+static const uint32_t kInitialFrameSize = 16;
+inline uint32_t InitialStackPointerFor(const XbeImage& xbe) {
+  return StackTopFor(xbe) - kInitialFrameSize;
+}
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_XBE_LOADER_H_
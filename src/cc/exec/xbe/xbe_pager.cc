@@ -0,0 +1,164 @@
+#include "cc/exec/xbe/xbe_pager.h"
+
+#include <linux/userfaultfd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "cc/exec/xbe/xbe_loader.h"
+#include "cc/io/io_stats.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using io::IoCounter;
+using io::IoOp;
+using io::IoStats;
+using io::ScopedIoLatency;
+using utils::Error;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+
+XbePager::XbePager(const XbeImage& xbe, int uffd)
+    : xbe_(xbe),
+      uffd_(uffd),
+      demand_pages_(DemandPagesOf(xbe)),
+      loaded_(demand_pages_.size(), false),
+      error_(Error::Ok()) {}
+
+XbePager::~XbePager() {
+  Stop();
+  close(uffd_);
+}
+
+Error XbePager::Start() {
+  stop_fd_ = eventfd(0, EFD_CLOEXEC);
+  RETURN_ERROR_SYSCALL(stop_fd_, "Could not create eventfd.");
+  IoStats::Get()->Add(IoCounter::DEMAND_PAGES, demand_pages_.size());
+  thread_ = std::thread(&XbePager::Serve, this);
+  return Error::Ok();
+}
+
+Error XbePager::Stop() {
+  if (!thread_.joinable()) {
+    return error_;
+  }
+  const uint64_t one = 1;
+  RETURN_ERROR_SYSCALL(write(stop_fd_, &one, sizeof(one)),
+                       "Could not stop pager.");
+  thread_.join();
+  close(stop_fd_);
+  stop_fd_ = -1;
+
+  IoStats::Get()->Add(IoCounter::DEMAND_PAGES_LOADED, pages_loaded());
+  uint64_t sections_resident = 0;
+  for (const XbeSectionHeader& section_header : xbe_.section_headers()) {
+    if (section_header.virt_mem_size > 0
+        && IsResident(section_header.virt_mem_addr,
+                      section_header.virt_mem_addr
+                          + static_cast<uint64_t>(
+                              section_header.virt_mem_size))) {
+      sections_resident++;
+    }
+  }
+  IoStats::Get()->Add(IoCounter::SECTIONS_RESIDENT, sections_resident);
+  return error_;
+}
+
+size_t XbePager::pages_loaded() const {
+  return std::count(loaded_.begin(), loaded_.end(), true);
+}
+
+void XbePager::Serve() {
+  vector<char> page(kXbePageSize);
+  pollfd fds[2] = {
+    {uffd_, POLLIN, 0},
+    {stop_fd_, POLLIN, 0},
+  };
+  while (true) {
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      error_ = Error(string("Could not poll userfaultfd: ") + strerror(errno),
+                     __FILE__, __LINE__);
+      return;
+    }
+    if (fds[1].revents != 0 || (fds[0].revents & (POLLERR | POLLHUP))) {
+      return;
+    }
+    uffd_msg msg;
+    const ssize_t amount_read = read(uffd_, &msg, sizeof(msg));
+    // Another reader, or a spurious wake up.
+    if (amount_read < 0 && errno == EAGAIN) {
+      continue;
+    }
+    if (amount_read != sizeof(msg)) {
+      error_ = Error("Short read from userfaultfd.", __FILE__, __LINE__);
+      return;
+    }
+    if (msg.event != UFFD_EVENT_PAGEFAULT) {
+      continue;
+    }
+    const Error error = ServeFault(msg.arg.pagefault.address, page.data());
+    if (!error.is_ok()) {
+      error_ = error;
+      return;
+    }
+  }
+}
+
+Error XbePager::ServeFault(uint64_t addr, char* page) {
+  Span span("XbePager::ServeFault");
+  ScopedIoLatency latency(IoOp::DEMAND_PAGE_FAULT);
+  const uint32_t page_addr = addr & ~static_cast<uint64_t>(kXbePageSize - 1);
+  memset(page, 0, kXbePageSize);
+  CopyXbePage(xbe_, page_addr, page);
+
+  uffdio_copy copy = {};
+  copy.dst = page_addr;
+  copy.src = reinterpret_cast<uint64_t>(page);
+  copy.len = kXbePageSize;
+  // EEXIST: another thread of the loaded process faulted on the same page
+  // first. ESRCH: the loaded process is gone.
+  if (ioctl(uffd_, UFFDIO_COPY, &copy) < 0
+      && errno != EEXIST && errno != ESRCH) {
+    RETURN_ERROR(string("Could not load page at ") + std::to_string(page_addr)
+                 + ": " + strerror(errno));
+  }
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 2);
+  span.set_bytes(kXbePageSize);
+
+  const auto it = std::lower_bound(demand_pages_.begin(),
+                                   demand_pages_.end(),
+                                   page_addr);
+  if (it != demand_pages_.end() && *it == page_addr) {
+    loaded_[it - demand_pages_.begin()] = true;
+  }
+  return Error::Ok();
+}
+
+// True unless every page in [begin, end) is a demand page nobody touched.
+bool XbePager::IsResident(uint64_t begin, uint64_t end) const {
+  for (uint64_t page = begin & ~static_cast<uint64_t>(kXbePageSize - 1);
+       page < end;
+       page += kXbePageSize) {
+    const auto it = std::lower_bound(demand_pages_.begin(),
+                                     demand_pages_.end(),
+                                     page);
+    if (it == demand_pages_.end() || *it != page
+        || loaded_[it - demand_pages_.begin()]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace xbe
+} // namespace exec
@@ -0,0 +1,57 @@
+#ifndef EXEC_XBE_XBE_PAGER_H_
+#define EXEC_XBE_XBE_PAGER_H_
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace xbe {
+
+// Serves the page faults of an XBE loaded with LoadXbeOnDemand, usually from
+// the tracer rather than the loaded process, on a thread of its own: the first
+// touch of a demand page copies its bytes out of xbe in one UFFDIO_COPY.
+//
+// Usage:
+//   XbePager pager(xbe, uffd);
+//   CHECK_ERROR(pager.Start());
+//   ... run the loaded process ...
+//   CHECK_ERROR(pager.Stop());
+class XbePager {
+ public:
+  // Takes ownership of uffd. xbe must outlive the pager.
+  XbePager(const XbeImage& xbe, int uffd);
+  ~XbePager();
+
+  utils::Error Start();
+  // Stops serving faults and records DEMAND_PAGES_LOADED and
+  // SECTIONS_RESIDENT. Returns the first error the serving thread hit, if any.
+  utils::Error Stop();
+
+  // Only meaningful once stopped.
+  size_t pages_loaded() const;
+
+ private:
+  const XbeImage& xbe_;
+  int uffd_;
+  int stop_fd_ = -1;
+  std::thread thread_;
+  // Sorted; loaded_[i] is set once demand_pages_[i] has been served.
+  const std::vector<uint32_t> demand_pages_;
+  std::vector<bool> loaded_;
+  utils::Error error_;
+
+  void Serve();
+  utils::Error ServeFault(uint64_t addr, char* page);
+  bool IsResident(uint64_t begin, uint64_t end) const;
+
+  XbePager(const XbePager&) = delete;
+  XbePager& operator=(const XbePager&) = delete;
+};
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_XBE_PAGER_H_
@@ -0,0 +1,675 @@
+#include "cc/exec/xbe/xbe_patch.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "cc/io/file.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using io::File;
+using io::FileLike;
+using utils::Error;
+using utils::ErrorOr;
+using utils::Sha1;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+namespace {
+// Bytes per indexed source block. Smaller blocks find shorter matches at the
+// cost of a bigger index.
+const size_t kBlockSize = 512;
+// The same for the headers.
+const size_t kHeaderBlockSize = 32;
+// Candidates compared per hash hit, so that a run of identical blocks (e.g.
+// zero padding) does not make matching quadratic.
+const size_t kMaxCandidates = 8;
+// Bounds both the writer's and the reader's buffers, and the data of one ADD.
+const size_t kBufferSize = 1 << 20;
+const size_t kChunkSize = 64 * 1024;
+
+// rsync's weak checksum: cheap to roll forward one byte at a time.
+class RollingHash {
+ public:
+  RollingHash(const char* data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      a_ += static_cast<uint8_t>(data[i]);
+      b_ += (size - i) * static_cast<uint8_t>(data[i]);
+    }
+    size_ = size;
+  }
+
+  uint32_t value() const { return (b_ & 0xffff) << 16 | (a_ & 0xffff); }
+
+  void Roll(char out, char in) {
+    a_ += static_cast<uint8_t>(in) - static_cast<uint8_t>(out);
+    b_ += a_ - size_ * static_cast<uint8_t>(out);
+  }
+
+ private:
+  uint32_t a_ = 0;
+  uint32_t b_ = 0;
+  uint32_t size_ = 0;
+};
+
+// Buffers ops, merging a copy that continues the one before it and adds
+// that follow each other, and writes them out in kBufferSize pieces.
+class PatchWriter {
+ public:
+  PatchWriter(FileLike* patch, XbePatchStats* stats)
+      : patch_(patch), stats_(stats) {}
+
+  Error Copy(uint64_t source_offset, uint64_t length) {
+    PASS_ERROR(FlushAdd());
+    stats_->bytes_copied += length;
+    if (copy_length_ > 0 && copy_offset_ + copy_length_ == source_offset
+        && copy_length_ + length <= UINT32_MAX) {
+      copy_length_ += length;
+      return Error::Ok();
+    }
+    PASS_ERROR(FlushCopy());
+    copy_offset_ = source_offset;
+    copy_length_ = length;
+    return Error::Ok();
+  }
+
+  Error Add(const char* data, size_t length) {
+    PASS_ERROR(FlushCopy());
+    stats_->bytes_added += length;
+    while (length > 0) {
+      const size_t part = std::min(length, kBufferSize - add_.size());
+      add_.insert(add_.end(), data, data + part);
+      data += part;
+      length -= part;
+      if (add_.size() == kBufferSize) {
+        PASS_ERROR(FlushAdd());
+      }
+    }
+    return Error::Ok();
+  }
+
+  Error Append(const void* data, size_t size) {
+    out_.append(static_cast<const char*>(data), size);
+    if (out_.size() >= kBufferSize) {
+      PASS_ERROR(Flush());
+    }
+    return Error::Ok();
+  }
+
+  Error Finish() {
+    PASS_ERROR(FlushCopy());
+    PASS_ERROR(FlushAdd());
+    XbePatchOp op = {XBE_PATCH_END, 0, 0};
+    PASS_ERROR(Append(&op, sizeof(op)));
+    return Flush();
+  }
+
+ private:
+  FileLike* const patch_;
+  XbePatchStats* const stats_;
+  string out_;
+  uint64_t copy_offset_ = 0;
+  uint64_t copy_length_ = 0;
+  vector<char> add_;
+
+  Error FlushCopy() {
+    if (copy_length_ == 0) {
+      return Error::Ok();
+    }
+    XbePatchOp op = {XBE_PATCH_COPY, static_cast<uint32_t>(copy_length_),
+                     copy_offset_};
+    copy_length_ = 0;
+    return Append(&op, sizeof(op));
+  }
+
+  Error FlushAdd() {
+    if (add_.empty()) {
+      return Error::Ok();
+    }
+    XbePatchOp op = {XBE_PATCH_ADD, static_cast<uint32_t>(add_.size()), 0};
+    PASS_ERROR(Append(&op, sizeof(op)));
+    PASS_ERROR(Append(add_.data(), add_.size()));
+    add_.clear();
+    return Error::Ok();
+  }
+
+  Error Flush() {
+    for (size_t written = 0; written < out_.size();) {
+      ErrorOr<ssize_t> error_or_written =
+          patch_->Write(out_.data() + written, out_.size() - written);
+      PASS_ERROR(error_or_written.error());
+      written += error_or_written.get();
+    }
+    stats_->patch_bytes += out_.size();
+    out_.clear();
+    return Error::Ok();
+  }
+};
+
+// Writes target as copies from reference, which starts at reference_offset
+// in the source, wherever its blocks of block_size bytes turn up in target,
+// and adds otherwise.
+Error MatchRegion(ArrayView<char> target,
+                  ArrayView<char> reference,
+                  uint64_t reference_offset,
+                  size_t block_size,
+                  PatchWriter* writer) {
+  const size_t n = target.size();
+  const size_t m = reference.size();
+  if (n == m && memcmp(target.data(), reference.data(), n) == 0) {
+    return n == 0 ? Error::Ok() : writer->Copy(reference_offset, n);
+  }
+  if (m == 0) {
+    return writer->Add(target.data(), n);
+  }
+  const char* t = target.data();
+  const char* s = reference.data();
+  std::unordered_map<uint32_t, vector<uint32_t>> index;
+  for (size_t offset = 0; offset + block_size <= m; offset += block_size) {
+    vector<uint32_t>& offsets =
+        index[RollingHash(s + offset, block_size).value()];
+    if (offsets.size() < kMaxCandidates) {
+      offsets.push_back(offset);
+    }
+  }
+
+  size_t literal_start = 0;
+  size_t i = 0;
+  // Where the last match was in reference relative to target. Unchanged
+  // bytes mostly stay in line with it, so it is tried at every offset, not
+  // just where a block of reference starts; that keeps a field changed in
+  // place down to its own bytes, and a run of repeated blocks (zero padding)
+  // from matching a copy somewhere else.
+  int64_t shift = 0;
+  vector<uint32_t> candidates;
+  RollingHash hash(t, std::min(block_size, n));
+  while (i < n) {
+    // Only a whole block, or the rest of target, starts a match.
+    const size_t least = std::min(block_size, n - i);
+    const int64_t in_line = static_cast<int64_t>(i) + shift;
+    candidates.clear();
+    if (in_line >= 0 && in_line + least <= m) {
+      candidates.push_back(in_line);
+    }
+    if (i + block_size <= n) {
+      auto it = index.find(hash.value());
+      if (it != index.end()) {
+        candidates.insert(candidates.end(), it->second.begin(),
+                          it->second.end());
+      }
+    }
+    bool matched = false;
+    for (const uint32_t offset : candidates) {
+      if (offset + least > m || memcmp(t + i, s + offset, least) != 0) {
+        continue;
+      }
+      size_t length = least;
+      while (i + length < n && offset + length < m
+             && t[i + length] == s[offset + length]) {
+        length++;
+      }
+      // The match may start inside the bytes not matched yet.
+      size_t back = 0;
+      while (back < i - literal_start && back < offset
+             && t[i - back - 1] == s[offset - back - 1]) {
+        back++;
+      }
+      PASS_ERROR(writer->Add(t + literal_start, i - back - literal_start));
+      PASS_ERROR(writer->Copy(reference_offset + offset - back,
+                              length + back));
+      shift = static_cast<int64_t>(offset) - static_cast<int64_t>(i);
+      i += length;
+      literal_start = i;
+      if (i + block_size <= n) {
+        hash = RollingHash(t + i, block_size);
+      }
+      matched = true;
+      break;
+    }
+    if (!matched) {
+      if (i + block_size < n) {
+        hash.Roll(t[i], t[i + block_size]);
+      }
+      i++;
+    }
+  }
+  return writer->Add(t + literal_start, n - literal_start);
+}
+
+struct Region {
+  uint64_t offset;
+  uint64_t size;
+  // Index of the target section, or -1 for the bytes between sections.
+  int section;
+};
+
+// The target split at its sections' file ranges, in file order.
+ErrorOr<vector<Region>> SplitIntoRegions(const XbeImage& image) {
+  vector<Region> sections;
+  for (size_t i = 0; i < image.section_headers().size(); i++) {
+    const uint64_t size = image.section_bytes(i).size();
+    if (size > 0) {
+      sections.push_back(
+          {image.section_headers()[i].file_offset, size, static_cast<int>(i)});
+    }
+  }
+  std::sort(sections.begin(), sections.end(),
+            [](const Region& left, const Region& right) {
+              return left.offset < right.offset;
+            });
+  vector<Region> regions;
+  uint64_t cursor = 0;
+  for (const Region& section : sections) {
+    RETURN_ERROR_IF(section.offset < cursor, "XBE sections overlap.");
+    if (section.offset > cursor) {
+      regions.push_back({cursor, section.offset - cursor, -1});
+    }
+    regions.push_back(section);
+    cursor = section.offset + section.size;
+  }
+  if (cursor < image.bytes().size()) {
+    regions.push_back({cursor, image.bytes().size() - cursor, -1});
+  }
+  return ErrorOr<vector<Region>>(std::move(regions));
+}
+
+// The digest of the bytes of image outside its sections, which regions
+// splits it into.
+Sha1::Digest OutsideSectionsDigest(const XbeImage& image,
+                                   const vector<Region>& regions) {
+  Sha1 sha1;
+  for (const Region& region : regions) {
+    if (region.section < 0) {
+      sha1.Update(image.bytes().data() + region.offset, region.size);
+    }
+  }
+  return sha1.Finish();
+}
+
+// Where the source's first section starts: everything before is headers.
+uint64_t HeaderRegionEnd(const XbeImage& image) {
+  uint64_t end = image.bytes().size();
+  for (size_t i = 0; i < image.section_headers().size(); i++) {
+    if (image.section_bytes(i).size() > 0) {
+      end = std::min<uint64_t>(end, image.section_headers()[i].file_offset);
+    }
+  }
+  return end;
+}
+
+ArrayView<char> SubView(ArrayView<char> bytes, uint64_t offset, uint64_t size) {
+  if (offset >= bytes.size()) {
+    return ArrayView<char>();
+  }
+  return ArrayView<char>(bytes.data() + offset,
+                         std::min<uint64_t>(size, bytes.size() - offset));
+}
+
+// Reads a patch front to back through one kBufferSize buffer.
+class PatchReader {
+ public:
+  explicit PatchReader(File* patch) : patch_(patch), buffer_(kBufferSize) {}
+
+  uint64_t bytes_read() const { return bytes_read_; }
+
+  Error Read(void* data, size_t size) {
+    char* out = static_cast<char*>(data);
+    while (size > 0) {
+      if (begin_ == end_) {
+        ErrorOr<ssize_t> error_or_read =
+            patch_->Read(buffer_.data(), buffer_.size());
+        PASS_ERROR(error_or_read.error());
+        RETURN_ERROR_IF(error_or_read.get() == 0, "Patch is truncated.");
+        begin_ = 0;
+        end_ = error_or_read.get();
+        bytes_read_ += end_;
+      }
+      const size_t part = std::min(size, end_ - begin_);
+      memcpy(out, buffer_.data() + begin_, part);
+      begin_ += part;
+      out += part;
+      size -= part;
+    }
+    return Error::Ok();
+  }
+
+ private:
+  File* const patch_;
+  vector<char> buffer_;
+  size_t begin_ = 0;
+  size_t end_ = 0;
+  uint64_t bytes_read_ = 0;
+};
+
+Error CopyRange(int source_fd,
+                uint64_t source_offset,
+                int target_fd,
+                uint64_t target_offset,
+                uint64_t length) {
+  loff_t in = source_offset;
+  loff_t out = target_offset;
+  while (length > 0) {
+    const ssize_t copied =
+        copy_file_range(source_fd, &in, target_fd, &out, length, 0);
+    if (copied > 0) {
+      length -= copied;
+      continue;
+    }
+    RETURN_ERROR_IF(copied == 0, "Source is truncated.");
+    // Across file systems on older kernels; copy through a buffer instead.
+    RETURN_ERROR_IF(errno != EXDEV && errno != ENOSYS && errno != EINVAL,
+                    string("Could not copy from source: ") + strerror(errno));
+    vector<char> buffer(std::min<uint64_t>(length, kChunkSize));
+    while (length > 0) {
+      const size_t part = std::min<uint64_t>(length, buffer.size());
+      const ssize_t amount = pread(source_fd, buffer.data(), part, in);
+      RETURN_ERROR_SYSCALL(amount, "Could not read source.");
+      RETURN_ERROR_IF(amount == 0, "Source is truncated.");
+      RETURN_ERROR_SYSCALL(pwrite(target_fd, buffer.data(), amount, out),
+                           "Could not write target.");
+      in += amount;
+      out += amount;
+      length -= amount;
+    }
+  }
+  return Error::Ok();
+}
+
+Error WriteAll(int fd, const char* data, size_t size, uint64_t offset) {
+  while (size > 0) {
+    const ssize_t written = pwrite(fd, data, size, offset);
+    RETURN_ERROR_SYSCALL(written, "Could not write target.");
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  return Error::Ok();
+}
+
+// Writes the target of patch to target_fd.
+Error WriteTarget(const XbeImage& source,
+                  int source_fd,
+                  const XbePatchHeader& header,
+                  PatchReader* reader,
+                  int target_fd,
+                  XbePatchStats* stats) {
+  Span span("WriteTarget");
+  vector<char> buffer(kChunkSize);
+  uint64_t written = 0;
+  while (true) {
+    XbePatchOp op;
+    PASS_ERROR(reader->Read(&op, sizeof(op)));
+    if (op.kind == XBE_PATCH_END) {
+      break;
+    }
+    RETURN_ERROR_IF(header.target_size - written < op.length,
+                    "Patch writes past the end of the target.");
+    if (op.kind == XBE_PATCH_COPY) {
+      RETURN_ERROR_IF(op.source_offset > source.bytes().size()
+                          || source.bytes().size() - op.source_offset
+                              < op.length,
+                      "Patch copies past the end of the source.");
+      PASS_ERROR(CopyRange(source_fd, op.source_offset, target_fd, written,
+                           op.length));
+      stats->bytes_copied += op.length;
+    } else if (op.kind == XBE_PATCH_ADD) {
+      for (uint32_t done = 0; done < op.length;) {
+        const size_t part =
+            std::min<size_t>(op.length - done, buffer.size());
+        PASS_ERROR(reader->Read(buffer.data(), part));
+        PASS_ERROR(WriteAll(target_fd, buffer.data(), part, written + done));
+        done += part;
+      }
+      stats->bytes_added += op.length;
+    } else {
+      RETURN_ERROR("Unknown patch op " + std::to_string(op.kind));
+    }
+    written += op.length;
+  }
+  RETURN_ERROR_IF(written != header.target_size,
+                  "Patch ends before the end of the target.");
+  span.set_bytes(written);
+  return Error::Ok();
+}
+
+Error VerifyTarget(const XbeImage& source,
+                   const string& target_path,
+                   const XbePatchHeader& patch_header,
+                   const vector<XbePatchSection>& sections,
+                   bool trust_source,
+                   XbePatchStats* stats) {
+  Span span("VerifyTarget");
+  ErrorOr<XbeImage> error_or_target = XbeImage::Open(target_path);
+  PASS_ERROR(error_or_target.error());
+  const XbeImage& target = error_or_target.get();
+  RETURN_ERROR_IF(target.section_headers().size() != sections.size(),
+                  "Patched XBE has the wrong number of sections.");
+  ErrorOr<vector<Region>> error_or_regions = SplitIntoRegions(target);
+  PASS_ERROR(error_or_regions.error());
+  const Sha1::Digest outside_digest =
+      OutsideSectionsDigest(target, error_or_regions.get());
+  RETURN_ERROR_IF(memcmp(outside_digest.bytes,
+                         patch_header.outside_sections_digest,
+                         sizeof(patch_header.outside_sections_digest)) != 0,
+                  "Patched headers or padding do not match their digest.");
+  for (size_t i = 0; i < sections.size(); i++) {
+    const XbePatchSection& section = sections[i];
+    const XbeSectionHeader& header = target.section_headers()[i];
+    const string name = target.section_name(i);
+    RETURN_ERROR_IF(header.file_offset != section.file_offset
+                        || target.section_bytes(i).size() != section.file_size,
+                    "Patched section " + name + " is out of place.");
+    if ((section.flags & kXbePatchSectionCarried) && trust_source) {
+      RETURN_ERROR_IF(
+          section.source_section >= source.section_headers().size()
+              || memcmp(source.section_headers()[section.source_section]
+                            .section_digest,
+                        section.digest, sizeof(section.digest)) != 0,
+          "Source section for " + name + " does not match its digest.");
+      stats->sections_carried++;
+      continue;
+    }
+    const Sha1::Digest digest = XbeSectionDigest(target.section_bytes(i));
+    RETURN_ERROR_IF(memcmp(digest.bytes, section.digest,
+                           sizeof(section.digest)) != 0,
+                    "Patched section " + name + " does not match its digest.");
+    RETURN_ERROR_IF((section.flags & kXbePatchSectionDigestInHeader)
+                        && memcmp(digest.bytes, header.section_digest,
+                                  sizeof(header.section_digest)) != 0,
+                    "Patched section " + name
+                        + " does not match its section_digest.");
+    stats->sections_verified++;
+  }
+  return Error::Ok();
+}
+} // namespace
+
+Sha1::Digest XbeSectionDigest(ArrayView<char> bytes) {
+  Sha1 sha1;
+  const uint32_t size = bytes.size();
+  sha1.Update(&size, sizeof(size));
+  sha1.Update(bytes.data(), bytes.size());
+  return sha1.Finish();
+}
+
+ErrorOr<XbePatchStats> MakeXbePatch(const XbeImage& source,
+                                    const XbeImage& target,
+                                    FileLike* patch) {
+  Span span("MakeXbePatch");
+  XbePatchStats stats;
+  PatchWriter writer(patch, &stats);
+  ErrorOr<vector<Region>> error_or_regions = SplitIntoRegions(target);
+  PASS_ERROR(error_or_regions.error());
+
+  std::map<string, size_t> source_sections;
+  for (size_t i = 0; i < source.section_headers().size(); i++) {
+    source_sections.insert({source.section_name(i), i});
+  }
+
+  XbePatchHeader header = {};
+  memcpy(header.magic, kXbePatchMagic, sizeof(header.magic));
+  header.version = kXbePatchVersion;
+  header.section_count = target.section_headers().size();
+  header.source_size = source.bytes().size();
+  header.target_size = target.bytes().size();
+  const Sha1::Digest source_headers_digest = Sha1::Of(
+      source.bytes().data(),
+      std::min<uint64_t>(source.image_header().headers_size,
+                         source.bytes().size()));
+  memcpy(header.source_headers_digest, source_headers_digest.bytes,
+         sizeof(header.source_headers_digest));
+  const Sha1::Digest outside_digest =
+      OutsideSectionsDigest(target, error_or_regions.get());
+  memcpy(header.outside_sections_digest, outside_digest.bytes,
+         sizeof(header.outside_sections_digest));
+  PASS_ERROR(writer.Append(&header, sizeof(header)));
+
+  vector<uint32_t> source_section_of(header.section_count,
+                                     kXbePatchNoSection);
+  for (uint32_t i = 0; i < header.section_count; i++) {
+    const XbeSectionHeader& section_header = target.section_headers()[i];
+    const ArrayView<char> bytes = target.section_bytes(i);
+    XbePatchSection section = {};
+    section.file_offset = section_header.file_offset;
+    section.file_size = bytes.size();
+    section.source_section = kXbePatchNoSection;
+    const Sha1::Digest digest = XbeSectionDigest(bytes);
+    memcpy(section.digest, digest.bytes, sizeof(section.digest));
+    if (memcmp(digest.bytes, section_header.section_digest,
+               sizeof(section.digest)) == 0) {
+      section.flags |= kXbePatchSectionDigestInHeader;
+    }
+    auto source_section = source_sections.find(target.section_name(i));
+    if (source_section != source_sections.end()) {
+      const uint32_t source_index = source_section->second;
+      section.source_section = source_index;
+      source_section_of[i] = source_index;
+      const ArrayView<char> source_bytes = source.section_bytes(source_index);
+      if (source_bytes.size() == bytes.size()
+          && memcmp(source_bytes.data(), bytes.data(), bytes.size()) == 0
+          && memcmp(digest.bytes,
+                    source.section_headers()[source_index].section_digest,
+                    sizeof(section.digest)) == 0) {
+        section.flags |= kXbePatchSectionCarried;
+        stats.sections_carried++;
+      }
+    }
+    PASS_ERROR(writer.Append(&section, sizeof(section)));
+  }
+
+  const uint64_t source_header_end = HeaderRegionEnd(source);
+  for (const Region& region : error_or_regions.get()) {
+    const ArrayView<char> bytes =
+        SubView(target.bytes(), region.offset, region.size);
+    uint64_t reference_offset = 0;
+    ArrayView<char> reference;
+    size_t block_size = kBlockSize;
+    if (region.section >= 0) {
+      const uint32_t source_index = source_section_of[region.section];
+      if (source_index != kXbePatchNoSection) {
+        reference_offset =
+            source.section_headers()[source_index].file_offset;
+        reference = source.section_bytes(source_index);
+      }
+    } else if (region.offset == 0) {
+      reference_offset = 0;
+      reference = SubView(source.bytes(), 0, source_header_end);
+      block_size = kHeaderBlockSize;
+    } else {
+      // Padding between sections, most likely where it was.
+      reference_offset = region.offset;
+      reference = SubView(source.bytes(), region.offset, region.size);
+    }
+    PASS_ERROR(MatchRegion(bytes, reference, reference_offset, block_size,
+                           &writer));
+  }
+  PASS_ERROR(writer.Finish());
+  span.set_bytes(stats.patch_bytes);
+  return ErrorOr<XbePatchStats>(std::move(stats));
+}
+
+ErrorOr<XbePatchStats> ApplyXbePatch(const string& source_path,
+                                     const string& patch_path,
+                                     const string& target_path,
+                                     bool trust_source) {
+  Span span("ApplyXbePatch");
+  span.set_detail(target_path);
+  ErrorOr<XbeImage> error_or_source = XbeImage::Open(source_path);
+  PASS_ERROR(error_or_source.error());
+  const XbeImage& source = error_or_source.get();
+  ErrorOr<File> error_or_patch = File::Open(patch_path, File::RD_ONLY);
+  PASS_ERROR(error_or_patch.error());
+  File patch = error_or_patch.move();
+  PatchReader reader(&patch);
+
+  XbePatchHeader header;
+  PASS_ERROR(reader.Read(&header, sizeof(header)));
+  RETURN_ERROR_IF(memcmp(header.magic, kXbePatchMagic,
+                         sizeof(kXbePatchMagic)) != 0,
+                  "Not an XBE patch: bad magic number.");
+  RETURN_ERROR_IF(header.version != kXbePatchVersion,
+                  "Unsupported XBE patch version "
+                      + std::to_string(header.version));
+  const Sha1::Digest source_headers_digest = Sha1::Of(
+      source.bytes().data(),
+      std::min<uint64_t>(source.image_header().headers_size,
+                         source.bytes().size()));
+  RETURN_ERROR_IF(header.source_size != source.bytes().size()
+                      || memcmp(source_headers_digest.bytes,
+                                header.source_headers_digest,
+                                sizeof(header.source_headers_digest)) != 0,
+                  "Patch is not for " + source_path);
+  RETURN_ERROR_IF(header.section_count > 0xffff,
+                  "Patch has too many sections.");
+  vector<XbePatchSection> sections(header.section_count);
+  PASS_ERROR(reader.Read(sections.data(),
+                         sections.size() * sizeof(XbePatchSection)));
+
+  XbePatchStats stats;
+  const int source_fd = open(source_path.c_str(), O_RDONLY | O_CLOEXEC);
+  RETURN_ERROR_SYSCALL(source_fd, "Could not open " + source_path);
+  // Written aside and renamed into place, so that a target that does not
+  // verify never takes the place of one that did.
+  const string temp_path = target_path + ".tmp-" + std::to_string(getpid());
+  const int target_fd =
+      open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+  if (target_fd < 0) {
+    const string info = "Could not create " + temp_path + ": "
+        + strerror(errno);
+    close(source_fd);
+    RETURN_ERROR(info);
+  }
+  Error error = WriteTarget(source, source_fd, header, &reader, target_fd,
+                            &stats);
+  close(source_fd);
+  if (close(target_fd) < 0 && error.is_ok()) {
+    error = Error(string("Could not write target: ") + strerror(errno),
+                  __FILE__, __LINE__);
+  }
+  if (error.is_ok()) {
+    error = VerifyTarget(source, temp_path, header, sections, trust_source,
+                         &stats);
+  }
+  if (error.is_ok() && rename(temp_path.c_str(), target_path.c_str()) < 0) {
+    error = Error("Could not rename " + temp_path + " to " + target_path
+                      + ": " + strerror(errno),
+                  __FILE__, __LINE__);
+  }
+  if (!error.is_ok()) {
+    unlink(temp_path.c_str());
+    PASS_ERROR(error);
+  }
+  stats.patch_bytes = reader.bytes_read();
+  return ErrorOr<XbePatchStats>(std::move(stats));
+}
+
+} // namespace xbe
+} // namespace exec
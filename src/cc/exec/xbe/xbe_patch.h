@@ -0,0 +1,124 @@
+#ifndef EXEC_XBE_XBE_PATCH_H_
+#define EXEC_XBE_XBE_PATCH_H_
+
+#include <cstdint>
+#include <string>
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/io/file_like.h"
+#include "cc/utils/error.h"
+#include "cc/utils/sha1.h"
+
+namespace exec {
+namespace xbe {
+
+// A patch turns one XBE (the source) into another (the target):
+//
+//   header:   "BBXP", uint32 version, uint32 flags, uint32 section_count,
+//             uint64 source_size, uint64 target_size, the SHA-1 of the
+//             source's headers, the SHA-1 of the target's bytes outside its
+//             sections, 8 reserved bytes
+//   sections: section_count XbePatchSections, one per target section
+//   ops:      XbePatchOps that write the target from its first byte to its
+//             last; an ADD op is followed by its length bytes of data, and
+//             an END op ends the patch
+//
+// The target is split where its sections begin and end, and each section is
+// matched only against the source section of the same name, the headers
+// against the source's headers: blocks of the source section are indexed by
+// a rolling hash, which finds them at any offset of the target section, so a
+// patch holds little more than the bytes that changed. The headers, being
+// small and full of fields that change in place, are indexed in finer blocks.
+//
+// The patch holds a digest of every byte of the target: one per section and
+// one for the bytes between sections.
+static const char kXbePatchMagic[4] = {'B', 'B', 'X', 'P'};
+static const uint32_t kXbePatchVersion = 1;
+
+struct XbePatchHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t flags;
+  uint32_t section_count;
+  uint64_t source_size;
+  uint64_t target_size;
+  uint8_t source_headers_digest[utils::Sha1::kDigestSize];
+  // In file order, as the target is split into regions.
+  uint8_t outside_sections_digest[utils::Sha1::kDigestSize];
+  uint8_t reserved[8];
+};
+static_assert(sizeof(XbePatchHeader) == 80, "XbePatchHeader is packed.");
+
+// XbePatchSection::flags.
+// The section is a copy of source_section, whose section_digest is right,
+// so the copy is right if the source is.
+static const uint32_t kXbePatchSectionCarried = 1 << 0;
+// The target's own section_digest is right, so digest is the same.
+static const uint32_t kXbePatchSectionDigestInHeader = 1 << 1;
+
+// No source section.
+static const uint32_t kXbePatchNoSection = 0xffffffff;
+
+struct XbePatchSection {
+  uint32_t file_offset;
+  uint32_t file_size;
+  uint32_t flags;
+  uint32_t source_section;
+  // As section_digest is computed: the SHA-1 of file_size, as a little
+  // endian uint32, then the section's bytes.
+  uint8_t digest[utils::Sha1::kDigestSize];
+};
+static_assert(sizeof(XbePatchSection) == 36, "XbePatchSection is packed.");
+
+enum XbePatchOpKind : uint32_t {
+  XBE_PATCH_END = 0,
+  // Copies length bytes from source_offset in the source.
+  XBE_PATCH_COPY = 1,
+  // Writes the length bytes that follow the op.
+  XBE_PATCH_ADD = 2,
+};
+
+struct XbePatchOp {
+  uint32_t kind;
+  uint32_t length;
+  uint64_t source_offset;
+};
+static_assert(sizeof(XbePatchOp) == 16, "XbePatchOp is packed.");
+
+// The digest section_digest holds for bytes.
+utils::Sha1::Digest XbeSectionDigest(ArrayView<char> bytes);
+
+struct XbePatchStats {
+  uint64_t patch_bytes = 0;
+  // Target bytes copied from the source and bytes carried in the patch.
+  uint64_t bytes_copied = 0;
+  uint64_t bytes_added = 0;
+  uint32_t sections_carried = 0;
+  // Sections hashed to verify them; only set by ApplyXbePatch, which counts
+  // a carried section as carried instead if trust_source spared it.
+  uint32_t sections_verified = 0;
+};
+
+// Writes the patch from source to target to patch.
+utils::ErrorOr<XbePatchStats> MakeXbePatch(const XbeImage& source,
+                                           const XbeImage& target,
+                                           io::FileLike* patch);
+
+// Writes the target of the patch at patch_path to target_path, reading the
+// patch front to back through a fixed size buffer. Copies are made by the
+// kernel with copy_file_range, which on file systems that share extents
+// writes nothing at all, so applying costs about what the patch adds rather
+// than what the target holds. Every byte of the target is then read back and
+// checked against the patch's digests, which fails the patch and removes the
+// target if any does not match. trust_source skips reading back the sections
+// the patch carries whole, which are checked against the source's
+// section_digest instead, so applying costs what changed; it trusts the
+// source's bytes to match its headers.
+utils::ErrorOr<XbePatchStats> ApplyXbePatch(const std::string& source_path,
+                                            const std::string& patch_path,
+                                            const std::string& target_path,
+                                            bool trust_source);
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_XBE_PATCH_H_
@@ -0,0 +1,69 @@
+#include "cc/exec/xbe/xbe_path.h"
+
+#include "cc/io/file.h"
+#include "cc/io/xdfs/xdfs.h"
+#include "cc/io/xdfs/xdfs_file.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using io::File;
+using io::xdfs::Xdfs;
+using io::xdfs::XdfsFile;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+namespace {
+static const char kImageSeparator[] = ":/";
+} // namespace
+
+bool SplitImagePath(const string& path,
+                    string* image_path,
+                    string* path_in_image) {
+  const size_t separator = path.find(kImageSeparator);
+  if (separator == string::npos || separator == 0) {
+    return false;
+  }
+  *image_path = path.substr(0, separator);
+  // Keep the '/': XDFS paths are absolute.
+  *path_in_image = path.substr(separator + 1);
+  return true;
+}
+
+ErrorOr<XbeImage> OpenXbe(const string& path) {
+  string image_path;
+  string path_in_image;
+  if (!SplitImagePath(path, &image_path, &path_in_image)) {
+    return XbeImage::Open(path);
+  }
+  Span span("OpenXbeInImage");
+  span.set_detail(path);
+  ErrorOr<File> error_or_image_file = File::Open(image_path, File::RD_ONLY);
+  PASS_ERROR(error_or_image_file.error());
+  ErrorOr<Xdfs> error_or_xdfs =
+      Xdfs::CreateXdfs(error_or_image_file.move());
+  PASS_ERROR(error_or_xdfs.error());
+  Xdfs xdfs = error_or_xdfs.move();
+  ErrorOr<XdfsFile> error_or_xbe_file = xdfs.OpenFile(path_in_image);
+  PASS_ERROR(error_or_xbe_file.error());
+  XdfsFile xbe_file = error_or_xbe_file.move();
+  return XbeImage::FromFileLike(&xbe_file);
+}
+
+string HostPathFor(const string& path) {
+  string image_path;
+  string path_in_image;
+  if (!SplitImagePath(path, &image_path, &path_in_image)) {
+    return path;
+  }
+  for (char& c : path_in_image) {
+    if (c == '/') {
+      c = '.';
+    }
+  }
+  return image_path + path_in_image;
+}
+
+} // namespace xbe
+} // namespace exec
@@ -0,0 +1,32 @@
+#ifndef EXEC_XBE_XBE_PATH_H_
+#define EXEC_XBE_XBE_PATH_H_
+
+#include <string>
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace xbe {
+
+// XBEs are named either by a host path or by a path inside an XDFS image,
+// written "<image path>:/<path in image>", e.g. "halo.iso:/default.xbe".
+
+// Splits an image path into its parts; returns false for host paths.
+bool SplitImagePath(const std::string& path,
+                    std::string* image_path,
+                    std::string* path_in_image);
+
+// Opens the XBE at path, reading it straight out of the image for image
+// paths so nothing has to be extracted first.
+utils::ErrorOr<XbeImage> OpenXbe(const std::string& path);
+
+// A host path derived from path to put files about the XBE at, e.g. the
+// converted ELF: path itself for host paths, otherwise the image path with
+// the path in the image appended, '/' replaced by '.'
+// ("halo.iso:/default.xbe" gives "halo.iso.default.xbe").
+std::string HostPathFor(const std::string& path);
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_XBE_PATH_H_
@@ -0,0 +1,131 @@
+#include "cc/exec/xbe/xbe_symbols.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "cc/exec/xbe/kernel_thunks.h"
+#include "cc/io/file.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using io::File;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace exec {
+namespace xbe {
+namespace {
+// At the same address, more specific kinds come first.
+bool AddrLess(const GuestSymbol& a, const GuestSymbol& b) {
+  return a.addr < b.addr || (a.addr == b.addr && a.kind < b.kind);
+}
+} // namespace
+
+vector<GuestSymbol> CollectXbeSymbols(const XbeImage& xbe) {
+  Span span("CollectXbeSymbols");
+  vector<GuestSymbol> symbols;
+  symbols.push_back(
+      {"xbe_entry", xbe.entry_mem_addr(), 0, GuestSymbolKind::FUNCTION});
+  for (size_t i = 0; i < xbe.section_headers().size(); i++) {
+    const XbeSectionHeader& section_header = xbe.section_headers()[i];
+    symbols.push_back({xbe.section_name(i),
+                       section_header.virt_mem_addr,
+                       section_header.virt_mem_size,
+                       GuestSymbolKind::SECTION});
+  }
+  ErrorOr<vector<KernelImport>> error_or_imports = DecodeKernelThunks(xbe);
+  if (error_or_imports.is_ok()) {
+    for (const KernelImport& kernel_import : error_or_imports.get()) {
+      const string name = kernel_import.kernel_export != nullptr
+          ? kernel_import.kernel_export->name
+          : "ordinal_" + std::to_string(kernel_import.ordinal);
+      symbols.push_back({"__imp_" + name,
+                         kernel_import.thunk_mem_addr,
+                         sizeof(uint32_t),
+                         GuestSymbolKind::OBJECT});
+    }
+  }
+  std::stable_sort(symbols.begin(), symbols.end(), AddrLess);
+  span.set_detail(std::to_string(symbols.size()) + " symbols");
+  return symbols;
+}
+
+ErrorOr<vector<GuestSymbol>> CollectXbeSymbols(
+    const XbeImage& xbe,
+    const string& signatures_path) {
+  ErrorOr<vector<Signature>> error_or_signatures =
+      LoadSignatures(signatures_path);
+  PASS_ERROR(error_or_signatures.error());
+  ErrorOr<SignatureScanner> error_or_scanner =
+      SignatureScanner::Compile(error_or_signatures.get());
+  PASS_ERROR(error_or_scanner.error());
+  vector<GuestSymbol> symbols = CollectXbeSymbols(xbe);
+  AddSignatureSymbols(error_or_signatures.get(),
+                      error_or_scanner.get().ScanXbe(xbe),
+                      &symbols);
+  return ErrorOr<vector<GuestSymbol>>(std::move(symbols));
+}
+
+void AddSignatureSymbols(const vector<Signature>& signatures,
+                         const vector<SignatureMatch>& matches,
+                         vector<GuestSymbol>* symbols) {
+  for (const SignatureMatch& match : matches) {
+    symbols->push_back({signatures[match.signature_index].name,
+                        match.virt_addr,
+                        0,
+                        GuestSymbolKind::FUNCTION});
+  }
+  std::stable_sort(symbols->begin(), symbols->end(), AddrLess);
+}
+
+string PerfMapPathFor(int pid) {
+  return "/tmp/perf-" + std::to_string(pid) + ".map";
+}
+
+Error WritePerfMap(const vector<GuestSymbol>& symbols, const string& path) {
+  Span span("WritePerfMap");
+  span.set_detail(path);
+  // Unlike ELF symbols, map entries are taken at their word: they must not
+  // overlap and must not be empty. So each entry is cut off at the next
+  // address that has a symbol, and only the most specific symbol is kept for
+  // each address.
+  string text;
+  char fields[32];
+  for (size_t i = 0; i < symbols.size(); i++) {
+    const GuestSymbol& symbol = symbols[i];
+    if (i > 0 && symbols[i - 1].addr == symbol.addr) {
+      continue;
+    }
+    uint64_t size = symbol.size;
+    for (size_t next = i + 1; next < symbols.size(); next++) {
+      if (symbols[next].addr != symbol.addr) {
+        const uint64_t gap = symbols[next].addr - symbol.addr;
+        size = size == 0 ? gap : std::min(size, gap);
+        break;
+      }
+    }
+    snprintf(fields, sizeof(fields), "%x %lx ",
+             symbol.addr,
+             static_cast<unsigned long>(std::max<uint64_t>(size, 1)));
+    text += fields;
+    text += symbol.name;
+    text += '\n';
+  }
+  ErrorOr<File> error_or_file = File::Create(path, 0664);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  for (size_t written = 0; written < text.size();) {
+    ErrorOr<ssize_t> error_or_written =
+        file.Write(text.data() + written, text.size() - written);
+    PASS_ERROR(error_or_written.error());
+    written += error_or_written.get();
+  }
+  PASS_ERROR(file.Close());
+  span.set_bytes(text.size());
+  return Error::Ok();
+}
+
+} // namespace xbe
+} // namespace exec
@@ -0,0 +1,58 @@
+#ifndef EXEC_XBE_XBE_SYMBOLS_H_
+#define EXEC_XBE_XBE_SYMBOLS_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cc/exec/xbe/signature_scanner.h"
+#include "cc/exec/xbe/xbe_image.h"
+#include "cc/utils/error.h"
+
+namespace exec {
+namespace xbe {
+
+enum class GuestSymbolKind {
+  FUNCTION,
+  OBJECT,
+  // Covers a whole section; a fallback for addresses no other symbol covers.
+  SECTION,
+};
+
+// A named address in the XBE's address space, for profilers and debuggers.
+struct GuestSymbol {
+  std::string name;
+  uint32_t addr;
+  // 0 if unknown; profilers then assume the symbol runs to the next one.
+  uint32_t size;
+  GuestSymbolKind kind;
+};
+
+// The symbols every XBE has: the entry point ("xbe_entry"), the start of each
+// section (named after it) and each kernel thunk slot ("__imp_" and the
+// export's name). Thunk slots are left out if the thunk table cannot be
+// decoded. Sorted by address and, at the same address, kind.
+std::vector<GuestSymbol> CollectXbeSymbols(const XbeImage& xbe);
+
+// Also with a symbol for every match of the signature database at
+// signatures_path (see LoadSignatures) in xbe's code.
+utils::ErrorOr<std::vector<GuestSymbol>> CollectXbeSymbols(
+    const XbeImage& xbe,
+    const std::string& signatures_path);
+
+// Adds a FUNCTION symbol, named after the signature, for every match and
+// keeps symbols sorted.
+void AddSignatureSymbols(const std::vector<Signature>& signatures,
+                         const std::vector<SignatureMatch>& matches,
+                         std::vector<GuestSymbol>* symbols);
+
+// perf's convention for symbols of code it cannot find in a file:
+// "/tmp/perf-<pid>.map", one "<start> <size> <name>" line per symbol, in hex.
+// symbols must be sorted as CollectXbeSymbols returns them.
+std::string PerfMapPathFor(int pid);
+utils::Error WritePerfMap(const std::vector<GuestSymbol>& symbols,
+                          const std::string& path);
+
+} // namespace xbe
+} // namespace exec
+
+#endif // EXEC_XBE_XBE_SYMBOLS_H_
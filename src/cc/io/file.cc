@@ -4,6 +4,8 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "cc/io/io_stats.h"
+
 using std::string;
 using utils::Error;
 using utils::ErrorOr;
@@ -26,12 +28,14 @@ int ToNativeAccessMode(File::AccessMode access_mode) {
 } // namespace
 
 ErrorOr<File> File::Create(const string& file_name, int permissions) {
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
   int fd = creat(file_name.c_str(), permissions);
   RETURN_ERROR_SYSCALL(fd, "Could not create file.");
   return ErrorOr<File>(File(fd));
 }
 
 ErrorOr<File> File::Open(const string& file_name, AccessMode access_mode) {
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
   int fd = open(file_name.c_str(), ToNativeAccessMode(access_mode));
   RETURN_ERROR_SYSCALL(fd, "Could not open file.");
   return ErrorOr<File>(File(fd));
@@ -39,20 +43,29 @@ ErrorOr<File> File::Open(const string& file_name, AccessMode access_mode) {
 
 ErrorOr<ssize_t> File::Read(char* buffer, size_t max_to_read) {
   CHECK(fd_ >= 0);
+  ScopedIoLatency latency(IoOp::FILE_READ);
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
   ssize_t amount_did_read = read(fd_, buffer, max_to_read);
   RETURN_ERROR_SYSCALL(amount_did_read, "Reading file failed.");
+  IoStats::Get()->Add(IoCounter::BYTES_READ, amount_did_read);
   return ErrorOr<ssize_t>(std::move(amount_did_read));
 }
 
 ErrorOr<ssize_t> File::Write(const char* buffer, size_t max_to_write) {
   CHECK(fd_ >= 0);
+  ScopedIoLatency latency(IoOp::FILE_WRITE);
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
   ssize_t amount_did_write = write(fd_, buffer, max_to_write);
   RETURN_ERROR_SYSCALL(amount_did_write, "Writing file failed.");
+  IoStats::Get()->Add(IoCounter::BYTES_WRITTEN, amount_did_write);
   return ErrorOr<ssize_t>(std::move(amount_did_write));
 }
 
 ErrorOr<size_t> File::Seek(size_t offset) {
   CHECK(fd_ >= 0);
+  ScopedIoLatency latency(IoOp::FILE_SEEK);
+  IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+  IoStats::Get()->Add(IoCounter::SEEKS, 1);
   ssize_t new_offset = lseek(fd_, offset, SEEK_SET);
   RETURN_ERROR_SYSCALL(new_offset, "Seeking file failed.");
   return ErrorOr<size_t>(std::move(new_offset));
@@ -60,7 +73,12 @@ ErrorOr<size_t> File::Seek(size_t offset) {
 
 Error File::Close() {
   if (fd_ >= 0) {
-    RETURN_ERROR_SYSCALL(close(fd_), "Could not close file.");
+    IoStats::Get()->Add(IoCounter::SYSCALLS, 1);
+    const int result = close(fd_);
+    // The descriptor is released even if close reports an error, so never
+    // close it again (the destructor would otherwise do so).
+    fd_ = -1;
+    RETURN_ERROR_SYSCALL(result, "Could not close file.");
   }
   return Error::Ok();
 }
@@ -0,0 +1,175 @@
+#include "cc/io/io_stats.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "cc/io/file.h"
+
+using std::string;
+using utils::Error;
+using utils::ErrorOr;
+using utils::JsonWriter;
+
+namespace io {
+namespace {
+const char* const kCounterNames[] = {
+  "syscalls",
+  "seeks",
+  "bytes_read",
+  "bytes_written",
+  "sectors_read",
+  "dir_entries_decoded",
+  "xdfs_file_bytes_read",
+  "bytes_mapped",
+  "demand_pages",
+  "demand_pages_loaded",
+  "sections_resident",
+};
+static_assert(sizeof(kCounterNames) / sizeof(kCounterNames[0])
+              == static_cast<int>(IoCounter::COUNT),
+              "Every counter needs a name.");
+
+const char* const kOpNames[] = {
+  "file_read",
+  "file_write",
+  "file_seek",
+  "xdfs_read_sector",
+  "xdfs_read_dir_entry",
+  "xdfs_file_read",
+  "demand_page_fault",
+};
+static_assert(sizeof(kOpNames) / sizeof(kOpNames[0])
+              == static_cast<int>(IoOp::COUNT),
+              "Every op needs a name.");
+
+int BucketOf(uint64_t ns) {
+  int bucket = 0;
+  while (ns > 1 && bucket < LatencyHistogram::kBucketCount - 1) {
+    ns >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+} // namespace
+
+void LatencyHistogram::Record(uint64_t ns) {
+  count_.fetch_add(1, std::memory_order_relaxed);
+  total_ns_.fetch_add(ns, std::memory_order_relaxed);
+  buckets_[BucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+  uint64_t max_ns = max_ns_.load(std::memory_order_relaxed);
+  while (ns > max_ns
+         && !max_ns_.compare_exchange_weak(max_ns, ns,
+                                           std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::WriteJson(JsonWriter* writer) const {
+  writer->BeginObject();
+  writer->Key("count");
+  writer->Uint(count_.load(std::memory_order_relaxed));
+  writer->Key("total_ns");
+  writer->Uint(total_ns_.load(std::memory_order_relaxed));
+  writer->Key("max_ns");
+  writer->Uint(max_ns_.load(std::memory_order_relaxed));
+  // Only non-empty buckets; "below_ns" is the exclusive upper bound.
+  writer->Key("buckets");
+  writer->BeginArray();
+  for (int i = 0; i < kBucketCount; i++) {
+    const uint64_t count = buckets_[i].load(std::memory_order_relaxed);
+    if (count == 0) {
+      continue;
+    }
+    writer->BeginObject();
+    writer->Key("below_ns");
+    writer->Uint(i == kBucketCount - 1 ? UINT64_MAX : 2ull << i);
+    writer->Key("count");
+    writer->Uint(count);
+    writer->EndObject();
+  }
+  writer->EndArray();
+  writer->EndObject();
+}
+
+IoStats* IoStats::Get() {
+  static IoStats* stats = new IoStats();
+  return stats;
+}
+
+void IoStats::SetValue(const string& group,
+                       const string& name,
+                       uint64_t value) {
+  if (!enabled_) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(values_mutex_);
+  auto group_it = std::find_if(
+      values_.begin(), values_.end(),
+      [&group](const std::pair<string, ValueGroup>& entry) {
+        return entry.first == group;
+      });
+  if (group_it == values_.end()) {
+    group_it = values_.insert(values_.end(), {group, ValueGroup()});
+  }
+  ValueGroup& values = group_it->second;
+  auto it = std::find_if(values.begin(), values.end(),
+                         [&name](const std::pair<string, uint64_t>& entry) {
+                           return entry.first == name;
+                         });
+  if (it == values.end()) {
+    values.push_back({name, value});
+  } else {
+    it->second = value;
+  }
+}
+
+void IoStats::WriteJson(JsonWriter* writer) const {
+  writer->BeginObject();
+  writer->Key("counters");
+  writer->BeginObject();
+  for (int i = 0; i < static_cast<int>(IoCounter::COUNT); i++) {
+    writer->Key(kCounterNames[i]);
+    writer->Uint(counters_[i].load(std::memory_order_relaxed));
+  }
+  writer->EndObject();
+  writer->Key("latencies");
+  writer->BeginObject();
+  for (int i = 0; i < static_cast<int>(IoOp::COUNT); i++) {
+    writer->Key(kOpNames[i]);
+    latencies_[i].WriteJson(writer);
+  }
+  writer->EndObject();
+  std::lock_guard<std::mutex> lock(values_mutex_);
+  for (const auto& group : values_) {
+    writer->Key(group.first);
+    writer->BeginObject();
+    for (const auto& value : group.second) {
+      writer->Key(value.first);
+      writer->Uint(value.second);
+    }
+    writer->EndObject();
+  }
+  writer->EndObject();
+}
+
+Error WriteIoStatsReport(const string& path) {
+  JsonWriter writer;
+  IoStats::Get()->WriteJson(&writer);
+  writer.Newline();
+  if (path.empty()) {
+    std::cerr << writer.str() << std::flush;
+    return Error::Ok();
+  }
+  // Serialized first, so the report's own writes are not in it.
+  const string& text = writer.str();
+  ErrorOr<File> error_or_file = File::Create(path, 0664);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  for (size_t written = 0; written < text.size();) {
+    ErrorOr<ssize_t> error_or_written =
+        file.Write(text.data() + written, text.size() - written);
+    PASS_ERROR(error_or_written.error());
+    written += error_or_written.get();
+  }
+  return file.Close();
+}
+
+} // namespace io
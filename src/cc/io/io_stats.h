@@ -0,0 +1,135 @@
+#ifndef IO_IO_STATS_H_
+#define IO_IO_STATS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "cc/utils/clock.h"
+#include "cc/utils/error.h"
+#include "cc/utils/json_writer.h"
+
+namespace io {
+
+enum class IoCounter {
+  SYSCALLS,
+  SEEKS,
+  BYTES_READ,
+  BYTES_WRITTEN,
+  SECTORS_READ,
+  DIR_ENTRIES_DECODED,
+  // Bytes handed out by XdfsFile::Read, as opposed to read from the image.
+  XDFS_FILE_BYTES_READ,
+  // Bytes mapped into memory rather than read.
+  BYTES_MAPPED,
+  // Pages of a directly loaded XBE left to be loaded on first touch, and how
+  // many of those were touched.
+  DEMAND_PAGES,
+  DEMAND_PAGES_LOADED,
+  // Sections with at least one page loaded when the XBE stopped running.
+  SECTIONS_RESIDENT,
+  COUNT,
+};
+
+enum class IoOp {
+  FILE_READ,
+  FILE_WRITE,
+  FILE_SEEK,
+  XDFS_READ_SECTOR,
+  XDFS_READ_DIR_ENTRY,
+  XDFS_FILE_READ,
+  DEMAND_PAGE_FAULT,
+  COUNT,
+};
+
+// Latencies bucketed by powers of two nanoseconds.
+class LatencyHistogram {
+ public:
+  static const int kBucketCount = 64;
+
+  void Record(uint64_t ns);
+  void WriteJson(utils::JsonWriter* writer) const;
+
+  uint64_t total_ns() const {
+    return total_ns_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> count_{0};
+  std::atomic<uint64_t> total_ns_{0};
+  std::atomic<uint64_t> max_ns_{0};
+  std::atomic<uint64_t> buckets_[kBucketCount] = {};
+};
+
+// Process wide I/O statistics. Recording is off until Enable() is called so
+// that tools which do not ask for statistics pay only for a branch.
+class IoStats {
+ public:
+  static IoStats* Get();
+
+  void Enable() { enabled_ = true; }
+  bool enabled() const { return enabled_; }
+
+  void Add(IoCounter counter, uint64_t amount) {
+    if (enabled_) {
+      counters_[static_cast<int>(counter)].fetch_add(
+          amount, std::memory_order_relaxed);
+    }
+  }
+  uint64_t Value(IoCounter counter) const {
+    return counters_[static_cast<int>(counter)].load(std::memory_order_relaxed);
+  }
+  void RecordLatency(IoOp op, uint64_t ns) {
+    latencies_[static_cast<int>(op)].Record(ns);
+  }
+  const LatencyHistogram& Latency(IoOp op) const {
+    return latencies_[static_cast<int>(op)];
+  }
+  // Values a tool measures besides I/O, such as how long its own phases took,
+  // reported as "<group>": {"<name>": value, ...} in the order first set.
+  // Setting a name again replaces its value.
+  void SetValue(const std::string& group,
+                const std::string& name,
+                uint64_t value);
+
+  void WriteJson(utils::JsonWriter* writer) const;
+
+ private:
+  typedef std::vector<std::pair<std::string, uint64_t>> ValueGroup;
+
+  bool enabled_ = false;
+  std::atomic<uint64_t> counters_[static_cast<int>(IoCounter::COUNT)] = {};
+  LatencyHistogram latencies_[static_cast<int>(IoOp::COUNT)];
+  mutable std::mutex values_mutex_;
+  std::vector<std::pair<std::string, ValueGroup>> values_;
+};
+
+// Records the lifetime of the enclosing scope as one latency sample of op.
+class ScopedIoLatency {
+ public:
+  explicit ScopedIoLatency(IoOp op)
+      : op_(op),
+        start_ns_(IoStats::Get()->enabled() ? utils::MonotonicNowNs() : 0) {}
+  ~ScopedIoLatency() {
+    if (start_ns_ != 0) {
+      IoStats::Get()->RecordLatency(op_, utils::MonotonicNowNs() - start_ns_);
+    }
+  }
+
+ private:
+  const IoOp op_;
+  const uint64_t start_ns_;
+
+  ScopedIoLatency(const ScopedIoLatency&) = delete;
+  ScopedIoLatency& operator=(const ScopedIoLatency&) = delete;
+};
+
+// Writes the statistics as JSON to path, or to stderr if path is empty. Meant
+// to back the --stats flag of the command line tools.
+utils::Error WriteIoStatsReport(const std::string& path);
+
+} // namespace io
+
+#endif // IO_IO_STATS_H_
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "cc/io/io_stats.h"
+#include "cc/io/xdfs/xdfs_tree.h"
+#include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/trace.h"
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::vector;
+using io::IoStats;
+using io::WriteIoStatsReport;
+using io::xdfs::DiffXdfsTrees;
+using io::xdfs::LoadOrBuildXdfsTree;
+using io::xdfs::XdfsChange;
+using io::xdfs::XdfsChangeKind;
+using io::xdfs::XdfsTreeBase;
+using io::xdfs::XdfsTreeBuildStats;
+using io::xdfs::XdfsTreeNode;
+using utils::ErrorOr;
+using utils::Flags;
+
+namespace {
+char ChangeLetter(XdfsChangeKind kind) {
+  switch (kind) {
+    case XdfsChangeKind::ADDED:
+      return 'A';
+    case XdfsChangeKind::REMOVED:
+      return 'D';
+    case XdfsChangeKind::MODIFIED:
+      return 'M';
+  }
+  return '?';
+}
+
+void PrintBuildStats(const string& image_path,
+                     const XdfsTreeBuildStats& stats) {
+  if (stats.files == 0) {
+    return;
+  }
+  cerr << "Indexed " << image_path << ": " << stats.files << " files, "
+       << stats.files_hashed << " hashed (" << stats.bytes_hashed
+       << " bytes), " << stats.files_reused << " unchanged ("
+       << stats.bytes_compared << " bytes compared)." << endl;
+}
+} // namespace
+
+// Usage: diff_images <old image> <new image> [--no_cache]
+//                    [--stats[=<json path>]] [--trace=<json path>]
+//
+// Prints the files and directories that differ between two XDFS images, one
+// "A", "D" or "M" (added, deleted or modified) and path per line; an added or
+// deleted directory stands for everything in it.
+//
+// The images are compared through Merkle trees of their contents (see
+// io::xdfs::XdfsTreeNode), cached next to each image in <image>.xdfs_tree
+// unless --no_cache is given, so comparing images that were compared before
+// reads nothing else. The old image's tree is built first; the new one's
+// takes the old one's digests for files at the same path and extent whose
+// bytes compare equal, rather than hashing them again.
+int main(int argc, char* argv[]) {
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 2,
+             "Must specify the old and new images.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  const string& old_path = flags.positional()[0];
+  const string& new_path = flags.positional()[1];
+  const bool use_cache = !flags.Has("no_cache");
+
+  XdfsTreeBuildStats old_stats;
+  ErrorOr<XdfsTreeNode> error_or_old_root =
+      LoadOrBuildXdfsTree(old_path, nullptr, use_cache, &old_stats);
+  CHECK_ERROR(error_or_old_root.error());
+  PrintBuildStats(old_path, old_stats);
+  XdfsTreeBase base;
+  base.root = &error_or_old_root.get();
+  base.image_path = old_path;
+  XdfsTreeBuildStats new_stats;
+  ErrorOr<XdfsTreeNode> error_or_new_root =
+      LoadOrBuildXdfsTree(new_path, &base, use_cache, &new_stats);
+  CHECK_ERROR(error_or_new_root.error());
+  PrintBuildStats(new_path, new_stats);
+
+  const vector<XdfsChange> changes =
+      DiffXdfsTrees(error_or_old_root.get(), error_or_new_root.get());
+  for (const XdfsChange& change : changes) {
+    cout << ChangeLetter(change.kind) << " " << change.path << "\n";
+  }
+  cout.flush();
+
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
+  return 0;
+}
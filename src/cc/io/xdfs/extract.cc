@@ -0,0 +1,108 @@
+#include "cc/io/xdfs/extract.h"
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "cc/io/xdfs/xdfs_dir.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::vector;
+using utils::Error;
+using utils::ErrorOr;
+using utils::trace::Span;
+
+namespace io {
+namespace xdfs {
+namespace {
+Error MakeDirs(const string& root_dir, const vector<string>& dirs) {
+  for (const string& dir : dirs) {
+    RETURN_ERROR_SYSCALL(mkdir((root_dir + dir).c_str(), 0775), "");
+  }
+  return Error::Ok();
+}
+
+Error CopyFiles(Xdfs* xdfs,
+                const string& root_dir,
+                const vector<string>& xdfs_dirs,
+                std::ostream* progress) {
+  for (const string& xdfs_path : xdfs_dirs) {
+    if (progress != nullptr) {
+      *progress << "Extracting file " << xdfs_path << " ..." << std::endl;
+    }
+    ErrorOr<File> error_or_local_file
+        = File::Create(root_dir + xdfs_path, 0664);
+    PASS_ERROR(error_or_local_file.error());
+    ErrorOr<XdfsFile> error_or_xdfs_file = xdfs->OpenFile(xdfs_path);
+    PASS_ERROR(error_or_xdfs_file.error());
+    File local_file = error_or_local_file.move();
+    XdfsFile xdfs_file = error_or_xdfs_file.move();
+    Span span("CopyFile");
+    span.set_detail(xdfs_path);
+    PASS_ERROR(CopyFileFromTo(&xdfs_file, &local_file));
+    span.set_bytes(xdfs_file.size_bytes());
+  }
+  return Error::Ok();
+}
+} // namespace
+
+FilePathsAndDirPaths FindAllFilePaths(Xdfs* xdfs) {
+  Span span("FindAllFilePaths");
+  FilePathsAndDirPaths paths;
+  vector<string> dirs_to_search;
+  dirs_to_search.push_back("/");
+  while (!dirs_to_search.empty()) {
+    const string current_dir_path = dirs_to_search.back();
+    dirs_to_search.pop_back();
+
+    ErrorOr<XdfsDir> error_or_dir = xdfs->OpenDir(current_dir_path);
+    CHECK_ERROR(error_or_dir.error());
+    XdfsDir dir = error_or_dir.move();
+
+    ErrorOr<vector<XdfsDirEntry>> error_or_dir_entries = dir.ReadEntries();
+    CHECK_ERROR(error_or_dir_entries.error());
+    for (const XdfsDirEntry& entry : error_or_dir_entries.get()) {
+      string new_path = current_dir_path + entry.file_name;
+      if (IsDir(entry.attributes)) {
+        new_path += "/";
+        dirs_to_search.push_back(new_path);
+        paths.dir_paths.push_back(new_path);
+      } else {
+        paths.file_paths.push_back(new_path);
+      }
+    }
+  }
+  return paths;
+}
+
+Error CopyFileFromTo(XdfsFile* xdfs_file, File* local_file) {
+  const size_t buffer_size = 2048;
+  char buffer[buffer_size];
+  ssize_t amount_read = buffer_size;
+  while (amount_read == buffer_size) {
+    ErrorOr<ssize_t> error_or_amount_read =
+        xdfs_file->Read(buffer, buffer_size);
+    PASS_ERROR(error_or_amount_read.error());
+    amount_read = error_or_amount_read.get();
+    PASS_ERROR(local_file->Write(buffer, amount_read).error());
+  }
+  return Error::Ok();
+}
+
+Error ExtractAllFiles(Xdfs* xdfs,
+                      const string& root_dir,
+                      std::ostream* progress) {
+  FilePathsAndDirPaths file_paths_and_dir_paths = FindAllFilePaths(xdfs);
+  {
+    Span span("MakeDirs");
+    PASS_ERROR(MakeDirs(root_dir, file_paths_and_dir_paths.dir_paths));
+  }
+  PASS_ERROR(CopyFiles(xdfs,
+                       root_dir,
+                       file_paths_and_dir_paths.file_paths,
+                       progress));
+  return Error::Ok();
+}
+
+} // namespace xdfs
+} // namespace io
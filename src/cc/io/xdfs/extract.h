@@ -0,0 +1,34 @@
+#ifndef IO_XDFS_EXTRACT_H_
+#define IO_XDFS_EXTRACT_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "cc/io/file.h"
+#include "cc/io/xdfs/xdfs.h"
+#include "cc/io/xdfs/xdfs_file.h"
+#include "cc/utils/error.h"
+
+namespace io {
+namespace xdfs {
+
+struct FilePathsAndDirPaths {
+  std::vector<std::string> dir_paths;
+  std::vector<std::string> file_paths;
+};
+
+// Walks the whole directory tree. Directory paths end with '/'.
+FilePathsAndDirPaths FindAllFilePaths(Xdfs* xdfs);
+
+utils::Error CopyFileFromTo(XdfsFile* xdfs_file, File* local_file);
+
+// Recreates the tree of the image under root_dir, which must already exist.
+// If progress is non-null a line is written to it for every file extracted.
+utils::Error ExtractAllFiles(Xdfs* xdfs,
+                             const std::string& root_dir,
+                             std::ostream* progress);
+
+} // namespace xdfs
+} // namespace io
+
+#endif // IO_XDFS_EXTRACT_H_
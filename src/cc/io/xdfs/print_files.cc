@@ -3,18 +3,24 @@
 #include <vector>
 
 #include "cc/io/file.h"
+#include "cc/io/io_stats.h"
 #include "cc/io/xdfs/xdfs.h"
 #include "cc/io/xdfs/xdfs_dir.h"
 #include "cc/utils/error.h"
+#include "cc/utils/flags.h"
+#include "cc/utils/trace.h"
 
 using std::string;
 using std::vector;
 using io::File;
+using io::IoStats;
+using io::WriteIoStatsReport;
 using io::xdfs::IsDir;
 using io::xdfs::Xdfs;
 using io::xdfs::XdfsDir;
 using io::xdfs::XdfsDirEntry;
 using utils::ErrorOr;
+using utils::Flags;
 
 vector<string> FindAllFilePaths(Xdfs* xdfs) {
   vector<string> all_file_paths;
@@ -42,9 +48,18 @@ vector<string> FindAllFilePaths(Xdfs* xdfs) {
   return all_file_paths;
 }
 
+// Usage: print_files <iso> [--stats[=<json path>]] [--trace=<json path>]
 int main(int argc, char* argv[]) {
-  CHECK_INFO(argc == 2, "Path to ISO must be provided.");
-  ErrorOr<File> error_or_file = File::Open(argv[1], File::RD_ONLY);
+  const Flags flags = Flags::Parse(argc, argv);
+  CHECK_INFO(flags.positional().size() == 1, "Path to ISO must be provided.");
+  if (flags.Has("stats")) {
+    IoStats::Get()->Enable();
+  }
+  if (flags.Has("trace")) {
+    utils::trace::Enable();
+  }
+  ErrorOr<File> error_or_file =
+      File::Open(flags.positional()[0], File::RD_ONLY);
   CHECK_ERROR(error_or_file.error());
   ErrorOr<Xdfs> error_or_xdfs = Xdfs::CreateXdfs(error_or_file.move());
   CHECK_ERROR(error_or_xdfs.error());
@@ -53,5 +68,11 @@ int main(int argc, char* argv[]) {
   for (const string& file_path : all_file_paths) {
     std::cout << file_path << std::endl;
   }
+  if (flags.Has("stats")) {
+    CHECK_ERROR(WriteIoStatsReport(flags.GetString("stats", "")));
+  }
+  if (flags.Has("trace")) {
+    CHECK_ERROR(utils::trace::WriteTrace(flags.GetString("trace", "")));
+  }
   return 0;
 }
@@ -6,6 +6,8 @@
 #include <sstream>
 #include <vector>
 
+#include "cc/utils/trace.h"
+
 using std::string;
 using std::vector;
 using utils::ErrorOr;
@@ -34,6 +36,7 @@ struct VolumeDescriptorPart2 {
 };
 
 ErrorOr<VolumeDescriptor> ReadVolumeDescriptorAndVerify(File* file) {
+  utils::trace::Span span("ReadVolumeDescriptorAndVerify");
   PASS_ERROR(file->Seek(kVolumeDescriptorOffsetBytes).error());
   VolumeDescriptor descriptor;
   PASS_ERROR(
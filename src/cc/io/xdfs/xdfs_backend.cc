@@ -1,15 +1,21 @@
 #include "cc/io/xdfs/xdfs_backend.h"
 
+#include "cc/io/io_stats.h"
+
 using utils::ErrorOr;
 
 namespace io {
 namespace xdfs {
 
 ErrorOr<DirEntry> XdfsBackend::ReadDirEntry(size_t offset_bytes) {
+  ScopedIoLatency latency(IoOp::XDFS_READ_DIR_ENTRY);
+  IoStats::Get()->Add(IoCounter::DIR_ENTRIES_DECODED, 1);
   return ReadDirEntryAtOffset(&file_, offset_bytes);
 }
 
 ErrorOr<Sector> XdfsBackend::ReadSector(size_t offset_bytes) {
+  ScopedIoLatency latency(IoOp::XDFS_READ_SECTOR);
+  IoStats::Get()->Add(IoCounter::SECTORS_READ, 1);
   PASS_ERROR(file_.Seek(offset_bytes).error());
   Sector sector;
   PASS_ERROR(file_.Read(reinterpret_cast<char*>(&sector),
@@ -2,6 +2,8 @@
 
 #include <string>
 
+#include "cc/utils/trace.h"
+
 using std::string;
 using std::vector;
 using utils::ErrorOr;
@@ -18,7 +20,8 @@ vector<XdfsDirEntry> ReadEntriesImpl(XdfsBackend* backend, size_t offset_bytes)
     CHECK_ERROR(error_or_dir_entry.error());
     const DirEntry& entry = error_or_dir_entry.get();
     offsets_to_scan.pop_back();
-    results.push_back({entry.name, entry.attributes});
+    results.push_back(
+        {entry.name, entry.attributes, entry.start_sector, entry.size_bytes});
     if (entry.left_child_dwords > 0) {
       offsets_to_scan.push_back(
           entry.left_child_dwords * kDWordsBytes + offset_bytes);
@@ -34,6 +37,7 @@ vector<XdfsDirEntry> ReadEntriesImpl(XdfsBackend* backend, size_t offset_bytes)
 
 ErrorOr<vector<XdfsDirEntry>> XdfsDir::ReadEntries() {
   if (!entries_read_) {
+    utils::trace::Span span("XdfsDir::ReadEntries");
     cached_entries_ = ReadEntriesImpl(xdfs_backend_,
                                       SectorToOffset(attributes_.start_sector));
     entries_read_ = true;
@@ -13,6 +13,9 @@ namespace xdfs {
 struct XdfsDirEntry {
   std::string file_name;
   uint8_t attributes;
+  // The entry's extent: its first sector and its size.
+  uint32_t start_sector;
+  uint32_t size_bytes;
 };
 
 class XdfsDir {
@@ -2,6 +2,8 @@
 
 #include <algorithm>
 
+#include "cc/io/io_stats.h"
+
 using utils::Error;
 using utils::ErrorOr;
 
@@ -9,6 +11,7 @@ namespace io {
 namespace xdfs {
 
 ErrorOr<ssize_t> XdfsFile::Read(char* buffer, size_t max_to_read) {
+  ScopedIoLatency latency(IoOp::XDFS_FILE_READ);
   if (sector_offset_ < 0) {
     ErrorOr<Sector> error_or_sector =
         xdfs_backend_->ReadSector(SectorToOffset(attributes_.start_sector));
@@ -19,7 +22,9 @@ ErrorOr<ssize_t> XdfsFile::Read(char* buffer, size_t max_to_read) {
   ssize_t i;
   for (i = 0; static_cast<size_t>(i) < max_to_read
        && current_offset_ < attributes_.size_bytes; i++, current_offset_++) {
-    if (current_offset_ >=
+    // A seek may have moved the offset before the cached sector as well.
+    if (current_offset_ < static_cast<size_t>(sector_offset_)
+        || current_offset_ >=
         static_cast<size_t>(sector_offset_) + kSectorSizeBytes) {
       sector_offset_ = current_offset_ - (current_offset_ % kSectorSizeBytes);
       ErrorOr<Sector> error_or_sector = xdfs_backend_->ReadSector(
@@ -30,6 +35,7 @@ ErrorOr<ssize_t> XdfsFile::Read(char* buffer, size_t max_to_read) {
     CHECK(current_offset_ - sector_offset_ < kSectorSizeBytes);
     buffer[i] = current_sector_.data[current_offset_ - sector_offset_];
   }
+  IoStats::Get()->Add(IoCounter::XDFS_FILE_BYTES_READ, i);
   return ErrorOr<ssize_t>(std::move(i));
 }
 
@@ -38,7 +44,7 @@ ErrorOr<ssize_t> XdfsFile::Write(const char*, size_t) {
 }
 
 ErrorOr<size_t> XdfsFile::Seek(size_t offset) {
-  current_offset_ = std::max<size_t>(offset, attributes_.size_bytes);
+  current_offset_ = std::min<size_t>(offset, attributes_.size_bytes);
   ssize_t new_offset = current_offset_;
   return ErrorOr<size_t>(std::move(new_offset));
 }
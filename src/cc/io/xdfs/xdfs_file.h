@@ -15,6 +15,8 @@ class XdfsFile : public FileLike {
   utils::ErrorOr<size_t> Seek(size_t offset) override;
   utils::Error Close() override;
 
+  size_t size_bytes() const { return attributes_.size_bytes; }
+
  private:
   DirEntry attributes_;
   XdfsBackend* xdfs_backend_;
@@ -0,0 +1,457 @@
+#include "cc/io/xdfs/xdfs_tree.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "cc/io/file.h"
+#include "cc/io/xdfs/xdfs_dir.h"
+#include "cc/io/xdfs/xdfs_file.h"
+#include "cc/utils/trace.h"
+
+using std::string;
+using std::unique_ptr;
+using std::vector;
+using utils::Error;
+using utils::ErrorOr;
+using utils::Sha1;
+using utils::trace::Span;
+
+namespace io {
+namespace xdfs {
+namespace {
+const char kXdfsTreeMagic[4] = {'B', 'B', 'X', 'T'};
+const uint32_t kXdfsTreeVersion = 1;
+const size_t kChunkSize = 64 * 1024;
+
+// XdfsTreeRecord::flags.
+const uint8_t kXdfsTreeDir = 1 << 0;
+
+struct XdfsTreeHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t node_count;
+  uint32_t reserved;
+  uint64_t image_size;
+  uint64_t image_mtime_ns;
+};
+static_assert(sizeof(XdfsTreeHeader) == 32, "XdfsTreeHeader is packed.");
+
+struct XdfsTreeRecord {
+  uint32_t start_sector;
+  uint32_t size_bytes;
+  // Directories only.
+  uint32_t child_count;
+  uint8_t flags;
+  uint8_t name_size;
+  uint8_t reserved[2];
+  uint8_t digest[Sha1::kDigestSize];
+};
+static_assert(sizeof(XdfsTreeRecord) == 36, "XdfsTreeRecord is packed.");
+
+struct ImageStamp {
+  uint64_t size;
+  uint64_t mtime_ns;
+};
+
+ErrorOr<ImageStamp> StampOf(const string& image_path) {
+  struct stat image_stat;
+  RETURN_ERROR_SYSCALL(stat(image_path.c_str(), &image_stat),
+                       "Could not stat " + image_path);
+  ImageStamp stamp;
+  stamp.size = image_stat.st_size;
+  stamp.mtime_ns = image_stat.st_mtim.tv_sec * 1000000000ull
+      + image_stat.st_mtim.tv_nsec;
+  return ErrorOr<ImageStamp>(std::move(stamp));
+}
+
+ErrorOr<Xdfs> OpenImage(const string& image_path) {
+  ErrorOr<File> error_or_file = File::Open(image_path, File::RD_ONLY);
+  PASS_ERROR(error_or_file.error());
+  return Xdfs::CreateXdfs(error_or_file.move());
+}
+
+struct NameLess {
+  bool operator()(const XdfsTreeNode& node, const string& name) const {
+    return node.name < name;
+  }
+};
+
+// The child of dir named name, or null; dir may be null.
+const XdfsTreeNode* FindChild(const XdfsTreeNode* dir, const string& name) {
+  if (dir == nullptr) {
+    return nullptr;
+  }
+  auto it = std::lower_bound(dir->children.begin(), dir->children.end(), name,
+                             NameLess());
+  if (it == dir->children.end() || it->name != name) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+Sha1::Digest DirDigest(const vector<XdfsTreeNode>& children) {
+  Sha1 sha1;
+  for (const XdfsTreeNode& child : children) {
+    // The NUL ends the name, which never holds one.
+    sha1.Update(child.name.c_str(), child.name.size() + 1);
+    const uint8_t is_dir = child.is_dir;
+    sha1.Update(&is_dir, sizeof(is_dir));
+    sha1.Update(child.digest.bytes, sizeof(child.digest.bytes));
+  }
+  return sha1.Finish();
+}
+
+ErrorOr<Sha1::Digest> HashFile(XdfsFile* file, XdfsTreeBuildStats* stats) {
+  vector<char> buffer(kChunkSize);
+  Sha1 sha1;
+  while (true) {
+    ErrorOr<ssize_t> error_or_read = file->Read(buffer.data(), buffer.size());
+    PASS_ERROR(error_or_read.error());
+    if (error_or_read.get() == 0) {
+      break;
+    }
+    sha1.Update(buffer.data(), error_or_read.get());
+    stats->bytes_hashed += error_or_read.get();
+  }
+  stats->files_hashed++;
+  return ErrorOr<Sha1::Digest>(sha1.Finish());
+}
+
+// Reads both files, which are the same size, up to their first difference.
+ErrorOr<bool> SameContents(XdfsFile* file,
+                           XdfsFile* base_file,
+                           XdfsTreeBuildStats* stats) {
+  vector<char> buffer(kChunkSize);
+  vector<char> base_buffer(kChunkSize);
+  while (true) {
+    ErrorOr<ssize_t> error_or_read = file->Read(buffer.data(), buffer.size());
+    PASS_ERROR(error_or_read.error());
+    ErrorOr<ssize_t> error_or_base_read =
+        base_file->Read(base_buffer.data(), base_buffer.size());
+    PASS_ERROR(error_or_base_read.error());
+    const ssize_t size = error_or_read.get();
+    stats->bytes_compared += size;
+    if (size != error_or_base_read.get()
+        || memcmp(buffer.data(), base_buffer.data(), size) != 0) {
+      return ErrorOr<bool>(false);
+    }
+    if (size == 0) {
+      return ErrorOr<bool>(true);
+    }
+  }
+}
+
+class TreeBuilder {
+ public:
+  TreeBuilder(Xdfs* xdfs, const XdfsTreeBase* base, XdfsTreeBuildStats* stats)
+      : xdfs_(xdfs), base_(base), stats_(stats) {}
+
+  // path ends in '/'; base_dir, the directory at path in the base, may be
+  // null.
+  Error BuildDir(const string& path,
+                 const XdfsTreeNode* base_dir,
+                 XdfsTreeNode* dir) {
+    ErrorOr<XdfsDir> error_or_dir = xdfs_->OpenDir(path);
+    PASS_ERROR(error_or_dir.error());
+    XdfsDir xdfs_dir = error_or_dir.move();
+    ErrorOr<vector<XdfsDirEntry>> error_or_entries = xdfs_dir.ReadEntries();
+    PASS_ERROR(error_or_entries.error());
+    for (const XdfsDirEntry& entry : error_or_entries.get()) {
+      XdfsTreeNode child;
+      child.name = entry.file_name;
+      child.is_dir = IsDir(entry.attributes);
+      child.start_sector = entry.start_sector;
+      child.size_bytes = entry.size_bytes;
+      dir->children.push_back(std::move(child));
+    }
+    std::sort(dir->children.begin(), dir->children.end(),
+              [](const XdfsTreeNode& left, const XdfsTreeNode& right) {
+                return left.name < right.name;
+              });
+    for (XdfsTreeNode& child : dir->children) {
+      const XdfsTreeNode* base_child = FindChild(base_dir, child.name);
+      if (base_child != nullptr && base_child->is_dir != child.is_dir) {
+        base_child = nullptr;
+      }
+      if (child.is_dir) {
+        PASS_ERROR(BuildDir(path + child.name + "/", base_child, &child));
+      } else {
+        PASS_ERROR(BuildFile(path + child.name, base_child, &child));
+      }
+    }
+    dir->digest = DirDigest(dir->children);
+    return Error::Ok();
+  }
+
+ private:
+  Xdfs* const xdfs_;
+  const XdfsTreeBase* const base_;
+  XdfsTreeBuildStats* const stats_;
+  // Opened on first use.
+  unique_ptr<Xdfs> base_xdfs_;
+
+  Error BuildFile(const string& path,
+                  const XdfsTreeNode* base_file,
+                  XdfsTreeNode* file) {
+    stats_->files++;
+    ErrorOr<XdfsFile> error_or_file = xdfs_->OpenFile(path);
+    PASS_ERROR(error_or_file.error());
+    XdfsFile xdfs_file = error_or_file.move();
+    // Metadata first: only a file that kept its extent can be unchanged
+    // cheaply enough to be worth comparing rather than hashing.
+    if (base_file != nullptr && base_file->start_sector == file->start_sector
+        && base_file->size_bytes == file->size_bytes) {
+      if (base_xdfs_ == nullptr) {
+        ErrorOr<Xdfs> error_or_base_xdfs = OpenImage(base_->image_path);
+        PASS_ERROR(error_or_base_xdfs.error());
+        base_xdfs_.reset(new Xdfs(error_or_base_xdfs.move()));
+      }
+      ErrorOr<XdfsFile> error_or_base_file = base_xdfs_->OpenFile(path);
+      PASS_ERROR(error_or_base_file.error());
+      XdfsFile base_xdfs_file = error_or_base_file.move();
+      ErrorOr<bool> error_or_same =
+          SameContents(&xdfs_file, &base_xdfs_file, stats_);
+      PASS_ERROR(error_or_same.error());
+      if (error_or_same.get()) {
+        file->digest = base_file->digest;
+        stats_->files_reused++;
+        return Error::Ok();
+      }
+      PASS_ERROR(xdfs_file.Seek(0).error());
+    }
+    ErrorOr<Sha1::Digest> error_or_digest = HashFile(&xdfs_file, stats_);
+    PASS_ERROR(error_or_digest.error());
+    file->digest = error_or_digest.get();
+    return Error::Ok();
+  }
+};
+
+void AppendNode(const XdfsTreeNode& node, string* out, uint32_t* count) {
+  XdfsTreeRecord record = {};
+  record.start_sector = node.start_sector;
+  record.size_bytes = node.size_bytes;
+  record.child_count = node.children.size();
+  record.flags = node.is_dir ? kXdfsTreeDir : 0;
+  record.name_size = node.name.size();
+  memcpy(record.digest, node.digest.bytes, sizeof(record.digest));
+  out->append(reinterpret_cast<const char*>(&record), sizeof(record));
+  out->append(node.name);
+  (*count)++;
+  for (const XdfsTreeNode& child : node.children) {
+    AppendNode(child, out, count);
+  }
+}
+
+// Parses the node at *offset of data and its children, advancing *offset
+// past them; *nodes_left counts down the header's node_count.
+Error ParseNode(const string& data,
+                size_t* offset,
+                uint32_t* nodes_left,
+                XdfsTreeNode* node) {
+  RETURN_ERROR_IF(*nodes_left == 0
+                      || data.size() - *offset < sizeof(XdfsTreeRecord),
+                  "XDFS tree is truncated.");
+  (*nodes_left)--;
+  XdfsTreeRecord record;
+  memcpy(&record, data.data() + *offset, sizeof(record));
+  *offset += sizeof(record);
+  RETURN_ERROR_IF(data.size() - *offset < record.name_size,
+                  "XDFS tree is truncated.");
+  node->name = data.substr(*offset, record.name_size);
+  *offset += record.name_size;
+  node->is_dir = record.flags & kXdfsTreeDir;
+  node->start_sector = record.start_sector;
+  node->size_bytes = record.size_bytes;
+  memcpy(node->digest.bytes, record.digest, sizeof(record.digest));
+  RETURN_ERROR_IF(record.child_count > *nodes_left,
+                  "XDFS tree is corrupt.");
+  node->children.resize(record.child_count);
+  for (XdfsTreeNode& child : node->children) {
+    PASS_ERROR(ParseNode(data, offset, nodes_left, &child));
+  }
+  return Error::Ok();
+}
+
+void DiffDir(const XdfsTreeNode& old_dir,
+             const XdfsTreeNode& new_dir,
+             const string& path,
+             vector<XdfsChange>* changes) {
+  if (old_dir.digest == new_dir.digest) {
+    return;
+  }
+  auto old_it = old_dir.children.begin();
+  auto new_it = new_dir.children.begin();
+  while (old_it != old_dir.children.end()
+         || new_it != new_dir.children.end()) {
+    if (new_it == new_dir.children.end()
+        || (old_it != old_dir.children.end() && old_it->name < new_it->name)) {
+      changes->push_back({XdfsChangeKind::REMOVED,
+                          path + old_it->name + (old_it->is_dir ? "/" : "")});
+      ++old_it;
+    } else if (old_it == old_dir.children.end()
+               || new_it->name < old_it->name) {
+      changes->push_back({XdfsChangeKind::ADDED,
+                          path + new_it->name + (new_it->is_dir ? "/" : "")});
+      ++new_it;
+    } else {
+      if (old_it->is_dir != new_it->is_dir) {
+        changes->push_back(
+            {XdfsChangeKind::REMOVED,
+             path + old_it->name + (old_it->is_dir ? "/" : "")});
+        changes->push_back(
+            {XdfsChangeKind::ADDED,
+             path + new_it->name + (new_it->is_dir ? "/" : "")});
+      } else if (old_it->is_dir) {
+        DiffDir(*old_it, *new_it, path + old_it->name + "/", changes);
+      } else if (old_it->digest != new_it->digest) {
+        changes->push_back({XdfsChangeKind::MODIFIED, path + old_it->name});
+      }
+      ++old_it;
+      ++new_it;
+    }
+  }
+}
+} // namespace
+
+ErrorOr<XdfsTreeNode> BuildXdfsTree(Xdfs* xdfs,
+                                    const XdfsTreeBase* base,
+                                    XdfsTreeBuildStats* stats) {
+  Span span("BuildXdfsTree");
+  XdfsTreeBuildStats unused_stats;
+  TreeBuilder builder(xdfs, base, stats != nullptr ? stats : &unused_stats);
+  XdfsTreeNode root;
+  root.is_dir = true;
+  PASS_ERROR(builder.BuildDir("/",
+                              base != nullptr ? base->root : nullptr,
+                              &root));
+  return ErrorOr<XdfsTreeNode>(std::move(root));
+}
+
+string XdfsTreePathFor(const string& image_path) {
+  return image_path + ".xdfs_tree";
+}
+
+Error WriteXdfsTree(const XdfsTreeNode& root, const string& image_path) {
+  Span span("WriteXdfsTree");
+  ErrorOr<ImageStamp> error_or_stamp = StampOf(image_path);
+  PASS_ERROR(error_or_stamp.error());
+  XdfsTreeHeader header = {};
+  memcpy(header.magic, kXdfsTreeMagic, sizeof(header.magic));
+  header.version = kXdfsTreeVersion;
+  header.image_size = error_or_stamp.get().size;
+  header.image_mtime_ns = error_or_stamp.get().mtime_ns;
+  string nodes;
+  AppendNode(root, &nodes, &header.node_count);
+  string data(reinterpret_cast<const char*>(&header), sizeof(header));
+  data += nodes;
+
+  // Written aside and renamed into place, so that a reader never sees half
+  // of it.
+  const string path = XdfsTreePathFor(image_path);
+  const string temp_path = path + ".tmp-" + std::to_string(getpid());
+  {
+    ErrorOr<File> error_or_file = File::Create(temp_path, 0664);
+    PASS_ERROR(error_or_file.error());
+    File file = error_or_file.move();
+    for (size_t written = 0; written < data.size();) {
+      ErrorOr<ssize_t> error_or_written =
+          file.Write(data.data() + written, data.size() - written);
+      PASS_ERROR(error_or_written.error());
+      written += error_or_written.get();
+    }
+    PASS_ERROR(file.Close());
+  }
+  if (rename(temp_path.c_str(), path.c_str()) < 0) {
+    const string info = "Could not rename " + temp_path + " to " + path
+        + ": " + strerror(errno);
+    unlink(temp_path.c_str());
+    RETURN_ERROR(info);
+  }
+  span.set_bytes(data.size());
+  return Error::Ok();
+}
+
+ErrorOr<XdfsTreeNode> ReadXdfsTree(const string& image_path) {
+  Span span("ReadXdfsTree");
+  const string path = XdfsTreePathFor(image_path);
+  ErrorOr<File> error_or_file = File::Open(path, File::RD_ONLY);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  string data;
+  vector<char> buffer(kChunkSize);
+  while (true) {
+    ErrorOr<ssize_t> error_or_read = file.Read(buffer.data(), buffer.size());
+    PASS_ERROR(error_or_read.error());
+    if (error_or_read.get() == 0) {
+      break;
+    }
+    data.append(buffer.data(), error_or_read.get());
+  }
+  span.set_bytes(data.size());
+
+  XdfsTreeHeader header;
+  RETURN_ERROR_IF(data.size() < sizeof(header), path + " is truncated.");
+  memcpy(&header, data.data(), sizeof(header));
+  RETURN_ERROR_IF(memcmp(header.magic, kXdfsTreeMagic,
+                         sizeof(kXdfsTreeMagic)) != 0,
+                  "Not an XDFS tree: bad magic number.");
+  RETURN_ERROR_IF(header.version != kXdfsTreeVersion,
+                  "Unsupported XDFS tree version "
+                      + std::to_string(header.version));
+  ErrorOr<ImageStamp> error_or_stamp = StampOf(image_path);
+  PASS_ERROR(error_or_stamp.error());
+  RETURN_ERROR_IF(header.image_size != error_or_stamp.get().size
+                      || header.image_mtime_ns
+                          != error_or_stamp.get().mtime_ns,
+                  path + " is out of date.");
+  XdfsTreeNode root;
+  size_t offset = sizeof(header);
+  uint32_t nodes_left = header.node_count;
+  PASS_ERROR(ParseNode(data, &offset, &nodes_left, &root));
+  RETURN_ERROR_IF(nodes_left != 0 || offset != data.size(),
+                  path + " is corrupt.");
+  return ErrorOr<XdfsTreeNode>(std::move(root));
+}
+
+ErrorOr<XdfsTreeNode> LoadOrBuildXdfsTree(const string& image_path,
+                                          const XdfsTreeBase* base,
+                                          bool use_cache,
+                                          XdfsTreeBuildStats* stats) {
+  if (use_cache) {
+    ErrorOr<XdfsTreeNode> error_or_root = ReadXdfsTree(image_path);
+    if (error_or_root.error().is_ok()) {
+      return ErrorOr<XdfsTreeNode>(error_or_root.move());
+    }
+  }
+  ErrorOr<Xdfs> error_or_xdfs = OpenImage(image_path);
+  PASS_ERROR(error_or_xdfs.error());
+  Xdfs xdfs = error_or_xdfs.move();
+  ErrorOr<XdfsTreeNode> error_or_root = BuildXdfsTree(&xdfs, base, stats);
+  PASS_ERROR(error_or_root.error());
+  if (use_cache) {
+    // The cache only saves the next build, so e.g. a read-only directory
+    // must not fail this one.
+    const Error error = WriteXdfsTree(error_or_root.get(), image_path);
+    if (!error.is_ok()) {
+      std::cerr << "Not caching the tree of " << image_path << ":\n"
+                << error.error_info() << std::endl;
+    }
+  }
+  return ErrorOr<XdfsTreeNode>(error_or_root.move());
+}
+
+vector<XdfsChange> DiffXdfsTrees(const XdfsTreeNode& old_root,
+                                 const XdfsTreeNode& new_root) {
+  Span span("DiffXdfsTrees");
+  vector<XdfsChange> changes;
+  DiffDir(old_root, new_root, "/", &changes);
+  return changes;
+}
+
+} // namespace xdfs
+} // namespace io
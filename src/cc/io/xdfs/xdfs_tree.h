@@ -0,0 +1,100 @@
+#ifndef IO_XDFS_XDFS_TREE_H_
+#define IO_XDFS_XDFS_TREE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "cc/io/xdfs/xdfs.h"
+#include "cc/utils/error.h"
+#include "cc/utils/sha1.h"
+
+namespace io {
+namespace xdfs {
+
+// A Merkle tree over an image's directory tree: a file's digest is the SHA-1
+// of its contents and a directory's is the SHA-1 of its entries' names, kinds
+// and digests, so two directories with the same digest hold the same files
+// and comparing two images only descends into directories that differ.
+struct XdfsTreeNode {
+  // Empty for the root.
+  std::string name;
+  bool is_dir = false;
+  // Where the entry's extent is in the image.
+  uint32_t start_sector = 0;
+  uint32_t size_bytes = 0;
+  utils::Sha1::Digest digest = {};
+  // Sorted by name; only directories have any.
+  std::vector<XdfsTreeNode> children;
+};
+
+// A tree built for another image, usually the previous revision of the one
+// being built for, and the path of that image. Files at the same path with
+// the same extent in both images are compared byte for byte instead of
+// hashed, and take the base's digest if they are equal.
+struct XdfsTreeBase {
+  const XdfsTreeNode* root = nullptr;
+  std::string image_path;
+};
+
+struct XdfsTreeBuildStats {
+  uint64_t files = 0;
+  uint64_t files_hashed = 0;
+  // Files that took their digest from the base.
+  uint64_t files_reused = 0;
+  uint64_t bytes_hashed = 0;
+  // Bytes read from each image to compare files with the base.
+  uint64_t bytes_compared = 0;
+};
+
+// Reads every file of xdfs once, unless base spares it. base and stats may
+// be null.
+utils::ErrorOr<XdfsTreeNode> BuildXdfsTree(Xdfs* xdfs,
+                                           const XdfsTreeBase* base,
+                                           XdfsTreeBuildStats* stats);
+
+// The cache of an image's tree is kept next to it, in <image>.xdfs_tree:
+//
+//   header: "BBXT", uint32 version, uint32 node_count, uint32 reserved,
+//           uint64 image size, uint64 image mtime in ns
+//   nodes:  node_count XdfsTreeRecords in pre-order, each followed by its
+//           name_size byte name; a directory's children follow it
+//
+// It only stands for the image with the size and mtime it records.
+std::string XdfsTreePathFor(const std::string& image_path);
+
+utils::Error WriteXdfsTree(const XdfsTreeNode& root,
+                           const std::string& image_path);
+// Fails if there is no cache for image_path or it is out of date.
+utils::ErrorOr<XdfsTreeNode> ReadXdfsTree(const std::string& image_path);
+
+// Reads the cached tree of image_path or, if there is none that is up to
+// date, builds it and, if use_cache is set, caches it; a tree that cannot be
+// cached is still returned. stats are only updated by a build; base and stats
+// may be null.
+utils::ErrorOr<XdfsTreeNode> LoadOrBuildXdfsTree(const std::string& image_path,
+                                                 const XdfsTreeBase* base,
+                                                 bool use_cache,
+                                                 XdfsTreeBuildStats* stats);
+
+enum class XdfsChangeKind {
+  ADDED,
+  REMOVED,
+  MODIFIED,
+};
+
+struct XdfsChange {
+  XdfsChangeKind kind;
+  // Directory paths end in '/'. An added or removed directory stands for
+  // everything in it.
+  std::string path;
+};
+
+// Changes from old_root to new_root in path order. An entry that turned
+// from a file into a directory or back is removed and added.
+std::vector<XdfsChange> DiffXdfsTrees(const XdfsTreeNode& old_root,
+                                      const XdfsTreeNode& new_root);
+
+} // namespace xdfs
+} // namespace io
+
+#endif // IO_XDFS_XDFS_TREE_H_
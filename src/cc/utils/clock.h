@@ -0,0 +1,17 @@
+#ifndef UTILS_CLOCK_H_
+#define UTILS_CLOCK_H_
+
+#include <time.h>
+#include <cstdint>
+
+namespace utils {
+
+inline uint64_t MonotonicNowNs() {
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+}
+
+} // namespace utils
+
+#endif // UTILS_CLOCK_H_
@@ -0,0 +1,51 @@
+#include "cc/utils/csv_writer.h"
+
+namespace utils {
+
+void CsvWriter::Field(const char* value, size_t size) {
+  BeforeField();
+  bool needs_quotes = false;
+  for (size_t i = 0; i < size && !needs_quotes; i++) {
+    const char c = value[i];
+    needs_quotes = c == ',' || c == '"' || c == '\r' || c == '\n';
+  }
+  if (!needs_quotes) {
+    buffer_.append(value, size);
+    return;
+  }
+  buffer_ += '"';
+  for (size_t i = 0; i < size; i++) {
+    if (value[i] == '"') {
+      buffer_ += '"';
+    }
+    buffer_ += value[i];
+  }
+  buffer_ += '"';
+}
+
+void CsvWriter::Field(uint64_t value) {
+  BeforeField();
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  while (count > 0) {
+    buffer_ += digits[--count];
+  }
+}
+
+void CsvWriter::EndRecord() {
+  buffer_ += "\r\n";
+  at_record_start_ = true;
+}
+
+void CsvWriter::BeforeField() {
+  if (!at_record_start_) {
+    buffer_ += ',';
+  }
+  at_record_start_ = false;
+}
+
+} // namespace utils
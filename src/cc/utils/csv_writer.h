@@ -0,0 +1,31 @@
+#ifndef UTILS_CSV_WRITER_H_
+#define UTILS_CSV_WRITER_H_
+
+#include <cstdint>
+#include <string>
+
+namespace utils {
+
+// Appends RFC 4180 CSV to an internal buffer. Fields that contain a comma,
+// quote or line break are quoted. Like JsonWriter, the buffer is kept across
+// Clear().
+class CsvWriter {
+ public:
+  void Field(const std::string& value) { Field(value.data(), value.size()); }
+  void Field(const char* value, size_t size);
+  void Field(uint64_t value);
+  void EndRecord();
+
+  void Clear() { buffer_.clear(); at_record_start_ = true; }
+  const std::string& str() const { return buffer_; }
+
+ private:
+  std::string buffer_;
+  bool at_record_start_ = true;
+
+  void BeforeField();
+};
+
+} // namespace utils
+
+#endif // UTILS_CSV_WRITER_H_
@@ -0,0 +1,76 @@
+#include "cc/utils/flags.h"
+
+#include <cstdlib>
+
+#include "cc/utils/error.h"
+
+using std::string;
+
+namespace utils {
+
+Flags Flags::Parse(int argc, char* argv[]) {
+  Flags flags;
+  bool flags_done = false;
+  for (int i = 1; i < argc; i++) {
+    const string arg = argv[i];
+    if (flags_done || arg.size() < 3 || arg.compare(0, 2, "--") != 0) {
+      if (arg == "--") {
+        flags_done = true;
+      } else {
+        flags.positional_.push_back(arg);
+      }
+      continue;
+    }
+    const size_t equals_pos = arg.find('=');
+    if (equals_pos == string::npos) {
+      flags.flags_[arg.substr(2)] = "";
+    } else {
+      flags.flags_[arg.substr(2, equals_pos - 2)] = arg.substr(equals_pos + 1);
+    }
+  }
+  return flags;
+}
+
+bool Flags::Has(const string& name) const {
+  return flags_.count(name) > 0;
+}
+
+string Flags::GetString(const string& name, const string& default_value) const {
+  auto iter = flags_.find(name);
+  return iter == flags_.end() ? default_value : iter->second;
+}
+
+uint64_t Flags::GetUint(const string& name, uint64_t default_value) const {
+  auto iter = flags_.find(name);
+  if (iter == flags_.end()) {
+    return default_value;
+  }
+  uint64_t value;
+  CHECK_INFO(ParseUint(iter->second, &value),
+             "Flag --" + name + " expects a number, got: " + iter->second);
+  return value;
+}
+
+double Flags::GetDouble(const string& name, double default_value) const {
+  auto iter = flags_.find(name);
+  if (iter == flags_.end()) {
+    return default_value;
+  }
+  char* end;
+  const double value = strtod(iter->second.c_str(), &end);
+  CHECK_INFO(!iter->second.empty() && *end == '\0',
+             "Flag --" + name + " expects a number, got: " + iter->second);
+  return value;
+}
+
+bool ParseUint(const string& text, uint64_t* value) {
+  if (text.empty() || text[0] == '-') {
+    return false;
+  }
+  char* end;
+  errno = 0;
+  *value = strtoull(text.c_str(), &end, 0);
+  return errno == 0 && *end == '\0';
+}
+
+} // namespace utils
@@ -0,0 +1,37 @@
+#ifndef UTILS_FLAGS_H_
+#define UTILS_FLAGS_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+// Minimal command line parsing: "--name" and "--name=value" are flags, every
+// other argument is positional. A lone "--" ends flag parsing.
+class Flags {
+ public:
+  static Flags Parse(int argc, char* argv[]);
+
+  bool Has(const std::string& name) const;
+  std::string GetString(const std::string& name,
+                        const std::string& default_value) const;
+  // Accepts decimal and 0x prefixed hex; aborts on malformed numbers.
+  uint64_t GetUint(const std::string& name, uint64_t default_value) const;
+  double GetDouble(const std::string& name, double default_value) const;
+
+  const std::vector<std::string>& positional() const { return positional_; }
+
+ private:
+  std::map<std::string, std::string> flags_;
+  std::vector<std::string> positional_;
+};
+
+// Parses a decimal or 0x prefixed hex number; returns false if the whole
+// string is not a number.
+bool ParseUint(const std::string& text, uint64_t* value);
+
+} // namespace utils
+
+#endif // UTILS_FLAGS_H_
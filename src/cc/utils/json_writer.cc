@@ -0,0 +1,147 @@
+#include "cc/utils/json_writer.h"
+
+#include <cmath>
+#include <cstdio>
+
+using std::string;
+
+namespace utils {
+
+void JsonWriter::BeginObject() {
+  BeforeValue();
+  buffer_ += '{';
+  has_element_.push_back(false);
+}
+
+void JsonWriter::EndObject() {
+  has_element_.pop_back();
+  buffer_ += '}';
+}
+
+void JsonWriter::BeginArray() {
+  BeforeValue();
+  buffer_ += '[';
+  has_element_.push_back(false);
+}
+
+void JsonWriter::EndArray() {
+  has_element_.pop_back();
+  buffer_ += ']';
+}
+
+void JsonWriter::Key(const string& key) {
+  BeforeValue();
+  buffer_ += '"';
+  AppendEscaped(key.data(), key.size());
+  buffer_ += "\":";
+  after_key_ = true;
+}
+
+void JsonWriter::String(const string& value) {
+  String(value.data(), value.size());
+}
+
+void JsonWriter::String(const char* value, size_t size) {
+  BeforeValue();
+  buffer_ += '"';
+  AppendEscaped(value, size);
+  buffer_ += '"';
+}
+
+void JsonWriter::Uint(uint64_t value) {
+  BeforeValue();
+  // Digits are produced in reverse into a small stack buffer; this avoids the
+  // allocation std::to_string would do for every number.
+  char digits[20];
+  int count = 0;
+  do {
+    digits[count++] = '0' + value % 10;
+    value /= 10;
+  } while (value > 0);
+  while (count > 0) {
+    buffer_ += digits[--count];
+  }
+}
+
+void JsonWriter::Int(int64_t value) {
+  if (value < 0) {
+    BeforeValue();
+    buffer_ += '-';
+    // Uint() must not insert a comma between the sign and the digits.
+    after_key_ = true;
+    Uint(static_cast<uint64_t>(-(value + 1)) + 1);
+  } else {
+    Uint(value);
+  }
+}
+
+void JsonWriter::Double(double value) {
+  if (!std::isfinite(value)) {
+    Null();
+    return;
+  }
+  BeforeValue();
+  char text[32];
+  const int size = snprintf(text, sizeof(text), "%.15g", value);
+  buffer_.append(text, size);
+}
+
+void JsonWriter::Bool(bool value) {
+  BeforeValue();
+  buffer_ += value ? "true" : "false";
+}
+
+void JsonWriter::Null() {
+  BeforeValue();
+  buffer_ += "null";
+}
+
+void JsonWriter::Clear() {
+  buffer_.clear();
+  has_element_.clear();
+  after_key_ = false;
+}
+
+void JsonWriter::BeforeValue() {
+  if (after_key_) {
+    after_key_ = false;
+    return;
+  }
+  if (!has_element_.empty()) {
+    if (has_element_.back()) {
+      buffer_ += ',';
+    }
+    has_element_.back() = true;
+  }
+}
+
+void JsonWriter::AppendEscaped(const char* value, size_t size) {
+  static const char kHexDigits[] = "0123456789abcdef";
+  for (size_t i = 0; i < size; i++) {
+    const unsigned char c = value[i];
+    switch (c) {
+      case '"':
+        buffer_ += "\\\"";
+        break;
+      case '\\':
+        buffer_ += "\\\\";
+        break;
+      case '\n':
+        buffer_ += "\\n";
+        break;
+      case '\t':
+        buffer_ += "\\t";
+        break;
+      default:
+        if (c < 0x20) {
+          buffer_ += "\\u00";
+          buffer_ += kHexDigits[c >> 4];
+          buffer_ += kHexDigits[c & 0xf];
+        } else {
+          buffer_ += c;
+        }
+    }
+  }
+}
+
+} // namespace utils
@@ -0,0 +1,56 @@
+#ifndef UTILS_JSON_WRITER_H_
+#define UTILS_JSON_WRITER_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace utils {
+
+// Appends JSON to an internal buffer. Commas are inserted automatically, so
+// callers only describe structure:
+//
+//   JsonWriter writer;
+//   writer.BeginObject();
+//   writer.Key("size");
+//   writer.Uint(42);
+//   writer.EndObject();
+//
+// The buffer is kept across Clear() so that a single writer can be reused for
+// many records without reallocating.
+class JsonWriter {
+ public:
+  void BeginObject();
+  void EndObject();
+  void BeginArray();
+  void EndArray();
+
+  void Key(const std::string& key);
+  void String(const std::string& value);
+  void String(const char* value, size_t size);
+  void Uint(uint64_t value);
+  void Int(int64_t value);
+  void Double(double value);
+  void Bool(bool value);
+  void Null();
+
+  // Appends a newline without affecting comma placement; used to separate
+  // top level records (e.g. JSON lines output).
+  void Newline() { buffer_ += '\n'; }
+
+  void Clear();
+  const std::string& str() const { return buffer_; }
+
+ private:
+  std::string buffer_;
+  // One entry per open object or array; true once it has an element.
+  std::vector<bool> has_element_;
+  bool after_key_ = false;
+
+  void BeforeValue();
+  void AppendEscaped(const char* value, size_t size);
+};
+
+} // namespace utils
+
+#endif // UTILS_JSON_WRITER_H_
@@ -0,0 +1,43 @@
+#include "cc/utils/parallel_for.h"
+
+#include <sched.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+namespace utils {
+
+void ParallelFor(size_t count,
+                 int worker_count,
+                 const std::function<void(int worker, size_t index)>& body) {
+  std::atomic<size_t> next_index(0);
+  auto work = [&](int worker) {
+    for (size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+         index < count;
+         index = next_index.fetch_add(1, std::memory_order_relaxed)) {
+      body(worker, index);
+    }
+  };
+  // The calling thread is worker 0.
+  vector<std::thread> threads;
+  for (int worker = 1; worker < worker_count; worker++) {
+    threads.emplace_back(work, worker);
+  }
+  work(0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+int DefaultWorkerCount() {
+  cpu_set_t cpus;
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+    return std::max(CPU_COUNT(&cpus), 1);
+  }
+  return std::max<int>(std::thread::hardware_concurrency(), 1);
+}
+
+} // namespace utils
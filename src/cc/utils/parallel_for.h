@@ -0,0 +1,23 @@
+#ifndef UTILS_PARALLEL_FOR_H_
+#define UTILS_PARALLEL_FOR_H_
+
+#include <cstddef>
+#include <functional>
+
+namespace utils {
+
+// Calls body(worker, index) for every index in [0, count) on a pool of
+// worker_count threads, and returns once all calls have returned. Indexes are
+// handed out one at a time, so uneven work balances itself. worker is in
+// [0, worker_count) and identifies the calling thread, which lets callers keep
+// per-thread state (buffers, writers) without locking.
+void ParallelFor(size_t count,
+                 int worker_count,
+                 const std::function<void(int worker, size_t index)>& body);
+
+// The number of CPUs this process may run on, at least 1.
+int DefaultWorkerCount();
+
+} // namespace utils
+
+#endif // UTILS_PARALLEL_FOR_H_
@@ -0,0 +1,137 @@
+#include "cc/utils/sha1.h"
+
+#include <algorithm>
+#include <cstring>
+
+using std::string;
+
+namespace utils {
+namespace {
+uint32_t RotateLeft(uint32_t value, int bits) {
+  return (value << bits) | (value >> (32 - bits));
+}
+
+uint32_t LoadBigEndian(const uint8_t* bytes) {
+  return static_cast<uint32_t>(bytes[0]) << 24
+      | static_cast<uint32_t>(bytes[1]) << 16
+      | static_cast<uint32_t>(bytes[2]) << 8
+      | static_cast<uint32_t>(bytes[3]);
+}
+} // namespace
+
+bool Sha1::Digest::operator==(const Digest& other) const {
+  return memcmp(bytes, other.bytes, kDigestSize) == 0;
+}
+
+string Sha1::Digest::ToHex() const {
+  static const char kHexDigits[] = "0123456789abcdef";
+  string hex;
+  for (const uint8_t byte : bytes) {
+    hex += kHexDigits[byte >> 4];
+    hex += kHexDigits[byte & 0xf];
+  }
+  return hex;
+}
+
+Sha1::Sha1()
+    : state_{0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0} {}
+
+void Sha1::Update(const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  total_size_ += size;
+  if (block_size_ > 0) {
+    const size_t amount = std::min(size, sizeof(block_) - block_size_);
+    memcpy(block_ + block_size_, bytes, amount);
+    block_size_ += amount;
+    bytes += amount;
+    size -= amount;
+    if (block_size_ < sizeof(block_)) {
+      return;
+    }
+    ProcessBlock(block_);
+    block_size_ = 0;
+  }
+  // Whole blocks are hashed in place.
+  while (size >= sizeof(block_)) {
+    ProcessBlock(bytes);
+    bytes += sizeof(block_);
+    size -= sizeof(block_);
+  }
+  memcpy(block_, bytes, size);
+  block_size_ = size;
+}
+
+Sha1::Digest Sha1::Finish() {
+  const uint64_t total_bits = total_size_ * 8;
+  const uint8_t padding_start = 0x80;
+  Update(&padding_start, 1);
+  const uint8_t zero = 0;
+  while (block_size_ != sizeof(block_) - sizeof(total_bits)) {
+    Update(&zero, 1);
+  }
+  uint8_t length[sizeof(total_bits)];
+  for (size_t i = 0; i < sizeof(length); i++) {
+    length[i] = total_bits >> (56 - 8 * i);
+  }
+  Update(length, sizeof(length));
+
+  Digest digest;
+  for (int i = 0; i < 5; i++) {
+    digest.bytes[4 * i] = state_[i] >> 24;
+    digest.bytes[4 * i + 1] = state_[i] >> 16;
+    digest.bytes[4 * i + 2] = state_[i] >> 8;
+    digest.bytes[4 * i + 3] = state_[i];
+  }
+  return digest;
+}
+
+Sha1::Digest Sha1::Of(const void* data, size_t size) {
+  Sha1 sha1;
+  sha1.Update(data, size);
+  return sha1.Finish();
+}
+
+void Sha1::ProcessBlock(const uint8_t* block) {
+  uint32_t w[80];
+  for (int i = 0; i < 16; i++) {
+    w[i] = LoadBigEndian(block + 4 * i);
+  }
+  for (int i = 16; i < 80; i++) {
+    w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+  }
+  uint32_t a = state_[0];
+  uint32_t b = state_[1];
+  uint32_t c = state_[2];
+  uint32_t d = state_[3];
+  uint32_t e = state_[4];
+  for (int i = 0; i < 80; i++) {
+    uint32_t f;
+    uint32_t k;
+    if (i < 20) {
+      f = (b & c) | (~b & d);
+      k = 0x5a827999;
+    } else if (i < 40) {
+      f = b ^ c ^ d;
+      k = 0x6ed9eba1;
+    } else if (i < 60) {
+      f = (b & c) | (b & d) | (c & d);
+      k = 0x8f1bbcdc;
+    } else {
+      f = b ^ c ^ d;
+      k = 0xca62c1d6;
+    }
+    const uint32_t temp = RotateLeft(a, 5) + f + e + k + w[i];
+    e = d;
+    d = c;
+    c = RotateLeft(b, 30);
+    b = a;
+    a = temp;
+  }
+  state_[0] += a;
+  state_[1] += b;
+  state_[2] += c;
+  state_[3] += d;
+  state_[4] += e;
+}
+
+} // namespace utils
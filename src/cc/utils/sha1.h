@@ -0,0 +1,45 @@
+#ifndef UTILS_SHA1_H_
+#define UTILS_SHA1_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace utils {
+
+// SHA-1 (FIPS 180-4). Used where the XBE format does (section digests) and
+// for content addressing; not for anything that needs collision resistance
+// against an attacker.
+class Sha1 {
+ public:
+  static const size_t kDigestSize = 20;
+
+  struct Digest {
+    uint8_t bytes[kDigestSize];
+
+    bool operator==(const Digest& other) const;
+    bool operator!=(const Digest& other) const { return !(*this == other); }
+    // 40 lower case hex digits.
+    std::string ToHex() const;
+  };
+
+  Sha1();
+
+  void Update(const void* data, size_t size);
+  // The Sha1 must not be updated afterwards.
+  Digest Finish();
+
+  static Digest Of(const void* data, size_t size);
+
+ private:
+  uint32_t state_[5];
+  uint64_t total_size_ = 0;
+  uint8_t block_[64];
+  size_t block_size_ = 0;
+
+  void ProcessBlock(const uint8_t* block);
+};
+
+} // namespace utils
+
+#endif // UTILS_SHA1_H_
@@ -0,0 +1,169 @@
+#include "cc/utils/trace.h"
+
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "cc/io/file.h"
+#include "cc/utils/clock.h"
+#include "cc/utils/json_writer.h"
+
+using std::string;
+using std::vector;
+using io::File;
+
+namespace utils {
+namespace trace {
+namespace {
+struct Event {
+  const char* name;
+  uint64_t start_ns;
+  uint64_t duration_ns;
+  uint64_t bytes;
+  bool has_bytes;
+  string detail;
+};
+
+struct ThreadBuffer {
+  pid_t tid;
+  // Held by the thread to append and by WriteTrace to read events.
+  std::mutex mutex;
+  vector<Event> events;
+};
+
+// Buffers are owned here rather than by the thread so that spans recorded by
+// threads which have since exited are still written out.
+struct Registry {
+  std::mutex mutex;
+  vector<ThreadBuffer*> buffers;
+  uint64_t origin_ns = 0;
+};
+
+std::atomic<bool> enabled(false);
+
+Registry* GetRegistry() {
+  static Registry* registry = new Registry();
+  return registry;
+}
+
+ThreadBuffer* GetThreadBuffer() {
+  static thread_local ThreadBuffer* buffer = nullptr;
+  if (buffer == nullptr) {
+    buffer = new ThreadBuffer();
+    buffer->tid = syscall(SYS_gettid);
+    buffer->events.reserve(1024);
+    Registry* registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    registry->buffers.push_back(buffer);
+  }
+  return buffer;
+}
+
+void WriteMicros(JsonWriter* writer, uint64_t ns) {
+  writer->Double(ns / 1000.0);
+}
+} // namespace
+
+void Enable() {
+  GetRegistry()->origin_ns = MonotonicNowNs();
+  enabled.store(true, std::memory_order_release);
+}
+
+bool IsEnabled() {
+  return enabled.load(std::memory_order_acquire);
+}
+
+Span::Span(const char* name)
+    : name_(name), start_ns_(IsEnabled() ? MonotonicNowNs() : 0) {}
+
+Span::~Span() {
+  if (start_ns_ == 0) {
+    return;
+  }
+  const uint64_t end_ns = MonotonicNowNs();
+  ThreadBuffer* buffer = GetThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffer->mutex);
+  buffer->events.push_back({name_,
+                            start_ns_,
+                            end_ns - start_ns_,
+                            bytes_,
+                            has_bytes_,
+                            std::move(detail_)});
+}
+
+void Span::set_detail(const string& detail) {
+  if (start_ns_ != 0) {
+    detail_ = detail;
+  }
+}
+
+Error WriteTrace(const string& path) {
+  // Spans that started before this still finish; the buffer locks keep them
+  // from being appended while their buffer is read.
+  enabled.store(false, std::memory_order_release);
+  Registry* registry = GetRegistry();
+  const pid_t pid = getpid();
+  JsonWriter writer;
+  writer.BeginObject();
+  writer.Key("displayTimeUnit");
+  writer.String("ns");
+  writer.Key("traceEvents");
+  writer.BeginArray();
+  {
+    std::lock_guard<std::mutex> lock(registry->mutex);
+    for (ThreadBuffer* buffer : registry->buffers) {
+      std::lock_guard<std::mutex> buffer_lock(buffer->mutex);
+      for (const Event& event : buffer->events) {
+        writer.BeginObject();
+        writer.Key("name");
+        writer.String(event.name);
+        writer.Key("cat");
+        writer.String("boombox");
+        writer.Key("ph");
+        writer.String("X");
+        writer.Key("ts");
+        WriteMicros(&writer, event.start_ns - registry->origin_ns);
+        writer.Key("dur");
+        WriteMicros(&writer, event.duration_ns);
+        writer.Key("pid");
+        writer.Uint(pid);
+        writer.Key("tid");
+        writer.Uint(buffer->tid);
+        if (event.has_bytes || !event.detail.empty()) {
+          writer.Key("args");
+          writer.BeginObject();
+          if (event.has_bytes) {
+            writer.Key("bytes");
+            writer.Uint(event.bytes);
+          }
+          if (!event.detail.empty()) {
+            writer.Key("detail");
+            writer.String(event.detail);
+          }
+          writer.EndObject();
+        }
+        writer.EndObject();
+      }
+    }
+  }
+  writer.EndArray();
+  writer.EndObject();
+  writer.Newline();
+
+  const string& text = writer.str();
+  ErrorOr<File> error_or_file = File::Create(path, 0664);
+  PASS_ERROR(error_or_file.error());
+  File file = error_or_file.move();
+  for (size_t written = 0; written < text.size();) {
+    ErrorOr<ssize_t> error_or_written =
+        file.Write(text.data() + written, text.size() - written);
+    PASS_ERROR(error_or_written.error());
+    written += error_or_written.get();
+  }
+  return file.Close();
+}
+
+} // namespace trace
+} // namespace utils
@@ -0,0 +1,55 @@
+#ifndef UTILS_TRACE_H_
+#define UTILS_TRACE_H_
+
+#include <cstdint>
+#include <string>
+#include "cc/utils/error.h"
+
+namespace utils {
+namespace trace {
+
+// Timeline tracing in the Chrome trace-event format, loadable by Perfetto and
+// chrome://tracing. Each thread appends its spans to its own buffer, under a
+// lock only WriteTrace contends for. The buffers are kept in a process-wide
+// registry, so spans of threads that have exited are still written out.
+//
+// Usage:
+//   utils::trace::Span span("CopySegment");
+//   ...
+//   span.set_bytes(size);
+
+// Nothing is recorded until Enable() is called; disabled spans cost a branch.
+void Enable();
+bool IsEnabled();
+
+// Disables tracing and writes every span recorded so far, from all threads,
+// to path. Spans still open are not included.
+utils::Error WriteTrace(const std::string& path);
+
+class Span {
+ public:
+  // name must outlive the process (in practice: a string literal).
+  explicit Span(const char* name);
+  ~Span();
+
+  void set_bytes(uint64_t bytes) { bytes_ = bytes; has_bytes_ = true; }
+  void add_bytes(uint64_t bytes) { bytes_ += bytes; has_bytes_ = true; }
+  // Free form context shown with the span, e.g. a file path. Only copied
+  // while tracing is enabled.
+  void set_detail(const std::string& detail);
+
+ private:
+  const char* const name_;
+  const uint64_t start_ns_;
+  uint64_t bytes_ = 0;
+  bool has_bytes_ = false;
+  std::string detail_;
+
+  Span(const Span&) = delete;
+  Span& operator=(const Span&) = delete;
+};
+
+} // namespace trace
+} // namespace utils
+
+#endif // UTILS_TRACE_H_